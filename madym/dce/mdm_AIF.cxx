@@ -15,10 +15,17 @@
 #include <cmath>
 #include <istream>
 
+#include <algorithm>
+
 #include <madym/utils/mdm_exception.h>
 #include <madym/utils/mdm_ProgramLogger.h>
 #include <boost/format.hpp>
 
+const size_t mdm_AIF::IF_CACHE_SIZE = 8;
+const double mdm_AIF::IRF_TAIL_AMPLITUDES[2] = { 2.83, 2.12 };
+const double mdm_AIF::IRF_TAIL_RATES[2] = { 10.80, 1.82 };
+const double mdm_AIF::REGULAR_TIMES_TOL = 1e-6;
+
 //
 MDM_API mdm_AIF::mdm_AIF()
 	:
@@ -31,9 +38,20 @@ MDM_API mdm_AIF::mdm_AIF()
   resampled_PIF_(0),
 	Hct_(0.42),
 	prebolus_(8),
-	dose_(0.1)
-{
-
+	dose_(0.1),
+	AIFResampled_(false),
+	PIFResampled_(false),
+	AIFOffset_(0),
+	PIFOffset_(0),
+	PIFAIFOffset_(0),
+	IRFOffset_(0),
+	IRFHead_(0),
+	PIFConvolution_(mdm_Convolution::RECURSIVE),
+	AIFTimesRegular_(false),
+	AIFTimesDelta_(0),
+	cacheClock_(0)
+{
+	clearCache();
 }
 
 //
@@ -54,6 +72,7 @@ MDM_API void mdm_AIF::readAIF(const std::string &full_AIF_filename, const size_t
     throw;
   }
   setAIFType(AIF_FILE);
+  clearCache();
 }
 
 //
@@ -68,6 +87,7 @@ MDM_API void mdm_AIF::readPIF(const std::string &full_PIF_filename, const size_t
     throw;
   }
   setPIFType(PIF_FILE);
+  clearCache();
 
 }
 
@@ -108,6 +128,7 @@ MDM_API void mdm_AIF::setBaseAIF(const std::vector<double> &aifVals)
       % aifVals.size() % AIFTimes_.size());
   
   base_AIF_ = aifVals;
+  clearCache();
 }
 
 //
@@ -128,25 +149,35 @@ MDM_API void mdm_AIF::resample_AIF(double tOffset)
 	//Important this is only called after AIFTimes has been set
 	const auto nTimes = AIFTimes_.size();
 
-	switch (AIFtype_)
-	{
-	case AIF_STD:
-		aifWeinman(nTimes, tOffset);
-		break;
-	case AIF_FILE:
-  case AIF_MAP:
-		aifFromBase(nTimes, tOffset);
-		break;
-	case AIF_POP:
-		aifPopGJMP(nTimes, tOffset);
-		break;
+	//Nothing to do if already resampled at this offset
+	if (AIFResampled_ && tOffset == AIFOffset_ && resampled_AIF_.size() == nTimes)
+		return;
 
-	case AIF_UNDEFINED:
-	default:
-		// Add warning, quit here
-    throw "Tried to resample undefined AIF";
-		break;
+	if (!fetchFromCache(AIFCache_, tOffset, 0, resampled_AIF_))
+	{
+		switch (AIFtype_)
+		{
+		case AIF_STD:
+			aifWeinman(nTimes, tOffset);
+			break;
+		case AIF_FILE:
+		case AIF_MAP:
+			aifFromBase(nTimes, tOffset);
+			break;
+		case AIF_POP:
+			aifPopGJMP(nTimes, tOffset);
+			break;
+
+		case AIF_UNDEFINED:
+		default:
+			// Add warning, quit here
+			throw "Tried to resample undefined AIF";
+			break;
+		}
+		storeInCache(AIFCache_, tOffset, 0, resampled_AIF_);
 	}
+	AIFOffset_ = tOffset;
+	AIFResampled_ = true;
 }
 
 //
@@ -155,22 +186,48 @@ MDM_API void mdm_AIF::resample_PIF(double tOffset, bool offsetAIF/* = true*/, bo
 	//Important this is only called after AIFTimes has been set
 	const auto nTimes = AIFTimes_.size();
 
-	switch (PIFtype_)
+	//A population PIF is the current AIF convolved with an IRF, so depends on the
+	//AIF offset, and on the IRF offset, which is only changed if resampleIRF is set
+	double aifOffset = 0;
+	double irfOffset = tOffset;
+	if (PIFtype_ == PIF_POP)
 	{
+		if (offsetAIF || resampled_AIF_.size() != nTimes)
+			resample_AIF(tOffset);
+		aifOffset = AIFOffset_;
 
-	case PIF_FILE:
-		pifFromBase(nTimes, tOffset);
-		break;
+		if (!resampleIRF && PIF_IRF_.size() == nTimes && !std::isnan(PIF_IRF_[0]))
+			irfOffset = IRFOffset_;
+	}
 
-	case PIF_POP:
-		aifPopHepaticAB(nTimes, tOffset, offsetAIF, resampleIRF);
-		break;
-	case PIF_UNDEFINED:
-	default:
-		// Add warning, quit here
-    throw "Tried to resample undefined AIF";
-		break;
+	//Nothing to do if already resampled at these offsets
+	if (PIFResampled_ && irfOffset == PIFOffset_ && aifOffset == PIFAIFOffset_
+		&& resampled_PIF_.size() == nTimes)
+		return;
+
+	if (!fetchFromCache(PIFCache_, irfOffset, aifOffset, resampled_PIF_))
+	{
+		switch (PIFtype_)
+		{
+
+		case PIF_FILE:
+			pifFromBase(nTimes, tOffset);
+			break;
+
+		case PIF_POP:
+			aifPopHepaticAB(nTimes, irfOffset, false, resampleIRF);
+			break;
+		case PIF_UNDEFINED:
+		default:
+			// Add warning, quit here
+			throw "Tried to resample undefined AIF";
+			break;
+		}
+		storeInCache(PIFCache_, irfOffset, aifOffset, resampled_PIF_);
 	}
+	PIFOffset_ = irfOffset;
+	PIFAIFOffset_ = aifOffset;
+	PIFResampled_ = true;
 }
 
 //
@@ -184,6 +241,8 @@ MDM_API bool mdm_AIF::setAIFType(AIF_TYPE value)
     case AIF_FILE:
     case AIF_POP:
     case AIF_MAP:
+      if (AIFtype_ != value)
+        clearCache();
       AIFtype_ = value;
       setOK = true;
       break;
@@ -206,6 +265,8 @@ MDM_API bool mdm_AIF::setPIFType(PIF_TYPE value)
 	{
 	case PIF_FILE:
 	case PIF_POP:
+		if (PIFtype_ != value)
+			clearCache();
 		PIFtype_ = value;
 		setOK = true;
 		break;
@@ -231,6 +292,20 @@ MDM_API mdm_AIF::PIF_TYPE mdm_AIF::PIFType() const
 	return PIFtype_;
 }
 
+//
+MDM_API void mdm_AIF::setPIFConvolution(mdm_Convolution::ConvolutionType value)
+{
+	if (PIFConvolution_ != value)
+		clearCache();
+	PIFConvolution_ = value;
+}
+
+//
+MDM_API mdm_Convolution::ConvolutionType mdm_AIF::PIFConvolution() const
+{
+	return PIFConvolution_;
+}
+
 //
 MDM_API const std::vector<double>& mdm_AIF::AIFTimes() const
 {
@@ -258,24 +333,29 @@ MDM_API void mdm_AIF::setAIFTimes(const std::vector<double> times)
 	AIFTimes_.resize(nTimes);
 	for (size_t i = 0; i < nTimes; i++)
 		AIFTimes_[i] = times[i] - times[0];
+
+	updateAIFTimes();
 }
 
 //
 MDM_API void  mdm_AIF::setPrebolus(size_t p)
 {
 	prebolus_ = p;
+	clearCache();
 }
 
 //
 MDM_API void  mdm_AIF::setHct(double h)
 {
 	Hct_ = h;
+	clearCache();
 }
 
 //
 MDM_API void  mdm_AIF::setDose(double d)
 {
 	dose_ = d;
+	clearCache();
 }
 
 //
@@ -304,7 +384,6 @@ MDM_API double mdm_AIF::dose() const
 void mdm_AIF::aifPopGJMP(size_t nTimes, double tOffset)
 {
   double gaussian1, gaussian2, sigmoid;
-  std::vector<double> offsetTimes(nTimes);
 
   // These parameters are from Parker et al MRM 56:993(2006)
   // For gaussian1
@@ -321,22 +400,21 @@ void mdm_AIF::aifPopGJMP(size_t nTimes, double tOffset)
   const double kS      = 38.078;
   const double kTau    = 0.483;
 
-  // Get AIF timing data
-  for (size_t i = 0; i < nTimes; i++)
-    offsetTimes[i] = (double) (AIFTimes_[i] - AIFTimes_[0] + tOffset);
-
+  // Get AIF timing data - only the offset time at bolus arrival is needed, so
+  // compute it directly rather than filling an offset times vector on every call
   // TODO Trying out Anita's pb - 1 instead of 2 in GJMP AIF
+  const double offsetTime = AIFTimes_[prebolus_ - 1] - AIFTimes_[0] + tOffset;
 	resampled_AIF_.resize(nTimes);
   for (int i = 0; i < nTimes; i++)
   {
-    gaussian1 = kA1 * exp(-1.0 * ((double) AIFTimes_[i] - kMu1 - offsetTimes[(int) prebolus_ - 1])
-                               * ((double) AIFTimes_[i] - kMu1 - offsetTimes[(int) prebolus_ - 1])
+    gaussian1 = kA1 * exp(-1.0 * ((double) AIFTimes_[i] - kMu1 - offsetTime)
+                               * ((double) AIFTimes_[i] - kMu1 - offsetTime)
                                / (2.0 * kSigma1 * kSigma1));
-    gaussian2 = kA2 * exp(-1.0 * ((double) AIFTimes_[i] - kMu2 - offsetTimes[(int) prebolus_ - 1])
-                               * ((double) AIFTimes_[i] - kMu2 - offsetTimes[(int) prebolus_ - 1])
+    gaussian2 = kA2 * exp(-1.0 * ((double) AIFTimes_[i] - kMu2 - offsetTime)
+                               * ((double) AIFTimes_[i] - kMu2 - offsetTime)
                                / (2.0 * kSigma2 * kSigma2));
-    sigmoid   = kAlpha * exp(-kBeta * ((double) AIFTimes_[i] - offsetTimes[(int) prebolus_ - 1]))
-                       / (1 + exp(-kS * ((double) AIFTimes_[i] - kTau - offsetTimes[(int) prebolus_ - 1])));
+    sigmoid   = kAlpha * exp(-kBeta * ((double) AIFTimes_[i] - offsetTime))
+                       / (1 + exp(-kS * ((double) AIFTimes_[i] - kTau - offsetTime)));
     resampled_AIF_[i] = (double) (((dose_ / 0.1) * (gaussian1 + gaussian2 + sigmoid))
     		                    / (1.0 - Hct_));
   }
@@ -349,9 +427,11 @@ void mdm_AIF::aifPopHepaticAB(size_t nTimes, double tOffset, bool offsetAIF, boo
 		resample_AIF( tOffset);
 
 	//generate a population IRF according to Anita's model
-	if (resampleIRF || PIF_IRF_.size() != nTimes || std::isnan(PIF_IRF_[0]))
+	if ((resampleIRF && tOffset != IRFOffset_) || PIF_IRF_.size() != nTimes || std::isnan(PIF_IRF_[0]))
 	{
+		IRFOffset_ = tOffset;
 		PIF_IRF_.resize(nTimes);
+		IRFHead_ = nTimes;
 		double irf_sum = 0.0;
 		for (size_t i_t = 0; i_t < nTimes; i_t++)
 		{
@@ -361,34 +441,63 @@ void mdm_AIF::aifPopHepaticAB(size_t nTimes, double tOffset, bool offsetAIF, boo
 			else if (t < 0.17)
 				PIF_IRF_[i_t] = 24.16*t - 2.01;
 			else
-				PIF_IRF_[i_t] = 2.83*exp(-10.80*t) + 2.12*exp(-1.82*t);
+			{
+				PIF_IRF_[i_t] = IRF_TAIL_AMPLITUDES[0]*exp(-IRF_TAIL_RATES[0]*t)
+					+ IRF_TAIL_AMPLITUDES[1]*exp(-IRF_TAIL_RATES[1]*t);
+				if (IRFHead_ == nTimes)
+					IRFHead_ = i_t;
+			}
 
 			irf_sum += PIF_IRF_[i_t];
 		}
 		for (int i_t = 0; i_t < nTimes; i_t++)
 			PIF_IRF_[i_t] /= irf_sum;
+
+		//For recursive convolution, the bi-exponential tail from IRFHead_ onwards is
+		//expressed as weights at IRFHead_ and ratios between successive time-points
+		if (IRFHead_ < nTimes)
+		{
+			const double tHead = AIFTimes_[IRFHead_] - tOffset;
+			for (size_t m = 0; m < 2; m++)
+			{
+				IRFTailWeights_[m] = IRF_TAIL_AMPLITUDES[m] * exp(-IRF_TAIL_RATES[m] * tHead) / irf_sum;
+				IRFTailRatios_[m] = exp(-IRF_TAIL_RATES[m] * AIFTimesDelta_);
+			}
+		}
 	}
 	
 	//Convolve the AIF with the IRF to generate the PIF
 	resampled_PIF_.resize(nTimes);
 
-	//literal convolution operation
-	for (int i_t = 0; i_t < nTimes; i_t++)
+	//Recursive convolution needs the IRF tail sampled at regular intervals, so
+	//if times aren't regular, fall back to the literal convolution
+	auto convolution = PIFConvolution_;
+	if (convolution == mdm_Convolution::RECURSIVE && !AIFTimesRegular_)
+		convolution = mdm_Convolution::LITERAL;
+
+	switch (convolution)
 	{
-		double pif_sum = 0.0;
-		for (int j_t = 0, k_t = i_t; j_t <= i_t; j_t++, k_t--)
-		{
-			pif_sum += resampled_AIF_[j_t] * PIF_IRF_[k_t];
-		}
-		resampled_PIF_[i_t] = pif_sum;
+	case mdm_Convolution::RECURSIVE:
+		mdm_Convolution::recursive(resampled_AIF_.data(), PIF_IRF_.data(), IRFHead_,
+			IRFTailWeights_, IRFTailRatios_, 2, nTimes, resampled_PIF_.data());
+		break;
+	case mdm_Convolution::FFT:
+		mdm_Convolution::fft(resampled_AIF_.data(), PIF_IRF_.data(), nTimes, resampled_PIF_.data());
+		break;
+	case mdm_Convolution::LITERAL:
+	default:
+		mdm_Convolution::literal(resampled_AIF_.data(), PIF_IRF_.data(), nTimes, resampled_PIF_.data());
+		break;
 	}
 }
 
 //
 void mdm_AIF::aifWeinman(size_t nTimes, double tOffset)
 {
-  std::vector<double> AIF(nTimes), offsetTimes(nTimes);
-  double delta_t, remainder;
+  std::vector<double> &AIF = IFScratch_;
+  std::vector<double> &offsetTimes = offsetTimes_;
+  AIF.resize(nTimes);
+  offsetTimes.resize(nTimes);
 
   /* From original paper TODO get Weinman ref */
   const double kAlpha1 = 3.99;
@@ -411,21 +520,12 @@ void mdm_AIF::aifWeinman(size_t nTimes, double tOffset)
   }
   
 	//Linear resample AIF to shifted time points
+  resampled_AIF_.resize(nTimes);
   resampled_AIF_[0] = 0.0;
-  for (size_t i = 1; i < nTimes; i++)
-  {
-    if (AIFTimes_[i] <= offsetTimes[0])
-      resampled_AIF_[i] = 0.0;
-    for (size_t j = 1; j < nTimes; j++)
-      // find where in the AIF time series the current tissue time point falls
-      if (AIFTimes_[i] > offsetTimes[j - 1] && AIFTimes_[i] <= offsetTimes[j])
-      {
-        delta_t = offsetTimes[j] - offsetTimes[j - 1];
-        remainder = AIFTimes_[i] - offsetTimes[j - 1];
-        resampled_AIF_[i] = remainder / delta_t * AIF[j]
-                           + (1.0 - remainder / delta_t) * AIF[j - 1];
-      }
-  }
+  for (size_t i = 1; i < nTimes && AIFTimes_[i] <= offsetTimes[0]; i++)
+    resampled_AIF_[i] = 0.0;
+
+  linearResample(resampled_AIF_, AIF, offsetTimes, nTimes, 1.0);
 }
 
 //
@@ -447,8 +547,8 @@ void mdm_AIF::pifFromBase(size_t nTimes, double tOffset)
 void mdm_AIF::resampleBase(std::vector<double> &resampled_if, const std::vector<double> &loaded_if,
   size_t nTimes, double tOffset)
 {
-	std::vector<double> offsetTimes(nTimes);
-	double delta_t, remainder;
+	std::vector<double> &offsetTimes = offsetTimes_;
+	offsetTimes.resize(nTimes);
 
 	// Get AIF timing data
 	for (size_t i = 0; i < nTimes; i++)
@@ -457,21 +557,105 @@ void mdm_AIF::resampleBase(std::vector<double> &resampled_if, const std::vector<
 
 	// Linear resample AIF to shifted time points
 	resampled_if.resize(nTimes);
+	linearResample(resampled_if, loaded_if, offsetTimes, nTimes, 1.0 - Hct_);
+}
+
+//Linearly interpolate input function at the AIF times
+void mdm_AIF::linearResample(std::vector<double> &resampled_if, const std::vector<double> &if_vals,
+  const std::vector<double> &offsetTimes, size_t nTimes, double scale)
+{
+	// Both AIF and offset times are increasing, so the interval of offset times
+	// containing each AIF time can only move forward. We can therefore find all the
+	// intervals in a single pass through both time arrays, rather than searching from
+	// the start for each time-point. Time-points outside the range of the offset times
+	// are not set.
+	size_t j = 1;
 	for (size_t i = 1; i < nTimes; i++)
 	{
-		for (size_t j = 1; j < nTimes; j++)
+		const double t = AIFTimes_[i];
+
+		// find where in the AIF time series the current tissue time point falls
+		while (j < nTimes && !(t <= offsetTimes[j]))
+			j++;
+
+		if (j == nTimes)
+			break;
+
+		if (t > offsetTimes[j - 1])
 		{
-			// find where in the AIF time series the current tissue time point falls
-			if (AIFTimes_[i] > offsetTimes[j - 1] && AIFTimes_[i] <= offsetTimes[j])
-			{
-				delta_t = offsetTimes[j] - offsetTimes[j - 1];
-				remainder = AIFTimes_[i] - offsetTimes[j - 1];
-				resampled_if[i] = ((remainder / delta_t) * loaded_if[j]
-					+ (1.0 - remainder / delta_t) * loaded_if[j - 1])
-					/ (1.0 - Hct_);
+			double delta_t = offsetTimes[j] - offsetTimes[j - 1];
+			double remainder = t - offsetTimes[j - 1];
+			resampled_if[i] = ((remainder / delta_t) * if_vals[j]
+				+ (1.0 - remainder / delta_t) * if_vals[j - 1])
+				/ scale;
+		}
+	}
+}
 
-				break;
-			}
+//
+bool mdm_AIF::fetchFromCache(std::vector<IFCacheEntry> &cache,
+	double offset, double aifOffset, std::vector<double> &resampled_if)
+{
+	for (auto &entry : cache)
+	{
+		if (entry.valid && entry.offset == offset && entry.aifOffset == aifOffset)
+		{
+			entry.lastUsed = ++cacheClock_;
+			resampled_if.assign(entry.values.begin(), entry.values.end());
+			return true;
+		}
+	}
+	return false;
+}
+
+//
+void mdm_AIF::storeInCache(std::vector<IFCacheEntry> &cache,
+	double offset, double aifOffset, const std::vector<double> &resampled_if)
+{
+	//Use an empty entry if there is one, otherwise replace the least recently used
+	auto entry = std::min_element(cache.begin(), cache.end(),
+		[](const IFCacheEntry &a, const IFCacheEntry &b) {
+			if (a.valid != b.valid)
+				return !a.valid;
+			return a.lastUsed < b.lastUsed;
+		});
+
+	entry->valid = true;
+	entry->offset = offset;
+	entry->aifOffset = aifOffset;
+	entry->lastUsed = ++cacheClock_;
+	entry->values.assign(resampled_if.begin(), resampled_if.end());
+}
+
+//
+void mdm_AIF::updateAIFTimes()
+{
+	//Check if times are regularly spaced, as required for recursive PIF convolution
+	const auto nTimes = AIFTimes_.size();
+	AIFTimesDelta_ = nTimes > 1 ? AIFTimes_[1] - AIFTimes_[0] : 0;
+	AIFTimesRegular_ = AIFTimesDelta_ > 0;
+	for (size_t i = 2; i < nTimes && AIFTimesRegular_; i++)
+		AIFTimesRegular_ =
+			std::abs(AIFTimes_[i] - AIFTimes_[0] - i * AIFTimesDelta_) <= REGULAR_TIMES_TOL * AIFTimesDelta_;
+	clearCache();
+}
+
+//
+void mdm_AIF::clearCache()
+{
+	AIFResampled_ = false;
+	PIFResampled_ = false;
+	PIF_IRF_.clear();
+
+	//Reserve space for cache entries up front, so filling the cache during model
+	//fitting doesn't allocate
+	for (auto cache : { &AIFCache_, &PIFCache_ })
+	{
+		cache->resize(IF_CACHE_SIZE);
+		for (auto &entry : *cache)
+		{
+			entry.valid = false;
+			entry.values.reserve(AIFTimes_.size());
 		}
 	}
 }
@@ -508,7 +692,10 @@ void mdm_AIF::readIFFromFile(std::vector<double> &loaded_if,
 
 	//Check if we have existing times, if not, use the times we've just read from the file
 	if (AIFTimes_.size() != nDynamics)
+	{
 		AIFTimes_ = timesFromFile;
+		updateAIFTimes();
+	}
 
 	mdm_ProgramLogger::logProgramMessage(
 		"IF successfully read from " + filename);
@@ -10,6 +10,7 @@
 #include <madym/utils/mdm_api.h>
 
 #include <madym/utils/mdm_Image3D.h>
+#include <madym/dce/mdm_Convolution.h>
 
  //! Reading, writing, generating and resampling vascular input functions for DCE TK models
 	/*!
@@ -156,11 +157,16 @@ public:
 	//! Resample the AIF at given time offset
 	 For AIFs loaded from file, this returns a bilinear interpolation of the AIF values
 	 at times + tOffset. For population forms, the AIF function is recomputed at the offset times.
+
+	 Resampled AIFs are cached by offset, so if the offset is unchanged since the last call
+	 nothing is recomputed, and recently used offsets are copied from the cache.
 	*/
 	MDM_API void resample_AIF(double tOffset);
 
 	//! Resample the PIF at given time offset
 	/*!
+	 As for resample_AIF, resampled PIFs are cached. For population PIFs the cache is keyed on
+	 both the PIF offset and the offset of the AIF it was convolved with.
 	*/
 	MDM_API void resample_PIF(double tOffset, bool offsetAIF = true, bool resampleIRF = true);
 
@@ -188,6 +194,21 @@ public:
 	*/
 	MDM_API PIF_TYPE  PIFType() const;
 
+	//! Set the method used to convolve the AIF with the IRF when generating population PIFs
+	/*!
+	The default, RECURSIVE, updates the bi-exponential tail of the IRF recursively, and is linear
+	in the number of time-points. It requires regularly spaced AIF times, otherwise the LITERAL
+	convolution is used instead.
+	\see mdm_Convolution::ConvolutionType
+	*/
+	MDM_API void setPIFConvolution(mdm_Convolution::ConvolutionType value);
+
+	//! Get the method used to convolve the AIF with the IRF when generating population PIFs
+	/*!
+	\see setPIFConvolution
+	*/
+	MDM_API mdm_Convolution::ConvolutionType PIFConvolution() const;
+
 	//! Get time (in minutes) of each AIF time-point
 	/*!
 	*/
@@ -263,10 +284,38 @@ private:
 	//Resample hepatic portal vein input funtion previously loaded from file
 	void pifFromBase(size_t nData, double tOffset);
 
+	//Linearly interpolate input function values at offset times to the AIF times,
+	//dividing by scale. Runs in O(nTimes)
+	void linearResample(std::vector<double> &resampled_if, const std::vector<double> &if_vals,
+		const std::vector<double> &offsetTimes, size_t nTimes, double scale);
+
 	//Load input funtion previously loaded from file
 	void resampleBase(std::vector<double> &resampled_if, const std::vector<double> &loaded_if,
     size_t nData, double tOffset);
 
+	//Cache of resampled input functions, keyed on resampling offset
+	struct IFCacheEntry {
+		bool valid;
+		double offset;
+		double aifOffset;
+		size_t lastUsed;
+		std::vector<double> values;
+	};
+
+	//Copy a cached input function into resampled_if if a matching entry exists
+	bool fetchFromCache(std::vector<IFCacheEntry> &cache,
+		double offset, double aifOffset, std::vector<double> &resampled_if);
+
+	//Store resampled_if in the cache, replacing the least recently used entry
+	void storeInCache(std::vector<IFCacheEntry> &cache,
+		double offset, double aifOffset, const std::vector<double> &resampled_if);
+
+	//Invalidate cached input functions, called whenever any data they depend on changes
+	void clearCache();
+
+	//Check whether AIF times are regularly spaced and clear the cache, called whenever AIF times change
+	void updateAIFTimes();
+
 	//Load/save an AIF from/to file
 	void readIFFromFile(std::vector<double> &loaded_if, const std::string &filename, const size_t nDynamics);
   void writeIFToFile(const std::vector<double> &if_to_save, const std::string &filename);
@@ -282,6 +331,41 @@ private:
 	std::vector<double> base_PIF_;
 	std::vector<double> PIF_IRF_;
 	std::vector<double> AIFTimes_;
+
+	//Scratch buffers reused when resampling, so repeated calls during model fitting
+	//don't allocate
+	std::vector<double> offsetTimes_;
+	std::vector<double> IFScratch_;
+
+	//Offsets of currently resampled AIF, PIF and population PIF IRF
+	bool AIFResampled_;
+	bool PIFResampled_;
+	double AIFOffset_;
+	double PIFOffset_;
+	double PIFAIFOffset_;
+	double IRFOffset_;
+
+	//Population PIF IRF, as a head of IRFHead_ samples followed by a bi-exponential tail,
+	//used for recursive convolution
+	static const double IRF_TAIL_AMPLITUDES[2];
+	static const double IRF_TAIL_RATES[2];
+	size_t IRFHead_;
+	double IRFTailWeights_[2];
+	double IRFTailRatios_[2];
+	mdm_Convolution::ConvolutionType PIFConvolution_;
+
+	//Whether AIF times are regularly spaced (to within REGULAR_TIMES_TOL of the spacing),
+	//and the spacing
+	static const double REGULAR_TIMES_TOL;
+	bool AIFTimesRegular_;
+	double AIFTimesDelta_;
+
+	//Bounded LRU caches of resampled input functions
+	static const size_t IF_CACHE_SIZE;
+	std::vector<IFCacheEntry> AIFCache_;
+	std::vector<IFCacheEntry> PIFCache_;
+	size_t cacheClock_;
+
 	size_t prebolus_;
 	double  Hct_;
 	double  dose_;
@@ -0,0 +1,111 @@
+/**
+*  @file    mdm_Convolution.cxx
+*  @brief   Implementation of mdm_Convolution class
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+#ifndef MDM_API_EXPORTS
+#define MDM_API_EXPORTS
+#endif // !MDM_API_EXPORTS
+
+#include "mdm_Convolution.h"
+
+#include <algorithm>
+
+#include "opt/fasttransforms.h"
+#include <madym/utils/mdm_exception.h>
+#include <boost/format.hpp>
+
+const size_t mdm_Convolution::MAX_TAIL_EXPONENTIALS;
+
+//
+MDM_API std::string mdm_Convolution::typeToString(ConvolutionType type)
+{
+	switch (type)
+	{
+	case LITERAL:
+		return "LITERAL";
+	case RECURSIVE:
+		return "RECURSIVE";
+	case FFT:
+		return "FFT";
+	default:
+		throw mdm_exception(__func__, "Convolution type " + std::to_string(type) + " not recognised");
+	}
+}
+
+//
+MDM_API mdm_Convolution::ConvolutionType mdm_Convolution::typeFromString(const std::string &type)
+{
+	if (type == "LITERAL")
+		return LITERAL;
+	else if (type == "RECURSIVE")
+		return RECURSIVE;
+	else if (type == "FFT")
+		return FFT;
+	else
+		throw mdm_exception(__func__, "Convolution type " + type + " not recognised");
+}
+
+//
+MDM_API void mdm_Convolution::literal(const double *x, const double *h, size_t n, double *y)
+{
+	for (size_t i_t = 0; i_t < n; i_t++)
+	{
+		double sum = 0.0;
+		for (size_t j_t = 0; j_t <= i_t; j_t++)
+			sum += x[j_t] * h[i_t - j_t];
+		y[i_t] = sum;
+	}
+}
+
+//
+MDM_API void mdm_Convolution::recursive(const double *x, const double *h, size_t nHead,
+	const double *tailWeights, const double *tailRatios, size_t nExponentials,
+	size_t n, double *y)
+{
+	if (nExponentials > MAX_TAIL_EXPONENTIALS)
+		throw mdm_exception(__func__, boost::format(
+			"Recursive convolution supports at most %1% exponentials, %2% given")
+			% MAX_TAIL_EXPONENTIALS % nExponentials);
+
+	//Tail sums for each exponential, S_m[i] = sum_{j <= i-nHead} x[j].w_m.r_m^(i-nHead-j),
+	//which satisfy S_m[i] = r_m.S_m[i-1] + w_m.x[i-nHead]
+	double tailSums[MAX_TAIL_EXPONENTIALS] = { 0 };
+
+	for (size_t i_t = 0; i_t < n; i_t++)
+	{
+		//Head of the IRF, summed directly
+		double sum = 0.0;
+		const size_t nK = std::min(i_t + 1, nHead);
+		for (size_t k_t = 0; k_t < nK; k_t++)
+			sum += x[i_t - k_t] * h[k_t];
+
+		//Tail of the IRF, updated recursively
+		if (i_t >= nHead)
+		{
+			for (size_t m = 0; m < nExponentials; m++)
+			{
+				tailSums[m] = tailRatios[m] * tailSums[m] + tailWeights[m] * x[i_t - nHead];
+				sum += tailSums[m];
+			}
+		}
+		y[i_t] = sum;
+	}
+}
+
+//
+MDM_API void mdm_Convolution::fft(const double *x, const double *h, size_t n, double *y)
+{
+	if (!n)
+		return;
+
+	alglib::real_1d_array xa, ha, ya;
+	xa.setcontent((alglib::ae_int_t)n, x);
+	ha.setcontent((alglib::ae_int_t)n, h);
+	alglib::convr1d(xa, (alglib::ae_int_t)n, ha, (alglib::ae_int_t)n, ya);
+
+	//Full convolution has 2n-1 samples, we only want the first n
+	const double *yc = ya.getcontent();
+	std::copy(yc, yc + n, y);
+}
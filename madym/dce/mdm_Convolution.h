@@ -0,0 +1,89 @@
+/**
+*  @file    mdm_Convolution.h
+*  @brief   Discrete convolution of input functions with impulse response functions
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_CONVOLUTION_HDR
+#define MDM_CONVOLUTION_HDR
+
+#include <madym/utils/mdm_api.h>
+#include <cstddef>
+#include <string>
+
+//! Discrete convolution of input functions with impulse response functions
+/*!
+All methods compute the causal discrete convolution y[i] = sum_{j<=i} x[j].h[i-j], for
+i = 0,...,n-1, of an input function x with an impulse response function (IRF) h, both
+sampled at the same n time-points. Three methods are available:
+
+- LITERAL: direct summation, O(n^2)
+- RECURSIVE: for IRFs that, after an arbitrary head of nHead samples, are a sum of
+	exponentials decaying geometrically with sample index (ie exponentials sampled at regular
+	time intervals). The head is summed directly, and each exponential term of the tail updated
+	recursively, O(n.nHead)
+- FFT: using ALGLIB's FFT convolution, O(n log n). Unlike the other methods, this allocates
+	working memory on each call
+
+All methods give the same result, up to floating point rounding.
+*/
+class mdm_Convolution {
+
+public:
+
+	//! Convolution methods
+	enum ConvolutionType {
+		LITERAL = 0, ///< Direct summation
+		RECURSIVE = 1, ///< Recursive update of an exponential IRF tail
+		FFT = 2 ///< Fast Fourier transform
+	};
+
+	//! Return string name of convolution type
+	MDM_API static std::string typeToString(ConvolutionType type);
+
+	//! Return convolution type from string
+	MDM_API static ConvolutionType typeFromString(const std::string &type);
+
+	//! Maximum number of exponentials in the tail of an IRF for recursive convolution
+	static const size_t MAX_TAIL_EXPONENTIALS = 4;
+
+	//! Convolve by direct summation
+	/*!
+	\param x input function, length n
+	\param h impulse response function, length n
+	\param n number of time-points
+	\param y convolved output, length n, must not overlap x or h
+	*/
+	MDM_API static void literal(const double *x, const double *h, size_t n, double *y);
+
+	//! Convolve with an IRF that has an exponential tail, by recursive update of the tail
+	/*!
+	The IRF is h[k] for k < nHead, and sum_m tailWeights[m].tailRatios[m]^(k - nHead) for
+	k >= nHead.
+
+	\param x input function, length n
+	\param h head of impulse response function, length at least min(nHead, n)
+	\param nHead number of samples in IRF head
+	\param tailWeights weight of each exponential in IRF tail, at sample nHead
+	\param tailRatios ratio between successive samples of each exponential in IRF tail
+	\param nExponentials number of exponentials in IRF tail, must be <= MAX_TAIL_EXPONENTIALS
+	\param n number of time-points
+	\param y convolved output, length n, must not overlap x or h
+	*/
+	MDM_API static void recursive(const double *x, const double *h, size_t nHead,
+		const double *tailWeights, const double *tailRatios, size_t nExponentials,
+		size_t n, double *y);
+
+	//! Convolve using the fast Fourier transform
+	/*!
+	\param x input function, length n
+	\param h impulse response function, length n
+	\param n number of time-points
+	\param y convolved output, length n
+	*/
+	MDM_API static void fft(const double *x, const double *h, size_t n, double *y);
+
+};
+
+#endif //MDM_CONVOLUTION_HDR
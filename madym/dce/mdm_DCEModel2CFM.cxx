@@ -12,7 +12,9 @@
 
 #include "mdm_DCEModel2CFM.h"
 #include <madym/dce/mdm_Exponentials.h>
+#include <madym/dce/mdm_ExponentialKernels.h>
 #include <cmath>
+#include <algorithm>
 
 MDM_API mdm_DCEModel2CFM::mdm_DCEModel2CFM(
   mdm_AIF &AIF,
@@ -54,11 +56,22 @@ MDM_API mdm_DCEModel2CFM::~mdm_DCEModel2CFM()
 
 }
 
+MDM_API mdm_DCEModel2CFM::mdm_DCEModel2CFM(const mdm_DCEModel2CFM &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModel2CFM::modelType() const
 {
   return "mdm_DCEModel2CFM";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModel2CFM::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModel2CFM>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModel2CFM::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -81,27 +94,115 @@ MDM_API void mdm_DCEModel2CFM::computeCtModel(size_t nTimes)
   //Get AIF and PIF, labelled in model equation as Ca_t and Cv_t
   //Resample AIF and get AIF times
   AIF_.resample_AIF( tau_a);
-  const std::vector<double> Ca_t = AIF_.AIF();
+  const std::vector<double> &Ca_t = AIF_.AIF();
   const std::vector<double> &t = AIF_.AIFTimes();
 
-  auto TP = v_p / F_p;
-  auto TE = v_e / PS;
-  auto TT = (v_p + v_e) / F_p;
-  auto Tpos = TE;
-  auto Tneg = TP;
-  auto Epos = (TT - Tneg) / (Tpos - Tneg);
-  auto Eneg = 1 - Epos;
-
-  auto F_pos = F_p * Epos;
-  auto F_neg = F_p * Eneg;
-  auto K_pos = 1 / Tpos;
-  auto K_neg = 1 / Tneg;
+  double F_pos, F_neg, K_pos, K_neg;
+  biexponentialParams(F_p, PS, v_e, v_p, F_pos, F_neg, K_pos, K_neg);
 
   mdm_Exponentials::biexponential(
     F_pos, F_neg, K_pos, K_neg, Ca_t, t,
     CtModel_);
 }
 
+MDM_API void mdm_DCEModel2CFM::computeCtModelBatch(size_t nTimes,
+  const std::vector<double> &params, std::vector<double> &CtModels)
+{
+  const size_t nParams = numParams();
+  const size_t nSets = params.size() / nParams;
+  CtModels.resize(nSets * nTimes);
+  if (!nSets)
+    return;
+
+  //Sets with invalid parameters are given NaN kernel parameters, so the kernel zeros them
+  batchKernelParams_.resize(4 * nSets);
+  double *F_pos = batchKernelParams_.data();
+  double *F_neg = F_pos + nSets;
+  double *K_pos = F_neg + nSets;
+  double *K_neg = K_pos + nSets;
+  for (size_t k = 0; k < nSets; k++)
+  {
+    const double *p = &params[k * nParams];
+    if (std::any_of(p, p + nParams, [](double x) {return std::isnan(x); }))
+      F_pos[k] = F_neg[k] = K_pos[k] = K_neg[k] = NAN;
+    else
+      biexponentialParams(p[0], p[1], p[2], p[3], F_pos[k], F_neg[k], K_pos[k], K_neg[k]);
+  }
+
+  //Sets with different bolus delays each use their own resampled AIF
+  size_t AIFStride;
+  const double *Ca_t = batchAIFs(nTimes, params, 4, AIFStride);
+  mdm_ExponentialKernels::biexponential(nSets, F_pos, F_neg, K_pos, K_neg,
+    Ca_t, AIF_.AIFTimes().data(), nTimes, CtModels.data(), AIFStride);
+}
+
+MDM_API void mdm_DCEModel2CFM::computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian)
+{
+  const double &F_p = pkParams_[0];
+  const double &PS = pkParams_[1];
+  const double &v_e = pkParams_[2];
+  const double &v_p = pkParams_[3];
+  const double &tau_a = pkParams_[4];
+
+  //Substituting the transit times, E_pos = v_e.PS / Q
+  double Q = F_p * v_e - v_p * PS;
+
+  if (std::any_of(pkParams_.begin(), pkParams_.end(), [](double p) {return std::isnan(p); }) ||
+    F_p <= 0 || PS <= 0 || v_e <= 0 || v_p <= 0 || Q == 0)
+  {
+    mdm_DCEModelBase::computeCtModelAndJacobian(nTimes, jacobian);
+    return;
+  }
+
+  const size_t nParams = numParams();
+  jacobian.assign(nTimes * nParams, 0.0);
+
+  //Derivative wrt to bolus arrival is numerical - must be computed before Cm(t)
+  numericalJacobian(nTimes, { 4 }, jacobian);
+
+  AIF_.resample_AIF(tau_a);
+  const auto &Ca_t = AIF_.AIF();
+  const auto &t = AIF_.AIFTimes();
+
+  auto Epos = v_e * PS / Q;
+  auto K_pos = PS / v_e;
+  auto K_neg = F_p / v_p;
+
+  std::fill(CtModel_.begin(), CtModel_.begin() + nTimes, 0.0);
+  mdm_Exponentials::biexponential_jacobian(
+    F_p * Epos, F_p * (1 - Epos), K_pos, K_neg, Ca_t, t, nTimes,
+    CtModel_, dCm_);
+
+  //Derivatives of Epos, K_pos, K_neg and F_p wrt to each of F_p, PS, v_e, v_p
+  auto Q2 = Q * Q;
+  const double dEpos[] = {
+    -v_e * v_e * PS / Q2, v_e * v_e * F_p / Q2, -v_p * PS * PS / Q2, v_e * PS * PS / Q2 };
+  const double dK_pos[] = { 0, 1 / v_e, -PS / (v_e * v_e), 0 };
+  const double dK_neg[] = { 1 / v_p, 0, 0, -F_p / (v_p * v_p) };
+  const double dF[] = { 1, 0, 0, 0 };
+
+  for (size_t i_p = 0; i_p < 4; i_p++)
+  {
+    if (!optParamFlags_[i_p])
+      continue;
+
+    auto dF_pos = dF[i_p] * Epos + F_p * dEpos[i_p];
+    auto dF_neg = dF[i_p] * (1 - Epos) - F_p * dEpos[i_p];
+
+    for (size_t i_t = 0; i_t < nTimes; i_t++)
+    {
+      const double *dC = &dCm_[i_t * 4];
+      jacobian[i_t * nParams + i_p] =
+        dC[0] * dF_pos + dC[1] * dF_neg + dC[2] * dK_pos[i_p] + dC[3] * dK_neg[i_p];
+    }
+  }
+}
+
+MDM_API bool mdm_DCEModel2CFM::hasAnalyticJacobian() const
+{
+  return true;
+}
+
 MDM_API void mdm_DCEModel2CFM::checkParams()
 {
   /*TODO: define parameter limits - for now, just check all finite and not NAN*/
@@ -144,4 +245,27 @@ MDM_API void mdm_DCEModel2CFM::transformLLSolution(const double* B)
   v_e = T * F_p - v_p;
   PS = v_e / T_e;
 
-}
\ No newline at end of file
+}
+
+//**************************************************************************
+// Private functions
+//**************************************************************************
+
+//
+void mdm_DCEModel2CFM::biexponentialParams(const double F_p, const double PS,
+  const double v_e, const double v_p,
+  double &F_pos, double &F_neg, double &K_pos, double &K_neg) const
+{
+  auto TP = v_p / F_p;
+  auto TE = v_e / PS;
+  auto TT = (v_p + v_e) / F_p;
+  auto Tpos = TE;
+  auto Tneg = TP;
+  auto Epos = (TT - Tneg) / (Tpos - Tneg);
+  auto Eneg = 1 - Epos;
+
+  F_pos = F_p * Epos;
+  F_neg = F_p * Eneg;
+  K_pos = 1 / Tpos;
+  K_neg = 1 / Tneg;
+}
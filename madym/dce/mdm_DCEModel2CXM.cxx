@@ -12,7 +12,9 @@
 
 #include "mdm_DCEModel2CXM.h"
 #include <madym/dce/mdm_Exponentials.h>
+#include <madym/dce/mdm_ExponentialKernels.h>
 #include <cmath>
+#include <algorithm>
 
 MDM_API mdm_DCEModel2CXM::mdm_DCEModel2CXM(
   mdm_AIF &AIF,
@@ -54,11 +56,22 @@ MDM_API mdm_DCEModel2CXM::~mdm_DCEModel2CXM()
 
 }
 
+MDM_API mdm_DCEModel2CXM::mdm_DCEModel2CXM(const mdm_DCEModel2CXM &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModel2CXM::modelType() const
 {
   return "mdm_DCEModel2CXM";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModel2CXM::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModel2CXM>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModel2CXM::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -81,56 +94,128 @@ MDM_API void mdm_DCEModel2CXM::computeCtModel(size_t nTimes)
   //Get AIF and PIF, labelled in model equation as Ca_t and Cv_t
   //Resample AIF and get AIF times
   AIF_.resample_AIF( tau_a);
-  const std::vector<double> Ca_t = AIF_.AIF();
+  const std::vector<double> &Ca_t = AIF_.AIF();
   const std::vector<double> &t = AIF_.AIFTimes();
 
-  double K_pos;
-  double K_neg;
-  double E_pos;
+  double F_pos, F_neg, K_pos, K_neg;
+  if (!biexponentialParams(F_p, PS, v_e, v_p, F_pos, F_neg, K_pos, K_neg))
+    return;
 
-  //Method 1: Sourbron 2011
-  if (F_p > 0 && PS > 0)
+  mdm_Exponentials::biexponential(
+    F_pos, F_neg, K_pos, K_neg, Ca_t, t,
+    CtModel_);
+}
+
+MDM_API void mdm_DCEModel2CXM::computeCtModelBatch(size_t nTimes,
+  const std::vector<double> &params, std::vector<double> &CtModels)
+{
+  const size_t nParams = numParams();
+  const size_t nSets = params.size() / nParams;
+  CtModels.resize(nSets * nTimes);
+  if (!nSets)
+    return;
+
+  //Sets with invalid parameters are given NaN kernel parameters, so the kernel zeros them
+  batchKernelParams_.resize(4 * nSets);
+  double *F_pos = batchKernelParams_.data();
+  double *F_neg = F_pos + nSets;
+  double *K_pos = F_neg + nSets;
+  double *K_neg = K_pos + nSets;
+  for (size_t k = 0; k < nSets; k++)
   {
-    // First derive the secondary parameters from the input Pk parameters
-    double E = PS / (PS + F_p); //Extraction fraction
-    double e = v_e / (v_p + v_e); //Extractcellular fraction
+    const double *p = &params[k * nParams];
+    if (std::any_of(p, p + nParams, [](double x) {return std::isnan(x); }) ||
+      !biexponentialParams(p[0], p[1], p[2], p[3], F_pos[k], F_neg[k], K_pos[k], K_neg[k]))
+      F_pos[k] = F_neg[k] = K_pos[k] = K_neg[k] = NAN;
+  }
 
-    double tau = (E - E * e + e) / (2 * E);
-    double tau_root = std::sqrt(1 - 4 * (E*e*(1 - E)*(1 - e)) / std::pow(E - E * e + e, 2));
-    double tau_pos = tau * (1 + tau_root);
-    double tau_neg = tau * (1 - tau_root);
+  //Sets with different bolus delays each use their own resampled AIF
+  size_t AIFStride;
+  const double *Ca_t = batchAIFs(nTimes, params, 4, AIFStride);
+  mdm_ExponentialKernels::biexponential(nSets, F_pos, F_neg, K_pos, K_neg,
+    Ca_t, AIF_.AIFTimes().data(), nTimes, CtModels.data(), AIFStride);
+}
 
-    K_pos = F_p / ((v_p + v_e)*tau_neg);
-    K_neg = F_p / ((v_p + v_e)*tau_pos);
+MDM_API void mdm_DCEModel2CXM::computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian)
+{
+  const double &F_p = pkParams_[0];
+  const double &PS = pkParams_[1];
+  const double &v_e = pkParams_[2];
+  const double &v_p = pkParams_[3];
+  const double &tau_a = pkParams_[4];
 
-    E_pos = (tau_pos - 1) / (tau_pos - tau_neg);
-  }
-  else
+  //Use method 2 from computeCtModel, as this has simpler derivatives
+  double Kp = (F_p + PS) / v_p;
+  double Ke = PS / v_e;
+  double Kb = F_p / v_p;
+  double K_sum = Kp + Ke;
+  double K_disc = K_sum * K_sum - 4 * Ke*Kb;
+
+  if (std::any_of(pkParams_.begin(), pkParams_.end(), [](double p) {return std::isnan(p); }) ||
+    v_p <= 0 || v_e <= 0 || !(K_disc > 0))
   {
-    // Method 2
-    double Kp = (F_p + PS) / v_p;
-    double Ke = PS / v_e;
-    double Kb = F_p / v_p;
+    mdm_DCEModelBase::computeCtModelAndJacobian(nTimes, jacobian);
+    return;
+  }
 
-    double K_sum = 0.5*(Kp + Ke);
-    double K_root = 0.5 * std::sqrt(std::pow(Kp + Ke, 2) - 4 * Ke*Kb);
-    K_pos = K_sum - K_root;
-    K_neg = K_sum + K_root;
+  double K_root = 0.5 * std::sqrt(K_disc);
+  double K_pos = 0.5 * K_sum - K_root;
+  double K_neg = 0.5 * K_sum + K_root;
+  double E_pos = (K_neg - Kb) / (2 * K_root);
 
-    E_pos = (K_neg - Kb) / (K_neg - K_pos);
+  if (!(K_pos > 0))
+  {
+    mdm_DCEModelBase::computeCtModelAndJacobian(nTimes, jacobian);
+    return;
   }
 
-  if (std::isnan(K_neg) || std::isnan(K_pos) || std::isnan(E_pos))
+  const size_t nParams = numParams();
+  jacobian.assign(nTimes * nParams, 0.0);
+
+  //Derivative wrt to bolus arrival is numerical - must be computed before Cm(t)
+  numericalJacobian(nTimes, { 4 }, jacobian);
+
+  AIF_.resample_AIF(tau_a);
+  const auto &Ca_t = AIF_.AIF();
+  const auto &t = AIF_.AIFTimes();
+
+  std::fill(CtModel_.begin(), CtModel_.begin() + nTimes, 0.0);
+  mdm_Exponentials::biexponential_jacobian(
+    F_p*E_pos, F_p*(1 - E_pos), K_pos, K_neg, Ca_t, t, nTimes,
+    CtModel_, dCm_);
+
+  //Chain rule through the derivatives of Kp, Ke, Kb and F_p wrt to each of F_p, PS, v_e, v_p,
+  //to get derivatives of F_pos, F_neg, K_pos, K_neg
+  const double dKp[] = { 1 / v_p, 1 / v_p, 0, -(F_p + PS) / (v_p*v_p) };
+  const double dKe[] = { 0, 1 / v_e, -PS / (v_e*v_e), 0 };
+  const double dKb[] = { 1 / v_p, 0, 0, -F_p / (v_p*v_p) };
+  const double dF[] = { 1, 0, 0, 0 };
+
+  for (size_t i_p = 0; i_p < 4; i_p++)
   {
-    return;
+    if (!optParamFlags_[i_p])
+      continue;
+
+    double dK_sum = dKp[i_p] + dKe[i_p];
+    double dK_root = (2 * K_sum*dK_sum - 4 * (dKe[i_p] * Kb + Ke * dKb[i_p])) / (8 * K_root);
+    double dK_pos = 0.5 * dK_sum - dK_root;
+    double dK_neg = 0.5 * dK_sum + dK_root;
+    double dE_pos = (dK_neg - dKb[i_p]) / (2 * K_root) - E_pos * dK_root / K_root;
+    double dF_pos = dF[i_p] * E_pos + F_p * dE_pos;
+    double dF_neg = dF[i_p] * (1 - E_pos) - F_p * dE_pos;
+
+    for (size_t i_t = 0; i_t < nTimes; i_t++)
+    {
+      const double *dC = &dCm_[i_t * 4];
+      jacobian[i_t * nParams + i_p] =
+        dC[0] * dF_pos + dC[1] * dF_neg + dC[2] * dK_pos + dC[3] * dK_neg;
+    }
   }
-  
-  double F_pos = F_p*E_pos;
-  double F_neg = F_p*(1 - E_pos);
+}
 
-  mdm_Exponentials::biexponential(
-    F_pos, F_neg, K_pos, K_neg, Ca_t, t,
-    CtModel_);
+MDM_API bool mdm_DCEModel2CXM::hasAnalyticJacobian() const
+{
+  return true;
 }
 
 MDM_API void mdm_DCEModel2CXM::checkParams()
@@ -174,4 +259,55 @@ MDM_API void mdm_DCEModel2CXM::transformLLSolution(const double* B)
   v_e = T * F_p - v_p;
   PS = v_e / T_e;
 
-}
\ No newline at end of file
+}
+
+//**************************************************************************
+// Private functions
+//**************************************************************************
+
+//
+bool mdm_DCEModel2CXM::biexponentialParams(const double F_p, const double PS,
+  const double v_e, const double v_p,
+  double &F_pos, double &F_neg, double &K_pos, double &K_neg) const
+{
+  double E_pos;
+
+  //Method 1: Sourbron 2011
+  if (F_p > 0 && PS > 0)
+  {
+    // First derive the secondary parameters from the input Pk parameters
+    double E = PS / (PS + F_p); //Extraction fraction
+    double e = v_e / (v_p + v_e); //Extractcellular fraction
+
+    double tau = (E - E * e + e) / (2 * E);
+    double tau_root = std::sqrt(1 - 4 * (E*e*(1 - E)*(1 - e)) / std::pow(E - E * e + e, 2));
+    double tau_pos = tau * (1 + tau_root);
+    double tau_neg = tau * (1 - tau_root);
+
+    K_pos = F_p / ((v_p + v_e)*tau_neg);
+    K_neg = F_p / ((v_p + v_e)*tau_pos);
+
+    E_pos = (tau_pos - 1) / (tau_pos - tau_neg);
+  }
+  else
+  {
+    // Method 2
+    double Kp = (F_p + PS) / v_p;
+    double Ke = PS / v_e;
+    double Kb = F_p / v_p;
+
+    double K_sum = 0.5*(Kp + Ke);
+    double K_root = 0.5 * std::sqrt(std::pow(Kp + Ke, 2) - 4 * Ke*Kb);
+    K_pos = K_sum - K_root;
+    K_neg = K_sum + K_root;
+
+    E_pos = (K_neg - Kb) / (K_neg - K_pos);
+  }
+
+  if (std::isnan(K_neg) || std::isnan(K_pos) || std::isnan(E_pos))
+    return false;
+
+  F_pos = F_p*E_pos;
+  F_neg = F_p*(1 - E_pos);
+  return true;
+}
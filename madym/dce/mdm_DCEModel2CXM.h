@@ -32,12 +32,24 @@ public:
     int repeatParam = -1,
     const std::vector<double>& repeatValues = std::vector<double>(0));
 
+	//! Copy constructor, binding the new model to a different AIF
+	MDM_API mdm_DCEModel2CXM(const mdm_DCEModel2CXM &model, mdm_AIF &AIF);
+
 	MDM_API ~mdm_DCEModel2CXM();
 
 	MDM_API virtual std::string modelType() const;
 
+	MDM_API virtual std::shared_ptr<mdm_DCEModelBase> clone(mdm_AIF &AIF) const;
+
 	MDM_API virtual void computeCtModel(size_t nTimes);
 
+	MDM_API virtual void computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian);
+
+	MDM_API virtual bool hasAnalyticJacobian() const;
+
+	MDM_API virtual void computeCtModelBatch(size_t nTimes, const std::vector<double> &params,
+		std::vector<double> &CtModels);
+
 	MDM_API virtual void checkParams();
 
   MDM_API std::vector<double> makeLLSMatrix(const std::vector<double>& Ct_sig) const;
@@ -48,9 +60,14 @@ protected:
 
 private:
   //METHODS:
+  //Convert F_p, PS, v_e, v_p to bi-exponential form, returning false if the result is NaN
+  bool biexponentialParams(const double F_p, const double PS,
+    const double v_e, const double v_p,
+    double &F_pos, double &F_neg, double &K_pos, double &K_neg) const;
 
   //VARIABLES
-
+  //Scratch buffers for Jacobian computation, reused between evaluations
+  std::vector<double> dCm_;
 };
 
 #endif //MDM_DCEMODEL2CXM_HDR
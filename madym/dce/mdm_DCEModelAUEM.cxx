@@ -53,11 +53,22 @@ MDM_API mdm_DCEModelAUEM::~mdm_DCEModelAUEM()
 
 }
 
+MDM_API mdm_DCEModelAUEM::mdm_DCEModelAUEM(const mdm_DCEModelAUEM &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelAUEM::modelType() const
 {
   return "mdm_DCEModelAUEM";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelAUEM::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelAUEM>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelAUEM::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -96,10 +107,10 @@ MDM_API void mdm_DCEModelAUEM::computeCtModel(size_t nTimes)
 
   //Get AIF and PIF, labelled in model equation as Ca_t and Cv_t
   const auto& t = AIF_.AIFTimes();
-  auto Cp_t = mdm_Exponentials::mix_vifs(AIF_, f_a, tau_a, tau_v);
+  mdm_Exponentials::mix_vifs(AIF_, f_a, tau_a, tau_v, Cp_t_);
 
   mdm_Exponentials::biexponential(
-    F_pos, F_neg, K_pos, K_neg, Cp_t, t,
+    F_pos, F_neg, K_pos, K_neg, Cp_t_, t,
     CtModel_);
 }
 
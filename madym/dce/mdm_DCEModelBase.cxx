@@ -12,6 +12,9 @@
 #include "mdm_DCEModelBase.h"
 #include <madym/utils/mdm_platform_defs.h>
 
+#include <algorithm>
+#include <cmath>
+
 MDM_API mdm_DCEModelBase::mdm_DCEModelBase(
   mdm_AIF &AIF,
   const std::vector<std::string> &paramNames,
@@ -40,6 +43,27 @@ MDM_API mdm_DCEModelBase::mdm_DCEModelBase(
   
 }
 
+MDM_API mdm_DCEModelBase::mdm_DCEModelBase(const mdm_DCEModelBase &model, mdm_AIF &AIF)
+  :CtModel_(model.CtModel_),
+  AIF_(AIF),
+  pkParams_(model.pkParams_),
+  pkParamsOpt_(model.pkParamsOpt_),
+  pkParamNames_(model.pkParamNames_),
+  pkInitParams_(model.pkInitParams_),
+  optParamFlags_(model.optParamFlags_),
+  lowerBounds_(model.lowerBounds_),
+  upperBounds_(model.upperBounds_),
+  relativeBounds_(model.relativeBounds_),
+  lowerBoundsOpt_(model.lowerBoundsOpt_),
+  upperBoundsOpt_(model.upperBoundsOpt_),
+  repeatParam_(model.repeatParam_),
+  repeatValues_(model.repeatValues_),
+  errorCode_(model.errorCode_),
+  currRpt_(model.currRpt_)
+{
+
+}
+
 MDM_API mdm_DCEModelBase::~mdm_DCEModelBase()
 {
 
@@ -287,6 +311,103 @@ MDM_API mdm_ErrorTracker::ErrorCode mdm_DCEModelBase::getModelErrorCode() const
 	return errorCode_;
 }
 
+MDM_API void mdm_DCEModelBase::computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian)
+{
+  jacobian.assign(nTimes * numParams(), 0.0);
+
+  for (int i_p = 0, n = numParams(); i_p < n; i_p++)
+    numericalDerivative(nTimes, i_p, jacobian);
+
+  computeCtModel(nTimes);
+}
+
+MDM_API bool mdm_DCEModelBase::hasAnalyticJacobian() const
+{
+  return false;
+}
+
+MDM_API void mdm_DCEModelBase::computeCtModelBatch(size_t nTimes,
+  const std::vector<double> &params, std::vector<double> &CtModels)
+{
+  const size_t nParams = numParams();
+  const size_t nSets = params.size() / nParams;
+  CtModels.resize(nSets * nTimes);
+
+  batchParams_ = pkParams_;
+  batchCtModel_ = CtModel_;
+  for (size_t k = 0; k < nSets; k++)
+  {
+    std::copy(params.begin() + k * nParams, params.begin() + (k + 1) * nParams, pkParams_.begin());
+    computeCtModel(nTimes);
+    std::copy(CtModel_.begin(), CtModel_.begin() + nTimes, CtModels.begin() + k * nTimes);
+  }
+  pkParams_ = batchParams_;
+  CtModel_ = batchCtModel_;
+}
+
+MDM_API const double* mdm_DCEModelBase::batchAIFs(size_t nTimes,
+  const std::vector<double> &params, size_t tauIdx, size_t &AIFStride)
+{
+  const size_t nParams = numParams();
+  const size_t nSets = params.size() / nParams;
+  bool shared = true;
+  for (size_t k = 1; k < nSets && shared; k++)
+    shared = params[k * nParams + tauIdx] == params[tauIdx];
+
+  if (shared)
+  {
+    AIFStride = 0;
+    AIF_.resample_AIF(params[tauIdx]);
+    return AIF_.AIF().data();
+  }
+
+  AIFStride = nTimes;
+  batchAIFs_.resize(nSets * nTimes);
+  for (size_t k = 0; k < nSets; k++)
+  {
+    const double tau_a = params[k * nParams + tauIdx];
+    auto AIF_k = batchAIFs_.begin() + k * nTimes;
+    if (std::isnan(tau_a))
+    {
+      std::fill(AIF_k, AIF_k + nTimes, 0.0);
+      continue;
+    }
+    AIF_.resample_AIF(tau_a);
+    std::copy(AIF_.AIF().begin(), AIF_.AIF().begin() + nTimes, AIF_k);
+  }
+  return batchAIFs_.data();
+}
+
+MDM_API void mdm_DCEModelBase::numericalJacobian(size_t nTimes, std::initializer_list<int> paramIdx,
+  std::vector<double> &jacobian)
+{
+  for (auto i_p : paramIdx)
+    numericalDerivative(nTimes, i_p, jacobian);
+}
+
+MDM_API void mdm_DCEModelBase::numericalDerivative(size_t nTimes, int paramIdx,
+  std::vector<double> &jacobian)
+{
+  if (!optParamFlags_[paramIdx])
+    return;
+
+  //Central difference, with step scaled to the size of the parameter
+  const size_t nParams = numParams();
+  const double p = pkParams_[paramIdx];
+  const double h = 1e-6 * std::max(std::abs(p), 1.0);
+
+  pkParams_[paramIdx] = p + h;
+  computeCtModel(nTimes);
+  CtPlus_.assign(CtModel_.begin(), CtModel_.begin() + nTimes);
+
+  pkParams_[paramIdx] = p - h;
+  computeCtModel(nTimes);
+  for (size_t i_t = 0; i_t < nTimes; i_t++)
+    jacobian[i_t * nParams + paramIdx] = (CtPlus_[i_t] - CtModel_[i_t]) / (2 * h);
+
+  pkParams_[paramIdx] = p;
+}
+
 MDM_API std::vector<double> mdm_DCEModelBase::makeLLSMatrix(const std::vector<double>& Ct_sig) const
 {
   throw mdm_exception(__func__, boost::format(
@@ -314,8 +435,13 @@ MDM_API bool mdm_DCEModelBase::nextRepeatParam()
     return false;
   }
 
-  pkInitParams_[repeatParam_] = repeatValues_[currRpt_++];
-  reset();
+  setRepeat(currRpt_++);
   return true;
 
+}
+
+MDM_API void mdm_DCEModelBase::setRepeat(size_t repeatIdx)
+{
+  pkInitParams_[repeatParam_] = repeatValues_[repeatIdx];
+  reset();
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 All DCE models should sub-class this abstract class providing an implementation of the following methods:
 - #mdm_DCEModelBase::modelType
+- #mdm_DCEModelBase::clone
 - #mdm_DCEModelBase::computeCtModel
 - #mdm_DCEModelBase::checkParams
 						
@@ -19,6 +20,8 @@ Original author MA Berks 24 Oct 2018
 #include <madym/utils/mdm_api.h>
 
 #include <vector>
+#include <initializer_list>
+#include <memory>
 #include <madym/dce/mdm_AIF.h>
 #include <madym/utils/mdm_ErrorTracker.h>
 
@@ -244,6 +247,16 @@ public:
 	*/
 	MDM_API virtual std::string modelType() const = 0;
 
+	//! Return a copy of the model bound to a different AIF
+	/*!
+	Pure virtual function, must be implemented by sub-classes. The copy takes the current
+	state of all parameters, bounds and flags, but evaluates Cm(t) using the supplied AIF, 
+	so copies can be fitted independently of the original (eg on separate threads).
+	\param AIF AIF used by the copied model, must outlive the copy
+	\return shared pointer to copy of model
+	*/
+	MDM_API virtual std::shared_ptr<mdm_DCEModelBase> clone(mdm_AIF &AIF) const = 0;
+
   //! Compute modelled concentration time-series Cm(t) with current model parameters.
 	/*!
 	Pure virtual function, must be implemented by sub-classes.
@@ -251,6 +264,41 @@ public:
 	*/
 	MDM_API virtual void computeCtModel(size_t nTimes) = 0;
 
+	//! Compute modelled concentration time-series Cm(t) and its Jacobian with current model parameters.
+	/*!
+	The Jacobian is stored row-major, so that element [i_t*numParams() + i_p] is the derivative
+	of Cm(t_i) with respect to parameter i_p. Only the columns of optimised parameters are set.
+	The base class computes all columns numerically (central differences). Models with an analytic
+	form should override this method and hasAnalyticJacobian.
+	\param nTimes number of time-points, starting from 0 at which to compute Cm(t). Must be < AIF.nTimes()
+	\param jacobian derivatives of Cm(t), resized to nTimes*numParams()
+	\see hasAnalyticJacobian
+	*/
+	MDM_API virtual void computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian);
+
+	//! Return true if the model computes its Jacobian analytically
+	/*!
+	Base class returns false. If true, fitters can use the Jacobian to compute the exact gradient
+	of the model fit error, rather than using numerical differentiation.
+	\return true if computeCtModelAndJacobian is overridden with an analytic form
+	*/
+	MDM_API virtual bool hasAnalyticJacobian() const;
+
+	//! Compute modelled concentration time-series Cm(t) for a batch of parameter sets
+	/*!
+	Evaluates the model for several parameter sets at once, for callers that need the model at
+	multiple points (eg multi-start or grid searches). The base class evaluates each set in turn
+	using computeCtModel. Models with batched kernels (see mdm_ExponentialKernels) override this to
+	compute all sets together, including sets with different bolus arrival times. The model's current parameters and CtModel() are not changed.
+	\param nTimes number of time-points, starting from 0 at which to compute Cm(t). Must be < AIF.nTimes()
+	\param params parameter sets stored row-major, so that element [k*numParams() + i_p] is
+	parameter i_p of set k. Length must be a multiple of numParams()
+	\param CtModels modelled Cm(t) for each set stored row-major, so that element [k*nTimes + i_t]
+	is Cm(t_i) for set k. Resized to nSets*nTimes
+	*/
+	MDM_API virtual void computeCtModelBatch(size_t nTimes, const std::vector<double> &params,
+		std::vector<double> &CtModels);
+
   //! Check the validity of fitted model prameters.
 	/*!
 	Pure virtual function, must be implemented by sub-classes. If any parameter is not valid,
@@ -286,7 +334,22 @@ public:
 	*/
 	MDM_API bool nextRepeatParam();
 
+	//! Set value of a given repeat in pkParams_, without changing the current repeat index
+	/*!
+	Allows repeats to be fitted in any order
+	\param repeatIdx index into repeatValues(), must be < repeatValues().size()
+	*/
+	MDM_API void setRepeat(size_t repeatIdx);
+
 protected:
+	//! Copy constructor, binding the new model to a different AIF
+	/*!
+	Used by sub-classes to implement clone
+	\param model model to copy
+	\param AIF AIF used by the new model
+	*/
+	MDM_API mdm_DCEModelBase(const mdm_DCEModelBase &model, mdm_AIF &AIF);
+
 	//! Initialise the model
 	/*!
 	Sets initial values and fixed status flags for parameters, and computes initial modelled Cm(t)
@@ -301,6 +364,43 @@ protected:
 		const std::vector<int>& relativeLimitParams,
 		const std::vector<double>& relativeLimitValues);
 
+	//! Compute columns of the Jacobian numerically by central differences
+	/*!
+	Used for parameters without an analytic derivative (eg bolus arrival times). Columns are only
+	computed for parameters being optimised. Overwrites CtModel_, so must be called before Cm(t) is
+	computed at the current parameters.
+	\param nTimes number of time-points, starting from 0 at which to compute Cm(t)
+	\param paramIdx indices of parameters for which to compute columns
+	\param jacobian derivatives of Cm(t), must already be sized nTimes*numParams()
+	*/
+	MDM_API void numericalJacobian(size_t nTimes, std::initializer_list<int> paramIdx,
+		std::vector<double> &jacobian);
+
+	//! Compute a single column of the Jacobian numerically by central differences
+	/*!
+	\param nTimes number of time-points, starting from 0 at which to compute Cm(t)
+	\param paramIdx index of parameter for which to compute column, skipped if not optimised
+	\param jacobian derivatives of Cm(t), must already be sized nTimes*numParams()
+	\see numericalJacobian
+	*/
+	MDM_API void numericalDerivative(size_t nTimes, int paramIdx,
+		std::vector<double> &jacobian);
+
+	//! Resample the AIF at the bolus arrival time of each set in a batch
+	/*!
+	Used by sub-classes to implement computeCtModelBatch with mdm_ExponentialKernels. If all sets
+	share the same arrival time, the AIF is resampled once and shared. Otherwise each set's AIF is
+	resampled into its own row of batchAIFs_, so sets with different arrival times (eg repeat
+	starts for tau_a) are still evaluated together. Sets with a NaN arrival time get a zero AIF.
+	\param nTimes number of time-points, starting from 0 at which to compute Cm(t)
+	\param params parameter sets stored row-major, as in computeCtModelBatch
+	\param tauIdx index of the bolus arrival time in each set
+	\param AIFStride set to the offset between the AIFs of consecutive sets, 0 if shared
+	\return pointer to the AIF of the first set
+	*/
+	MDM_API const double* batchAIFs(size_t nTimes, const std::vector<double> &params,
+		size_t tauIdx, size_t &AIFStride);
+
   //VARIABLES USED BY ALL BASE CLASSES
   std::vector<double> CtModel_; //!< Fitted concentration time-series using model parameters
   std::vector<double> pkParams_; //!< All model parameters
@@ -318,6 +418,16 @@ protected:
   std::vector<double> lowerBoundsOpt_; //!< Lower bounds for optimised parameters 
   std::vector<double> upperBoundsOpt_; //!< Upper bounds for optimised parameters 
 
+  //Scratch buffers reused between model evaluations, so fitting doesn't allocate
+  std::vector<double> Cp_t_; //!< Combined vascular input
+  std::vector<double> Cd_t_; //!< Difference of arterial and venous inputs
+  std::vector<double> CtPlus_; //!< Forward step model for numerical derivatives
+  std::vector<double> batchParams_; //!< Current parameters, saved while evaluating a batch
+  std::vector<double> batchCtModel_; //!< Current Cm(t), saved while evaluating a batch
+  std::vector<double> batchKernelParams_; //!< Kernel parameters for each set in a batch
+  std::vector<double> batchAIFs_; //!< AIF of each set in a batch, if arrival times differ
+
+
   //! Reference to AIF object set at initialization from global volume analysis
   mdm_AIF &AIF_;
 
@@ -53,11 +53,22 @@ MDM_API mdm_DCEModelDI2CXM::~mdm_DCEModelDI2CXM()
 
 }
 
+MDM_API mdm_DCEModelDI2CXM::mdm_DCEModelDI2CXM(const mdm_DCEModelDI2CXM &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelDI2CXM::modelType() const
 {
   return "mdm_DCEModelDI2CXM";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelDI2CXM::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelDI2CXM>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelDI2CXM::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -125,10 +136,10 @@ MDM_API void mdm_DCEModelDI2CXM::computeCtModel(size_t nTimes)
 
   //Get AIF and PIF, labelled in model equation as Ca_t and Cv_t
   const auto& t = AIF_.AIFTimes();
-  auto Cp_t = mdm_Exponentials::mix_vifs(AIF_, f_a, tau_a, tau_v);
+  mdm_Exponentials::mix_vifs(AIF_, f_a, tau_a, tau_v, Cp_t_);
 
   mdm_Exponentials::biexponential(
-    F_pos, F_neg, K_pos, K_neg, Cp_t, t,
+    F_pos, F_neg, K_pos, K_neg, Cp_t_, t,
     CtModel_);
 }
 
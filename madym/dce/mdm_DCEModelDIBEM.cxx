@@ -13,6 +13,7 @@
 #include <madym/dce/mdm_Exponentials.h>
 
 #include <cmath>
+#include <algorithm>
 
 MDM_API mdm_DCEModelDIBEM::mdm_DCEModelDIBEM(
   mdm_AIF &AIF,
@@ -54,11 +55,22 @@ MDM_API mdm_DCEModelDIBEM::~mdm_DCEModelDIBEM()
 
 }
 
+MDM_API mdm_DCEModelDIBEM::mdm_DCEModelDIBEM(const mdm_DCEModelDIBEM &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelDIBEM::modelType() const
 {
   return "mdm_DCEModelDIBEM";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelDIBEM::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelDIBEM>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelDIBEM::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -82,13 +94,77 @@ MDM_API void mdm_DCEModelDIBEM::computeCtModel(size_t nTimes)
 
   //Get AIF and PIF, labelled in model equation as Ca_t and Cv_t
   const auto& t = AIF_.AIFTimes();
-  auto Cp_t = mdm_Exponentials::mix_vifs(AIF_, f_a, tau_a, tau_v);
+  mdm_Exponentials::mix_vifs(AIF_, f_a, tau_a, tau_v, Cp_t_);
 
   mdm_Exponentials::biexponential(
-    F_pos, F_neg, K_pos, K_neg, Cp_t, t,
+    F_pos, F_neg, K_pos, K_neg, Cp_t_, t,
     CtModel_);
 }
 
+MDM_API void mdm_DCEModelDIBEM::computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian)
+{
+  if (std::any_of(pkParams_.begin(), pkParams_.end(), [](double p) {return std::isnan(p); }))
+  {
+    mdm_DCEModelBase::computeCtModelAndJacobian(nTimes, jacobian);
+    return;
+  }
+
+  const double &F_pos = pkParams_[0];
+  const double &F_neg = pkParams_[1];
+  const double &K_pos = pkParams_[2];
+  const double &K_neg = pkParams_[3];
+  const double &f_a = pkParams_[4];
+  const double &tau_a = pkParams_[5];
+  const double &tau_v = pkParams_[6];
+
+  const size_t nParams = numParams();
+  jacobian.assign(nTimes * nParams, 0.0);
+
+  //Derivatives wrt to bolus arrivals are numerical - must be computed before Cm(t)
+  numericalJacobian(nTimes, { 5, 6 }, jacobian);
+
+  //Resample both inputs, even if one has zero weight, as we need their difference
+  //for the derivative wrt to f_a
+  AIF_.resample_AIF(tau_a);
+  AIF_.resample_PIF(tau_v, false, true);
+  const auto &Ca_t = AIF_.AIF();
+  const auto &Cv_t = AIF_.PIF();
+  const auto &t = AIF_.AIFTimes();
+  double f_v = 1 - f_a;
+
+  //Note biexponential computes over all times, so difference must be full length
+  const auto nAll = t.size();
+  Cp_t_.resize(nAll);
+  Cd_t_.resize(nAll);
+  for (size_t i_t = 0; i_t < nAll; i_t++)
+  {
+    Cp_t_[i_t] = f_a * Ca_t[i_t] + f_v * Cv_t[i_t];
+    Cd_t_[i_t] = Ca_t[i_t] - Cv_t[i_t];
+  }
+
+  std::fill(CtModel_.begin(), CtModel_.begin() + nTimes, 0.0);
+  mdm_Exponentials::biexponential_jacobian(
+    F_pos, F_neg, K_pos, K_neg, Cp_t_, t, nTimes,
+    CtModel_, dCm_);
+
+  //Cm(t) is linear in the input, so the derivative wrt f_a is the model applied to Ca(t) - Cv(t)
+  dCm_dfa_.assign(nAll, 0.0);
+  if (optParamFlags_[4])
+    mdm_Exponentials::biexponential(F_pos, F_neg, K_pos, K_neg, Cd_t_, t, dCm_dfa_);
+
+  for (size_t i_t = 0; i_t < nTimes; i_t++)
+  {
+    double *J = &jacobian[i_t * nParams];
+    std::copy(&dCm_[i_t * 4], &dCm_[i_t * 4] + 4, J);
+    J[4] = dCm_dfa_[i_t];
+  }
+}
+
+MDM_API bool mdm_DCEModelDIBEM::hasAnalyticJacobian() const
+{
+  return true;
+}
+
 MDM_API void mdm_DCEModelDIBEM::checkParams()
 {
 	/*TODO: define parameter limits - for now, just check all finite and not NAN*/
@@ -34,12 +34,21 @@ public:
     int repeatParam = -1,
     const std::vector<double>& repeatValues = std::vector<double>(0));
 
+  //! Copy constructor, binding the new model to a different AIF
+  MDM_API mdm_DCEModelDIBEM(const mdm_DCEModelDIBEM &model, mdm_AIF &AIF);
+
   MDM_API ~mdm_DCEModelDIBEM();
 
   MDM_API virtual std::string modelType() const;
 
+  MDM_API virtual std::shared_ptr<mdm_DCEModelBase> clone(mdm_AIF &AIF) const;
+
   MDM_API virtual void computeCtModel(size_t nTimes);
 
+  MDM_API virtual void computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian);
+
+  MDM_API virtual bool hasAnalyticJacobian() const;
+
   MDM_API virtual void checkParams();
 
 protected:
@@ -48,7 +57,9 @@ private:
   //METHODS:
 
   //VARIABLES
-
+  //Scratch buffers for Jacobian computation, reused between evaluations
+  std::vector<double> dCm_;
+  std::vector<double> dCm_dfa_;
 };
 
 #endif //MDM_DCEMODELDIBEM_HDR
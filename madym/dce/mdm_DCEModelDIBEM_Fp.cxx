@@ -54,11 +54,22 @@ MDM_API mdm_DCEModelDIBEM_Fp::~mdm_DCEModelDIBEM_Fp()
 
 }
 
+MDM_API mdm_DCEModelDIBEM_Fp::mdm_DCEModelDIBEM_Fp(const mdm_DCEModelDIBEM_Fp &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelDIBEM_Fp::modelType() const
 {
   return "mdm_DCEModelDIBEM_Fp";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelDIBEM_Fp::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelDIBEM_Fp>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelDIBEM_Fp::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -82,10 +93,10 @@ MDM_API void mdm_DCEModelDIBEM_Fp::computeCtModel(size_t nTimes)
 
   //Get AIF and PIF, labelled in model equation as Ca_t and Cv_t
   const auto& t = AIF_.AIFTimes();
-  auto Cp_t = mdm_Exponentials::mix_vifs(AIF_, f_a, tau_a, tau_v);
+  mdm_Exponentials::mix_vifs(AIF_, f_a, tau_a, tau_v, Cp_t_);
 
   mdm_Exponentials::biexponential(
-    F_p * E_pos, F_p * (1 - E_pos), K_pos, K_neg, Cp_t, t,
+    F_p * E_pos, F_p * (1 - E_pos), K_pos, K_neg, Cp_t_, t,
     CtModel_);
 }
 
@@ -10,7 +10,9 @@
 #endif // !MDM_API_EXPORTS
 
 #include "mdm_DCEModelDIETM.h"
+#include <madym/dce/mdm_Exponentials.h>
 #include <cmath>
+#include <algorithm>
 
 const double mdm_DCEModelDIETM::ETM_KEPMAX = 42.0;
 
@@ -55,11 +57,22 @@ MDM_API mdm_DCEModelDIETM::~mdm_DCEModelDIETM()
 
 }
 
+MDM_API mdm_DCEModelDIETM::mdm_DCEModelDIETM(const mdm_DCEModelDIETM &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelDIETM::modelType() const
 {
   return "mdm_DCEModelDIETM";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelDIETM::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelDIETM>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelDIETM::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -82,8 +95,8 @@ MDM_API void mdm_DCEModelDIETM::computeCtModel(size_t nTimes)
   //Resample AIF and get AIF times
   AIF_.resample_AIF( tau_a);
   AIF_.resample_PIF( tau_v, false, true);
-  const std::vector<double> Ca_t = AIF_.AIF();
-  const std::vector<double> Cv_t = AIF_.PIF();
+  const std::vector<double> &Ca_t = AIF_.AIF();
+  const std::vector<double> &Cv_t = AIF_.PIF();
   const std::vector<double> &t = AIF_.AIFTimes();
   double f_v = 1 - f_a; // estimate of hepatic portal venous fraction
 
@@ -118,6 +131,77 @@ MDM_API void mdm_DCEModelDIETM::computeCtModel(size_t nTimes)
   }
 }
 
+MDM_API void mdm_DCEModelDIETM::computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian)
+{
+  const double &kTrans = pkParams_[0];
+  const double &ve = pkParams_[1];
+  const double &vp = pkParams_[2];
+  const double &f_a = pkParams_[3];
+  const double &tau_a = pkParams_[4];
+  const double &tau_v = pkParams_[5];
+
+  //No exponential term to differentiate, so use numerical form
+  if (std::any_of(pkParams_.begin(), pkParams_.end(), [](double p) {return std::isnan(p); }) ||
+    ve == 0.0 || kTrans == 0.0)
+  {
+    mdm_DCEModelBase::computeCtModelAndJacobian(nTimes, jacobian);
+    return;
+  }
+
+  const size_t nParams = numParams();
+  jacobian.assign(nTimes * nParams, 0.0);
+
+  //Derivatives wrt to bolus arrivals are numerical - must be computed before Cm(t)
+  numericalJacobian(nTimes, { 4, 5 }, jacobian);
+
+  AIF_.resample_AIF(tau_a);
+  AIF_.resample_PIF(tau_v, false, true);
+  const auto &Ca_t = AIF_.AIF();
+  const auto &Cv_t = AIF_.PIF();
+  const auto &t = AIF_.AIFTimes();
+  double f_v = 1 - f_a;
+
+  //Cm(t) is linear in the input Cp(t) = f_a.Ca(t) + f_v.Cv(t), so the derivative wrt f_a
+  //is the model applied to Ca(t) - Cv(t)
+  Cp_t_.resize(nTimes);
+  Cd_t_.resize(nTimes);
+  for (size_t i_t = 0; i_t < nTimes; i_t++)
+  {
+    Cp_t_[i_t] = f_a * Ca_t[i_t] + f_v * Cv_t[i_t];
+    Cd_t_[i_t] = Ca_t[i_t] - Cv_t[i_t];
+  }
+
+  double kep = kTrans / ve;
+  I_t_.resize(nTimes);
+  dI_dkep_.resize(nTimes);
+  Id_t_.assign(nTimes, 0.0);
+  dId_dkep_.assign(nTimes, 0.0);
+  mdm_Exponentials::exp_integral(kep, Cp_t_, t, nTimes, I_t_, dI_dkep_);
+  if (optParamFlags_[3])
+    mdm_Exponentials::exp_integral(kep, Cd_t_, t, nTimes, Id_t_, dId_dkep_);
+
+  std::fill(CtModel_.begin(), CtModel_.begin() + nTimes, 0.0);
+  for (size_t i_t = 0; i_t < nTimes; i_t++)
+  {
+    double C_t = vp * Cp_t_[i_t] + kTrans * I_t_[i_t];
+    if (std::isnan(C_t))
+      return;
+
+    CtModel_[i_t] = C_t;
+
+    double *J = &jacobian[i_t * nParams];
+    J[0] = I_t_[i_t] + kep * dI_dkep_[i_t];
+    J[1] = -kep * kep * dI_dkep_[i_t];
+    J[2] = Cp_t_[i_t];
+    J[3] = vp * Cd_t_[i_t] + kTrans * Id_t_[i_t];
+  }
+}
+
+MDM_API bool mdm_DCEModelDIETM::hasAnalyticJacobian() const
+{
+  return true;
+}
+
 MDM_API void mdm_DCEModelDIETM::checkParams()
 { 
 	//First check all finite and not NaN
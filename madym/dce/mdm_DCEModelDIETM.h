@@ -33,12 +33,21 @@ public:
     int repeatParam = -1,
     const std::vector<double>& repeatValues = std::vector<double>(0));
 
+  //! Copy constructor, binding the new model to a different AIF
+  MDM_API mdm_DCEModelDIETM(const mdm_DCEModelDIETM &model, mdm_AIF &AIF);
+
   MDM_API ~mdm_DCEModelDIETM();
 
   MDM_API virtual std::string modelType() const;
 
+  MDM_API virtual std::shared_ptr<mdm_DCEModelBase> clone(mdm_AIF &AIF) const;
+
   MDM_API virtual void computeCtModel(size_t nTimes);
 
+  MDM_API virtual void computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian);
+
+  MDM_API virtual bool hasAnalyticJacobian() const;
+
   MDM_API virtual void checkParams();
 
 protected:
@@ -47,6 +56,11 @@ private:
   //METHODS:
 
   //VARIABLES
+  //Scratch buffers for Jacobian computation, reused between evaluations
+  std::vector<double> I_t_;
+  std::vector<double> dI_dkep_;
+  std::vector<double> Id_t_;
+  std::vector<double> dId_dkep_;
 	const static int ETM_ERR_VEPLUSVPGT1;   /* Ve + Vp > 1.0                           - Binary bit 14 set  */
 	const static int ETM_ERR_KEPINF;  /* Ktrans / Ve > MDM_KEPMAX                - Binary bit 15 set  */
 
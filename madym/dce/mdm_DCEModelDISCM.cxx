@@ -52,11 +52,22 @@ MDM_API mdm_DCEModelDISCM::~mdm_DCEModelDISCM()
 
 }
 
+MDM_API mdm_DCEModelDISCM::mdm_DCEModelDISCM(const mdm_DCEModelDISCM &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelDISCM::modelType() const
 {
   return "mdm_DCEModelDISCM";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelDISCM::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelDISCM>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelDISCM::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -81,8 +92,8 @@ MDM_API void mdm_DCEModelDISCM::computeCtModel(size_t nTimes)
   //Resample AIF and get AIF times
   AIF_.resample_AIF( tau_a);
   AIF_.resample_PIF( tau_v, false, true);
-  const std::vector<double> Ca_t = AIF_.AIF();
-  const std::vector<double> Cv_t = AIF_.PIF();
+  const std::vector<double> &Ca_t = AIF_.AIF();
+  const std::vector<double> &Cv_t = AIF_.PIF();
   const std::vector<double> &t = AIF_.AIFTimes();
 
   double f_v = 1 - f_a; // estimate of hepatic portal venous fraction
@@ -11,7 +11,9 @@
 
 #include "mdm_DCEModelETM.h"
 #include <madym/dce/mdm_Exponentials.h>
+#include <madym/dce/mdm_ExponentialKernels.h>
 #include <cmath>
+#include <algorithm>
 
 const double mdm_DCEModelETM::ETM_KEPMAX = 42.0;
 
@@ -56,11 +58,22 @@ MDM_API mdm_DCEModelETM::~mdm_DCEModelETM()
 
 }
 
+MDM_API mdm_DCEModelETM::mdm_DCEModelETM(const mdm_DCEModelETM &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelETM::modelType() const
 {
   return "mdm_DCEModelETM";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelETM::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelETM>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelETM::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -81,7 +94,7 @@ MDM_API void mdm_DCEModelETM::computeCtModel(size_t nTimes)
   //Resample AIF and get AIF times (I don't usually like single letter variables
   //but to be consistent with paper formulae, use AIF times = t)
   AIF_.resample_AIF( tau_a);
-  const std::vector<double> Ca_t = AIF_.AIF();
+  const std::vector<double> &Ca_t = AIF_.AIF();
   const std::vector<double> &t = AIF_.AIFTimes();
 
   if (v_e == 0.0 || Ktrans == 0.0)
@@ -111,6 +124,98 @@ MDM_API void mdm_DCEModelETM::computeCtModel(size_t nTimes)
   }
 }
 
+MDM_API void mdm_DCEModelETM::computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian)
+{
+  const double &Ktrans = pkParams_[0];
+  const double &v_e = pkParams_[1];
+  const double &v_p = pkParams_[2];
+  const double &tau_a = pkParams_[3];
+
+  //No exponential term to differentiate, so use numerical form
+  if (std::any_of(pkParams_.begin(), pkParams_.end(), [](double p) {return std::isnan(p); }) ||
+    v_e == 0.0 || Ktrans == 0.0)
+  {
+    mdm_DCEModelBase::computeCtModelAndJacobian(nTimes, jacobian);
+    return;
+  }
+
+  const size_t nParams = numParams();
+  jacobian.assign(nTimes * nParams, 0.0);
+
+  //Derivative wrt to bolus arrival is numerical - must be computed before Cm(t)
+  numericalJacobian(nTimes, { 3 }, jacobian);
+
+  AIF_.resample_AIF(tau_a);
+  const auto &Ca_t = AIF_.AIF();
+  const auto &t = AIF_.AIFTimes();
+
+  //Cm(t) = v_p.Ca(t) + Ktrans.I(t), where I(t) is the Ca(t) convolved with exp(-kep.t)
+  double kep = Ktrans / v_e;
+  I_t_.resize(nTimes);
+  dI_dkep_.resize(nTimes);
+  mdm_Exponentials::exp_integral(kep, Ca_t, t, nTimes, I_t_, dI_dkep_);
+
+  std::fill(CtModel_.begin(), CtModel_.begin() + nTimes, 0.0);
+  for (size_t i_t = 0; i_t < nTimes; i_t++)
+  {
+    double C_t = v_p * Ca_t[i_t] + Ktrans * I_t_[i_t];
+    if (std::isnan(C_t))
+      return;
+
+    CtModel_[i_t] = C_t;
+
+    double *J = &jacobian[i_t * nParams];
+    J[0] = I_t_[i_t] + kep * dI_dkep_[i_t];
+    J[1] = -kep * kep * dI_dkep_[i_t];
+    J[2] = Ca_t[i_t];
+  }
+}
+
+MDM_API bool mdm_DCEModelETM::hasAnalyticJacobian() const
+{
+  return true;
+}
+
+MDM_API void mdm_DCEModelETM::computeCtModelBatch(size_t nTimes,
+  const std::vector<double> &params, std::vector<double> &CtModels)
+{
+  const size_t nParams = numParams();
+  const size_t nSets = params.size() / nParams;
+  CtModels.resize(nSets * nTimes);
+  if (!nSets)
+    return;
+
+  //Sets with invalid parameters are given NaN kernel parameters, so the kernel zeros them.
+  //As in computeCtModel, if v_e or Ktrans is zero, only the vascular term is non-zero
+  batchKernelParams_.resize(3 * nSets);
+  double *Ktrans = batchKernelParams_.data();
+  double *v_p = Ktrans + nSets;
+  double *kep = v_p + nSets;
+  for (size_t k = 0; k < nSets; k++)
+  {
+    const double *p = &params[k * nParams];
+    if (std::any_of(p, p + nParams, [](double x) {return std::isnan(x); }))
+      Ktrans[k] = v_p[k] = kep[k] = NAN;
+    else if (p[1] == 0.0 || p[0] == 0.0)
+    {
+      Ktrans[k] = kep[k] = 0.0;
+      v_p[k] = p[2];
+    }
+    else
+    {
+      Ktrans[k] = p[0];
+      v_p[k] = p[2];
+      kep[k] = p[0] / p[1];
+    }
+  }
+
+  //Sets with different bolus delays each use their own resampled AIF
+  size_t AIFStride;
+  const double *Ca_t = batchAIFs(nTimes, params, 3, AIFStride);
+  mdm_ExponentialKernels::extendedTofts(nSets, Ktrans, v_p, kep,
+    Ca_t, AIF_.AIFTimes().data(), nTimes, CtModels.data(), AIFStride);
+}
+
 MDM_API void mdm_DCEModelETM::checkParams()
 { 
 	//First check all finite and not NaN
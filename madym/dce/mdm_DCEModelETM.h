@@ -33,12 +33,24 @@ public:
     int repeatParam = -1,
     const std::vector<double>& repeatValues = std::vector<double>(0));
 
+  //! Copy constructor, binding the new model to a different AIF
+  MDM_API mdm_DCEModelETM(const mdm_DCEModelETM &model, mdm_AIF &AIF);
+
   MDM_API ~mdm_DCEModelETM();
 
   MDM_API virtual std::string modelType() const;
 
+  MDM_API virtual std::shared_ptr<mdm_DCEModelBase> clone(mdm_AIF &AIF) const;
+
   MDM_API virtual void computeCtModel(size_t nTimes);
 
+  MDM_API virtual void computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian);
+
+  MDM_API virtual bool hasAnalyticJacobian() const;
+
+  MDM_API virtual void computeCtModelBatch(size_t nTimes, const std::vector<double> &params,
+    std::vector<double> &CtModels);
+
   MDM_API virtual void checkParams();
 
   MDM_API virtual std::vector<double> makeLLSMatrix(const std::vector<double>& Ct_sig) const;
@@ -55,6 +67,10 @@ private:
 	const static int ETM_ERR_KEPINF;  /* Ktrans / Ve > MDM_KEPMAX                - Binary bit 15 set  */
 
 	const static double ETM_KEPMAX;
+
+	//Scratch buffers for exponential integral and its derivative, reused between evaluations
+	std::vector<double> I_t_;
+	std::vector<double> dI_dkep_;
 };
 
 #endif //MDM_DCEMODELETM_HDR
@@ -11,8 +11,9 @@
 #endif // !MDM_API_EXPORTS
 #include "mdm_DCEModelFitter.h"
 
-//#include <cmath>
+#include <cmath>
 #include <algorithm>
+#include <numeric>
 
 #include "opt/optimization.h"
 #include "opt/interpolation.h"
@@ -21,6 +22,9 @@
 #include <madym/utils/mdm_exception.h>
 #include <cfloat>
 
+const int mdm_DCEModelFitter::REPEAT_PRUNE_ITERATIONS = 10;
+const double mdm_DCEModelFitter::REPEAT_PRUNE_RATIO = 2.0;
+
 MDM_API mdm_DCEModelFitter::mdm_DCEModelFitter(
 	mdm_DCEModelBase &model,
 	const size_t timepoint0,
@@ -36,6 +40,11 @@ MDM_API mdm_DCEModelFitter::mdm_DCEModelFitter(
   modelFitError_(0),
   type_(typeFromString(type)),
 	maxIterations_(maxIterations),
+  numIterations_(0),
+  repeatPruning_(false),
+  pruneSSD_(DBL_MAX),
+  pruneIterations_(0),
+  optimiserState_(NULL),
   BAD_FIT_SSD(DBL_MAX)
 {
 }
@@ -52,6 +61,7 @@ MDM_API std::string mdm_DCEModelFitter::toString(FitterTypes type)
   case LLS: return "LLS";
   case BLEIC: return "BLEIC";
   case NS: return "NS";
+  case LM: return "LM";
   default:
     throw mdm_exception(__func__, "Unknown optimisation type option " + type);
   }
@@ -62,7 +72,8 @@ MDM_API const std::vector<std::string> mdm_DCEModelFitter::validTypes()
   return {
     toString(LLS),
     toString(BLEIC),
-    toString(NS)
+    toString(NS),
+    toString(LM)
   };
 }
 
@@ -75,9 +86,11 @@ MDM_API mdm_DCEModelFitter::FitterTypes mdm_DCEModelFitter::typeFromString(const
     return BLEIC;
   else if (type == toString(NS))
     return NS;
+  else if (type == toString(LM))
+    return LM;
   else
     throw mdm_exception(__func__, boost::format(
-      "Optimisation type (%1%) is not recognised. Must be one of LLS, BLEIC or NS")
+      "Optimisation type (%1%) is not recognised. Must be one of LLS, BLEIC, NS or LM")
       % type);
 }
 
@@ -166,6 +179,21 @@ MDM_API double mdm_DCEModelFitter::modelFitError() const
   return modelFitError_;
 }
 
+MDM_API int mdm_DCEModelFitter::numIterations() const
+{
+  return numIterations_;
+}
+
+MDM_API void mdm_DCEModelFitter::setRepeatPruning(bool prune)
+{
+  repeatPruning_ = prune;
+}
+
+MDM_API bool mdm_DCEModelFitter::repeatPruning() const
+{
+  return repeatPruning_;
+}
+
 //-----------------------------------------------------------------------
 // Private
 //-------------------------------------------------------------------------
@@ -184,7 +212,7 @@ double mdm_DCEModelFitter::CtSSD()
 	model_.computeCtModel(timepointN_);
 
 	//Compute SSD
-  return computeSSD(model_.CtModel());
+  return computeSSD(model_.CtModel().data());
 }
 
 //
@@ -199,7 +227,7 @@ double mdm_DCEModelFitter::CtSSD(
 
 //
 double mdm_DCEModelFitter::computeSSD(
-  const std::vector<double> &CtModel) const
+  const double *CtModel) const
 {
   double  ssd = 0.0;
   for (size_t i = timepoint0_; i < timepointN_; i++)
@@ -212,32 +240,102 @@ double mdm_DCEModelFitter::computeSSD(
 }
 
 //
-void mdm_DCEModelFitter::optimiseModel()
+double mdm_DCEModelFitter::CtSSDAndGradient(
+  const std::vector<double>& parameter_array, double *gradient)
 {
-  //Check if we're repeating fits at a given parameter
-  if (model_.singleFit())
-    optimiseModelOnce();
+  //Set the full parameter array in the model from the optimised subset
+  model_.setOptimisedParams(parameter_array);
 
-  else
+  const auto nOpt = parameter_array.size();
+  std::fill(gradient, gradient + nOpt, 0.0);
+
+  model_.checkParams();
+  if (model_.getModelErrorCode() != mdm_ErrorTracker::ErrorCode::OK)
+    return BAD_FIT_SSD;
+
+  model_.computeCtModelAndJacobian(timepointN_, jacobian_);
+  const auto &CtModel = model_.CtModel();
+  const auto &optFlags = model_.optimisedParamFlags();
+  const size_t nParams = model_.numParams();
+
+  //d(SSD)/dp = -2 * sum_t (C(t) - Cm(t)) * dCm(t)/dp / noise(t)
+  double  ssd = 0.0;
+  for (size_t i = timepoint0_; i < timepointN_; i++)
   {
-    //For repeat fits, we loop over the repeats, saving the parameters that provide best fit
-    lowestModelFitError_ = DBL_MAX;
-    while (model_.nextRepeatParam())
+    double diff = ((*CtData_)[i] - CtModel[i]);
+    double w = 1.0 / noiseVar_[i];
+    ssd += diff * diff * w;
+
+    const double *J = &jacobian_[i * nParams];
+    for (size_t i_p = 0, i_opt = 0; i_p < nParams; i_p++)
     {
-      optimiseModelOnce();
-      if (modelFitError_ < lowestModelFitError_)
-      {
-        bestParams_ = model_.params();
-        lowestModelFitError_ = modelFitError_;
-      }
+      if (optFlags[i_p])
+        gradient[i_opt++] -= 2 * diff * w * J[i_p];
     }
-    //Once complete, set the model parameters to the saved best ones
-    //Recompute modelled C(t), and set the model fit error
-    model_.setParams(bestParams_);
+  }
+  return ssd;
+}
+
+//
+void mdm_DCEModelFitter::CtResiduals(
+  const std::vector<double>& parameter_array, double *residuals, alglib::real_2d_array *jac)
+{
+  //Set the full parameter array in the model from the optimised subset
+  model_.setOptimisedParams(parameter_array);
+
+  const auto nOpt = parameter_array.size();
+  const auto nResiduals = timepointN_ - timepoint0_;
+
+  model_.checkParams();
+  if (model_.getModelErrorCode() != mdm_ErrorTracker::ErrorCode::OK)
+  {
+    //Residuals set so their sum of squares is (close to) BAD_FIT_SSD
+    std::fill(residuals, residuals + nResiduals, std::sqrt(0.5 * BAD_FIT_SSD / nResiduals));
+    if (jac)
+      for (size_t i = 0; i < nResiduals; i++)
+        std::fill((*jac)[i], (*jac)[i] + nOpt, 0.0);
+    return;
+  }
+
+  if (jac)
+    model_.computeCtModelAndJacobian(timepointN_, jacobian_);
+  else
     model_.computeCtModel(timepointN_);
-    modelFitError_ = lowestModelFitError_;
+
+  const auto &CtModel = model_.CtModel();
+  const auto &optFlags = model_.optimisedParamFlags();
+  const size_t nParams = model_.numParams();
+
+  //r(t) = (C(t) - Cm(t)) / sqrt(noise(t)), so dr(t)/dp = -dCm(t)/dp / sqrt(noise(t))
+  for (size_t i = timepoint0_, i_r = 0; i < timepointN_; i++, i_r++)
+  {
+    double w = 1.0 / std::sqrt(noiseVar_[i]);
+    residuals[i_r] = ((*CtData_)[i] - CtModel[i]) * w;
+
+    if (!jac)
+      continue;
+
+    const double *J = &jacobian_[i * nParams];
+    double *jacRow = (*jac)[i_r];
+    for (size_t i_p = 0, i_opt = 0; i_p < nParams; i_p++)
+    {
+      if (optFlags[i_p])
+        jacRow[i_opt++] = -J[i_p] * w;
+    }
   }
-    
+}
+
+//
+void mdm_DCEModelFitter::optimiseModel()
+{
+  numIterations_ = 0;
+
+  //Check if we're repeating fits at a given parameter
+  if (model_.singleFit())
+    optimiseModelOnce();
+
+  else
+    optimiseModelRepeats();
 
   //Reset CtData_ to NULL, this forces the user to call initialiseModelFit before fitModel
   //and avoids potential dangling pointer. No danger of memory leak because CtData_ is never 
@@ -245,6 +343,108 @@ void mdm_DCEModelFitter::optimiseModel()
   CtData_ = NULL;
 }
 
+//
+void mdm_DCEModelFitter::optimiseModelRepeats()
+{
+  //If pruning, rank the repeats by their initial fit error, so the best fit is usually
+  //found first, and later repeats can be pruned. The initial model C(t) of every repeat
+  //with valid starting parameters is computed in a single batch. Otherwise, just fit
+  //the repeats in order
+  const auto nRepeats = model_.repeatValues().size();
+  repeatInitParams_ = model_.initialParams();
+  repeatOrder_.resize(nRepeats);
+  std::iota(repeatOrder_.begin(), repeatOrder_.end(), 0);
+  if (repeatPruning_)
+  {
+    repeatSSD_.assign(nRepeats, BAD_FIT_SSD);
+    repeatParams_.clear();
+    repeatValid_.clear();
+    for (size_t i_r = 0; i_r < nRepeats; i_r++)
+    {
+      model_.setRepeat(i_r);
+      model_.checkParams();
+      if (model_.getModelErrorCode() != mdm_ErrorTracker::ErrorCode::OK)
+        continue;
+
+      repeatParams_.insert(repeatParams_.end(), model_.params().begin(), model_.params().end());
+      repeatValid_.push_back(i_r);
+    }
+    if (!repeatValid_.empty())
+    {
+      model_.computeCtModelBatch(timepointN_, repeatParams_, repeatCtModels_);
+      for (size_t k = 0; k < repeatValid_.size(); k++)
+        repeatSSD_[repeatValid_[k]] = computeSSD(&repeatCtModels_[k * timepointN_]);
+    }
+
+    //Stable sort so ties are in repeat order
+    std::stable_sort(repeatOrder_.begin(), repeatOrder_.end(),
+      [&](size_t a, size_t b) {return repeatSSD_[a] < repeatSSD_[b]; });
+  }
+
+  //Fit each repeat, saving the parameters that provide best fit. If repeats have equal
+  //fit errors, keep the first in repeat order, as if they'd been fitted in that order
+  lowestModelFitError_ = DBL_MAX;
+  size_t bestRepeat = nRepeats;
+  for (auto i_r : repeatOrder_)
+  {
+    model_.setRepeat(i_r);
+    pruneSSD_ = repeatPruning_ && bestRepeat < nRepeats ? lowestModelFitError_ : DBL_MAX;
+    optimiseModelOnce();
+    if (modelFitError_ < lowestModelFitError_ ||
+      (modelFitError_ == lowestModelFitError_ && i_r < bestRepeat))
+    {
+      bestParams_ = model_.params();
+      lowestModelFitError_ = modelFitError_;
+      bestRepeat = i_r;
+    }
+  }
+  pruneSSD_ = DBL_MAX;
+
+  //Restore the initial parameters, so the next voxel's fit doesn't depend on the
+  //order this voxel's repeats were fitted in
+  model_.setInitialParams(repeatInitParams_);
+
+  //Once complete, set the model parameters to the saved best ones
+  //Recompute modelled C(t), and set the model fit error
+  model_.setParams(bestParams_);
+  model_.computeCtModel(timepointN_);
+  modelFitError_ = lowestModelFitError_;
+}
+
+//
+bool mdm_DCEModelFitter::startPruning(void *optimiserState)
+{
+  if (pruneSSD_ == DBL_MAX)
+    return false;
+
+  optimiserState_ = optimiserState;
+  pruneIterations_ = 0;
+  return true;
+}
+
+//
+void mdm_DCEModelFitter::pruneRepeat(double ssd)
+{
+  if (pruneSSD_ == DBL_MAX || !optimiserState_)
+    return;
+
+  if (++pruneIterations_ < REPEAT_PRUNE_ITERATIONS || !(ssd > REPEAT_PRUNE_RATIO * pruneSSD_))
+    return;
+
+  switch (type_)
+  {
+  case BLEIC:
+    alglib::minbleicrequesttermination(*static_cast<alglib::minbleicstate*>(optimiserState_)); break;
+  case NS:
+    alglib::minnsrequesttermination(*static_cast<alglib::minnsstate*>(optimiserState_)); break;
+  case LM:
+    alglib::minlmrequesttermination(*static_cast<alglib::minlmstate*>(optimiserState_)); break;
+  default:
+    break;
+  }
+  optimiserState_ = NULL;
+}
+
 //
 void mdm_DCEModelFitter::optimiseModelOnce()
 {
@@ -269,10 +469,13 @@ void mdm_DCEModelFitter::optimiseModelOnce()
       optimiseModel_bleic(x, maxits); break;
     case NS:
       optimiseModel_ns(x, maxits); break;
+    case LM:
+      optimiseModel_lm(x, maxits); break;
 
     default:
       throw mdm_exception(__func__, "Optimisation type not recognised");
     }
+    optimiserState_ = NULL;
     //optimiseModel_ns(x, maxits);
     
 
@@ -325,8 +528,11 @@ void mdm_DCEModelFitter::optimiseModel_ns(alglib::real_1d_array &x, alglib::ae_i
     alglib::minnssetcond(state, epsx, maxits);
 
     alglib::minnssetbc(state, lowerBoundsOpt_, upperBoundsOpt_);
-    alglib::minnsoptimize(state, &CtSSDalglib, NULL, this);
+    const bool prune = startPruning(&state);
+    alglib::minnssetxrep(state, prune);
+    alglib::minnsoptimize(state, &CtSSDalglib, prune ? &CtSSDrepalglib : NULL, this);
     alglib::minnsresults(state, x, rep);
+    numIterations_ += (int)rep.iterationscount;
   }
   catch (alglib::ap_error e)
   {
@@ -362,11 +568,73 @@ void mdm_DCEModelFitter::optimiseModel_bleic(alglib::real_1d_array& x, alglib::a
 	//
   try
   {
-    alglib::minbleiccreatef(x, diffstep, state);
+    //If the model has an analytic Jacobian, use it to supply the exact gradient,
+    //otherwise the optimiser computes the gradient by numerical differentiation
+    const bool useGradient = model_.hasAnalyticJacobian();
+    if (useGradient)
+      alglib::minbleiccreate(x, state);
+    else
+      alglib::minbleiccreatef(x, diffstep, state);
+
     alglib::minbleicsetbc(state, lowerBoundsOpt_, upperBoundsOpt_);
     alglib::minbleicsetcond(state, epsg, epsf, epsx, maxits);
-    alglib::minbleicoptimize(state, &CtSSDalglib, NULL, this);
+
+    const bool prune = startPruning(&state);
+    alglib::minbleicsetxrep(state, prune);
+    if (useGradient)
+      alglib::minbleicoptimize(state, &CtSSDGradalglib, prune ? &CtSSDrepalglib : NULL, this);
+    else
+      alglib::minbleicoptimize(state, &CtSSDalglib, prune ? &CtSSDrepalglib : NULL, this);
     alglib::minbleicresults(state, x, rep);
+    numIterations_ += (int)rep.iterationscount;
+  }
+  catch (alglib::ap_error e)
+  {
+    printf("ALGLIB error msg: %s\n", e.msg.c_str());
+  }
+}
+
+void mdm_DCEModelFitter::optimiseModel_lm(alglib::real_1d_array& x, alglib::ae_int_t maxits)
+{
+  alglib::minlmstate state;
+  alglib::minlmreport rep;
+
+  //
+  // Stopping condition on step size, if 0 (and maxits 0) ALGLIB selects a small
+  // step size automatically
+  //
+  double epsx = 0;
+
+  //
+  // This variable contains differentiation step
+  //
+  double diffstep = 1.0e-4;
+
+  //
+  // Optimise the vector of weighted residuals (C(t) - Cm(t)) / sqrt(noise(t)), supplying
+  // their Jacobian if the model has an analytic form, otherwise ALGLIB computes it numerically
+  //
+  alglib::ae_int_t nResiduals = timepointN_ - timepoint0_;
+  try
+  {
+    const bool useJacobian = model_.hasAnalyticJacobian();
+    if (useJacobian)
+      alglib::minlmcreatevj(nResiduals, x, state);
+    else
+      alglib::minlmcreatev(nResiduals, x, diffstep, state);
+
+    alglib::minlmsetbc(state, lowerBoundsOpt_, upperBoundsOpt_);
+    alglib::minlmsetcond(state, epsx, maxits);
+
+    const bool prune = startPruning(&state);
+    alglib::minlmsetxrep(state, prune);
+    if (useJacobian)
+      alglib::minlmoptimize(state, &CtResidualsalglib, &CtResidualsJacalglib,
+        prune ? &CtSSDrepalglib : NULL, this);
+    else
+      alglib::minlmoptimize(state, &CtResidualsalglib, prune ? &CtSSDrepalglib : NULL, this);
+    alglib::minlmresults(state, x, rep);
+    numIterations_ += (int)rep.iterationscount;
   }
   catch (alglib::ap_error e)
   {
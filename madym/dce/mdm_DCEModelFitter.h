@@ -26,7 +26,8 @@ public:
 	enum FitterTypes {
 		LLS,
 		BLEIC,
-		NS
+		NS,
+		LM
 	};
 	
 	//! Constructor
@@ -108,6 +109,39 @@ public:
 	*/
 	MDM_API double     modelFitError() const;
 
+	//! Return number of optimiser iterations used in the last model fit
+	/*!
+	Summed over all fits if repeat fitting a parameter. Zero for LLS fits.
+	\return number of iterations
+	*/
+	MDM_API int     numIterations() const;
+
+	//! Set whether repeat fits that are unlikely to improve on the best fit so far are abandoned early
+	/*!
+	When repeat fitting a parameter, starts are first ranked by their initial fit error, then
+	fitted from best to worst. If pruning is on, a later start is stopped after
+	REPEAT_PRUNE_ITERATIONS iterations if its fit error is still more than REPEAT_PRUNE_RATIO
+	times the best final error so far. This is a heuristic, not a bound: a start that converges
+	slowly may still have gone on to give the best fit, so pruning is off by default. Starts are
+	always fitted in the same order in a single thread, so results are deterministic, regardless
+	of how many voxels are fitted in parallel.
+	\param prune if true, prune repeat fits
+	*/
+	MDM_API void setRepeatPruning(bool prune);
+
+	//! Return whether repeat fits are pruned
+	/*!
+	\return true if repeat fits are pruned
+	\see setRepeatPruning
+	*/
+	MDM_API bool repeatPruning() const;
+
+	//! Number of iterations a repeat fit runs before it can be pruned
+	static const int REPEAT_PRUNE_ITERATIONS;
+
+	//! Ratio of fit error to best fit error at which repeat fits are pruned
+	static const double REPEAT_PRUNE_RATIO;
+
 
 protected:
 
@@ -120,27 +154,68 @@ private:
 
 	double CtSSD(const std::vector<double> &parameter_array);
 
-  double computeSSD(const std::vector<double> &CtModel) const;
+  double computeSSD(const double *CtModel) const;
+
+	double CtSSDAndGradient(const std::vector<double> &parameter_array, double *gradient);
+
+	void CtResiduals(const std::vector<double> &parameter_array, double *residuals,
+		alglib::real_2d_array *jac);
+
+	//Copy optimiser parameters into a reusable buffer, so callbacks don't allocate
+	const std::vector<double>& evalParams(const alglib::real_1d_array& x) {
+		evalParams_.assign(x.getcontent(), x.getcontent() + x.length());
+		return evalParams_;
+	}
 
 	static void CtSSDalglib(const alglib::real_1d_array &x, alglib::real_1d_array &func, void *context) {
-		std::vector<double> params(x.getcontent(), x.getcontent() + x.length());
-		func[0] = static_cast<mdm_DCEModelFitter*>(context)->CtSSD(params);
+		auto fitter = static_cast<mdm_DCEModelFitter*>(context);
+		func[0] = fitter->CtSSD(fitter->evalParams(x));
 	}
 
 	static void CtSSDalglib(const alglib::real_1d_array& x, double& func, void* context) {
-		std::vector<double> params(x.getcontent(), x.getcontent() + x.length());
-		func = static_cast<mdm_DCEModelFitter*>(context)->CtSSD(params);
+		auto fitter = static_cast<mdm_DCEModelFitter*>(context);
+		func = fitter->CtSSD(fitter->evalParams(x));
+	}
+
+	static void CtSSDGradalglib(const alglib::real_1d_array& x, double& func, 
+		alglib::real_1d_array& grad, void* context) {
+		auto fitter = static_cast<mdm_DCEModelFitter*>(context);
+		func = fitter->CtSSDAndGradient(fitter->evalParams(x), grad.getcontent());
 	}
 
+	static void CtResidualsalglib(const alglib::real_1d_array& x, alglib::real_1d_array& fi, void* context) {
+		auto fitter = static_cast<mdm_DCEModelFitter*>(context);
+		fitter->CtResiduals(fitter->evalParams(x), fi.getcontent(), NULL);
+	}
+
+	static void CtResidualsJacalglib(const alglib::real_1d_array& x, alglib::real_1d_array& fi,
+		alglib::real_2d_array& jac, void* context) {
+		auto fitter = static_cast<mdm_DCEModelFitter*>(context);
+		fitter->CtResiduals(fitter->evalParams(x), fi.getcontent(), &jac);
+	}
+
+	//Called by ALGLIB after each iteration, to stop repeat fits that won't beat the best so far
+	static void CtSSDrepalglib(const alglib::real_1d_array& /*x*/, double func, void* context) {
+		static_cast<mdm_DCEModelFitter*>(context)->pruneRepeat(func);
+	}
+
+	bool startPruning(void *optimiserState);
+
+	void pruneRepeat(double ssd);
+
 	//
 	void optimiseModel();
 
+	void optimiseModelRepeats();
+
 	void optimiseModelOnce();
 
 	void optimiseModel_ns(alglib::real_1d_array& x, alglib::ae_int_t maxits);
 
 	void optimiseModel_bleic(alglib::real_1d_array& x, alglib::ae_int_t maxits);
 
+	void optimiseModel_lm(alglib::real_1d_array& x, alglib::ae_int_t maxits);
+
 	void optimiseModel_lls();
 
 	/*VARIABLES*/
@@ -163,10 +238,39 @@ private:
 	//Maximum number of iterations applied
 	int maxIterations_;
 
+	//Number of iterations used in last fit
+	int numIterations_;
+
 	double lowestModelFitError_;
 
 	std::vector<double> bestParams_;
 
+	//Repeat fit pruning. While a repeat is fitted, pruneSSD_ is the error it must get close to
+	//(DBL_MAX if it can't be pruned), and optimiserState_ points to the active ALGLIB state
+	bool repeatPruning_;
+	double pruneSSD_;
+	int pruneIterations_;
+	void *optimiserState_;
+
+	//Model initial parameters before repeat fitting, restored after each voxel
+	std::vector<double> repeatInitParams_;
+
+	//Initial fit error and fitting order of each repeat
+	std::vector<double> repeatSSD_;
+	std::vector<size_t> repeatOrder_;
+
+	//Starting parameters (row-major) of repeats with valid parameters, their indices,
+	//and their modelled C(t), evaluated together with computeCtModelBatch
+	std::vector<double> repeatParams_;
+	std::vector<size_t> repeatValid_;
+	std::vector<double> repeatCtModels_;
+
+	//Jacobian of modelled C(t), used when the model computes analytic gradients
+	std::vector<double> jacobian_;
+
+	//Optimised parameters passed to objective function callbacks
+	std::vector<double> evalParams_;
+
 
   const double BAD_FIT_SSD; //!< Value returned for SSD for failed model fits
 };
@@ -57,11 +57,22 @@ MDM_API mdm_DCEModelMLDRW::~mdm_DCEModelMLDRW()
 
 }
 
+MDM_API mdm_DCEModelMLDRW::mdm_DCEModelMLDRW(const mdm_DCEModelMLDRW &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelMLDRW::modelType() const
 {
   return "mdm_DCEModelMLDRW";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelMLDRW::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelMLDRW>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelMLDRW::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -82,21 +93,21 @@ MDM_API void mdm_DCEModelMLDRW::computeCtModel(size_t nTimes)
 
   //Resample AIF and get AIF times (I don't usually like single letter variables
   //but to be consistent with paper formulae, use AIF times = t)
-  std::vector<double> Ca_t(nTimes, 0.0);
+  //Only the current and previous input values are needed, so no need to store Ca(t)
   const auto &t = AIF_.AIFTimes();
   auto t_inj = t[AIF_.prebolus()-1];
 
   double  integral = 0.0;
   //double kep = Ktrans / v_e;
 
-  Ca_t[0] = 0;
+  double Ca_t0 = 0;
   for (size_t i_t = 1; i_t < nTimes; i_t++)
   {
-    Ca_t[i_t] = IF(alpha, kappa, MTT, t[i_t]-tau_a, t_inj);
+    double Ca_t1 = IF(alpha, kappa, MTT, t[i_t]-tau_a, t_inj);
 
     double delta_t = t[i_t] - t[i_t - 1];
     double e_delta = std::exp(-kep * delta_t);
-    double A = delta_t * 0.5 * (Ca_t[i_t] + Ca_t[i_t - 1] * e_delta);
+    double A = delta_t * 0.5 * (Ca_t1 + Ca_t0 * e_delta);
 
     integral = integral*e_delta + A;
     double C_t = integral;
@@ -105,6 +116,7 @@ MDM_API void mdm_DCEModelMLDRW::computeCtModel(size_t nTimes)
       return;
 
     CtModel_[i_t] = C_t;
+    Ca_t0 = Ca_t1;
   }
 }
 
@@ -33,10 +33,15 @@ public:
     int repeatParam = -1,
     const std::vector<double>& repeatValues = std::vector<double>(0));
 
+  //! Copy constructor, binding the new model to a different AIF
+  MDM_API mdm_DCEModelMLDRW(const mdm_DCEModelMLDRW &model, mdm_AIF &AIF);
+
   MDM_API ~mdm_DCEModelMLDRW();
 
   MDM_API virtual std::string modelType() const;
 
+  MDM_API virtual std::shared_ptr<mdm_DCEModelBase> clone(mdm_AIF &AIF) const;
+
   MDM_API virtual void computeCtModel(size_t nTimes);
 
   MDM_API virtual void checkParams();
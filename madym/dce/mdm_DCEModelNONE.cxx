@@ -23,11 +23,22 @@ MDM_API mdm_DCEModelNONE::~mdm_DCEModelNONE()
 
 }
 
+MDM_API mdm_DCEModelNONE::mdm_DCEModelNONE(const mdm_DCEModelNONE &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelNONE::modelType() const
 {
   return "mdm_DCEModelNONE";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelNONE::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelNONE>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelNONE::computeCtModel(size_t nTimes)
 {
   return;
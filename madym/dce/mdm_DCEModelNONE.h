@@ -23,10 +23,15 @@ public:
   MDM_API mdm_DCEModelNONE(
     mdm_AIF &AIF);
 
+  //! Copy constructor, binding the new model to a different AIF
+  MDM_API mdm_DCEModelNONE(const mdm_DCEModelNONE &model, mdm_AIF &AIF);
+
   MDM_API ~mdm_DCEModelNONE();
 
   MDM_API virtual std::string modelType() const;
 
+  MDM_API virtual std::shared_ptr<mdm_DCEModelBase> clone(mdm_AIF &AIF) const;
+
   MDM_API virtual void computeCtModel(size_t nTimes);
 
   MDM_API virtual void checkParams();
@@ -11,6 +11,7 @@
 
 #include "mdm_DCEModelPatlak.h"
 #include <cmath>
+#include <algorithm>
 
 MDM_API mdm_DCEModelPatlak::mdm_DCEModelPatlak(
   mdm_AIF &AIF,
@@ -53,11 +54,22 @@ MDM_API mdm_DCEModelPatlak::~mdm_DCEModelPatlak()
 
 }
 
+MDM_API mdm_DCEModelPatlak::mdm_DCEModelPatlak(const mdm_DCEModelPatlak &model, mdm_AIF &AIF)
+  :mdm_DCEModelBase(model, AIF)
+{
+
+}
+
 MDM_API std::string mdm_DCEModelPatlak::modelType() const
 {
   return "mdm_DCEModelPatlak";
 }
 
+MDM_API std::shared_ptr<mdm_DCEModelBase> mdm_DCEModelPatlak::clone(mdm_AIF &AIF) const
+{
+  return std::make_shared<mdm_DCEModelPatlak>(*this, AIF);
+}
+
 MDM_API void mdm_DCEModelPatlak::computeCtModel(size_t nTimes)
 {
   //Reset all the model concentrations to 0
@@ -77,7 +89,7 @@ MDM_API void mdm_DCEModelPatlak::computeCtModel(size_t nTimes)
   //Resample AIF and get AIF times (I don't usually like single letter variables
   //but to be consistent with paper formulae, use AIF times = t)
   AIF_.resample_AIF( tau_a);
-  const std::vector<double> Ca_t = AIF_.AIF();
+  const std::vector<double> &Ca_t = AIF_.AIF();
   const std::vector<double> &t = AIF_.AIFTimes();
 
   if (kTrans == 0.0)
@@ -105,6 +117,51 @@ MDM_API void mdm_DCEModelPatlak::computeCtModel(size_t nTimes)
   }
 }
 
+MDM_API void mdm_DCEModelPatlak::computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian)
+{
+  if (std::any_of(pkParams_.begin(), pkParams_.end(), [](double p) {return std::isnan(p); }))
+  {
+    mdm_DCEModelBase::computeCtModelAndJacobian(nTimes, jacobian);
+    return;
+  }
+
+  const double &kTrans = pkParams_[0];
+  const double &vp = pkParams_[1];
+  const double &tau_a = pkParams_[2];
+
+  const size_t nParams = numParams();
+  jacobian.assign(nTimes * nParams, 0.0);
+
+  //Derivative wrt to bolus arrival is numerical - must be computed before Cm(t)
+  numericalJacobian(nTimes, { 2 }, jacobian);
+
+  AIF_.resample_AIF(tau_a);
+  const auto &Ca_t = AIF_.AIF();
+  const auto &t = AIF_.AIFTimes();
+
+  //Cm(t) is linear in Ktrans and vp
+  std::fill(CtModel_.begin(), CtModel_.begin() + nTimes, 0.0);
+  double integral = 0.0;
+  for (size_t i_t = 0; i_t < nTimes; i_t++)
+  {
+    if (i_t)
+      integral += (t[i_t] - t[i_t - 1]) * (Ca_t[i_t - 1] + Ca_t[i_t]) / 2;
+
+    double C_t = vp * Ca_t[i_t] + kTrans * integral;
+    if (std::isnan(C_t))
+      return;
+
+    CtModel_[i_t] = C_t;
+    jacobian[i_t * nParams] = integral;
+    jacobian[i_t * nParams + 1] = Ca_t[i_t];
+  }
+}
+
+MDM_API bool mdm_DCEModelPatlak::hasAnalyticJacobian() const
+{
+  return true;
+}
+
 MDM_API void mdm_DCEModelPatlak::checkParams()
 { 
 	//First check all finite and not NaN
@@ -33,12 +33,21 @@ public:
     int repeatParam = -1,
     const std::vector<double>& repeatValues = std::vector<double>(0));
 
+  //! Copy constructor, binding the new model to a different AIF
+  MDM_API mdm_DCEModelPatlak(const mdm_DCEModelPatlak &model, mdm_AIF &AIF);
+
   MDM_API ~mdm_DCEModelPatlak();
 
   MDM_API virtual std::string modelType() const;
 
+  MDM_API virtual std::shared_ptr<mdm_DCEModelBase> clone(mdm_AIF &AIF) const;
+
   MDM_API virtual void computeCtModel(size_t nTimes);
 
+  MDM_API virtual void computeCtModelAndJacobian(size_t nTimes, std::vector<double> &jacobian);
+
+  MDM_API virtual bool hasAnalyticJacobian() const;
+
   MDM_API virtual void checkParams();
 
 protected:
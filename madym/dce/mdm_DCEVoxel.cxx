@@ -24,22 +24,23 @@ const double mdm_DCEVoxel::DYN_T1_MAX = 1.0e9;
 const double mdm_DCEVoxel::DYN_T1_INVALID = -1.0;
 
 MDM_API mdm_DCEVoxel::mdm_DCEVoxel(
-	const std::vector<double> &dynSignals,
-	const std::vector<double> &dynConc,
+	std::vector<double> dynSignals,
+	std::vector<double> dynConc,
   const size_t injectionImg,
 	const std::vector<double> &dynamicTimings,
 	const std::vector<double> &IAUCTimes,
-  const bool IAUCAtPeak)
+  const bool IAUCAtPeak,
+  const mdm_DCEVoxelStatus status)
 	:
-	StData_(dynSignals),
-	CtData_(dynConc),
+	StData_(std::move(dynSignals)),
+	CtData_(std::move(dynConc)),
   injectionImg_(injectionImg),
 	IAUCTimes_(IAUCTimes),
 	IAUCVals_(0),
   IAUCAtPeak_(IAUCAtPeak),
 	enhancing_(true),
 	dynamicTimings_(dynamicTimings),
-	status_(mdm_DCEVoxelStatus::OK)
+	status_(status)
 {
 }
 
@@ -58,7 +59,6 @@ MDM_API void mdm_DCEVoxel::computeCtFromSignal(
   if (!nTimes)
     return;
 
-  double r1Const_ms = r1Const*0.001;  // Use millisec instead of sec (as in user interface)
   CtData_.resize(nTimes);
 
   // Only calculate if T1(0) > 0.0
@@ -68,114 +68,99 @@ MDM_API void mdm_DCEVoxel::computeCtFromSignal(
     status_ = mdm_DCEVoxelStatus::T10_BAD;
     return;
   }
-
-  // Calculate dyn_pbm
-  double meanPrebolusSignal;
-  if (!M0)
-  {
-    // Need to check that we've got the pb time points
-    if (injectionImg_ > timepoint0)
-    {
-      double prebolusSum = 0.0;
-      size_t nPrebolus = 0;
-      for (size_t k = timepoint0; k < injectionImg_; k++)
-      {
-        prebolusSum += StData()[k];
-        nPrebolus++;
-      }
-      meanPrebolusSignal = prebolusSum / nPrebolus;
-    }
-    else
-    {
-      for (auto & c : CtData_)
-        c = Ca_BAD1;
-        
-      status_ = mdm_DCEVoxelStatus::M0_BAD;
-      return;
-    }  
-  }
  
   //Precompute cos and sin FA, corrected by B1 value
   const auto PI = acos(-1.0);
   double sinFA = sin(B1 *FA * PI / 180);
   double cosFA = cos(B1 *FA * PI / 180);
 
-  //Compute R1 and hence signal at each time point
-  for (size_t k = 0; k < nTimes; k++)
-  {
-    double R1value;
-    int errorCode;
-    if (M0)
-      R1value = computeT1DynM0(StData_[k], M0, cosFA, sinFA, TR, errorCode);
-    else
-      R1value = computeT1DynPBM(StData_[k], meanPrebolusSignal, T1, cosFA, sinFA, TR, errorCode);
-           
-    CtData_[k] = (R1value - 1.0 / T1) / r1Const_ms;
-
-    if (errorCode)
-      status_ = mdm_DCEVoxelStatus::DYN_T1_BAD;
-
-    if (std::isnan(CtData_[k]) || std::isinf(CtData_[k]))
-    {
-      status_ = mdm_DCEVoxelStatus::CA_NAN;
-      break;
-    }
-      
-  }
+  auto status = signalToConcentration(StData_.data(), CtData_.data(), nTimes,
+    T1, M0, cosFA, sinFA, TR, r1Const, injectionImg_, timepoint0);
 
+  if (status != mdm_DCEVoxelStatus::OK)
+    status_ = status;
 }
 
 //
-double mdm_DCEVoxel::computeT1DynPBM(const double st, const double meanPrebolusSignal, 
-  const double T1, const double cosFA, const double sinFA, const double TR, int &errorCode)
+MDM_API mdm_DCEVoxel::mdm_DCEVoxelStatus mdm_DCEVoxel::signalToConcentration(
+  const double *St, double *Ct, const size_t nTimes,
+  const double T1, const double M0, const double cosFA, const double sinFA,
+  const double TR, const double r1Const, const size_t injectionImg, const size_t timepoint0)
 {
-  //  Yes, it looks horrible and over-complicated.  I don't care.
-  //  Too many div by zeros to account for, and a log zero to boot
-  errorCode = 0;
-  if (meanPrebolusSignal < T1_TOLERANCE)
-    errorCode = -1;
-
-  auto expTR_T10 = exp(-TR / T1);
-  auto S1_M0 = st / meanPrebolusSignal;
+  if (!nTimes)
+    return mdm_DCEVoxelStatus::OK;
 
-  auto denominator = 1.0 - cosFA * expTR_T10;
-  if (std::abs(denominator) < T1_TOLERANCE)
-    errorCode = -2;
+  // Only calculate if T1(0) > 0.0
+  if (T1 <= 0.0)
+  {
+    std::fill(Ct, Ct + nTimes, 0.0);
+    return mdm_DCEVoxelStatus::T10_BAD;
+  }
 
-  auto fraction1 = (1.0 - expTR_T10) / denominator;
+  const double r1Const_ms = r1Const*0.001;  // Use millisec instead of sec (as in user interface)
+  const double R10 = 1.0 / T1;
 
-  denominator = 1.0 - S1_M0 * cosFA * fraction1;
-  if (std::abs(denominator) < T1_TOLERANCE)
-    errorCode = -3;
+  //Everything that doesn't depend on the time-point is computed once, and each loop only
+  //accumulates error flags, without branching, so it can be vectorised
+  int dynT1Bad = 0;
+  if (M0)
+  {
+    const double M0sinFA = M0 * sinFA;
+    for (size_t k = 0; k < nTimes; k++)
+    {
+      const double num = M0sinFA - St[k];
+      const double denom = M0sinFA - St[k] * cosFA;
+      const double R1_t = -log(num / denom) / TR;
+      Ct[k] = (R1_t - R10) / r1Const_ms;
 
-  auto fraction2 = (1.0 - S1_M0 * fraction1) / denominator;
-  if (std::abs(fraction2) < T1_TOLERANCE)
-    errorCode = -3;
+      dynT1Bad |= (std::abs(num) < T1_TOLERANCE) | (std::abs(denom) < T1_TOLERANCE);
+    }
+  }
+  else
+  {
+    // Need to check that we've got the pb time points
+    if (injectionImg <= timepoint0)
+    {
+      std::fill(Ct, Ct + nTimes, Ca_BAD1);
+      return mdm_DCEVoxelStatus::M0_BAD;
+    }
 
-  auto  R1_t = log(fraction2) / -TR;
-  if (R1_t < 0.0)
-    errorCode = -4;
-  else if (1.0 / R1_t > DYN_T1_MAX)
-    errorCode = -5;
+    double prebolusSum = 0.0;
+    for (size_t k = timepoint0; k < injectionImg; k++)
+      prebolusSum += St[k];
+    const double meanPrebolusSignal = prebolusSum / (injectionImg - timepoint0);
 
-  return R1_t;
-}
+    //  Yes, it looks horrible and over-complicated.  I don't care.
+    //  Too many div by zeros to account for, and a log zero to boot
+    const double expTR_T10 = exp(-TR / T1);
+    const double denominator1 = 1.0 - cosFA * expTR_T10;
+    const double fraction1 = (1.0 - expTR_T10) / denominator1;
+    dynT1Bad = (meanPrebolusSignal < T1_TOLERANCE) | (std::abs(denominator1) < T1_TOLERANCE);
 
-//
-double mdm_DCEVoxel::computeT1DynM0(const double st, const double M0,
-  const double cosFA, const double sinFA, const double TR, int &errorCode)
-{
-  errorCode = 0;
-  auto num = M0 * sinFA - st;
-  auto denom = M0 * sinFA - st * cosFA;
-  auto R1_t = -log(num / denom) / TR;
+    for (size_t k = 0; k < nTimes; k++)
+    {
+      const double S1_M0 = St[k] / meanPrebolusSignal;
+      const double denominator2 = 1.0 - S1_M0 * cosFA * fraction1;
+      const double fraction2 = (1.0 - S1_M0 * fraction1) / denominator2;
+      const double R1_t = log(fraction2) / -TR;
+      Ct[k] = (R1_t - R10) / r1Const_ms;
+
+      dynT1Bad |= (std::abs(denominator2) < T1_TOLERANCE) | (std::abs(fraction2) < T1_TOLERANCE) |
+        (R1_t < 0.0) | (1.0 / R1_t > DYN_T1_MAX);
+    }
+  }
 
-  if (std::abs(num) < T1_TOLERANCE)
-    errorCode = -1;
-  else if (std::abs(denom) < T1_TOLERANCE)
-    errorCode = -2;
+  //Time-points after the first NaN are zeroed
+  for (size_t k = 0; k < nTimes; k++)
+  {
+    if (std::isnan(Ct[k]) || std::isinf(Ct[k]))
+    {
+      std::fill(Ct + k + 1, Ct + nTimes, 0.0);
+      return mdm_DCEVoxelStatus::CA_NAN;
+    }
+  }
 
-  return R1_t;
+  return dynT1Bad ? mdm_DCEVoxelStatus::DYN_T1_BAD : mdm_DCEVoxelStatus::OK;
 }
 
 //
@@ -39,14 +39,16 @@ public:
 	\param dynamicTimings time in minutes of each series timepoint
 	\param IAUCTimes times at which compute IAUC
 	\param IAUCAtPeak flag to compute IAUC at peak signal
+	\param status initial error status, eg if dynConc was converted from signal outside the voxel
 	*/
 	MDM_API mdm_DCEVoxel(
-		const std::vector<double> &dynSignals,
-		const std::vector<double> &dynConc,
+		std::vector<double> dynSignals,
+		std::vector<double> dynConc,
     const size_t injectionImg,
 		const std::vector<double> &dynamicTimings,
 		const std::vector<double> &IAUCTimes,
-  	const bool IAUCAtPeak);
+  	const bool IAUCAtPeak,
+    const mdm_DCEVoxelStatus status = OK);
 
 	//! Default destructor
 	/*!
@@ -67,6 +69,29 @@ public:
     const double T1, const double FA, const double TR, const double r1Const,
     const double M0, const double B1 = 1, size_t timepoint0 = 0);
 
+  //! Convert a signal time-series to contrast agent concentration in place
+  /*!
+  Used by computeCtFromSignal, and by callers converting many voxels at once, that can
+  precompute the sin and cos of the flip-angle when it is not B1 corrected. Does not log
+  warnings, so may be called concurrently.
+  \param St signal time-series, nTimes contiguous values
+  \param Ct array of nTimes values to hold concentration time-series
+  \param nTimes number of time-points
+  \param T1 baseline T1
+  \param M0 baseline magnetisation constant, if 0 the ratio of signal to pre-bolus mean is used
+  \param cosFA cos of the (B1 corrected) flip-angle
+  \param sinFA sin of the (B1 corrected) flip-angle
+  \param TR repetition in ms
+  \param r1Const relaxivity constant of contrast-agent
+  \param injectionImg timepoint bolus injected
+  \param timepoint0 first time-point to use in pre-bolus mean
+  \return error status of conversion
+  */
+  MDM_API static mdm_DCEVoxelStatus signalToConcentration(
+    const double *St, double *Ct, const size_t nTimes,
+    const double T1, const double M0, const double cosFA, const double sinFA,
+    const double TR, const double r1Const, const size_t injectionImg, const size_t timepoint0);
+
 	//! Compute IAUC values at selected times
 	/*!
 	*/
@@ -123,14 +148,6 @@ private:
 
 	/*METHODS*/
 
-  //
-  double computeT1DynPBM(const double st, const double s_pbm, 
-    const double T1, const double cosFA, const double sinFA, const double TR, int &errorCode);
-
-  //
-  double computeT1DynM0(const double st, const double M0, 
-    const double cosFA, const double sinFA, const double TR, int &errorCode);
-
   //
 	std::vector<double> computeIAUC(
 		const std::vector<double> &times, bool computePeak) const;
@@ -0,0 +1,177 @@
+/**
+*  @file    mdm_ExponentialKernels.cxx
+*  @brief   Implementation of mdm_ExponentialKernels class
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+#ifndef MDM_API_EXPORTS
+#define MDM_API_EXPORTS
+#endif // !MDM_API_EXPORTS
+
+#include "mdm_ExponentialKernels.h"
+#include "mdm_ExponentialKernels_avx2.h"
+#include <madym/dce/mdm_Exponentials.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(MDM_HAS_AVX2_KERNELS) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+//
+static mdm_ExponentialKernels::SIMDType detectSIMDType()
+{
+#if defined(MDM_HAS_AVX2_KERNELS)
+#if defined(_MSC_VER)
+	//Need AVX2 (leaf 7, EBX bit 5), FMA (leaf 1, ECX bit 12), and the OS to save
+	//AVX registers (OSXSAVE, ECX bit 27, and XCR0 bits 1 and 2)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7)
+	{
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+		if (avx2 && fma && osxsave && (_xgetbv(0) & 6) == 6)
+			return mdm_ExponentialKernels::AVX2;
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return mdm_ExponentialKernels::AVX2;
+#endif
+#endif
+	return mdm_ExponentialKernels::SCALAR;
+}
+
+//
+static mdm_ExponentialKernels::SIMDType& currentSIMDType()
+{
+	static mdm_ExponentialKernels::SIMDType type = detectSIMDType();
+	return type;
+}
+
+//
+MDM_API mdm_ExponentialKernels::SIMDType mdm_ExponentialKernels::simdType()
+{
+	return currentSIMDType();
+}
+
+//
+MDM_API bool mdm_ExponentialKernels::setSIMDType(SIMDType type)
+{
+	if (type == AVX2 && detectSIMDType() != AVX2)
+	{
+		currentSIMDType() = SCALAR;
+		return false;
+	}
+	currentSIMDType() = type;
+	return true;
+}
+
+//
+MDM_API void mdm_ExponentialKernels::extendedTofts(size_t nSets,
+	const double *Ktrans, const double *v_p, const double *k_ep,
+	const double *Cp_t, const double *t, size_t nTimes,
+	double *Cm_t, size_t CpStride)
+{
+	if (!nSets || !nTimes)
+		return;
+
+#if defined(MDM_HAS_AVX2_KERNELS)
+	if (currentSIMDType() == AVX2)
+	{
+		mdm_extendedTofts_avx2(nSets, Ktrans, v_p, k_ep, Cp_t, t, nTimes, Cm_t, CpStride);
+		zeroAfterNaN(nSets, nTimes, Cm_t);
+		return;
+	}
+#endif
+
+	for (size_t k = 0; k < nSets; k++)
+	{
+		double *C_k = Cm_t + k * nTimes;
+		const double *Cp_k = Cp_t + k * CpStride;
+		double integral = 0.0;
+
+		C_k[0] = v_p[k] * Cp_k[0];
+		for (size_t i_t = 1; i_t < nTimes; i_t++)
+		{
+			double delta_t = t[i_t] - t[i_t - 1];
+			double e_delta = std::exp(-k_ep[k] * delta_t);
+			double A = delta_t * 0.5 * (Cp_k[i_t] + Cp_k[i_t - 1] * e_delta);
+
+			integral = integral * e_delta + A;
+			C_k[i_t] = v_p[k] * Cp_k[i_t] + Ktrans[k] * integral;
+		}
+	}
+	zeroAfterNaN(nSets, nTimes, Cm_t);
+}
+
+//
+MDM_API void mdm_ExponentialKernels::biexponential(size_t nSets,
+	const double *F_pos, const double *F_neg, const double *K_pos, const double *K_neg,
+	const double *Cp_t, const double *t, size_t nTimes,
+	double *Cm_t, size_t CpStride)
+{
+	if (!nSets || !nTimes)
+		return;
+
+#if defined(MDM_HAS_AVX2_KERNELS)
+	if (currentSIMDType() == AVX2)
+	{
+		mdm_biexponential_avx2(nSets, F_pos, F_neg, K_pos, K_neg, Cp_t, t, nTimes, Cm_t, CpStride);
+		zeroAfterNaN(nSets, nTimes, Cm_t);
+		return;
+	}
+#endif
+
+	for (size_t k = 0; k < nSets; k++)
+	{
+		double *C_k = Cm_t + k * nTimes;
+		const double *Cp_k = Cp_t + k * CpStride;
+		double Ft_pos = 0;
+		double Ft_neg = 0;
+		double exp_pos = 1.0;
+		double exp_neg = 1.0;
+
+		C_k[0] = 0;
+		for (size_t i_t = 1; i_t < nTimes; i_t++)
+		{
+			auto delta_t = t[i_t] - t[i_t - 1];
+
+			if (K_pos[k])
+			{
+				mdm_Exponentials::exp_conv(K_pos[k], delta_t, Cp_k[i_t], Cp_k[i_t - 1], Ft_pos);
+				exp_pos = Ft_pos / K_pos[k];
+			}
+
+			if (K_neg[k])
+			{
+				mdm_Exponentials::exp_conv(K_neg[k], delta_t, Cp_k[i_t], Cp_k[i_t - 1], Ft_neg);
+				exp_neg = Ft_neg / K_neg[k];
+			}
+
+			C_k[i_t] = F_neg[k] * exp_neg + F_pos[k] * exp_pos;
+		}
+	}
+	zeroAfterNaN(nSets, nTimes, Cm_t);
+}
+
+//**************************************************************************
+// Private functions
+//**************************************************************************
+
+//
+void mdm_ExponentialKernels::zeroAfterNaN(size_t nSets, size_t nTimes, double *Cm_t)
+{
+	for (size_t k = 0; k < nSets; k++)
+	{
+		double *C_k = Cm_t + k * nTimes;
+		auto nan_t = std::find_if(C_k, C_k + nTimes, [](double c) {return std::isnan(c); });
+		std::fill(nan_t, C_k + nTimes, 0.0);
+	}
+}
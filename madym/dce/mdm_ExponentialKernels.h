@@ -0,0 +1,102 @@
+/**
+*  @file    mdm_ExponentialKernels.h
+*  @brief   Batched forward model kernels for exponential convolution models
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_EXPONENTIALKERNELS_HDR
+#define MDM_EXPONENTIALKERNELS_HDR
+
+#include <madym/utils/mdm_api.h>
+#include <cstddef>
+
+//! Batched forward model kernels for exponential convolution models
+/*!
+Each kernel evaluates a model for a batch of parameter sets, computing the recursive
+convolution for several parameter sets at once. Sets may share the same vascular input
+function, or each have their own (eg when sets have different bolus arrival times).
+Where the CPU supports it, SIMD implementations are selected at runtime, otherwise portable
+scalar code is used. The scalar kernels give the same results as the single parameter set
+forms in mdm_Exponentials.
+
+Outputs are stored row-major, so that row k (ie elements k*nTimes to (k+1)*nTimes - 1) is
+the modelled time-series for parameter set k. As in the single parameter set models, if a
+time-series becomes NaN, it and all subsequent time-points are set to zero.
+*/
+class mdm_ExponentialKernels {
+
+public:
+
+	//! Instruction sets available for batched kernels
+	enum SIMDType {
+		SCALAR = 0, ///< Portable scalar implementation
+		AVX2 = 1 ///< AVX2 with FMA, evaluates 4 parameter sets per instruction
+	};
+
+	//! Return the instruction set used by the batched kernels
+	/*!
+	Detected from the CPU on first call, unless overridden with setSIMDType.
+	\return current instruction set
+	*/
+	MDM_API static SIMDType simdType();
+
+	//! Override the instruction set used by the batched kernels
+	/*!
+	Mainly for testing and benchmarking SIMD kernels against scalar equivalents.
+	\param type instruction set to use. If not supported by the CPU, or the library
+	was built without it, the scalar kernels are used instead
+	\return true if the requested instruction set will be used
+	*/
+	MDM_API static bool setSIMDType(SIMDType type);
+
+	//! Extended Tofts model for a batch of parameter sets
+	/*!
+	Model equation: Cm(t) = v_p.Cp(t) + Ktrans.[Cp(t) * exp(-k_ep.t)], with the convolution
+	computed using the trapezium rule, as in mdm_DCEModelETM.
+
+	\param nSets number of parameter sets
+	\param Ktrans array of Ktrans, length nSets
+	\param v_p array of v_p, length nSets
+	\param k_ep array of k_ep (= Ktrans / v_e), length nSets
+	\param Cp_t vascular input function time-series. Set k uses elements k*CpStride to
+	k*CpStride + nTimes - 1
+	\param t times, length nTimes
+	\param nTimes number of time-points
+	\param Cm_t modelled concentration time-series, length nSets * nTimes
+	\param CpStride offset between the input functions of consecutive sets. If 0 (the default),
+	all sets share the same input function
+	*/
+	MDM_API static void extendedTofts(size_t nSets,
+		const double *Ktrans, const double *v_p, const double *k_ep,
+		const double *Cp_t, const double *t, size_t nTimes,
+		double *Cm_t, size_t CpStride = 0);
+
+	//! Bi-exponential model for a batch of parameter sets
+	/*!
+	Model equation: Cm(t) = Cp(t) * [ Fpos.exp(-t.Kpos) + Fneg.exp(-t.Kneg) ], as in
+	mdm_Exponentials::biexponential.
+
+	\param nSets number of parameter sets
+	\param F_pos array of Fpos, length nSets
+	\param F_neg array of Fneg, length nSets
+	\param K_pos array of Kpos, length nSets
+	\param K_neg array of Kneg, length nSets
+	\param Cp_t vascular input function time-series, as in extendedTofts
+	\param t times, length nTimes
+	\param nTimes number of time-points
+	\param Cm_t modelled concentration time-series, length nSets * nTimes
+	\param CpStride offset between the input functions of consecutive sets, 0 if shared
+	*/
+	MDM_API static void biexponential(size_t nSets,
+		const double *F_pos, const double *F_neg, const double *K_pos, const double *K_neg,
+		const double *Cp_t, const double *t, size_t nTimes,
+		double *Cm_t, size_t CpStride = 0);
+
+private:
+
+	//Zero each time-series from its first NaN onwards
+	static void zeroAfterNaN(size_t nSets, size_t nTimes, double *Cm_t);
+};
+
+#endif //MDM_EXPONENTIALKERNELS_HDR
@@ -0,0 +1,218 @@
+/**
+*  @file    mdm_ExponentialKernels_avx2.cxx
+*  @brief   AVX2 implementations of batched exponential convolution kernels
+*
+*  This file is compiled with AVX2 and FMA code generation enabled, so nothing in it
+*  may be called unless mdm_ExponentialKernels has checked the CPU supports them.
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+#include "mdm_ExponentialKernels_avx2.h"
+
+#if defined(MDM_HAS_AVX2_KERNELS)
+
+#include <immintrin.h>
+#include <cmath>
+
+//Number of parameter sets evaluated per instruction
+static const size_t LANES = 4;
+
+//Vectorised exp(x), using the Cephes rational approximation, with range reduction
+//exp(x) = 2^n.exp(r), |r| <= ln(2)/2. Accurate to within a couple of ulp for
+//x in [-708.39, 709]. Below this range returns 0 (std::exp would return a
+//denormal), above it returns infinity, and NaN is propagated
+static inline __m256d exp_pd(__m256d x)
+{
+	const __m256d LOG2E = _mm256_set1_pd(1.4426950408889634073599);
+	const __m256d C1 = _mm256_set1_pd(6.93145751953125E-1);
+	const __m256d C2 = _mm256_set1_pd(1.42860682030941723212E-6);
+	const __m256d MAXLOG = _mm256_set1_pd(709.0);
+	const __m256d MINLOG = _mm256_set1_pd(-7.08396418532264106224E2);
+
+	const __m256d P0 = _mm256_set1_pd(1.26177193074810590878E-4);
+	const __m256d P1 = _mm256_set1_pd(3.02994407707441961300E-2);
+	const __m256d P2 = _mm256_set1_pd(9.99999999999999999910E-1);
+	const __m256d Q0 = _mm256_set1_pd(3.00198505138664455042E-6);
+	const __m256d Q1 = _mm256_set1_pd(2.52448340349684104192E-3);
+	const __m256d Q2 = _mm256_set1_pd(2.27265548208155028766E-1);
+	const __m256d Q3 = _mm256_set1_pd(2.00000000000000000009E0);
+
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d half = _mm256_set1_pd(0.5);
+
+	//Clamp so 2^n below is a normal double, then n = round(x / ln(2))
+	__m256d xc = _mm256_min_pd(_mm256_max_pd(x, MINLOG), MAXLOG);
+	__m256d n = _mm256_floor_pd(_mm256_fmadd_pd(xc, LOG2E, half));
+
+	//r = x - n.ln(2), with ln(2) split in two for extra precision
+	__m256d r = _mm256_fnmadd_pd(n, C1, xc);
+	r = _mm256_fnmadd_pd(n, C2, r);
+
+	//exp(r) = 1 + 2r.P(r^2) / (Q(r^2) - r.P(r^2))
+	__m256d rr = _mm256_mul_pd(r, r);
+	__m256d p = _mm256_fmadd_pd(_mm256_fmadd_pd(P0, rr, P1), rr, P2);
+	p = _mm256_mul_pd(p, r);
+	__m256d q = _mm256_fmadd_pd(_mm256_fmadd_pd(_mm256_fmadd_pd(Q0, rr, Q1), rr, Q2), rr, Q3);
+	__m256d e = _mm256_div_pd(p, _mm256_sub_pd(q, p));
+	e = _mm256_fmadd_pd(_mm256_set1_pd(2.0), e, one);
+
+	//Scale by 2^n, constructing the double directly from its exponent bits
+	__m256i n64 = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+	n64 = _mm256_slli_epi64(_mm256_add_epi64(n64, _mm256_set1_epi64x(1023)), 52);
+	e = _mm256_mul_pd(e, _mm256_castsi256_pd(n64));
+
+	//Underflow to zero, overflow to infinity and propagate NaN
+	e = _mm256_blendv_pd(e, _mm256_setzero_pd(), _mm256_cmp_pd(x, MINLOG, _CMP_LT_OQ));
+	e = _mm256_blendv_pd(e, _mm256_set1_pd(HUGE_VAL), _mm256_cmp_pd(x, MAXLOG, _CMP_GT_OQ));
+	return _mm256_blendv_pd(e, x, _mm256_cmp_pd(x, x, _CMP_UNORD_Q));
+}
+
+//Store each lane of C in the time-series of its own parameter set
+static inline void store_lanes(__m256d C, double *Cm_t, size_t nTimes, size_t i_t)
+{
+	alignas(32) double c[LANES];
+	_mm256_store_pd(c, C);
+	for (size_t l = 0; l < LANES; l++)
+		Cm_t[l * nTimes + i_t] = c[l];
+}
+
+//Load values for the remaining nSets - k0 parameter sets, padding with pad
+static inline __m256d load_lanes(const double *x, size_t k0, size_t nSets, double pad)
+{
+	if (k0 + LANES <= nSets)
+		return _mm256_loadu_pd(x + k0);
+
+	alignas(32) double v[LANES];
+	for (size_t l = 0; l < LANES; l++)
+		v[l] = k0 + l < nSets ? x[k0 + l] : pad;
+	return _mm256_load_pd(v);
+}
+
+//Load the input function at time i_t for each parameter set, broadcast if shared (CpStride = 0)
+static inline __m256d load_Cp(const double *Cp_k0, size_t CpStride, size_t i_t, size_t nLanes)
+{
+	if (!CpStride)
+		return _mm256_set1_pd(Cp_k0[i_t]);
+
+	alignas(32) double v[LANES];
+	for (size_t l = 0; l < LANES; l++)
+		v[l] = l < nLanes ? Cp_k0[l * CpStride + i_t] : 0.0;
+	return _mm256_load_pd(v);
+}
+
+//As store_lanes, but only for the remaining nSets - k0 parameter sets
+static inline void store_lanes(__m256d C, double *Cm_t, size_t nTimes, size_t i_t, size_t nLanes)
+{
+	alignas(32) double c[LANES];
+	_mm256_store_pd(c, C);
+	for (size_t l = 0; l < nLanes; l++)
+		Cm_t[l * nTimes + i_t] = c[l];
+}
+
+//
+void mdm_extendedTofts_avx2(size_t nSets,
+	const double *Ktrans, const double *v_p, const double *k_ep,
+	const double *Cp_t, const double *t, size_t nTimes,
+	double *Cm_t, size_t CpStride)
+{
+	const __m256d half = _mm256_set1_pd(0.5);
+
+	for (size_t k0 = 0; k0 < nSets; k0 += LANES)
+	{
+		const size_t nLanes = nSets - k0 < LANES ? nSets - k0 : LANES;
+		const __m256d vKtrans = load_lanes(Ktrans, k0, nSets, 0.0);
+		const __m256d vv_p = load_lanes(v_p, k0, nSets, 0.0);
+		const __m256d vneg_kep = _mm256_sub_pd(_mm256_setzero_pd(), load_lanes(k_ep, k0, nSets, 0.0));
+		double *C_k0 = Cm_t + k0 * nTimes;
+		const double *Cp_k0 = Cp_t + k0 * CpStride;
+
+		__m256d integral = _mm256_setzero_pd();
+		__m256d Cp0 = load_Cp(Cp_k0, CpStride, 0, nLanes);
+		store_lanes(_mm256_mul_pd(vv_p, Cp0), C_k0, nTimes, 0, nLanes);
+
+		for (size_t i_t = 1; i_t < nTimes; i_t++)
+		{
+			const double delta_t = t[i_t] - t[i_t - 1];
+			const __m256d vdelta_t = _mm256_set1_pd(delta_t);
+			const __m256d Cp1 = load_Cp(Cp_k0, CpStride, i_t, nLanes);
+
+			__m256d e_delta = exp_pd(_mm256_mul_pd(vneg_kep, vdelta_t));
+			__m256d A = _mm256_mul_pd(_mm256_mul_pd(vdelta_t, half),
+				_mm256_add_pd(Cp1, _mm256_mul_pd(Cp0, e_delta)));
+
+			integral = _mm256_add_pd(_mm256_mul_pd(integral, e_delta), A);
+			__m256d C = _mm256_add_pd(_mm256_mul_pd(vv_p, Cp1), _mm256_mul_pd(vKtrans, integral));
+
+			if (nLanes == LANES)
+				store_lanes(C, C_k0, nTimes, i_t);
+			else
+				store_lanes(C, C_k0, nTimes, i_t, nLanes);
+			Cp0 = Cp1;
+		}
+	}
+}
+
+//Vectorised mdm_Exponentials::exp_conv, updating f in lanes where T is non-zero, then
+//returning f / T in those lanes, and f_T (previous value) elsewhere
+static inline void exp_conv_pd(__m256d T, __m256d nonZero, __m256d delta_t,
+	__m256d Ca1, __m256d Ca0, __m256d &f, __m256d &f_T)
+{
+	const __m256d one = _mm256_set1_pd(1.0);
+
+	__m256d xi = _mm256_mul_pd(delta_t, T);
+	__m256d delta_a = _mm256_div_pd(_mm256_sub_pd(Ca1, Ca0), xi);
+	__m256d E = exp_pd(_mm256_sub_pd(_mm256_setzero_pd(), xi));
+	__m256d E0 = _mm256_sub_pd(one, E);
+	__m256d E1 = _mm256_sub_pd(xi, E0);
+
+	__m256d integral = _mm256_add_pd(_mm256_mul_pd(Ca0, E0), _mm256_mul_pd(delta_a, E1));
+	__m256d f_new = _mm256_add_pd(_mm256_mul_pd(f, E), integral);
+
+	f = _mm256_blendv_pd(f, f_new, nonZero);
+	f_T = _mm256_blendv_pd(f_T, _mm256_div_pd(f_new, T), nonZero);
+}
+
+//
+void mdm_biexponential_avx2(size_t nSets,
+	const double *F_pos, const double *F_neg, const double *K_pos, const double *K_neg,
+	const double *Cp_t, const double *t, size_t nTimes,
+	double *Cm_t, size_t CpStride)
+{
+	for (size_t k0 = 0; k0 < nSets; k0 += LANES)
+	{
+		const size_t nLanes = nSets - k0 < LANES ? nSets - k0 : LANES;
+		const __m256d vF_pos = load_lanes(F_pos, k0, nSets, 0.0);
+		const __m256d vF_neg = load_lanes(F_neg, k0, nSets, 0.0);
+		const __m256d vK_pos = load_lanes(K_pos, k0, nSets, 0.0);
+		const __m256d vK_neg = load_lanes(K_neg, k0, nSets, 0.0);
+		const __m256d pos_nonZero = _mm256_cmp_pd(vK_pos, _mm256_setzero_pd(), _CMP_NEQ_UQ);
+		const __m256d neg_nonZero = _mm256_cmp_pd(vK_neg, _mm256_setzero_pd(), _CMP_NEQ_UQ);
+		double *C_k0 = Cm_t + k0 * nTimes;
+		const double *Cp_k0 = Cp_t + k0 * CpStride;
+
+		__m256d Ft_pos = _mm256_setzero_pd();
+		__m256d Ft_neg = _mm256_setzero_pd();
+		__m256d exp_pos = _mm256_set1_pd(1.0);
+		__m256d exp_neg = _mm256_set1_pd(1.0);
+
+		store_lanes(_mm256_setzero_pd(), C_k0, nTimes, 0, nLanes);
+		for (size_t i_t = 1; i_t < nTimes; i_t++)
+		{
+			const __m256d delta_t = _mm256_set1_pd(t[i_t] - t[i_t - 1]);
+			const __m256d Ca1 = load_Cp(Cp_k0, CpStride, i_t, nLanes);
+			const __m256d Ca0 = load_Cp(Cp_k0, CpStride, i_t - 1, nLanes);
+
+			exp_conv_pd(vK_pos, pos_nonZero, delta_t, Ca1, Ca0, Ft_pos, exp_pos);
+			exp_conv_pd(vK_neg, neg_nonZero, delta_t, Ca1, Ca0, Ft_neg, exp_neg);
+
+			__m256d C = _mm256_add_pd(_mm256_mul_pd(vF_neg, exp_neg), _mm256_mul_pd(vF_pos, exp_pos));
+
+			if (nLanes == LANES)
+				store_lanes(C, C_k0, nTimes, i_t);
+			else
+				store_lanes(C, C_k0, nTimes, i_t, nLanes);
+		}
+	}
+}
+
+#endif //MDM_HAS_AVX2_KERNELS
@@ -0,0 +1,33 @@
+/**
+*  @file    mdm_ExponentialKernels_avx2.h
+*  @brief   AVX2 implementations of batched exponential convolution kernels
+*
+*  Only compiled when the compiler supports AVX2 (MDM_HAS_AVX2_KERNELS is defined). These
+*  must only be called if the CPU supports AVX2 and FMA, which is checked at runtime by
+*  mdm_ExponentialKernels.
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_EXPONENTIALKERNELS_AVX2_HDR
+#define MDM_EXPONENTIALKERNELS_AVX2_HDR
+
+#include <cstddef>
+
+#if defined(MDM_HAS_AVX2_KERNELS)
+
+//! Extended Tofts model for a batch of parameter sets, see mdm_ExponentialKernels::extendedTofts
+void mdm_extendedTofts_avx2(size_t nSets,
+	const double *Ktrans, const double *v_p, const double *k_ep,
+	const double *Cp_t, const double *t, size_t nTimes,
+	double *Cm_t, size_t CpStride);
+
+//! Bi-exponential model for a batch of parameter sets, see mdm_ExponentialKernels::biexponential
+void mdm_biexponential_avx2(size_t nSets,
+	const double *F_pos, const double *F_neg, const double *K_pos, const double *K_neg,
+	const double *Cp_t, const double *t, size_t nTimes,
+	double *Cm_t, size_t CpStride);
+
+#endif //MDM_HAS_AVX2_KERNELS
+
+#endif //MDM_EXPONENTIALKERNELS_AVX2_HDR
@@ -39,6 +39,66 @@ public:
     f += integral;
   }
 
+  //!Computes update to exp_conv and its derivative with respect to T
+  /*!
+  \param T exponent parameter
+  \param delta_t time difference t_i - t_i-1
+  \param Ca1 value of Ca at t_i
+  \param Ca0 value of Ca at t_i-1
+  \param f previous value of convolved function to be updated
+  \param df_dT previous value of derivative of f with respect to T, to be updated
+  \see exp_conv
+  */
+  static void exp_conv_jacobian(double T, double delta_t, double Ca1, double Ca0,
+    double& f, double& df_dT)
+  {
+    auto xi = delta_t * T;
+    auto delta_a = (Ca1 - Ca0) / xi;
+    auto E = std::exp(-xi);
+    auto E0 = 1 - E;
+    auto E1 = xi - E0;
+
+    auto integral = Ca0 * E0 + delta_a * E1;
+    auto d_integral = Ca0 * delta_t * E - delta_a * E1 / T + delta_a * delta_t * E0;
+
+    df_dT = df_dT * E - delta_t * E * f + d_integral;
+    f = f * E + integral;
+  }
+
+  //!Computes exponentially weighted integral of Cp(t) and its derivative
+  /*!
+  Computes I(t_i) = int_0^t_i Cp(u).exp(-k(t_i - u)) du using the trapezium rule (as in the
+  Tofts models), and dI/dk, in a single forward loop.
+  \param k exponent parameter
+  \param Cp_t vascular input function time-series
+  \param t times
+  \param nTimes number of time-points to compute, must be <= t.size()
+  \param I_t integral at each time-point, must be at least length nTimes
+  \param dI_dk derivative of integral with respect to k, must be at least length nTimes
+  */
+  static void exp_integral(const double k,
+    const std::vector<double>& Cp_t, const std::vector<double>& t, const size_t nTimes,
+    std::vector<double>& I_t, std::vector<double>& dI_dk)
+  {
+    double integral = 0.0;
+    double d_integral = 0.0;
+    I_t[0] = 0.0;
+    dI_dk[0] = 0.0;
+    for (size_t i_t = 1; i_t < nTimes; i_t++)
+    {
+      double delta_t = t[i_t] - t[i_t - 1];
+      double e_delta = std::exp(-k * delta_t);
+      double de_delta = -delta_t * e_delta;
+      double A = delta_t * 0.5 * (Cp_t[i_t] + Cp_t[i_t - 1] * e_delta);
+      double dA = delta_t * 0.5 * Cp_t[i_t - 1] * de_delta;
+
+      d_integral = d_integral * e_delta + integral * de_delta + dA;
+      integral = integral * e_delta + A;
+      I_t[i_t] = integral;
+      dI_dk[i_t] = d_integral;
+    }
+  }
+
   //!Computes trapezoidal integration of time-series C(t) at time-points t
   /*!
   \param C_t time series to integrate
@@ -116,27 +176,92 @@ public:
     }
   }
 
+  //! Compute bi-exponential model time-series and its derivatives
+  /*!
+  Model equation as for biexponential. Derivatives are returned with respect to each of
+  F_pos, F_neg, K_pos and K_neg, in a row-major nTimes x 4 matrix.
+
+  \param F_pos (see model equation)
+  \param F_neg (see model equation)
+  \param K_pos (see model equation)
+  \param K_neg (see model equation)
+  \param Cp_t vascular input function time-series
+  \param t times
+  \param nTimes number of time-points to compute, must be <= t.size()
+  \param Cm_t modelled concentration time-series, must be at least length nTimes
+  \param dCm_t derivatives of Cm(t), resized to nTimes * 4
+  \see biexponential
+  */
+  static void biexponential_jacobian(
+    const double F_pos, const double F_neg, const double K_pos, const double K_neg,
+    const std::vector<double>& Cp_t, const std::vector<double>& t, const size_t nTimes,
+    std::vector<double>& Cm_t, std::vector<double>& dCm_t)
+  {
+    double Ft_pos = 0, dFt_pos = 0;
+    double Ft_neg = 0, dFt_neg = 0;
+    double exp_pos = 1.0, dexp_pos = 0.0;
+    double exp_neg = 1.0, dexp_neg = 0.0;
+
+    dCm_t.assign(nTimes * 4, 0.0);
+
+    for (size_t i_t = 1; i_t < nTimes; i_t++)
+    {
+      auto delta_t = t[i_t] - t[i_t - 1];
+
+      if (K_pos)
+      {
+        exp_conv_jacobian(K_pos, delta_t, Cp_t[i_t], Cp_t[i_t - 1], Ft_pos, dFt_pos);
+        exp_pos = Ft_pos / K_pos;
+        dexp_pos = (dFt_pos - exp_pos) / K_pos;
+      }
+
+      if (K_neg)
+      {
+        exp_conv_jacobian(K_neg, delta_t, Cp_t[i_t], Cp_t[i_t - 1], Ft_neg, dFt_neg);
+        exp_neg = Ft_neg / K_neg;
+        dexp_neg = (dFt_neg - exp_neg) / K_neg;
+      }
+
+      auto C_t = F_neg * exp_neg + F_pos * exp_pos;
+
+      if (std::isnan(C_t))
+        return;
+
+      Cm_t[i_t] = C_t;
+
+      auto dC = &dCm_t[i_t * 4];
+      dC[0] = exp_pos;
+      dC[1] = exp_neg;
+      dC[2] = F_pos * dexp_pos;
+      dC[3] = F_neg * dexp_neg;
+    }
+  }
+
   //! Combine vascular inputs with a given mixing fraction
   /*!
-  \param
-  \return
+  \param aif AIF object, resampled at the given delays
+  \param f_a arterial fraction, venous fraction set as 1 - f_a
+  \param tau_a arterial delay
+  \param tau_v venous delay
+  \param Cp_t combined vascular input, resized to length of AIF. Reusing the same vector
+  between calls avoids reallocation.
   */
-  static std::vector<double> mix_vifs(mdm_AIF& aif, const double f_a, const double tau_a, const double tau_v)
+  static void mix_vifs(mdm_AIF& aif, const double f_a, const double tau_a, const double tau_v,
+    std::vector<double>& Cp_t)
   {
     double f_v = 1 - f_a;
 
     //Get AIF and PIF, labelled in model equation as Ca_t and Cv_t
     //Resample AIF and get AIF times
-    std::vector<double> Cp_t;
     if (!f_v)
     {
       aif.resample_AIF(tau_a);
-      Cp_t = aif.AIF();
+      Cp_t.assign(aif.AIF().begin(), aif.AIF().end());
     }
     else if (!f_a)
     {
       aif.resample_PIF(tau_v, false, true);
-      Cp_t = aif.PIF();
+      Cp_t.assign(aif.PIF().begin(), aif.PIF().end());
     }
     else
     {
@@ -147,11 +272,10 @@ public:
       const auto& Cv_t = aif.PIF();
 
       auto nTimes = Ca_t.size();
-      Cp_t.resize(nTimes, 0);
+      Cp_t.resize(nTimes);
       for (size_t i = 0; i < nTimes; i++)
         Cp_t[i] = f_a * Ca_t[i] + f_v * Cv_t[i];
     }
-    return Cp_t;
   }
 
   static std::vector<double> make_biexponential_LLS_matrix(
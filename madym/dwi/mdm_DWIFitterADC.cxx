@@ -16,7 +16,6 @@
 #include <cmath>            /* For cos(), sin() and exp() */
 #include <cassert>          /* For assert macro */
 
-#include <madym/opt/interpolation.h>
 #include <madym/utils/mdm_ProgramLogger.h>
 #include <madym/utils/mdm_exception.h>
 
@@ -26,6 +25,9 @@ MDM_API mdm_DWIFitterADC::mdm_DWIFitterADC(const std::vector<double>& Bvals, boo
 	mdm_DWIFitterBase(Bvals, { "S0", "ADC" }),
 	linearFit_(linearFit)
 {
+	x_.setlength(2);
+	grad_.setlength(2);
+
 	//Pre-initialise the alglib state
 	if (!linearFit_)
 	{
@@ -106,15 +108,15 @@ MDM_API mdm_ErrorTracker::ErrorCode mdm_DWIFitterADC::fitModel(
 	
 
 	//Otherwise, use lin fit as init values for full non-linear fit
-	alglib::real_1d_array x;
-	x.attach_to_ptr(2, params.data());
+	x_[0] = params[0];
+	x_[1] = params[1];
 
 	// Optimize and evaluate results
 	try
 	{
-		minbcrestartfrom(state_, x);
+		minbcrestartfrom(state_, x_);
 		alglib::minbcoptimize(state_, &computeSSEGradientAlglib, NULL, this);
-		minbcresults(state_, x, rep_);
+		minbcresultsbuf(state_, x_, rep_);
 
 #if _DEBUG
 		//
@@ -142,11 +144,9 @@ MDM_API mdm_ErrorTracker::ErrorCode mdm_DWIFitterADC::fitModel(
 		return mdm_ErrorTracker::DWI_MAX_ITER;
 	}
 
-	params[0] = x[0]; //s0 - do we need to do this if we attached pointer above?
-	params[1] = x[1]; //ADC
-	alglib::real_1d_array g;
-	g.setlength(2);
-	computeSSEGradient(x, ssr, g);
+	params[0] = x_[0]; //s0
+	params[1] = x_[1]; //ADC
+	computeSSEGradient(x_, ssr, grad_);
 	return mdm_ErrorTracker::ErrorCode::OK;
 
 	
@@ -247,35 +247,31 @@ void mdm_DWIFitterADC::computeSSEGradient(
 //
 void mdm_DWIFitterADC::linearFit(double& S0, double& ADC, double& ssr)
 {
-	alglib::real_1d_array x;
-	alglib::real_1d_array y;
+	//Least-squares straight line fit of log signal against B-value, computed
+	//directly from the centred sums rather than a general polynomial fit
 	auto n = signals_to_fit_.size();
-	x.setcontent(n, Bvals_to_fit_.data());
-	y.setlength(n);
+	double meanB = 0, meanY = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		meanB += Bvals_to_fit_[i];
+		meanY += std::log(signals_to_fit_[i]);
+	}
+	meanB /= n;
+	meanY /= n;
+
+	double sBB = 0, sBY = 0;
 	for (size_t i = 0; i < n; i++)
-		y[i] = std::log(signals_to_fit_[i]);
-
-	alglib::ae_int_t info;
-	alglib::barycentricinterpolant pi;
-	alglib::real_1d_array p;
-	alglib::polynomialfitreport rep;
-
-	//
-	// Fitting without individual weights
-	//
-	// NOTE: result is returned as barycentricinterpolant structure.
-	//       if you want to get representation in the power basis,
-	//       you can use barycentricbar2pow() function to convert
-	//       from barycentric to power representation (see docs for 
-	//       POLINT subpackage for more info).
-	//
-	polynomialfit(x, y, 2, info, pi, rep);
-	polynomialbar2pow(pi, p);
-
-	S0 = std::exp(p[0]);
-	ADC = -p[1];
-
-	alglib::real_1d_array g;
-	g.setlength(2);
-	computeSSEGradient(x, ssr, g);
+	{
+		auto dB = Bvals_to_fit_[i] - meanB;
+		sBB += dB * dB;
+		sBY += dB * (std::log(signals_to_fit_[i]) - meanY);
+	}
+	auto slope = sBY / sBB;
+
+	S0 = std::exp(meanY - slope * meanB);
+	ADC = -slope;
+
+	x_[0] = S0;
+	x_[1] = ADC;
+	computeSSEGradient(x_, ssr, grad_);
 }
\ No newline at end of file
@@ -97,6 +97,11 @@ private:
 
 	bool linearFit_;
 
+	//Scratch arrays for the optimiser parameters and SSE gradient, allocated once
+	//so fitting does not allocate memory
+	alglib::real_1d_array x_;
+	alglib::real_1d_array grad_;
+
 };
 
 #endif /* MDM_DWIFITTERADC_HDR */
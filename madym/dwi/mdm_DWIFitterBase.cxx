@@ -63,6 +63,26 @@ MDM_API void mdm_DWIFitterBase::setSignalsToFit(const std::vector<double>& sigs)
 	signals_to_fit_ = sigs;
 }
 
+//
+MDM_API void mdm_DWIFitterBase::setInputsFromRow(const std::vector<double> &row,
+	const int nSignals)
+{
+	if (row.size() < size_t(numInputValues(nSignals)))
+		throw mdm_exception(__func__, boost::format(
+			"Row has %1% values, %2% required") % row.size() % numInputValues(nSignals));
+
+	Bvals_.assign(row.begin(), row.begin() + nSignals);
+	signals_.assign(row.begin() + nSignals, row.begin() + 2 * nSignals);
+	signals_to_fit_ = signals_;
+	Bvals_to_fit_ = Bvals_;
+}
+
+//
+MDM_API int mdm_DWIFitterBase::numInputValues(const int nSignals) const
+{
+	return 2 * nSignals;
+}
+
 MDM_API const std::vector<std::string> mdm_DWIFitterBase::paramNames() const
 {
 	return paramNames_;
@@ -21,15 +21,29 @@
 
 //
 MDM_API mdm_DWIFitterIVIM::mdm_DWIFitterIVIM(const std::vector<double> &Bvals,
-  bool fullModel, const std::vector<double> &BValsThresh)
+  bool fullModel, const std::vector<double> &BValsThresh, double restartTol)
   :
   mdm_DWIFitterBase(Bvals, { "S0", "D", "f", "Dstar" }),
   ADCFitter_(Bvals, false),
   fullModel_(fullModel),
-  BValsThresh_(BValsThresh)
+  BValsThresh_(BValsThresh),
+  restartTol_(restartTol),
+  s0Index_(-1),
+  fitSignals_(&signals_),
+  fitBvals_(&Bvals_),
+  ADCParams_(2),
+  startingVals_(4)
 {
+  //Pre-allocate scratch space, and partition the B-values if already set
+  fit_.fitted_params.resize(4);
+  bestFit_.fitted_params.resize(4);
+  if (!Bvals_.empty())
+    setPartitions();
+
   //Pre-initialise the alglib state
   int nParams = fullModel_ ? 4 : 3;
+  x_.setlength(nParams);
+  grad_.setlength(nParams);
   std::vector<double> init = { 100, 1e-3, 0.5, 1e-2 };
   std::vector<double> lowerBounds = { 0, 1e-4, 0, 0 };
   std::vector<double> upperBounds = {1e6, 1e6, 1, 1e6};
@@ -79,10 +93,10 @@ MDM_API mdm_DWIFitterIVIM::~mdm_DWIFitterIVIM()
 MDM_API mdm_ErrorTracker::ErrorCode mdm_DWIFitterIVIM::fitModel(
 	std::vector<double> &params, double& ssr)
 {
-  auto fit = fitMultipleThresholds();
-  params = fit.fitted_params;
-  ssr = fit.ssr;
-	return fit.success;
+  fitMultipleThresholds();
+  params = bestFit_.fitted_params;
+  ssr = bestFit_.ssr;
+	return bestFit_.success;
 }
 
 //
@@ -197,7 +211,9 @@ void mdm_DWIFitterIVIM::computeSSEGradient(
   const double& d = x[1];
   const double& f = x[2];
   const double& dstar = fullModel_ ? x[3] : 0;
-  auto n = signals_to_fit_.size();
+  const auto& signals = *fitSignals_;
+  const auto& Bvals = *fitBvals_;
+  auto n = signals.size();
 
   func = 0;
   grad[0] = 0;
@@ -211,9 +227,9 @@ void mdm_DWIFitterIVIM::computeSSEGradient(
   for (int i = 0; i < n; i++)
   {
     computeSignalGradient(
-      s0, d, f, dstar, Bvals_to_fit_[i],
+      s0, d, f, dstar, Bvals[i],
       s, ds0, dd, df, ddstar);
-    double diff = s - signals_to_fit_[i];
+    double diff = s - signals[i];
     func += diff * diff;
     grad[0] += 2 * ds0 * diff;
     grad[1] += 2 * dd * diff;
@@ -227,22 +243,20 @@ void mdm_DWIFitterIVIM::bcfitIVIM(
   const std::vector<double>& initParams,
   bcfitOutput &fit)
 {
-  //
-  // First, we create optimizer object and tune its properties
-  //
-  alglib::real_1d_array x;
+  //Restart the pre-initialised optimiser from the initial parameters
   int nParams = fullModel_ ? 4 : 3;
-  x.setcontent(nParams, initParams.data());
+  for (int i = 0; i < nParams; i++)
+    x_[i] = initParams[i];
 
-  //
-  fit.fitted_params.resize(4);
+  //Fits that fail have no SSR, so can't be selected as the best fit
+  fit.ssr = NAN;
 
   // Optimize and evaluate results
   try
   {
-    minbcrestartfrom(state_, x);
+    minbcrestartfrom(state_, x_);
     minbcoptimize(state_, &computeSSEGradientAlglib, NULL, this);
-    minbcresults(state_, x, rep_);
+    minbcresultsbuf(state_, x_, rep_);
 
     
 
@@ -274,27 +288,60 @@ void mdm_DWIFitterIVIM::bcfitIVIM(
     return;
   }
 
-  fit.fitted_params[0] = x[0]; //s0
-  fit.fitted_params[1] = x[1]; //d
-  fit.fitted_params[2] = x[2]; //f
+  fit.fitted_params[0] = x_[0]; //s0
+  fit.fitted_params[1] = x_[1]; //d
+  fit.fitted_params[2] = x_[2]; //f
+  fit.fitted_params[3] = fullModel_ ? x_[3] : 0; //dstar
 
-  if (fullModel_)
-    fit.fitted_params[3] = x[3]; //dstar
-
-  alglib::real_1d_array g;
-  g.setlength(nParams);
-  computeSSEGradient(x, fit.ssr, g);
+  computeSSEGradient(x_, fit.ssr, grad_);
   fit.success = mdm_ErrorTracker::OK;
   return;
 }
 
-bcfitOutput setNan()
+void mdm_DWIFitterIVIM::setNan(bcfitOutput& fit) const
 {
-  bcfitOutput fit;
-  fit.fitted_params = std::vector<double>(4, NAN);
+  fit.fitted_params.assign(4, NAN);
   fit.ssr = NAN;
   fit.success = mdm_ErrorTracker::DWI_FIT_FAIL;
-  return fit;
+}
+
+//
+void mdm_DWIFitterIVIM::setPartitions()
+{
+  //Split the B-values into high and low sets for each threshold
+  auto nBvals = Bvals_.size();
+  partitions_.resize(BValsThresh_.size());
+  for (size_t i_t = 0; i_t < BValsThresh_.size(); i_t++)
+  {
+    auto& partition = partitions_[i_t];
+    partition.hiIdx.clear();
+    partition.loIdx.clear();
+    partition.Bvals_hi.clear();
+    partition.Bvals_lo.clear();
+    for (size_t i_b = 0; i_b < nBvals; i_b++)
+    {
+      if (Bvals_[i_b] >= BValsThresh_[i_t])
+      {
+        partition.hiIdx.push_back(i_b);
+        partition.Bvals_hi.push_back(Bvals_[i_b]);
+      }
+      else
+      {
+        partition.loIdx.push_back(i_b);
+        partition.Bvals_lo.push_back(Bvals_[i_b]);
+      }
+    }
+  }
+
+  //The measured S0 is the (last) signal at B = 0
+  s0Index_ = -1;
+  for (size_t i_b = 0; i_b < nBvals; i_b++)
+    if (!Bvals_[i_b])
+      s0Index_ = int(i_b);
+
+  signals_hi_.reserve(nBvals);
+  signals_lo_.reserve(nBvals);
+  partitionBvals_ = Bvals_;
 }
 
 void correctAic(bcfitOutput& fit)
@@ -360,10 +407,10 @@ Fit IVIM - biexponential decay with b-value.
   Dictionary of fitted parameters and goodness of fit metrics from
   bcfit MinimizerResult.
 */
-bcfitOutput mdm_DWIFitterIVIM::fitMultipleThresholds()
+void mdm_DWIFitterIVIM::fitMultipleThresholds()
 {
-  auto nBvals = Bvals_.size();
-  bcfitOutput best_fit = setNan();
+  auto& best_fit = bestFit_;
+  setNan(best_fit);
 
   // Only peform fit if all signals are non - zero
   for (auto s : signals_)
@@ -371,119 +418,103 @@ bcfitOutput mdm_DWIFitterIVIM::fitMultipleThresholds()
     if (s <= 0)
     {
       best_fit.success = mdm_ErrorTracker::ErrorCode::DWI_INPUT_ZERO;
-      return best_fit;
+      return;
     }
       
   }
 
+  //B-values only change between samples in lite analysis, where they're read with the signals
+  if (Bvals_ != partitionBvals_)
+    setPartitions();
+
   // Loop over starting values generated for different thresholds
   double min_ssr = INFINITY;
-  std::vector<double> signals_fitted;
-  std::vector<double> bvals_fitted;
+  double s0_meas = s0Index_ >= 0 ? signals_[s0Index_] : 0.0;
 
   // Calculate starting values, depending on model_type
   
   // Get starting values from fit to subset of bvals
   // Use high bvals for S0 interceptand D starting value
-  
-  for (auto bthresh : BValsThresh_)
-    
+  for (const auto& partition : partitions_)
   {
-    // Collect all starting values
-    std::vector<double> starting_vals(4);
-
-    std::vector<double> Bvals_hi;
-    std::vector<double> signals_hi;
-
-    std::vector<double> Bvals_lo;
-    std::vector<double> signals_lo;
-
-    double s0_meas = 0.0;
-
-    for (size_t i_b = 0; i_b < nBvals; i_b++)
-    {
-      if (Bvals_[i_b] >= bthresh)
-      {
-        Bvals_hi.push_back(Bvals_[i_b]);
-        signals_hi.push_back(signals_[i_b]);
-      }
-      else //Bvals_[i_b] < bthresh
-      {
-        Bvals_lo.push_back(Bvals_[i_b]);
-        signals_lo.push_back(signals_[i_b]);
-      }
-
-      if (!Bvals_[i_b])
-        s0_meas = signals_[i_b];
-    }
+    signals_hi_.resize(partition.hiIdx.size());
+    for (size_t i = 0; i < partition.hiIdx.size(); i++)
+      signals_hi_[i] = signals_[partition.hiIdx[i]];
 
     //Do ADC fit on high B-values
     double res;
-    std::vector<double> initial_fit_high;
-    ADCFitter_.setSignalsToFit(signals_hi);
-    ADCFitter_.setBvalsToFit(Bvals_hi);
-    ADCFitter_.fitModel(initial_fit_high, res);
+    ADCFitter_.setSignalsToFit(signals_hi_);
+    ADCFitter_.setBvalsToFit(partition.Bvals_hi);
+    ADCFitter_.fitModel(ADCParams_, res);
       
-    auto s0_inter = initial_fit_high[0]; //s0
-    auto d_strt = initial_fit_high[1]; //adc
+    auto s0_inter = ADCParams_[0]; //s0
+    auto d_strt = ADCParams_[1]; //adc
     double f_strt;
 
     if (fullModel_)
     {
       // Use low bvals for S0and D* starting values
-      std::vector<double> initial_fit_low;
-      
+      signals_lo_.resize(partition.loIdx.size());
+      for (size_t i = 0; i < partition.loIdx.size(); i++)
+        signals_lo_[i] = signals_[partition.loIdx[i]];
+
       //Do ADC fit on low B-values
-      ADCFitter_.setSignalsToFit(signals_lo);
-      ADCFitter_.setBvalsToFit(Bvals_lo);
-      ADCFitter_.fitModel(initial_fit_low, res);
+      ADCFitter_.setSignalsToFit(signals_lo_);
+      ADCFitter_.setBvalsToFit(partition.Bvals_lo);
+      ADCFitter_.fitModel(ADCParams_, res);
 
-      auto s0_strt = initial_fit_low[0]; // "s0"
-      auto dstar_strt = initial_fit_low[1];// "adc"
+      auto s0_strt = ADCParams_[0]; // "s0"
+      auto dstar_strt = ADCParams_[1];// "adc"
 
       // Starting value for f from ratio of two "S0" values
       // This is only valid if s0_inter < s0_strt, otherwise set f to 0
       f_strt = (s0_strt > s0_inter) ? 1 - s0_inter / s0_strt : 0;
 
-      starting_vals[0] = s0_strt;
-      starting_vals[3] = dstar_strt;
+      startingVals_[0] = s0_strt;
+      startingVals_[3] = dstar_strt;
 
-      signals_to_fit_ = signals_;
-      Bvals_to_fit_ = Bvals_;
+      fitSignals_ = &signals_;
+      fitBvals_ = &Bvals_;
     }
     else
     {
       // Starting value for f from ratio of estimatedand measured s0
       f_strt = 1 - s0_inter / s0_meas;
 
-      starting_vals[0] = s0_meas;
+      startingVals_[0] = s0_meas;
 
-      signals_to_fit_ = signals_hi;
-      Bvals_to_fit_ = Bvals_hi;
+      fitSignals_ = &signals_hi_;
+      fitBvals_ = &partition.Bvals_hi;
     }
 
     //Same for both and full and simple
-    starting_vals[1] = d_strt;
-    starting_vals[2] = f_strt;
+    startingVals_[1] = d_strt;
+    startingVals_[2] = f_strt;
 
     //Do LM fit based on these starting values:
-    bcfitOutput fit;
-    bcfitIVIM(starting_vals, fit);
+    bcfitIVIM(startingVals_, fit_);
 
-    if (fit.ssr < min_ssr)
+    //If this restart has converged to (nearly) the same SSR as the best so far,
+    //further restarts are unlikely to improve the fit, so can stop early
+    bool converged = restartTol_ > 0 && std::isfinite(min_ssr) &&
+      std::abs(fit_.ssr - min_ssr) <= restartTol_ * min_ssr;
+
+    //Swap rather than copy, so the previous best fit's storage is reused for the next restart
+    if (fit_.ssr < min_ssr)
     {
-      //std::cout << "Fit " << bthresh << " is new best fit\n";
-      min_ssr = fit.ssr;
-      best_fit = fit;
-      signals_fitted = signals_to_fit_;
-      bvals_fitted = Bvals_to_fit_;
+      min_ssr = fit_.ssr;
+      std::swap(best_fit, fit_);
     }
+
+    if (converged)
+      break;
   }
+  fitSignals_ = &signals_;
+  fitBvals_ = &Bvals_;
   
   // Calculate corrected AIC(AICc)
   //correctAic(best_fit);
 
   // Rsq calculation
   //best_fit.rsq = calculateRsq(signals_fitted, best_fit.ssr);
-  return best_fit;
 }
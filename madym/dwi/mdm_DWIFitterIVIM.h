@@ -38,8 +38,13 @@ public:
 	//! Constructor from set of FAs and repetition time
 	/*!
 	\param Bvals vector of B0 values sin msecs
+	\param fullModel if true fit full model, otherwise simplified model with no D* term
+	\param Bvalsthresh thresholds on B-value used to generate starting values for each fit restart
+	\param restartTol if > 0, stop restarting once a restart's SSR is within this relative tolerance
+	of the best SSR so far. If 0, all thresholds are fitted
 	*/
-	MDM_API mdm_DWIFitterIVIM(const std::vector<double> &Bvals, bool fullModel, const std::vector<double> &Bvalsthresh);
+	MDM_API mdm_DWIFitterIVIM(const std::vector<double> &Bvals, bool fullModel, const std::vector<double> &Bvalsthresh,
+		double restartTol = 0.0);
 
 	//! Default denstructor
 	/*!
@@ -97,11 +102,24 @@ public:
 	
 private:
 
+	//Split of the B-values into high and low sets for one threshold
+	struct BvalsPartition
+	{
+		std::vector<size_t> hiIdx;
+		std::vector<size_t> loIdx;
+		std::vector<double> Bvals_hi;
+		std::vector<double> Bvals_lo;
+	};
+
 	void bcfitIVIM(
 		const std::vector<double>& initParams,
 		bcfitOutput& fit);
 
-	bcfitOutput fitMultipleThresholds();
+	void fitMultipleThresholds();
+
+	void setPartitions();
+
+	void setNan(bcfitOutput& fit) const;
 
 	void computeSignalGradient(
 		const double& s0, const double& d, const double& f, const double& dstar,
@@ -126,11 +144,31 @@ private:
 
 	bool fullModel_;
 
+	//!Relative tolerance on SSR for terminating threshold restarts early
+	double restartTol_;
+
 	//ADC fitter
 	mdm_DWIFitterADC ADCFitter_;
 
-	
-	
+	//B-value partitions for each threshold, these only depend on the B-values so are
+	//computed when the fitter is created, and only recomputed if the B-values change
+	std::vector<BvalsPartition> partitions_;
+	std::vector<double> partitionBvals_;
+	int s0Index_;
+
+	//Signals and B-values of the current fit, either all inputs or the high B-value set
+	const std::vector<double>* fitSignals_;
+	const std::vector<double>* fitBvals_;
+
+	//Scratch space reused for every voxel, so that fitting does not allocate memory
+	std::vector<double> signals_hi_;
+	std::vector<double> signals_lo_;
+	std::vector<double> ADCParams_;
+	std::vector<double> startingVals_;
+	bcfitOutput fit_;
+	bcfitOutput bestFit_;
+	alglib::real_1d_array x_;
+	alglib::real_1d_array grad_;
 };
 
 #endif /* MDM_DWIFITTERIVIM_HDR */
@@ -13,10 +13,12 @@
 
 #include <cassert>
 #include <chrono>  // chrono::system_clock
+#include <mutex>
 
 #include <madym/utils/mdm_ErrorTracker.h>
 #include <madym/utils/mdm_ProgramLogger.h>
 #include <madym/utils/mdm_exception.h>
+#include <madym/utils/mdm_ThreadPool.h>
 #include <boost/format.hpp>
 
 //
@@ -24,7 +26,9 @@ MDM_API mdm_DWIMapper::mdm_DWIMapper(mdm_ErrorTracker &errorTracker, mdm_Image3D
 	:inputImages_(0),
 	errorTracker_(errorTracker),
   ROI_(ROI),
-	model_(mdm_DWIModelGenerator::DWImodels::UNDEFINED)
+	model_(mdm_DWIModelGenerator::DWImodels::UNDEFINED),
+	restartTol_(0.0),
+	numThreads_(1)
 {}
 
 //
@@ -60,8 +64,9 @@ MDM_API void  mdm_DWIMapper::mapDWI(mdm_DWIModelGenerator::DWImodels method)
 	//
 	auto nSignals = inputImages_.size();
 
-	//Instantiate DWI fitter object of required method type
-	auto DWIFitter = mdm_DWIModelGenerator::createFitter(method, inputImages_, BvalsThresh_);
+	//Instantiate DWI fitter object of required method type, each thread creates its own
+	//below, this one just sets the model parameters
+	auto DWIFitter = mdm_DWIModelGenerator::createFitter(method, inputImages_, BvalsThresh_, restartTol_);
 	auto nParams = DWIFitter->nParams();
 
 	//Initialise maps
@@ -78,47 +83,77 @@ MDM_API void  mdm_DWIMapper::mapDWI(mdm_DWIModelGenerator::DWImodels method)
 
   bool useROI = (bool)ROI_;
 
+	//Partition the volume into slabs of whole slices (or rows if there are fewer
+	//slices than threads), which threads claim in turn until the volume is done
+	size_t nX, nY, nZ;
+	SSR_.getDimensions(nX, nY, nZ);
 	auto numVoxels = inputImages_[0].numVoxels();
+	auto nThreads = mdm_ThreadPool::numThreads(numThreads_, numVoxels);
+	const size_t slabSize = nZ >= nThreads ? nX * nY : nX;
+	mdm_ThreadPool::WorkQueue slabQueue(numVoxels, slabSize);
+
 	int numFitted = 0;
 	int numErrors = 0;
+	std::vector<std::pair<size_t, mdm_ErrorTracker::ErrorCode>> errors;
+	std::mutex resultsMutex;
+
 	auto fit_start = std::chrono::system_clock::now();
-	for (size_t voxelIndex = 0, n = numVoxels; voxelIndex < n; voxelIndex++)
+	mdm_ThreadPool::run(nThreads, [&](size_t)
 	{
-		if (useROI && !ROI_.voxel(voxelIndex))
-			continue;
+		//Each thread fits with its own fitter, as the fitters store the signals and optimiser state
+		auto threadFitter = mdm_DWIModelGenerator::createFitter(method, inputImages_, BvalsThresh_, restartTol_);
 
-		//Get signals at this voxel
+		//Errors are stored by each thread and merged into the error tracker afterwards
+		int threadFitted = 0;
+		std::vector<std::pair<size_t, mdm_ErrorTracker::ErrorCode>> threadErrors;
 		std::vector<double> signal(nSignals);
-		for (size_t i_f = 0; i_f < nSignals; i_f++)
-			signal[i_f] = inputImages_[i_f].voxel(voxelIndex);
-
-        
-		//Compute T1 and M0
 		std::vector<double> params;
-		double ssr;
-		DWIFitter->setSignals(signal);
-		auto errCode = DWIFitter->fitModel(params, ssr);
 
-		//Check for errors
-		if (errCode != mdm_ErrorTracker::OK)
+		size_t begin, end;
+		while (slabQueue.next(begin, end))
 		{
-			errorTracker_.updateVoxel(voxelIndex, errCode);
-			numErrors++;
+			for (size_t voxelIndex = begin; voxelIndex < end; voxelIndex++)
+			{
+				if (useROI && !ROI_.voxel(voxelIndex))
+					continue;
+
+				//Get signals at this voxel
+				for (size_t i_f = 0; i_f < nSignals; i_f++)
+					signal[i_f] = inputImages_[i_f].voxel(voxelIndex);
+
+				//Fit the model
+				double ssr;
+				threadFitter->setSignals(signal);
+				auto errCode = threadFitter->fitModel(params, ssr);
+
+				//Check for errors
+				if (errCode != mdm_ErrorTracker::OK)
+					threadErrors.push_back({ voxelIndex, errCode });
+
+				//Fill the image maps.
+				for (size_t i_p = 0; i_p < nParams; i_p++)
+					modelMaps_[i_p].setVoxel(voxelIndex, params[i_p]);
+				SSR_.setVoxel(voxelIndex, ssr);
+				threadFitted++;
+			}
 		}
 
-		//Fill the image maps.
-		for (size_t i_p = 0; i_p < nParams; i_p++)
-			modelMaps_[i_p].setVoxel(voxelIndex, params[i_p]);
-		SSR_.setVoxel(voxelIndex, ssr);
-		numFitted++;
-	}
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		numFitted += threadFitted;
+		errors.insert(errors.end(), threadErrors.begin(), threadErrors.end());
+	}, &slabQueue);
+
+	for (const auto &error : errors)
+		errorTracker_.updateVoxel(error.first, error.second);
+	numErrors = (int)errors.size();
 
 	// Get end time and log results
 	auto fit_end = std::chrono::system_clock::now();
 	std::chrono::duration<double> elapsed_seconds = fit_end - fit_start;
 
 	mdm_ProgramLogger::logProgramMessage("Fitted " +
-    std::to_string(numFitted) + " voxels in " + std::to_string(elapsed_seconds.count()) + "s");
+    std::to_string(numFitted) + " voxels in " + std::to_string(elapsed_seconds.count()) + "s"
+		+ (nThreads > 1 ? " using " + std::to_string(nThreads) + " threads" : ""));
   if (numErrors)
     mdm_ProgramLogger::logProgramWarning(__func__, 
       std::to_string(numErrors) + " voxels returned fit errors");
@@ -195,6 +230,19 @@ MDM_API void  mdm_DWIMapper::setBvalsThresh(const std::vector<double>& BvalsThre
 	BvalsThresh_ = BvalsThresh;
 }
 
+MDM_API void  mdm_DWIMapper::setRestartTolerance(double restartTol)
+{
+	if (restartTol < 0)
+		throw mdm_exception(__func__, boost::format(
+			"IVIM restart tolerance (%1%) must not be negative") % restartTol);
+	restartTol_ = restartTol;
+}
+
+MDM_API void  mdm_DWIMapper::setNumThreads(int nThreads)
+{
+	numThreads_ = nThreads;
+}
+
 //******************************************************************
 //Private methods
 //******************************************************************
\ No newline at end of file
@@ -108,6 +108,19 @@ public:
 	*/
 	MDM_API void  setBvalsThresh(const std::vector<double>& BvalsThresh);
 
+	//!Set relative SSR tolerance for stopping IVIM threshold restarts early
+	/*!
+	\param restartTol if > 0, IVIM fits stop trying further B-value thresholds once a restart's SSR
+	is within this relative tolerance of the best SSR so far. If 0 (default), all thresholds are fitted
+	*/
+	MDM_API void  setRestartTolerance(double restartTol);
+
+	//! Set number of threads used to fit voxels in mapDWI
+	/*!
+	\param nThreads number of worker threads. If 0, uses all available hardware threads
+	*/
+	MDM_API void  setNumThreads(int nThreads);
+
 protected:
 
 private:
@@ -136,5 +149,11 @@ private:
 	// Output image maps
 	std::vector<double> BvalsThresh_;
 
+	//Relative SSR tolerance for stopping IVIM restarts early
+	double restartTol_;
+
+	//Number of threads used for fitting
+	int numThreads_;
+
 };
 #endif /* mdm_T1VolumeAnalysis_HDR */
@@ -109,11 +109,13 @@ public:
 	to run the model from the input signal images
 	\param modelType enum code of specified DWI model
 	\param inputImages signal input images
+	\param BvalsThresh B-value thresholds used to initialise IVIM fits
+	\param restartTol relative SSR tolerance for stopping IVIM threshold restarts early, 0 to fit all thresholds
 	\return shared pointer to DWI fitter using specified model
 	*/
 	MDM_API static std::unique_ptr<mdm_DWIFitterBase> createFitter(
 		DWImodels modelType, const std::vector<mdm_Image3D>& inputImages,
-		const std::vector<double>& BvalsThresh)
+		const std::vector<double>& BvalsThresh, double restartTol = 0.0)
 	{
 		const auto& nSignals = inputImages.size();
 
@@ -122,7 +124,7 @@ public:
 		case ADC:
 		{
 			std::vector<double> B0s;
-			for (auto img : inputImages)
+			for (const auto &img : inputImages)
 				B0s.push_back(img.info().B.value());
 
 			return std::make_unique<mdm_DWIFitterADC>(B0s, false);
@@ -130,7 +132,7 @@ public:
 		case ADC_linear:
 		{
 			std::vector<double> B0s;
-			for (auto img : inputImages)
+			for (const auto &img : inputImages)
 				B0s.push_back(img.info().B.value());
 
 			return std::make_unique<mdm_DWIFitterADC>(B0s, true);
@@ -138,18 +140,18 @@ public:
 		case IVIM:
 		{
 			std::vector<double> B0s;
-			for (auto img : inputImages)
+			for (const auto &img : inputImages)
 				B0s.push_back(img.info().B.value());
 
-			return std::make_unique<mdm_DWIFitterIVIM>(B0s, true, BvalsThresh);
+			return std::make_unique<mdm_DWIFitterIVIM>(B0s, true, BvalsThresh, restartTol);
 		}
 		case IVIM_simple:
 		{
 			std::vector<double> B0s;
-			for (auto img : inputImages)
+			for (const auto &img : inputImages)
 				B0s.push_back(img.info().B.value());
 
-			return std::make_unique<mdm_DWIFitterIVIM>(B0s, false, BvalsThresh);
+			return std::make_unique<mdm_DWIFitterIVIM>(B0s, false, BvalsThresh, restartTol);
 		}
 		default:
 			throw mdm_exception(__func__, "DWI model " + std::to_string(modelType) + " not valid");
@@ -162,10 +164,12 @@ public:
 	the specified DWI model, configures the return object with meta-data (eg B values) required
 	to run the model from the input options structure
 	\param model enum code of specified DWI model
-	\param options set by user to configure mapping tool
+	\param BValsThresh B-value thresholds used to initialise IVIM fits
+	\param restartTol relative SSR tolerance for stopping IVIM threshold restarts early, 0 to fit all thresholds
 	\return shared pointer to DWI fitter using specified model
 	*/
-	MDM_API static std::unique_ptr<mdm_DWIFitterBase> createFitter(DWImodels model, const std::vector<double> BValsThresh = {})
+	MDM_API static std::unique_ptr<mdm_DWIFitterBase> createFitter(DWImodels model, const std::vector<double> BValsThresh = {},
+		double restartTol = 0.0)
 	{
 		std::vector<double> empty;
 		switch (model)
@@ -182,12 +186,12 @@ public:
 		}
 		case IVIM:
 		{
-			auto DWIFitter = std::make_unique<mdm_DWIFitterIVIM>(empty, true, BValsThresh);
+			auto DWIFitter = std::make_unique<mdm_DWIFitterIVIM>(empty, true, BValsThresh, restartTol);
 			return DWIFitter;
 		}
 		case IVIM_simple:
 		{
-			auto DWIFitter = std::make_unique<mdm_DWIFitterIVIM>(empty, false, BValsThresh);
+			auto DWIFitter = std::make_unique<mdm_DWIFitterIVIM>(empty, false, BValsThresh, restartTol);
 			return DWIFitter;
 		}
 		default:
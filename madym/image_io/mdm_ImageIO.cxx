@@ -91,7 +91,8 @@ MDM_API mdm_Image3D mdm_ImageIO::readImage3D(ImageFormat imgFormat,
 
 MDM_API std::vector<mdm_Image3D> mdm_ImageIO::readImage4D(ImageFormat imgFormat,
   const std::string& fileName,
-  bool loadXtr, bool applyScaling)
+  bool loadXtr, bool applyScaling,
+  mdm_Image3D::StorageType storageType)
 {
   switch (imgFormat)
   {
@@ -103,7 +104,7 @@ MDM_API std::vector<mdm_Image3D> mdm_ImageIO::readImage4D(ImageFormat imgFormat,
   case ImageFormat::NIFTI:
     ; //Fall through to use nifti
   case ImageFormat::NIFTI_GZ:
-    return mdm_NiftiFormat::readImage4D(fileName, loadXtr, applyScaling);
+    return mdm_NiftiFormat::readImage4D(fileName, loadXtr, applyScaling, storageType);
 
   case DICOM:
 #ifdef USING_DCMTK
@@ -126,7 +127,7 @@ MDM_API void mdm_ImageIO::writeImage3D(ImageFormat imgFormat,
 	const mdm_Image3D &img,
 	const mdm_ImageDatatypes::DataType dataTypeFlag, 
   const mdm_XtrFormat::XTR_type xtrTypeFlag,
-  bool applyScaling)
+  bool applyScaling, int compressionThreads)
 {
   switch (imgFormat)
   {
@@ -143,7 +144,8 @@ MDM_API void mdm_ImageIO::writeImage3D(ImageFormat imgFormat,
     break;
 
   case ImageFormat::NIFTI_GZ:
-    mdm_NiftiFormat::writeImage3D(baseName, img, dataTypeFlag, xtrTypeFlag, true, applyScaling);
+    mdm_NiftiFormat::writeImage3D(baseName, img, dataTypeFlag, xtrTypeFlag, true, applyScaling,
+      compressionThreads);
     break;
 
   case DICOM:
@@ -168,7 +170,7 @@ MDM_API void mdm_ImageIO::writeImage4D(ImageFormat imgFormat,
   const std::vector< mdm_Image3D> & imgs,
   const mdm_ImageDatatypes::DataType dataTypeFlag,
   const mdm_XtrFormat::XTR_type xtrTypeFlag,
-  bool applyScaling)
+  bool applyScaling, int compressionThreads)
 {
   if (xtrTypeFlag != mdm_XtrFormat::XTR_type::BIDS)
     throw mdm_exception(__func__, "XTR format must be BIDS for 4D writing. Check input option use_BIDS is set.");
@@ -180,7 +182,8 @@ MDM_API void mdm_ImageIO::writeImage4D(ImageFormat imgFormat,
     break;
 
   case ImageFormat::NIFTI_GZ:
-    mdm_NiftiFormat::writeImage4D(baseName, imgs, dataTypeFlag, xtrTypeFlag, true, applyScaling);
+    mdm_NiftiFormat::writeImage4D(baseName, imgs, dataTypeFlag, xtrTypeFlag, true, applyScaling,
+      compressionThreads);
     break;
 
   case DICOM:
@@ -79,11 +79,13 @@ public:
   \param    fileName		name of file from which to read the data
   \param		loadXtr			flag, if true tries to load .xtr file too
   \param    applyScaling If the scl slope and intercept fields are set in NIFTI headers, use to recsale the image intensities
+  \param    storageType precision in which voxel values of each image are stored, each volume is converted directly to this type as it is read
   \return   mdm_Image3D object containing image read from disk
   */
   MDM_API static std::vector<mdm_Image3D> readImage4D(ImageFormat imgFormat,
     const std::string& fileName,
-    bool loadXtr, bool applyScaling);
+    bool loadXtr, bool applyScaling,
+    mdm_Image3D::StorageType storageType = mdm_Image3D::STORAGE_DOUBLE);
 
 	
 	//!    Write mdm_Image3D to QBI extended Analyze (hdr/img/xtr) or NIFTI (nii/xtr) file set
@@ -94,13 +96,15 @@ public:
 	\param    dataTypeFlag  integer data type flag; see Data_type enum
 	\param    xtrTypeFlag   integer xtr type flag
   \param    applyScaling  If set in image meta info use scl slope and intercept fields to recsale the image intensities before writing to NIFTI
+  \param    compressionThreads number of threads used to compress NIFTI_GZ images, see mdm_NiftiFormat::writeImage3D
 	*/
 	MDM_API static void writeImage3D(ImageFormat imgFormat,
 		const std::string & baseName,
     const mdm_Image3D &img,
 		const mdm_ImageDatatypes::DataType dataTypeFlag, 
     const mdm_XtrFormat::XTR_type xtrTypeFlag, 
-    bool applyScaling);
+    bool applyScaling,
+    int compressionThreads = 1);
 
   //!    Write vector of mdm_Image3Ds to NIFTI 4D file set
   /*!
@@ -110,13 +114,15 @@ public:
   \param    dataTypeFlag  integer data type flag; see Data_type enum
   \param    xtrTypeFlag   integer xtr type flag, must be BIDS
   \param    applyScaling  If set in image meta info use scl slope and intercept fields to recsale the image intensities before writing to NIFTI
+  \param    compressionThreads number of threads used to compress NIFTI_GZ images, see mdm_NiftiFormat::writeImage3D
   */
   MDM_API static void writeImage4D(ImageFormat imgFormat,
     const std::string& baseName,
     const std::vector< mdm_Image3D> & imgs,
     const mdm_ImageDatatypes::DataType dataTypeFlag,
     const mdm_XtrFormat::XTR_type xtrTypeFlag,
-    bool applyScaling);
+    bool applyScaling,
+    int compressionThreads = 1);
 
   //!    Test for existence of the file with the specified basename and format appropriate extension
   /*!
@@ -9,6 +9,8 @@
 
 #include "mdm_NiftiFormat.h"
 #include "nifti_swaps.h"
+#include "mdm_NiftiMappedImage.h"
+#include "mdm_ParallelGzip.h"
 
 #include <iostream>
 #include <cstdio>
@@ -184,7 +186,7 @@ MDM_API mdm_Image3D mdm_NiftiFormat::readImage3D(const std::string &fileName,
 }
 
 MDM_API std::vector<mdm_Image3D> mdm_NiftiFormat::readImage4D(const std::string& fileName,
-  bool loadXtr, bool applyScaling)
+  bool loadXtr, bool applyScaling, mdm_Image3D::StorageType storageType)
 {
   if (fileName.empty())
     throw mdm_exception(__func__, "Filename image must not be empty");
@@ -196,9 +198,22 @@ MDM_API std::vector<mdm_Image3D> mdm_NiftiFormat::readImage4D(const std::string&
   parseName(fileName,
     baseName, ext, gz);
 
-  nifti_image nii = nifti_image_read(fileName, 1);
-  if (!nii.data)
-    throw mdm_exception(__func__, "Error reading " + fileName);
+  //Uncompressed binary images are memory mapped and each volume converted directly
+  //from the mapping, and compressed binary images are decompressed in the background
+  //while each volume is converted, so only read the header first, and only load the
+  //data for ASCII images
+  nifti_image nii = nifti_image_read(fileName, 0);
+  const bool compressed = nifti_is_gzfile(nifti_findimgname(nii.iname, nii.nifti_type));
+  const bool mapData = !compressed && nii.nifti_type != NIFTI_FTYPE::ASCII;
+  const bool streamData = compressed && nii.nifti_type != NIFTI_FTYPE::ASCII;
+  if (!mapData && !streamData)
+  {
+    if (nifti_image_load(nii) < 0 || !nii.data)
+    {
+      nifti_image_free(nii);
+      throw mdm_exception(__func__, "Error reading " + fileName);
+    }
+  }
 
   // Store the voxel matrix dimensions
   int nX = nii.dim[1];
@@ -265,7 +280,9 @@ MDM_API std::vector<mdm_Image3D> mdm_NiftiFormat::readImage4D(const std::string&
 
   for (auto& img : imgs)
   {
-    //Set dimensions of each image
+    //Set storage type and dimensions of each image, so voxel values are converted
+    //straight into the requested precision as they're read
+    img.setStorageType(storageType);
     img.setDimensions(nX, nY, nZ);
     img.setVoxelDims(xmm, ymm, zmm);
 
@@ -275,6 +292,44 @@ MDM_API std::vector<mdm_Image3D> mdm_NiftiFormat::readImage4D(const std::string&
 
   //Copy the data
   // ------------------------------------------------------------------------
+  if (mapData)
+  {
+    try
+    {
+      mdm_NiftiMappedImage mapped(nii, applyScaling);
+      if (mapped.numVolumes() != imgs.size())
+        throw mdm_exception(__func__, boost::format(
+          "Mapped %1% volumes, expected %2%") % mapped.numVolumes() % imgs.size());
+
+      for (size_t i_t = 0; i_t < imgs.size(); i_t++)
+        mapped.volumeData(i_t, imgs[i_t]);
+    }
+    catch (mdm_exception &e)
+    {
+      nifti_image_free(nii);
+      e.append("Error reading " + fileName);
+      throw;
+    }
+    nifti_image_free(nii);
+    return imgs;
+  }
+
+  if (streamData)
+  {
+    try
+    {
+      readCompressedVolumes(nii, imgs, applyScaling);
+    }
+    catch (mdm_exception &e)
+    {
+      nifti_image_free(nii);
+      e.append("Error reading " + fileName);
+      throw;
+    }
+    nifti_image_free(nii);
+    return imgs;
+  }
+
   switch (nii.datatype)
   {
   case NIFTI_TYPE_UINT8: {
@@ -335,7 +390,7 @@ MDM_API void mdm_NiftiFormat::writeImage3D(const std::string &fileName,
 	const mdm_Image3D &img,
 	const mdm_ImageDatatypes::DataType dataTypeFlag, 
   const mdm_XtrFormat::XTR_type xtrTypeFlag,
-	bool compress, bool applyScaling)
+	bool compress, bool applyScaling, int compressionThreads)
 {
   if (!img)
     throw mdm_exception(__func__, "Image for writing must not be empty");
@@ -446,7 +501,7 @@ MDM_API void mdm_NiftiFormat::writeImage3D(const std::string &fileName,
     saveName += extgz;
 
   nifti_set_filenames(nii, saveName, 0, 0);
-  nifti_image_write(nii);
+  nifti_image_write(nii, compressionThreads);
 
   //Free NIFTI struct
   nifti_image_free(nii);
@@ -467,7 +522,7 @@ MDM_API void mdm_NiftiFormat::writeImage4D(const std::string& fileName,
   const std::vector<mdm_Image3D> imgs,
   const mdm_ImageDatatypes::DataType dataTypeFlag,
   const mdm_XtrFormat::XTR_type xtrTypeFlag,
-  bool compress, bool applyScaling)
+  bool compress, bool applyScaling, int compressionThreads)
 {
   if (imgs.empty())
     throw mdm_exception(__func__, "Images for writing image must not be empty");
@@ -593,7 +648,7 @@ MDM_API void mdm_NiftiFormat::writeImage4D(const std::string& fileName,
     saveName += extgz;
 
   nifti_set_filenames(nii, saveName, 0, 0);
-  nifti_image_write(nii);
+  nifti_image_write(nii, compressionThreads);
 
   //Free NIFTI struct
   nifti_image_free(nii);
@@ -658,9 +713,15 @@ MDM_API bool mdm_NiftiFormat::filesExist(const std::string & fileName,
 
 //
 template <class T> void mdm_NiftiFormat::fromData(const nifti_image &nii, mdm_Image3D &img, bool applyScaling)
+{
+  fromData<T>(nii, nii.data, img, applyScaling);
+}
+
+//
+template <class T> void mdm_NiftiFormat::fromData(const nifti_image &nii, const void *data, mdm_Image3D &img, bool applyScaling)
 {
   auto nVoxels = img.numVoxels();
-  T* nii_data = static_cast<T*>(nii.data);
+  const T* nii_data = static_cast<const T*>(data);
   auto slope = applyScaling && !std::isnan(nii.scl_slope) ? nii.scl_slope : 1.0;
   auto inter = applyScaling && !std::isnan(nii.scl_inter) ? nii.scl_inter : 0.0;
   for (size_t i = 0; i < nVoxels; ++i)
@@ -689,6 +750,49 @@ template <class T> void mdm_NiftiFormat::fromData(const nifti_image& nii, std::v
   
 }
 
+//
+void mdm_NiftiFormat::readCompressedVolumes(const nifti_image& nii, std::vector<mdm_Image3D>& imgs, bool applyScaling)
+{
+  if (nii.iname_offset < 0)
+    throw mdm_exception(__func__, "Negative data offsets not supported for compressed images");
+
+  mdm_ParallelGzip::Reader reader(nifti_findimgname(nii.iname, nii.nifti_type));
+  if (reader.skip(nii.iname_offset) < (size_t)nii.iname_offset)
+    throw mdm_exception(__func__, "Could not seek to data offset");
+
+  //Each volume is read into the same buffer, while the reader decompresses
+  //the next in the background
+  const size_t volumeBytes = imgs[0].numVoxels() * nii.nbyper;
+  std::vector<char> volume(volumeBytes);
+  const bool swap = nii.swapsize > 1 && nii.byteorder != nifti_short_order();
+
+  for (auto& img : imgs)
+  {
+    if (reader.read(volume.data(), volumeBytes) < volumeBytes)
+      throw mdm_exception(__func__, "Short read of image data");
+
+    if (swap)
+      nifti_swap_Nbytes((int64_t)(volumeBytes / nii.swapsize), nii.swapsize, volume.data());
+
+    switch (nii.datatype)
+    {
+    case NIFTI_TYPE_UINT8: fromData<uint8_t>(nii, volume.data(), img, applyScaling); break;
+    case NIFTI_TYPE_UINT16: fromData<uint16_t>(nii, volume.data(), img, applyScaling); break;
+    case NIFTI_TYPE_UINT32: fromData<uint32_t>(nii, volume.data(), img, applyScaling); break;
+    case NIFTI_TYPE_UINT64: fromData<uint64_t>(nii, volume.data(), img, applyScaling); break;
+    case NIFTI_TYPE_INT8: fromData<int8_t>(nii, volume.data(), img, applyScaling); break;
+    case NIFTI_TYPE_INT16: fromData<int16_t>(nii, volume.data(), img, applyScaling); break;
+    case NIFTI_TYPE_INT32: fromData<int32_t>(nii, volume.data(), img, applyScaling); break;
+    case NIFTI_TYPE_INT64: fromData<int64_t>(nii, volume.data(), img, applyScaling); break;
+    case NIFTI_TYPE_FLOAT32: fromData<float>(nii, volume.data(), img, applyScaling); break;
+    case NIFTI_TYPE_FLOAT64: fromData<double>(nii, volume.data(), img, applyScaling); break;
+    default:
+      throw mdm_exception(__func__, boost::format(
+        "Datatype = %1% not recognised") % nii.datatype);
+    }
+  }
+}
+
 //
 template <class T> void mdm_NiftiFormat::toData(const mdm_Image3D &img, nifti_image &nii)
 {
@@ -858,9 +962,9 @@ mdm_NiftiFormat::nifti_image mdm_NiftiFormat::nifti_image_read(const std::string
    \sa nifti_image_write_bricks, nifti_image_free, nifti_set_filenames,
        nifti_image_write_hdr_img
 *//*------------------------------------------------------------------------*/
-void mdm_NiftiFormat::nifti_image_write(nifti_image &nim)
+void mdm_NiftiFormat::nifti_image_write(nifti_image &nim, int compressionThreads)
 {
-  znzFile fp = nifti_image_write_hdr_img(nim, 1, "wb");
+  znzFile fp = nifti_image_write_hdr_img(nim, 1, "wb", compressionThreads);
   if (fp) 
     free(fp);
 }
@@ -891,7 +995,7 @@ void mdm_NiftiFormat::nifti_image_write(nifti_image &nim)
  *     nifti_set_filenames
 *//*---------------------------------------------------------------------*/
 znzFile mdm_NiftiFormat::nifti_image_write_hdr_img(nifti_image &nim, int write_opts,
-  const char * opts)
+  const char * opts, int compressionThreads)
 {
   nifti_1_header n1hdr;
   nifti_2_header n2hdr;
@@ -945,7 +1049,7 @@ znzFile mdm_NiftiFormat::nifti_image_write_hdr_img(nifti_image &nim, int write_o
 
   }
 
-  fp = znzopen(nim.fname.c_str(), opts, nifti_is_gzfile(nim.fname));
+  fp = znzopen_threads(nim.fname.c_str(), opts, nifti_is_gzfile(nim.fname), compressionThreads);
   if (znz_isnull(fp))
     throw mdm_exception(__func__, "cannot open output file" + nim.fname);
 
@@ -973,7 +1077,7 @@ znzFile mdm_NiftiFormat::nifti_image_write_hdr_img(nifti_image &nim, int write_o
   { /* get a new file pointer */
     znzclose(fp);         /* first, close header file */
     
-    fp = znzopen(nim.iname.c_str(), opts, nifti_is_gzfile(nim.iname));
+    fp = znzopen_threads(nim.iname.c_str(), opts, nifti_is_gzfile(nim.iname), compressionThreads);
     if (znz_isnull(fp)) 
       throw mdm_exception(__func__, "cannot open image file");
     
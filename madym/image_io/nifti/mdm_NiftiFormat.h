@@ -16,6 +16,8 @@
 #include "nifti1.h"                  /*** NIFTI-1 header specification ***/
 #include "nifti2.h"                  /*** NIFTI-2 header specification ***/
 
+class mdm_NiftiMappedImage;
+
  //! NIFTI image format reading and writing
 	/*!
 	*/
@@ -38,10 +40,12 @@ public:
   \param    fileName		name of file from which to read the data
   \param		loadXtr			flag, if true tries to load .xtr file too
   \param    applyScaling use the scl slope and intercept fields to recsale the image intensities
+  \param    storageType precision in which voxel values of each image are stored, each volume is converted directly to this type as it is read
   \return   mdm_Image3D object containing image read from disk
   */
   MDM_API static std::vector<mdm_Image3D> readImage4D(const std::string& fileName,
-    bool loadXtr, bool applyScaling = false);
+    bool loadXtr, bool applyScaling = false,
+    mdm_Image3D::StorageType storageType = mdm_Image3D::STORAGE_DOUBLE);
 
 	
 	//!    Write mdm_Image3D to QBI extended Analyze hdr/img/xtr file set
@@ -52,13 +56,17 @@ public:
 	\param    xtrTypeFlag   integer xtr type flag; 0 for old, 1 for new
 	\param		compress			flag, if true, write out compressed image (nii.gz)
   \param    applyScaling use the scl slope and intercept fields to recsale the image intensities
+  \param    compressionThreads number of threads used to compress the image. If 1, the image is
+  compressed as a single stream, otherwise as independent blocks in parallel. If 0, uses all available
+  hardware threads. Ignored if compress is false
 	\return   bool 0 for success or 1 for failure
 	*/
 	MDM_API static void writeImage3D(const std::string & fileName,
 		const mdm_Image3D &img,
 		const mdm_ImageDatatypes::DataType dataTypeFlag, 
     const mdm_XtrFormat::XTR_type xtrTypeFlag,
-		bool compress = false, bool applyScaling = false);
+		bool compress = false, bool applyScaling = false,
+    int compressionThreads = 1);
 
   //!    Write mdm_Image4D to QBI extended Analyze hdr/img/xtr file set
   /*!
@@ -68,13 +76,15 @@ public:
   \param    xtrTypeFlag   integer xtr type flag; 0 for old, 1 for new
   \param		compress			flag, if true, write out compressed image (nii.gz)
   \param    applyScaling use the scl slope and intercept fields to recsale the image intensities
+  \param    compressionThreads number of threads used to compress the image, see writeImage3D
   \return   bool 0 for success or 1 for failure
   */
   MDM_API static void writeImage4D(const std::string& fileName,
     const std::vector<mdm_Image3D> imgs,
     const mdm_ImageDatatypes::DataType dataTypeFlag,
     const mdm_XtrFormat::XTR_type xtrTypeFlag,
-    bool compress = false, bool applyScaling = false);
+    bool compress = false, bool applyScaling = false,
+    int compressionThreads = 1);
 
   //!    Test for existence of the file with the specified basename and all NIFTI extensions (.img, .hdr, .nii etc)
   /*!
@@ -88,6 +98,7 @@ public:
 protected:
 
 private:
+  friend class mdm_NiftiMappedImage;
 
   /********************** Data structures for transforms **************************/
   struct mat44 {                   /** 4x4 matrix struct **/
@@ -321,12 +332,12 @@ private:
   //Main read/write
   static nifti_image nifti_image_read(const std::string &hname, int read_data);
 
-  static void nifti_image_write(nifti_image &nim);
+  static void nifti_image_write(nifti_image &nim, int compressionThreads = 1);
 
   //----------------------------------------------------------------------------
   //Aux read/write
   static znzFile nifti_image_write_hdr_img(nifti_image &nim, int write_opts,
-    const char * opts);
+    const char * opts, int compressionThreads = 1);
 
   static int nifti_image_load(nifti_image &nim);
 
@@ -520,7 +531,11 @@ private:
 
   //Copy to/from nifit_image data to Madym mdm_Image3D
   template <class T> static void fromData(const nifti_image &nii, mdm_Image3D &img, bool applyScaling);
+  template <class T> static void fromData(const nifti_image &nii, const void *data, mdm_Image3D &img, bool applyScaling);
   template <class T> static void fromData(const nifti_image& nii, std::vector<mdm_Image3D>& imgs, bool applyScaling);
+
+  //Stream volumes from a compressed image, converting each volume while the next is decompressed
+  static void readCompressedVolumes(const nifti_image& nii, std::vector<mdm_Image3D>& imgs, bool applyScaling);
   template <class T> static void toData(const mdm_Image3D &img, nifti_image &nii);
   template <class T> static void toData(const std::vector<mdm_Image3D>& imgs, nifti_image& nii);
 
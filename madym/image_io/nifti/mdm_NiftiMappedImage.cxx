@@ -0,0 +1,274 @@
+/**
+ *  @file    mdm_NiftiMappedImage.cxx
+ *  @brief   Implementation of class for memory-mapped reading of NIFTI images
+ *  @author MA Berks (c) Copyright QBI Lab, University of Manchester 2022
+ */
+#ifndef MDM_API_EXPORTS
+#define MDM_API_EXPORTS
+#endif
+
+#include "mdm_NiftiMappedImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <madym/utils/mdm_exception.h>
+
+//
+struct mdm_NiftiMappedImage::Mapping {
+	boost::interprocess::file_mapping file;
+	boost::interprocess::mapped_region region;
+};
+
+//Convert n values of type T, strideBytes apart, to scaled doubles. If SWAP is set,
+//the byte order of each value is reversed before conversion
+template <class T, bool SWAP> static void convertValues(const char *src, size_t n,
+	size_t strideBytes, double slope, double inter, double *dst)
+{
+	for (size_t i = 0; i < n; i++, src += strideBytes)
+	{
+		T t;
+		if (SWAP)
+		{
+			char bytes[sizeof(T)];
+			std::reverse_copy(src, src + sizeof(T), bytes);
+			std::memcpy(&t, bytes, sizeof(T));
+		}
+		else
+			std::memcpy(&t, src, sizeof(T));
+		dst[i] = static_cast<double>(t)*slope + inter;
+	}
+}
+
+//
+MDM_API mdm_NiftiMappedImage::mdm_NiftiMappedImage(const std::string &fileName, bool applyScaling)
+	:
+	data_(NULL),
+	nbyper_(0),
+	numVoxels_(0),
+	numVolumes_(0),
+	slope_(1.0),
+	inter_(0.0),
+	convert_(NULL)
+{
+	if (fileName.empty())
+		throw mdm_exception(__func__, "Filename image must not be empty");
+
+	auto nii = mdm_NiftiFormat::nifti_image_read(fileName, 0);
+	try
+	{
+		mapData(nii, applyScaling);
+	}
+	catch (mdm_exception &e)
+	{
+		mdm_NiftiFormat::nifti_image_free(nii);
+		e.append("Error mapping " + fileName);
+		throw;
+	}
+	mdm_NiftiFormat::nifti_image_free(nii);
+}
+
+//
+mdm_NiftiMappedImage::mdm_NiftiMappedImage(const mdm_NiftiFormat::nifti_image &nii, bool applyScaling)
+	:
+	data_(NULL),
+	nbyper_(0),
+	numVoxels_(0),
+	numVolumes_(0),
+	slope_(1.0),
+	inter_(0.0),
+	convert_(NULL)
+{
+	mapData(nii, applyScaling);
+}
+
+//
+MDM_API mdm_NiftiMappedImage::~mdm_NiftiMappedImage()
+{
+}
+
+//
+MDM_API size_t mdm_NiftiMappedImage::numVolumes() const
+{
+	return numVolumes_;
+}
+
+//
+MDM_API size_t mdm_NiftiMappedImage::numVoxels() const
+{
+	return numVoxels_;
+}
+
+//
+MDM_API const mdm_Image3D& mdm_NiftiMappedImage::volumeTemplate() const
+{
+	return volumeTemplate_;
+}
+
+//
+MDM_API double mdm_NiftiMappedImage::value(size_t volume, size_t voxel) const
+{
+	double v;
+	convert(volume*numVoxels_ + voxel, 1, 1, &v);
+	return v;
+}
+
+//
+MDM_API mdm_NiftiMappedImage::View mdm_NiftiMappedImage::volumeView(size_t volume) const
+{
+	if (volume >= numVolumes_)
+		throw mdm_exception(__func__, boost::format(
+			"Volume %1% out of range, image has %2% volumes") % volume % numVolumes_);
+	return View(*this, volume*numVoxels_, 1, numVoxels_);
+}
+
+//
+MDM_API mdm_NiftiMappedImage::View mdm_NiftiMappedImage::timeSeriesView(size_t voxel) const
+{
+	if (voxel >= numVoxels_)
+		throw mdm_exception(__func__, boost::format(
+			"Voxel %1% out of range, image has %2% voxels") % voxel % numVoxels_);
+	return View(*this, voxel, numVoxels_, numVolumes_);
+}
+
+//
+MDM_API mdm_Image3D mdm_NiftiMappedImage::volume(size_t volume) const
+{
+	mdm_Image3D img(volumeTemplate_);
+	volumeData(volume, img);
+	return img;
+}
+
+//
+MDM_API void mdm_NiftiMappedImage::volumeData(size_t volume, mdm_Image3D &img) const
+{
+	if (img.numVoxels() != numVoxels_)
+		throw mdm_exception(__func__, boost::format(
+			"Image has %1% voxels, mapped volumes have %2%") % img.numVoxels() % numVoxels_);
+
+	//Convert in blocks to a small local buffer, so we don't need to allocate a
+	//temporary copy of the whole volume
+	const auto view = volumeView(volume);
+	const size_t BLOCK_SIZE = 1024;
+	double block[BLOCK_SIZE];
+	for (size_t i_b = 0; i_b < numVoxels_; i_b += BLOCK_SIZE)
+	{
+		const auto n = std::min(BLOCK_SIZE, numVoxels_ - i_b);
+		convert(view.start_ + i_b, 1, n, block);
+		for (size_t i = 0; i < n; i++)
+			img.setVoxel(i_b + i, block[i]);
+	}
+}
+
+//
+MDM_API double mdm_NiftiMappedImage::View::operator[](size_t i) const
+{
+	double v;
+	img_->convert(start_ + i * stride_, 1, 1, &v);
+	return v;
+}
+
+//
+MDM_API void mdm_NiftiMappedImage::View::copyTo(double *data) const
+{
+	img_->convert(start_, stride_, size_, data);
+}
+
+//
+MDM_API void mdm_NiftiMappedImage::View::copyTo(std::vector<double> &data) const
+{
+	data.resize(size_);
+	copyTo(data.data());
+}
+
+//
+mdm_NiftiMappedImage::View::View(const mdm_NiftiMappedImage &img,
+	size_t start, size_t stride, size_t size)
+	:
+	img_(&img),
+	start_(start),
+	stride_(stride),
+	size_(size)
+{}
+
+//-----------------------------------------------------------------------
+// Private
+//-------------------------------------------------------------------------
+void mdm_NiftiMappedImage::mapData(const mdm_NiftiFormat::nifti_image &nii, bool applyScaling)
+{
+	auto imgName = mdm_NiftiFormat::nifti_findimgname(nii.iname, nii.nifti_type);
+	if (imgName.empty() || mdm_NiftiFormat::nifti_is_gzfile(imgName) ||
+		nii.nifti_type == mdm_NiftiFormat::NIFTI_FTYPE::ASCII)
+		throw mdm_exception(__func__, "Only uncompressed binary NIFTI images can be memory mapped");
+
+	if (nii.nx <= 0 || nii.ny <= 0 || nii.nz <= 0)
+		throw mdm_exception(__func__, boost::format(
+			"Dimensions (%1%, %2%, %3%) should be strictly positive")
+			% nii.nx % nii.ny % nii.nz);
+
+	if (nii.pixdim[1] <= 0 || nii.pixdim[2] <= 0 || nii.pixdim[3] <= 0)
+		throw mdm_exception(__func__, boost::format(
+			"Voxel sizes (%1%, %2%, %3%) should be strictly positive")
+			% nii.pixdim[1] % nii.pixdim[2] % nii.pixdim[3]);
+
+	numVoxels_ = nii.nx * nii.ny * nii.nz;
+	numVolumes_ = nii.nt > 1 ? nii.nt : 1;
+	nbyper_ = nii.nbyper;
+	slope_ = applyScaling && !std::isnan(nii.scl_slope) ? nii.scl_slope : 1.0;
+	inter_ = applyScaling && !std::isnan(nii.scl_inter) ? nii.scl_inter : 0.0;
+
+	//Select the conversion function for the datatype and byte order
+	const bool swap = nii.swapsize > 1 && nii.byteorder != mdm_NiftiFormat::nifti_short_order();
+#define MDM_CONVERT_FUNCTION(T) swap ? &convertValues<T, true> : &convertValues<T, false>
+	switch (nii.datatype)
+	{
+	case NIFTI_TYPE_UINT8: convert_ = MDM_CONVERT_FUNCTION(uint8_t); break;
+	case NIFTI_TYPE_UINT16: convert_ = MDM_CONVERT_FUNCTION(uint16_t); break;
+	case NIFTI_TYPE_UINT32: convert_ = MDM_CONVERT_FUNCTION(uint32_t); break;
+	case NIFTI_TYPE_UINT64: convert_ = MDM_CONVERT_FUNCTION(uint64_t); break;
+	case NIFTI_TYPE_INT8: convert_ = MDM_CONVERT_FUNCTION(int8_t); break;
+	case NIFTI_TYPE_INT16: convert_ = MDM_CONVERT_FUNCTION(int16_t); break;
+	case NIFTI_TYPE_INT32: convert_ = MDM_CONVERT_FUNCTION(int32_t); break;
+	case NIFTI_TYPE_INT64: convert_ = MDM_CONVERT_FUNCTION(int64_t); break;
+	case NIFTI_TYPE_FLOAT32: convert_ = MDM_CONVERT_FUNCTION(float); break;
+	case NIFTI_TYPE_FLOAT64: convert_ = MDM_CONVERT_FUNCTION(double); break;
+	default:
+		throw mdm_exception(__func__, boost::format(
+			"Datatype = %1% not recognised") % nii.datatype);
+	}
+#undef MDM_CONVERT_FUNCTION
+
+	//Map the image data
+	const size_t dataSize = numVoxels_ * numVolumes_ * nbyper_;
+	const size_t offset = nii.iname_offset > 0 ? (size_t)nii.iname_offset : 0;
+	try
+	{
+		mapping_.reset(new Mapping);
+		mapping_->file = boost::interprocess::file_mapping(
+			imgName.c_str(), boost::interprocess::read_only);
+		mapping_->region = boost::interprocess::mapped_region(
+			mapping_->file, boost::interprocess::read_only, offset, dataSize);
+	}
+	catch (boost::interprocess::interprocess_exception &e)
+	{
+		throw mdm_exception(__func__, boost::format(
+			"Failed to map %1% bytes at offset %2% of %3%: %4%")
+			% dataSize % offset % imgName % e.what());
+	}
+	data_ = static_cast<const char*>(mapping_->region.get_address());
+
+	//Set up the template for each volume
+	volumeTemplate_.setDimensions(nii.nx, nii.ny, nii.nz);
+	volumeTemplate_.setVoxelDims(nii.pixdim[1], nii.pixdim[2], nii.pixdim[3]);
+	mdm_NiftiFormat::nifti_nii_transform_to_img(nii, volumeTemplate_);
+}
+
+//
+void mdm_NiftiMappedImage::convert(size_t start, size_t stride, size_t n, double *data) const
+{
+	convert_(data_ + start * nbyper_, n, stride * nbyper_, slope_, inter_, data);
+}
@@ -0,0 +1,172 @@
+/*!
+ *  @file    mdm_NiftiMappedImage.h
+ *  @brief   Memory-mapped read access to uncompressed NIFTI images
+ *  @details More info...
+ *  @author MA Berks (c) Copyright QBI Lab, University of Manchester 2022
+ */
+
+#ifndef MDM_NIFTIMAPPEDIMAGE_H
+#define MDM_NIFTIMAPPEDIMAGE_H
+
+#include <madym/utils/mdm_api.h>
+#include <madym/utils/mdm_Image3D.h>
+#include <madym/image_io/nifti/mdm_NiftiFormat.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+//! Memory-mapped read access to uncompressed NIFTI images
+/*!
+Rather than loading the whole of a (possibly 4D) image into memory and converting every volume
+to an mdm_Image3D of doubles, the image data file is memory mapped. Volumes, and time-series at
+individual voxels, can then be read directly from the mapping, with type conversion, byte
+swapping and intensity scaling applied to each value as it is accessed. Only the pages of the
+file that are accessed are read from disk, and these can be released by the OS as required.
+
+Only uncompressed images (.nii, or .hdr/.img pairs) can be mapped.
+*/
+class mdm_NiftiMappedImage {
+
+public:
+
+	//! View of values in a mapped image
+	/*!
+	Lightweight, copyable view of either a volume, or the time-series at a voxel. Values are
+	converted to double as they are accessed. Views are only valid while the image they were
+	created from exists.
+	*/
+	class View {
+
+	public:
+		//! Number of values in the view
+		/*!
+		\return number of values
+		*/
+		size_t size() const { return size_; }
+
+		//! Return value at given index
+		/*!
+		\param i index of value, must be < size()
+		\return value, converted to double and scaled
+		*/
+		MDM_API double operator[](size_t i) const;
+
+		//! Convert all values in the view
+		/*!
+		\param data array of length at least size() into which values are written
+		*/
+		MDM_API void copyTo(double *data) const;
+
+		//! Convert all values in the view
+		/*!
+		\param data vector, resized to size(), into which values are written
+		*/
+		MDM_API void copyTo(std::vector<double> &data) const;
+
+	private:
+		friend class mdm_NiftiMappedImage;
+		View(const mdm_NiftiMappedImage &img, size_t start, size_t stride, size_t size);
+
+		const mdm_NiftiMappedImage *img_;
+		size_t start_;
+		size_t stride_;
+		size_t size_;
+	};
+
+	//! Map an image
+	/*!
+	\param fileName name of the NIFTI image file
+	\param applyScaling use the scl slope and intercept fields to rescale the image intensities
+	*/
+	MDM_API mdm_NiftiMappedImage(const std::string &fileName, bool applyScaling = false);
+
+	//! Default destructor, unmaps the image
+	MDM_API ~mdm_NiftiMappedImage();
+
+	//! Return the number of volumes (time-points) in the image
+	/*!
+	\return number of volumes, 1 for a 3D image
+	*/
+	MDM_API size_t numVolumes() const;
+
+	//! Return the number of voxels in each volume
+	/*!
+	\return number of voxels
+	*/
+	MDM_API size_t numVoxels() const;
+
+	//! Return an image with the dimensions, voxel sizes and axes of each volume
+	/*!
+	\return image template. Its voxel values are not set
+	*/
+	MDM_API const mdm_Image3D& volumeTemplate() const;
+
+	//! Return a single value
+	/*!
+	\param volume index of volume, must be < numVolumes()
+	\param voxel index of voxel, must be < numVoxels()
+	\return value, converted to double and scaled
+	*/
+	MDM_API double value(size_t volume, size_t voxel) const;
+
+	//! Return a view of a volume
+	/*!
+	\param volume index of volume, must be < numVolumes()
+	\return view of numVoxels() values
+	*/
+	MDM_API View volumeView(size_t volume) const;
+
+	//! Return a view of the time-series at a voxel
+	/*!
+	\param voxel index of voxel, must be < numVoxels()
+	\return view of numVolumes() values
+	*/
+	MDM_API View timeSeriesView(size_t voxel) const;
+
+	//! Convert a volume to an mdm_Image3D
+	/*!
+	\param volume index of volume, must be < numVolumes()
+	\return image, with dimensions, voxel sizes and axes set from the NIFTI header
+	*/
+	MDM_API mdm_Image3D volume(size_t volume) const;
+
+	//! Convert the data in a volume into an existing mdm_Image3D
+	/*!
+	\param volume index of volume, must be < numVolumes()
+	\param img image to which values are written, must have numVoxels() voxels. Only the voxel
+	values are set
+	*/
+	MDM_API void volumeData(size_t volume, mdm_Image3D &img) const;
+
+private:
+	friend class mdm_NiftiFormat;
+
+	//Map the image data described by a NIFTI header
+	mdm_NiftiMappedImage(const mdm_NiftiFormat::nifti_image &nii, bool applyScaling);
+
+	void mapData(const mdm_NiftiFormat::nifti_image &nii, bool applyScaling);
+
+	//Convert n values, stride elements apart, starting at element start
+	void convert(size_t start, size_t stride, size_t n, double *data) const;
+
+	//Function that converts n values of the image datatype, strideBytes apart, to doubles,
+	//applying scaling
+	typedef void(*ConvertFunction)(const char *src, size_t n, size_t strideBytes,
+		double slope, double inter, double *dst);
+
+	//Mapped file and region, hidden so platform specific headers aren't exposed
+	struct Mapping;
+	std::unique_ptr<Mapping> mapping_;
+
+	const char *data_;
+	size_t nbyper_;
+	size_t numVoxels_;
+	size_t numVolumes_;
+	double slope_;
+	double inter_;
+	ConvertFunction convert_;
+	mdm_Image3D volumeTemplate_;
+};
+
+#endif /* MDM_NIFTIMAPPEDIMAGE_H */
@@ -0,0 +1,373 @@
+/**
+ *  @file    mdm_ParallelGzip.cxx
+ *  @brief   Implementation of multi-threaded block gzip writer and pipelined gzip reader
+ *  @author MA Berks (c) Copyright QBI Lab, University of Manchester 2022
+ */
+#ifndef MDM_API_EXPORTS
+#define MDM_API_EXPORTS
+#endif
+
+#include "mdm_ParallelGzip.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <madym/utils/mdm_ThreadPool.h>
+#include <madym/utils/mdm_exception.h>
+
+const size_t mdm_ParallelGzip::DEFAULT_BLOCK_SIZE;
+
+#ifdef HAVE_ZLIB
+namespace {
+	//Write a 32-bit value in little-endian order, as required by the gzip trailer
+	void putLE32(unsigned char *buf, unsigned long v)
+	{
+		for (int i = 0; i < 4; i++)
+			buf[i] = (unsigned char)((v >> (8 * i)) & 0xff);
+	}
+}
+#endif
+
+//
+MDM_API mdm_ParallelGzip::Writer::Writer(const std::string &fileName, int nThreads, int level,
+	size_t blockSize)
+	:
+	file_(NULL),
+	nThreads_(mdm_ThreadPool::numThreads(nThreads, size_t(-1))),
+	level_(level),
+	blockSize_(std::max(blockSize, size_t(1))),
+	crc_(0),
+	totalIn_(0)
+{
+#ifdef HAVE_ZLIB
+	if (level < Z_DEFAULT_COMPRESSION || level > Z_BEST_COMPRESSION)
+		throw mdm_exception(__func__, boost::format(
+			"Compression level %1% not valid, must be -1 or 0 to 9") % level);
+
+	file_ = fopen(fileName.c_str(), "wb");
+	if (!file_)
+		throw mdm_exception(__func__, "Unable to open " + fileName + " for writing");
+
+	//Minimal gzip header: magic, deflate, no flags, no mtime, no extra flags, unknown OS
+	const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+	if (fwrite(header, 1, sizeof(header), file_) != sizeof(header))
+	{
+		fclose(file_);
+		file_ = NULL;
+		throw mdm_exception(__func__, "Error writing gzip header to " + fileName);
+	}
+	crc_ = crc32(0L, Z_NULL, 0);
+	pending_.reserve(blockSize_);
+#else
+	throw mdm_exception(__func__,
+		"Can't write " + fileName + ", this version of Madym has been built without zlib support");
+#endif
+}
+
+//
+MDM_API mdm_ParallelGzip::Writer::~Writer()
+{
+	try
+	{
+		close();
+	}
+	catch (...)
+	{
+	}
+}
+
+//
+MDM_API void mdm_ParallelGzip::Writer::write(const void *data, size_t n)
+{
+	if (!file_)
+		throw mdm_exception(__func__, "File is not open");
+
+	const char *src = static_cast<const char*>(data);
+	totalIn_ += n;
+
+	//Top up any partially filled block first
+	if (!pending_.empty())
+	{
+		const auto nTake = std::min(n, blockSize_ - pending_.size());
+		pending_.insert(pending_.end(), src, src + nTake);
+		src += nTake;
+		n -= nTake;
+		if (pending_.size() < blockSize_)
+			return;
+	}
+
+	//Compress full blocks, in batches of up to 4 blocks per thread, directly from
+	//the input. A full pending block is compressed in the first batch, after
+	//which the pending buffer is free
+	const size_t batchSize = 4 * nThreads_;
+	std::vector<const char*> blocks;
+	std::vector<size_t> blockSizes;
+	blocks.reserve(batchSize);
+	blockSizes.reserve(batchSize);
+	if (pending_.size() == blockSize_)
+	{
+		blocks.push_back(pending_.data());
+		blockSizes.push_back(blockSize_);
+	}
+	while (n >= blockSize_)
+	{
+		blocks.push_back(src);
+		blockSizes.push_back(blockSize_);
+		src += blockSize_;
+		n -= blockSize_;
+		if (blocks.size() == batchSize)
+		{
+			writeBlocks(blocks, blockSizes, false);
+			blocks.clear();
+			blockSizes.clear();
+		}
+	}
+	if (!blocks.empty())
+		writeBlocks(blocks, blockSizes, false);
+
+	//Buffer whatever is left
+	pending_.assign(src, src + n);
+}
+
+//
+MDM_API size_t mdm_ParallelGzip::Writer::tell() const
+{
+	return totalIn_;
+}
+
+//
+MDM_API void mdm_ParallelGzip::Writer::close()
+{
+	if (!file_)
+		return;
+
+#ifdef HAVE_ZLIB
+	//Always write a final block, even if empty, to terminate the deflate stream
+	writeBlocks({ pending_.data() }, { pending_.size() }, true);
+	pending_.clear();
+
+	unsigned char trailer[8];
+	putLE32(trailer, crc_);
+	putLE32(trailer + 4, (unsigned long)(totalIn_ & 0xffffffffUL));
+	const bool ok = fwrite(trailer, 1, sizeof(trailer), file_) == sizeof(trailer);
+	const bool closed = fclose(file_) == 0;
+	file_ = NULL;
+	if (!ok || !closed)
+		throw mdm_exception(__func__, "Error writing gzip trailer");
+#endif
+}
+
+//
+void mdm_ParallelGzip::Writer::writeBlocks(const std::vector<const char*> &blocks,
+	const std::vector<size_t> &blockSizes, bool finish)
+{
+#ifdef HAVE_ZLIB
+	const auto nBlocks = blocks.size();
+	if (compressed_.size() < nBlocks)
+	{
+		compressed_.resize(nBlocks);
+		crcs_.resize(nBlocks);
+	}
+
+	mdm_ThreadPool::WorkQueue queue(nBlocks);
+	auto worker = [&](size_t) {
+		z_stream strm;
+		std::memset(&strm, 0, sizeof(strm));
+
+		//Raw deflate (negative window bits), the gzip wrapper is written by us
+		if (deflateInit2(&strm, level_, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+			throw mdm_exception(__func__, "Failed to initialise deflate");
+
+		size_t begin, end;
+		while (queue.next(begin, end))
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const bool last = finish && i == nBlocks - 1;
+				auto &out = compressed_[i];
+
+				//Sync flush appends an empty stored block, allow for it in the bound
+				out.resize(deflateBound(&strm, (uLong)blockSizes[i]) + 16);
+				strm.next_in = (Bytef*)blocks[i];
+				strm.avail_in = (uInt)blockSizes[i];
+				strm.next_out = (Bytef*)out.data();
+				strm.avail_out = (uInt)out.size();
+
+				const auto ret = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+				if (ret == Z_STREAM_ERROR || strm.avail_in || (last && ret != Z_STREAM_END))
+				{
+					deflateEnd(&strm);
+					throw mdm_exception(__func__, "Failed to deflate block");
+				}
+				out.resize(out.size() - strm.avail_out);
+				crcs_[i] = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)blocks[i], (uInt)blockSizes[i]);
+				deflateReset(&strm);
+			}
+		}
+		deflateEnd(&strm);
+	};
+	mdm_ThreadPool::run(std::min(nThreads_, nBlocks), worker, &queue);
+
+	//Write the compressed blocks in order, combining their CRCs
+	for (size_t i = 0; i < nBlocks; i++)
+	{
+		const auto &out = compressed_[i];
+		if (fwrite(out.data(), 1, out.size(), file_) != out.size())
+			throw mdm_exception(__func__, "Error writing compressed data");
+		crc_ = crc32_combine(crc_, crcs_[i], (z_off_t)blockSizes[i]);
+	}
+#endif
+}
+
+//
+MDM_API mdm_ParallelGzip::Reader::Reader(const std::string &fileName, size_t blockSize,
+	size_t numBlocks)
+	:
+	file_(NULL),
+	blocks_(std::max(numBlocks, size_t(2)), std::vector<char>(std::max(blockSize, size_t(1)))),
+	blockSizes_(blocks_.size(), 0),
+	numFull_(0),
+	readBlock_(0),
+	readPos_(0),
+	haveBlock_(false),
+	eof_(false),
+	stop_(false),
+	error_(nullptr)
+{
+#ifdef HAVE_ZLIB
+	auto gz = gzopen(fileName.c_str(), "rb");
+	if (!gz)
+		throw mdm_exception(__func__, "Unable to open " + fileName + " for reading");
+	gzbuffer(gz, (unsigned)std::max(blockSize, size_t(8192)));
+	file_ = gz;
+
+	thread_ = std::thread(&Reader::decompress, this);
+#else
+	throw mdm_exception(__func__,
+		"Can't read " + fileName + ", this version of Madym has been built without zlib support");
+#endif
+}
+
+//
+MDM_API mdm_ParallelGzip::Reader::~Reader()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	cv_.notify_all();
+	if (thread_.joinable())
+		thread_.join();
+
+#ifdef HAVE_ZLIB
+	if (file_)
+		gzclose(static_cast<gzFile>(file_));
+#endif
+}
+
+//
+MDM_API size_t mdm_ParallelGzip::Reader::read(void *data, size_t n)
+{
+	char *dst = static_cast<char*>(data);
+	size_t nRead = 0;
+	while (nRead < n)
+	{
+		if (!haveBlock_ || readPos_ == blockSizes_[readBlock_])
+		{
+			if (!nextBlock())
+				break;
+		}
+		const auto nTake = std::min(n - nRead, blockSizes_[readBlock_] - readPos_);
+		if (dst)
+			std::memcpy(dst + nRead, blocks_[readBlock_].data() + readPos_, nTake);
+		readPos_ += nTake;
+		nRead += nTake;
+	}
+	return nRead;
+}
+
+//
+MDM_API size_t mdm_ParallelGzip::Reader::skip(size_t n)
+{
+	return read(NULL, n);
+}
+
+//
+void mdm_ParallelGzip::Reader::decompress()
+{
+#ifdef HAVE_ZLIB
+	auto gz = static_cast<gzFile>(file_);
+	const auto numBlocks = blocks_.size();
+	while (true)
+	{
+		//Wait for a free block
+		size_t idx;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [&] { return stop_ || numFull_ < numBlocks; });
+			if (stop_)
+				return;
+			idx = (readBlock_ + numFull_) % numBlocks;
+		}
+
+		//Decompress outside the lock, the consumer never touches free blocks
+		auto &block = blocks_[idx];
+		const int n = gzread(gz, block.data(), (unsigned)block.size());
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (n < 0)
+			{
+				int errnum;
+				error_ = std::make_exception_ptr(mdm_exception(__func__,
+					std::string("Error decompressing: ") + gzerror(gz, &errnum)));
+				eof_ = true;
+			}
+			else
+			{
+				if (n > 0)
+				{
+					blockSizes_[idx] = size_t(n);
+					numFull_++;
+				}
+				//gzread only returns a short block at the end of the file
+				if (size_t(n) < block.size())
+					eof_ = true;
+			}
+		}
+		cv_.notify_all();
+		if (eof_)
+			return;
+	}
+#endif
+}
+
+//
+bool mdm_ParallelGzip::Reader::nextBlock()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	//Release the block we've finished with
+	if (haveBlock_)
+	{
+		numFull_--;
+		readBlock_ = (readBlock_ + 1) % blocks_.size();
+		haveBlock_ = false;
+		cv_.notify_all();
+	}
+
+	cv_.wait(lock, [&] { return numFull_ > 0 || eof_; });
+	if (numFull_ > 0)
+	{
+		haveBlock_ = true;
+		readPos_ = 0;
+		return true;
+	}
+	if (error_)
+		std::rethrow_exception(error_);
+	return false;
+}
@@ -0,0 +1,155 @@
+/*!
+ *  @file    mdm_ParallelGzip.h
+ *  @brief   Multi-threaded block gzip writer and pipelined gzip reader
+ *  @details More info...
+ *  @author MA Berks (c) Copyright QBI Lab, University of Manchester 2022
+ */
+
+#ifndef MDM_PARALLELGZIP_H
+#define MDM_PARALLELGZIP_H
+
+#include <madym/utils/mdm_api.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//! Multi-threaded block gzip writer and pipelined gzip reader
+/*!
+Both classes require Madym to be built with zlib, otherwise their constructors throw.
+*/
+class mdm_ParallelGzip {
+
+public:
+
+	//! Default size in bytes of the uncompressed blocks compressed and read
+	static const size_t DEFAULT_BLOCK_SIZE = 128 * 1024;
+
+	//! Multi-threaded gzip writer
+	/*!
+	Data are split into fixed size blocks which are deflated independently, in parallel,
+	then concatenated into a single gzip stream (as in pigz). Each block except the last is
+	terminated with a sync flush, so ends on a byte boundary. The CRCs of the blocks are
+	combined for the gzip trailer. The file produced is a standard, single member, gzip
+	file that can be read by any gzip reader.
+
+	As blocks don't share a dictionary, compression is very slightly worse than for a
+	single stream.
+	*/
+	class Writer {
+
+	public:
+		//! Open a file for writing
+		/*!
+		\param fileName name of file to write
+		\param nThreads number of compression threads. If 0, uses all available hardware threads
+		\param level zlib compression level, 0-9 or -1 for zlib's default
+		\param blockSize size of uncompressed blocks
+		*/
+		MDM_API Writer(const std::string &fileName, int nThreads = 0, int level = -1,
+			size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+		//! Destructor, closes the file if still open
+		MDM_API ~Writer();
+
+		//! Compress and write data
+		/*!
+		Data may be buffered until a block is full or the file is closed.
+		\param data bytes to write
+		\param n number of bytes
+		*/
+		MDM_API void write(const void *data, size_t n);
+
+		//! Return the number of uncompressed bytes written
+		/*!
+		\return number of bytes passed to write
+		*/
+		MDM_API size_t tell() const;
+
+		//! Compress any buffered data, write the gzip trailer and close the file
+		MDM_API void close();
+
+	private:
+		//Compress blocks in parallel and write them in order. The last block is marked
+		//final if finish is set
+		void writeBlocks(const std::vector<const char*> &blocks,
+			const std::vector<size_t> &blockSizes, bool finish);
+
+		FILE *file_;
+		size_t nThreads_;
+		int level_;
+		size_t blockSize_;
+
+		std::vector<char> pending_;
+		std::vector<std::vector<char> > compressed_;
+		std::vector<unsigned long> crcs_;
+		unsigned long crc_;
+		size_t totalIn_;
+	};
+
+	//! Pipelined gzip reader
+	/*!
+	A background thread decompresses the file into a ring of blocks while the caller
+	consumes previously decompressed blocks, so decompression overlaps whatever processing
+	the caller does with the data (eg type conversion).
+	*/
+	class Reader {
+
+	public:
+		//! Open a file for reading, and start decompressing
+		/*!
+		\param fileName name of gzip file
+		\param blockSize size of decompressed blocks
+		\param numBlocks number of blocks the background thread may decompress ahead
+		*/
+		MDM_API Reader(const std::string &fileName, size_t blockSize = DEFAULT_BLOCK_SIZE,
+			size_t numBlocks = 4);
+
+		//! Destructor, stops the background thread and closes the file
+		MDM_API ~Reader();
+
+		//! Read decompressed data
+		/*!
+		\param data buffer of at least n bytes
+		\param n number of bytes to read
+		\return number of bytes read, less than n only at the end of the file
+		*/
+		MDM_API size_t read(void *data, size_t n);
+
+		//! Skip decompressed data
+		/*!
+		\param n number of bytes to skip
+		\return number of bytes skipped, less than n only at the end of the file
+		*/
+		MDM_API size_t skip(size_t n);
+
+	private:
+		//Background thread decompressing blocks
+		void decompress();
+
+		//Wait for the next decompressed block, return false at end of file
+		bool nextBlock();
+
+		void *file_;
+		std::thread thread_;
+		std::mutex mutex_;
+		std::condition_variable cv_;
+
+		std::vector<std::vector<char> > blocks_;
+		std::vector<size_t> blockSizes_;
+		size_t numFull_;
+		size_t readBlock_;
+		size_t readPos_;
+		bool haveBlock_;
+		bool eof_;
+		bool stop_;
+		std::exception_ptr error_;
+	};
+
+};
+
+#endif /* MDM_PARALLELGZIP_H */
@@ -22,6 +22,8 @@ NB: seeks for writable files with compression are quite restricted
  */
 
 #include "./znzlib.h"
+#include "mdm_ParallelGzip.h"
+#include <madym/utils/mdm_ProgramLogger.h>
 
 /*
 znzlib.c  (zipped or non-zipped library)
@@ -81,6 +83,35 @@ znzFile znzopen(const char *path, const char *mode, int use_compression)
 }
 
 
+znzFile znzopen_threads(const char *path, const char *mode, int use_compression,
+  int n_threads)
+{
+#ifdef HAVE_ZLIB
+  if (use_compression && n_threads != 1 && strchr(mode, 'w')) {
+    znzFile file;
+    file = (znzFile) calloc(1,sizeof(struct znzptr));
+    if( file == NULL ){
+       fprintf(stderr,"** ERROR: znzopen_threads failed to alloc znzptr\n");
+       return NULL;
+    }
+
+    file->withz = 1;
+    try {
+      file->pzfptr = new mdm_ParallelGzip::Writer(path, n_threads);
+      return file;
+    }
+    catch (const std::exception &e) {
+      /* report why, then fall back to writing a single gzip stream */
+      mdm_ProgramLogger::logProgramWarning(__func__,
+        std::string("parallel gzip writer failed, using single stream: ") + e.what());
+      free(file);
+    }
+  }
+#endif
+  return znzopen(path, mode, use_compression);
+}
+
+
 znzFile znzdopen(int fd, const char *mode, int use_compression)
 {
   znzFile file;
@@ -114,6 +145,12 @@ int Xznzclose(znzFile * file)
   if (*file!=NULL) {
 #ifdef HAVE_ZLIB
     if ((*file)->zfptr!=NULL)  { retval = gzclose((*file)->zfptr); }
+    if ((*file)->pzfptr!=NULL) {
+      mdm_ParallelGzip::Writer *pz = (mdm_ParallelGzip::Writer *)(*file)->pzfptr;
+      try { pz->close(); }
+      catch (...) { retval = -1; }
+      delete pz;
+    }
 #endif
     if ((*file)->nzfptr!=NULL) { retval = fclose((*file)->nzfptr); }
 
@@ -171,6 +208,11 @@ size_t znzwrite(const void* buf, size_t size, size_t nmemb, znzFile file)
 
   if (file==NULL) { return 0; }
 #ifdef HAVE_ZLIB
+  if (file->pzfptr!=NULL) {
+    try { ((mdm_ParallelGzip::Writer *)file->pzfptr)->write(buf, remain); }
+    catch (...) { return 0; }
+    return nmemb;
+  }
   if (file->zfptr!=NULL) {
     while( remain > 0 ) {
        n2write = (remain < ZNZ_MAX_BLOCK_SIZE) ? remain : ZNZ_MAX_BLOCK_SIZE;
@@ -200,6 +242,20 @@ long znzseek(znzFile file, long offset, int whence)
 {
   if (file==NULL) { return 0; }
 #ifdef HAVE_ZLIB
+  if (file->pzfptr!=NULL) {
+    /* like gzseek on a file open for writing, only forward seeks are
+       supported, filling with zeros */
+    mdm_ParallelGzip::Writer *pz = (mdm_ParallelGzip::Writer *)file->pzfptr;
+    long pos = (long)pz->tell();
+    if (whence == SEEK_SET) offset -= pos;
+    else if (whence != SEEK_CUR) return -1;
+    if (offset < 0) return -1;
+    if (offset > 0) {
+      try { pz->write(std::vector<char>((size_t)offset, 0).data(), (size_t)offset); }
+      catch (...) { return -1; }
+    }
+    return pos + offset;
+  }
   if (file->zfptr!=NULL) return (long) gzseek(file->zfptr,offset,whence);
 #endif
   return fseek(file->nzfptr,offset,whence);
@@ -225,6 +281,7 @@ long znztell(znzFile file)
 {
   if (file==NULL) { return 0; }
 #ifdef HAVE_ZLIB
+  if (file->pzfptr!=NULL) return (long) ((mdm_ParallelGzip::Writer *)file->pzfptr)->tell();
   if (file->zfptr!=NULL) return (long) gztell(file->zfptr);
 #endif
   return ftell(file->nzfptr);
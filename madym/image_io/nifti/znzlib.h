@@ -68,6 +68,7 @@ struct znzptr {
   FILE* nzfptr;
 #ifdef HAVE_ZLIB
   gzFile zfptr;
+  void* pzfptr; /* multi-threaded block gzip writer, see znzopen_threads */
 #endif
 } ;
 
@@ -89,6 +90,15 @@ znzFile znzopen(const char *path, const char *mode, int use_compression);
 
 znzFile znzdopen(int fd, const char *mode, int use_compression);
 
+/* As znzopen, but compressed files opened for writing are compressed in
+   independent blocks using n_threads threads (0 for all available). Only
+   forward seeks are supported on these files. If n_threads is 1, or the
+   block writer can't be created (reported as a program log warning), this
+   is the same as znzopen
+*/
+znzFile znzopen_threads(const char *path, const char *mode, int use_compression,
+  int n_threads);
+
 int Xznzclose(znzFile * file);
 
 size_t znzread(void* buf, size_t size, size_t nmemb, znzFile file);
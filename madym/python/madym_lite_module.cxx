@@ -0,0 +1,313 @@
+/**
+* @file madym_lite_module.cxx
+* Python extension module running the lite analysis tools in-process.
+*
+* Input data are read directly from any object supporting the buffer protocol
+* (eg numpy float64 arrays) without copying, and fitted in parallel with the
+* GIL released, so no temporary files or sub-processes are needed.
+*
+* @author   MA Berks
+* @brief    In-process python bindings for madym_DCE_lite, madym_T1_lite and madym_DWI_lite
+*/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <madym/run/mdm_RunTools_madym_DCE_lite.h>
+#include <madym/run/mdm_RunTools_madym_T1_lite.h>
+#include <madym/run/mdm_RunTools_madym_DWI_lite.h>
+#include <madym/run/mdm_LiteDataIO.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+	//! Holds a buffer view of a python object, released on destruction
+	class BufferView {
+	public:
+		BufferView()
+			: set_(false)
+		{}
+
+		~BufferView()
+		{
+			if (set_)
+				PyBuffer_Release(&view_);
+		}
+
+		//! Get a C-contiguous float64 view of obj, setting a python error and returning false if not possible
+		bool get(PyObject *obj, const char *name)
+		{
+			if (PyObject_GetBuffer(obj, &view_, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+			{
+				PyErr_Format(PyExc_TypeError,
+					"%s must support the buffer protocol and be C-contiguous", name);
+				return false;
+			}
+			set_ = true;
+
+			//Accept native byte order doubles only
+			const char *fmt = view_.format ? view_.format : "B";
+			if (*fmt == '@' || *fmt == '=' || *fmt == (isLittleEndian() ? '<' : '>'))
+				fmt++;
+			if (std::strcmp(fmt, "d") || view_.itemsize != sizeof(double))
+			{
+				PyErr_Format(PyExc_TypeError, "%s must be float64 in native byte order", name);
+				return false;
+			}
+			if (view_.ndim > 2)
+			{
+				PyErr_Format(PyExc_ValueError, "%s must be 1D or 2D", name);
+				return false;
+			}
+			return true;
+		}
+
+		//! Pointer to the data
+		const double *data() const
+		{
+			return static_cast<const double*>(view_.buf);
+		}
+
+		//! Number of values
+		size_t size() const
+		{
+			return size_t(view_.len) / sizeof(double);
+		}
+
+		//! Number of rows, a 1D buffer is treated as a single row
+		size_t numRows() const
+		{
+			return view_.ndim == 2 ? size_t(view_.shape[0]) : (size() ? 1 : 0);
+		}
+
+		//! Number of columns
+		size_t numColumns() const
+		{
+			return view_.ndim == 2 ? size_t(view_.shape[1]) : size();
+		}
+
+	private:
+		static bool isLittleEndian()
+		{
+			const uint16_t one = 1;
+			return *reinterpret_cast<const char*>(&one) != 0;
+		}
+
+		Py_buffer view_;
+		bool set_;
+	};
+
+	//Convert a python sequence of strings into an argument list, prefixed by the tool name
+	bool parseArgs(PyObject *argsObj, const std::string &toolName, std::vector<std::string> &args)
+	{
+		PyObject *seq = PySequence_Fast(argsObj, "args must be a sequence of strings");
+		if (!seq)
+			return false;
+
+		args.assign(1, toolName);
+		const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+		for (Py_ssize_t i = 0; i < n; i++)
+		{
+			PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+			const char *arg = PyUnicode_Check(item) ? PyUnicode_AsUTF8(item) : NULL;
+			if (!arg)
+			{
+				Py_DECREF(seq);
+				PyErr_SetString(PyExc_TypeError, "args must be a sequence of strings");
+				return false;
+			}
+			args.push_back(arg);
+		}
+		Py_DECREF(seq);
+		return true;
+	}
+
+	//Parse options and run a lite tool on in-memory arrays, with the GIL released. Returns
+	//a tuple (outputs, numColumns), where outputs is a bytes object of float64 values stored
+	//row by row, or NULL with a python error set
+	template <class T>
+	PyObject *runTool(PyObject *argsObj, mdm_LiteDataIO::Arrays &arrays)
+	{
+		T tool;
+		std::vector<std::string> args;
+		if (!parseArgs(argsObj, tool.who(), args))
+			return NULL;
+
+		std::vector<const char*> argv;
+		for (const auto &arg : args)
+			argv.push_back(arg.c_str());
+
+		int parseError = 0;
+		std::string error;
+		Py_BEGIN_ALLOW_THREADS
+		try
+		{
+			parseError = tool.parseInputs(int(argv.size()), argv.data());
+			if (parseError == mdm_OptionsParser::OK)
+				tool.runArrays(arrays);
+		}
+		catch (std::exception &e)
+		{
+			error = e.what();
+		}
+		catch (...)
+		{
+			error = "unknown error";
+		}
+		Py_END_ALLOW_THREADS
+
+		if (parseError != mdm_OptionsParser::OK)
+		{
+			PyErr_Format(PyExc_ValueError, "Error parsing %s options", tool.who().c_str());
+			return NULL;
+		}
+		if (!error.empty())
+		{
+			PyErr_SetString(PyExc_RuntimeError, error.c_str());
+			return NULL;
+		}
+
+		PyObject *outputs = PyBytes_FromStringAndSize(
+			reinterpret_cast<const char*>(arrays.outputs.data()),
+			Py_ssize_t(arrays.outputs.size() * sizeof(double)));
+		if (!outputs)
+			return NULL;
+		return Py_BuildValue("(Nn)", outputs, Py_ssize_t(arrays.numOutputColumns));
+	}
+
+	//Get the input data buffer, and set it in the arrays
+	bool setInputs(PyObject *dataObj, BufferView &data, mdm_LiteDataIO::Arrays &arrays)
+	{
+		if (!data.get(dataObj, "data"))
+			return false;
+
+		arrays.inputs = data.data();
+		arrays.numRows = data.numRows();
+		arrays.numInputColumns = data.numColumns();
+		return true;
+	}
+
+	//Copy an optional vector of values
+	bool setVector(PyObject *obj, const char *name, std::vector<double> &values)
+	{
+		if (!obj || obj == Py_None)
+			return true;
+
+		BufferView view;
+		if (!view.get(obj, name))
+			return false;
+		values.assign(view.data(), view.data() + view.size());
+		return true;
+	}
+}
+
+//
+static PyObject *run_DCE_lite(PyObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = {
+		"args", "data", "initial_params", "dyn_times", "dyn_noise", NULL };
+	PyObject *argsObj, *dataObj;
+	PyObject *paramsObj = NULL, *timesObj = NULL, *noiseObj = NULL;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|OOO", const_cast<char**>(keywords),
+		&argsObj, &dataObj, &paramsObj, &timesObj, &noiseObj))
+		return NULL;
+
+	mdm_LiteDataIO::Arrays arrays;
+	BufferView data, params;
+	if (!setInputs(dataObj, data, arrays))
+		return NULL;
+
+	if (paramsObj && paramsObj != Py_None)
+	{
+		if (!params.get(paramsObj, "initial_params"))
+			return NULL;
+		if (params.numRows() != arrays.numRows)
+		{
+			PyErr_SetString(PyExc_ValueError, "initial_params must have a row for each row of data");
+			return NULL;
+		}
+		arrays.initialParams = params.data();
+		arrays.numParamColumns = params.numColumns();
+	}
+
+	if (!setVector(timesObj, "dyn_times", arrays.dynTimes) ||
+		!setVector(noiseObj, "dyn_noise", arrays.dynNoise))
+		return NULL;
+
+	return runTool<mdm_RunTools_madym_DCE_lite>(argsObj, arrays);
+}
+
+//
+static PyObject *run_T1_lite(PyObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = { "args", "data", NULL };
+	PyObject *argsObj, *dataObj;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO", const_cast<char**>(keywords),
+		&argsObj, &dataObj))
+		return NULL;
+
+	mdm_LiteDataIO::Arrays arrays;
+	BufferView data;
+	if (!setInputs(dataObj, data, arrays))
+		return NULL;
+
+	return runTool<mdm_RunTools_madym_T1_lite>(argsObj, arrays);
+}
+
+//
+static PyObject *run_DWI_lite(PyObject *, PyObject *args, PyObject *kwargs)
+{
+	static const char *keywords[] = { "args", "data", NULL };
+	PyObject *argsObj, *dataObj;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO", const_cast<char**>(keywords),
+		&argsObj, &dataObj))
+		return NULL;
+
+	mdm_LiteDataIO::Arrays arrays;
+	BufferView data;
+	if (!setInputs(dataObj, data, arrays))
+		return NULL;
+
+	return runTool<mdm_RunTools_madym_DWI_lite>(argsObj, arrays);
+}
+
+static PyMethodDef madym_lite_methods[] = {
+	{ "run_DCE_lite", (PyCFunction)(void(*)(void))run_DCE_lite, METH_VARARGS | METH_KEYWORDS,
+		"run_DCE_lite(args, data, initial_params=None, dyn_times=None, dyn_noise=None)\n"
+		"Fit tracer-kinetic models to each row of data, as madym_DCE_lite.\n"
+		"args are the command-line options of madym_DCE_lite, the data options are ignored.\n"
+		"data, initial_params (n_samples x n_params), dyn_times and dyn_noise must be\n"
+		"C-contiguous float64 buffers (eg numpy arrays), and are not copied.\n"
+		"Returns (outputs, n_columns), outputs a bytes object of float64 output rows." },
+	{ "run_T1_lite", (PyCFunction)(void(*)(void))run_T1_lite, METH_VARARGS | METH_KEYWORDS,
+		"run_T1_lite(args, data)\n"
+		"Fit T1 to each row of data, as madym_T1_lite.\n"
+		"args are the command-line options of madym_T1_lite, the data options are ignored.\n"
+		"data must be a C-contiguous float64 buffer (eg numpy array), and is not copied.\n"
+		"Returns (outputs, n_columns), outputs a bytes object of float64 output rows." },
+	{ "run_DWI_lite", (PyCFunction)(void(*)(void))run_DWI_lite, METH_VARARGS | METH_KEYWORDS,
+		"run_DWI_lite(args, data)\n"
+		"Fit DWI models to each row of data, as madym_DWI_lite.\n"
+		"args are the command-line options of madym_DWI_lite, the data options are ignored.\n"
+		"data must be a C-contiguous float64 buffer (eg numpy array), and is not copied.\n"
+		"Returns (outputs, n_columns), outputs a bytes object of float64 output rows." },
+	{ NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef madym_lite_module = {
+	PyModuleDef_HEAD_INIT,
+	"_madym_lite",
+	"In-process versions of the madym lite analysis tools",
+	-1,
+	madym_lite_methods
+};
+
+//! Python module initialisation
+PyMODINIT_FUNC PyInit__madym_lite(void)
+{
+	return PyModule_Create(&madym_lite_module);
+}
@@ -31,14 +31,20 @@ MDM_API mdm_FileManager::mdm_FileManager(mdm_VolumeAnalysis &volumeAnalysis)
 	writeCtDataMaps_(false),
   writeCtModelMaps_(false),
   applyNiftiScaling_(false),
+  floatStorage_(false),
+  compressionThreads_(1),
   imageWriteFormat_(mdm_ImageIO::ImageFormat::NIFTI),
   imageReadFormat_(mdm_ImageIO::ImageFormat::NIFTI),
-  xtrType_(mdm_XtrFormat::XTR_type::BIDS)
+  xtrType_(mdm_XtrFormat::XTR_type::BIDS),
+  writeQueue_(0)
 {
 }
 
 MDM_API mdm_FileManager::~mdm_FileManager()
-{}
+{
+  //writeQueue_ is the last member, so is destroyed first, waiting for any pending
+  //writes (which may reference this object and the volume analysis) to finish
+}
 
 //
 MDM_API void mdm_FileManager::loadROI(const std::string &path)
@@ -172,22 +178,31 @@ MDM_API void mdm_FileManager::saveDynamicOutputMaps(const std::string& outputDir
 MDM_API void mdm_FileManager::saveDynamicOutputMaps(const std::string& outputDir,
   const  std::string& Ct_sigPrefix, const  std::string& Ct_modPrefix)
 {
+  //The 4D series are written from references to the maps held in the volume
+  //analysis, which must not change until waitForWrites is called
+  const auto imageWriteFormat = imageWriteFormat_;
+  const auto xtrType = xtrType_;
+  const auto applyNiftiScaling = applyNiftiScaling_;
+  const auto compressionThreads = compressionThreads_;
   if (writeCtDataMaps_)
   {
     auto saveName = fs::path(outputDir) / Ct_sigPrefix;
     fs::create_directories(saveName.parent_path());
-    mdm_ImageIO::writeImage4D(imageWriteFormat_, saveName.string(),
-      volumeAnalysis_.CtDataMaps(),
-      mdm_ImageDatatypes::DT_FLOAT, xtrType_, applyNiftiScaling_);
-
+    const auto &imgs = volumeAnalysis_.CtDataMaps();
+    writeQueue_.submit([=, &imgs]() {
+      mdm_ImageIO::writeImage4D(imageWriteFormat, saveName.string(),
+        imgs, mdm_ImageDatatypes::DT_FLOAT, xtrType, applyNiftiScaling, compressionThreads);
+    });
   }
   if (writeCtModelMaps_)
   {
     auto saveName = fs::path(outputDir) / Ct_modPrefix;
     fs::create_directories(saveName.parent_path());
-    mdm_ImageIO::writeImage4D(imageWriteFormat_, saveName.string(),
-      volumeAnalysis_.CtModelMaps(),
-      mdm_ImageDatatypes::DT_FLOAT, xtrType_, applyNiftiScaling_);
+    const auto &imgs = volumeAnalysis_.CtModelMaps();
+    writeQueue_.submit([=, &imgs]() {
+      mdm_ImageIO::writeImage4D(imageWriteFormat, saveName.string(),
+        imgs, mdm_ImageDatatypes::DT_FLOAT, xtrType, applyNiftiScaling, compressionThreads);
+    });
   }
 }
 
@@ -243,23 +258,26 @@ MDM_API void mdm_FileManager::saveModelResiduals(const std::string &outputDir)
 //
 MDM_API void mdm_FileManager::saveSummaryStats(const std::string &outputDir)
 {
-	//Create a new stats object
-	mdm_ParamSummaryStats stats;
+  //Stats only read the maps, so can be computed and written in the background
+  writeQueue_.submit([this, outputDir]() {
+    //Create a new stats object
+    mdm_ParamSummaryStats stats;
 
-	//Do stats for whole ROI
-	const auto &ROI = volumeAnalysis_.ROI();
-	if (ROI)
-		stats.setROI(ROI);
+    //Do stats for whole ROI
+    const auto &ROI = volumeAnalysis_.ROI();
+    if (ROI)
+      stats.setROI(ROI);
 
-	saveMapsSummaryStats(outputDir + "/" + volumeAnalysis_.MAP_NAME_ROI, stats);
+    saveMapsSummaryStats(outputDir + "/" + volumeAnalysis_.MAP_NAME_ROI, stats);
 
-	//Repeat for the enhancing map
-	const auto &enh = volumeAnalysis_.DCEMap(volumeAnalysis_.MAP_NAME_ENHANCING);
-	if (enh)
-	{
-		stats.setROI(enh);
-		saveMapsSummaryStats(outputDir + "/" + volumeAnalysis_.MAP_NAME_ENHANCING, stats);
-	}
+    //Repeat for the enhancing map
+    const auto &enh = volumeAnalysis_.DCEMap(volumeAnalysis_.MAP_NAME_ENHANCING);
+    if (enh)
+    {
+      stats.setROI(enh);
+      saveMapsSummaryStats(outputDir + "/" + volumeAnalysis_.MAP_NAME_ENHANCING, stats);
+    }
+  });
 }
 
 //
@@ -482,7 +500,7 @@ MDM_API void mdm_FileManager::loadDynamicTimeseries(const std::string &dynBasePa
         auto setFunc = std::bind(
           &mdm_VolumeAnalysis::addCtDataMap, &volumeAnalysis_, std::placeholders::_1);
         loadAndSetImage(dynPath, msg, setFunc,
-          mdm_Image3D::ImageType::TYPE_CAMAP, true);
+          mdm_Image3D::ImageType::TYPE_CAMAP, true, 1.0, dynamicStorageType());
       }
       else
       {
@@ -490,11 +508,14 @@ MDM_API void mdm_FileManager::loadDynamicTimeseries(const std::string &dynBasePa
         auto setFunc = std::bind(
           &mdm_VolumeAnalysis::addStDataMap, &volumeAnalysis_, std::placeholders::_1);
         loadAndSetImage(dynPath, msg, setFunc,
-          mdm_Image3D::ImageType::TYPE_T1DYNAMIC, true);
+          mdm_Image3D::ImageType::TYPE_T1DYNAMIC, true, 1.0, dynamicStorageType());
       }
       
 		}
 	}
+
+  //Pack the time-series in the ROI so each voxel can be read contiguously when fitting
+  volumeAnalysis_.packDynamics();
 }
 
 //
@@ -503,11 +524,14 @@ MDM_API void mdm_FileManager::loadDynamicTimeseries(const std::string& basePath,
 {
   auto imgName = basePath.empty() ? StName :
     (fs::path(basePath) / StName).string();
-  auto imgs = mdm_ImageIO::readImage4D(imageReadFormat_, imgName, true, applyNiftiScaling_);
+  //Read each volume directly in the dynamic storage type, so the series is never
+  //held in double precision when float storage is requested
+  auto imgs = mdm_ImageIO::readImage4D(imageReadFormat_, imgName, true, applyNiftiScaling_,
+    dynamicStorageType());
   double dynTime = 0;
   double temp_res = imgs[0].info().temporalResolution.isSet() ?
     imgs[0].info().temporalResolution.value() : 0;
-  for (auto img : imgs)
+  for (auto &img : imgs)
   {
     //If set, use the temporal resolution field, otherwise assume acquisition times
     //have been set from JSON meta file
@@ -527,6 +551,13 @@ MDM_API void mdm_FileManager::loadDynamicTimeseries(const std::string& basePath,
       dynTime += temp_res;
   }
 
+  //Pack the time-series in the ROI so each voxel can be read contiguously when fitting
+  volumeAnalysis_.packDynamics();
+}
+
+MDM_API void mdm_FileManager::setFloatStorage(bool flag)
+{
+  floatStorage_ = flag;
 }
 
 MDM_API void mdm_FileManager::setSaveCtDataMaps(bool b)
@@ -557,6 +588,30 @@ MDM_API void mdm_FileManager::setApplyNiftiScaling(bool flag)
   applyNiftiScaling_ = flag;
 }
 
+//
+MDM_API void mdm_FileManager::setWriteThreads(int nThreads)
+{
+  if (nThreads < 0)
+    throw mdm_exception(__func__, boost::format(
+      "Number of write threads (%1%) must not be negative") % nThreads);
+  writeQueue_.setNumThreads(size_t(nThreads));
+}
+
+//
+MDM_API void mdm_FileManager::setCompressionThreads(int nThreads)
+{
+  if (nThreads < 0)
+    throw mdm_exception(__func__, boost::format(
+      "Number of compression threads (%1%) must not be negative") % nThreads);
+  compressionThreads_ = nThreads;
+}
+
+//
+MDM_API void mdm_FileManager::waitForWrites()
+{
+  writeQueue_.wait();
+}
+
 //
 MDM_API void mdm_FileManager::setXtrType(bool use_bids)
 {
@@ -586,16 +641,21 @@ void mdm_FileManager::saveOutputMap(const std::string &mapName, const mdm_Image3
     xtrType_ : 
     mdm_XtrFormat::XTR_type::NO_XTR;
 
-
-  try {
-    mdm_ImageIO::writeImage3D(imageWriteFormat_, saveName, img,
-      format, xtr, applyNiftiScaling_);
-  }
-  catch (mdm_exception &e)
-  {
-    e.append("Failed to write output map " + mapName);
-    throw;
-  }
+  //The job takes its own copy of the image, so the map is free to change once queued
+  const auto imageWriteFormat = imageWriteFormat_;
+  const auto applyNiftiScaling = applyNiftiScaling_;
+  const auto compressionThreads = compressionThreads_;
+  writeQueue_.submit([=]() {
+    try {
+      mdm_ImageIO::writeImage3D(imageWriteFormat, saveName, img,
+        format, xtr, applyNiftiScaling, compressionThreads);
+    }
+    catch (mdm_exception &e)
+    {
+      e.append("Failed to write output map " + mapName);
+      throw;
+    }
+  });
 }
 
 void mdm_FileManager::saveMapsSummaryStats(const std::string &roiName, mdm_ParamSummaryStats &stats)
@@ -649,12 +709,14 @@ void mdm_FileManager::saveMapSummaryStats(const std::string &mapName, const mdm_
 //
 template <class T> void  mdm_FileManager::loadAndSetImage(
   const std::string &path, const std::string &msgName, T setFunc,
-  const mdm_Image3D::ImageType type, bool loadXtr, double scaling)
+  const mdm_Image3D::ImageType type, bool loadXtr, double scaling,
+  const mdm_Image3D::StorageType storage)
 {
   try {
-    //Read in image and set type
+    //Read in image and set type and storage
     mdm_Image3D img = mdm_ImageIO::readImage3D(imageReadFormat_, path, loadXtr, applyNiftiScaling_);
     img.setType(type);
+    img.setStorageType(storage);
 
     //Scale if necessary
     if (scaling && scaling != 1)
@@ -693,4 +755,8 @@ template void  mdm_FileManager::setImage< std::function<void(const std::string&,
   const std::string &msgName,
   std::function<void(const std::string&, mdm_Image3D)> setFunc);*/
 
-
+//
+mdm_Image3D::StorageType mdm_FileManager::dynamicStorageType() const
+{
+  return floatStorage_ ? mdm_Image3D::STORAGE_FLOAT : mdm_Image3D::STORAGE_DOUBLE;
+}
@@ -15,6 +15,7 @@
 #include <madym/image_io/mdm_ImageIO.h>
 #include <madym/image_io/meta/mdm_XtrFormat.h>
 #include <madym/utils/mdm_Image3D.h>
+#include <madym/utils/mdm_AsyncWriteQueue.h>
 
 //!   Manager class for reading input and writing ouput of volume-wise model analysis
 /*!
@@ -33,6 +34,8 @@ public:
 		
 	//! Destructor
 	/*!
+	Waits for any pending background writes. Writes read maps held in the volume analysis,
+	so the file manager must be destroyed before it.
 	*/
 	MDM_API ~mdm_FileManager();
 
@@ -244,6 +247,37 @@ public:
 	*/
 	MDM_API void setApplyNiftiScaling(bool flag);
 
+	//! Set flag to store dynamic images as float
+	/*!
+	\param flag if true, dynamic time-series images (and the concentration maps derived from them)
+	are stored in single precision, halving their memory use. Time-series packed for an ROI are
+	then packed as float too. Model fitting is still done in double
+	\see mdm_Image3D::StorageType
+	*/
+	MDM_API void setFloatStorage(bool flag);
+
+	//! Set number of background threads writing output maps
+	/*!
+	Output maps are encoded, compressed and written by background threads as each save function
+	is called, so writing overlaps the remaining output. waitForWrites() must be called before the
+	volume analysis is modified or reset. Waits for any pending writes first.
+	\param nThreads number of background write threads. If 0, maps are written synchronously
+	*/
+	MDM_API void setWriteThreads(int nThreads);
+
+	//! Set number of threads used to compress each output map
+	/*!
+	Only used when writing NIFTI_GZ images, see mdm_NiftiFormat::writeImage3D
+	\param nThreads number of threads compressing each map. If 0, uses all available hardware threads
+	*/
+	MDM_API void setCompressionThreads(int nThreads);
+
+	//! Wait for all pending output maps to be written
+	/*!
+	Throws the first error raised writing any map since the last call
+	*/
+	MDM_API void waitForWrites();
+
 	//! Set image meta information format for writing output
 	/*!
 	\param use_bids if true uses BIDS JSON format, otherwise uses original Madym XTR format
@@ -270,7 +304,10 @@ private:
 
   template <class T> void loadAndSetImage(
     const std::string &path, const std::string &msgName, T setFunc,
-    const mdm_Image3D::ImageType type, bool loadXtr, double scaling = 1.0);
+    const mdm_Image3D::ImageType type, bool loadXtr, double scaling = 1.0,
+    const mdm_Image3D::StorageType storage = mdm_Image3D::STORAGE_DOUBLE);
+
+  mdm_Image3D::StorageType dynamicStorageType() const;
 
 	/*VARIABLES*/
 
@@ -283,7 +320,13 @@ private:
   mdm_ImageIO::ImageFormat imageWriteFormat_;
   mdm_ImageIO::ImageFormat imageReadFormat_;
 	bool applyNiftiScaling_;
+	bool floatStorage_;
+	int compressionThreads_;
 	mdm_XtrFormat::XTR_type xtrType_;
+
+	//Background writer for output maps. Must be the last member, so pending writes
+	//finish before anything they reference is destroyed
+	mdm_AsyncWriteQueue writeQueue_;
 };
 
 #endif /* MDM_FILELOAD_HDR */
@@ -27,6 +27,9 @@ struct mdm_InputOptions {
     "Read input parameters from a configuration file"); //!< See initial value
 	mdm_input_string dataDir = mdm_input_string(
 		mdm_input_str(""), "cwd", "", "Set the working directory"); //!< See initial value
+	mdm_input_int nThreads = mdm_input_int(
+		1, "nthreads", "",
+		"Number of threads used for voxel-wise processing - 0 to use all available cores"); //!< See initial value
 
 	//DCE input options
 	mdm_input_bool inputCt = mdm_input_bool(
@@ -87,6 +90,15 @@ struct mdm_InputOptions {
 	mdm_input_doubles T1InitialParams = mdm_input_doubles(
 		mdm_input_double_list(std::vector<double>{}), "T1_init_params", "",
 		"Initial values for [T1,M0] to be optimised. If only 1 set, this will initialise T1"); //!< See initial value
+	mdm_input_bool T1ClosedFormInit = mdm_input_bool(
+		false, "T1_closed_form_init", "",
+		"Initialise IR_E fits from a closed-form estimate of T1 and M0, instead of an initial IR fit"); //!< See initial value
+	mdm_input_bool T1DictRefine = mdm_input_bool(
+		true, "T1_dict_refine", "",
+		"Refine T1 matched by dictionary methods (eg VFA_DICT) with a single Gauss-Newton step"); //!< See initial value
+	mdm_input_double T1LinearRefineTol = mdm_input_double(
+		0.0, "T1_linear_refine_tol", "",
+		"If > 0, VFA_LINEAR fits with RMS residual, relative to RMS signal, above this are refined with a nonlinear fit"); //!< See initial value
 
 	//DWI tool inputs
 	mdm_input_string DWImodel = mdm_input_string(
@@ -101,6 +113,9 @@ struct mdm_InputOptions {
 	mdm_input_doubles BvalsThresh = mdm_input_doubles(
 		mdm_input_double_list(std::vector<double>{ 100.0 }), "Bvals_thresh", "",
 		"Used to separate B-values into high and low sets for initial IVIM fitting"); //!< See initial value
+	mdm_input_double IVIMRestartTol = mdm_input_double(
+		0.0, "IVIM_restart_tol", "",
+		"Relative SSR tolerance at which IVIM fits stop trying further B-value thresholds - 0 to fit all thresholds"); //!< See initial value
 	mdm_input_int nDWIInputs = mdm_input_int(
 		0, "n_DWI", "",
 		"Number of input signals for DWI models"); //!< See initial value
@@ -169,6 +184,9 @@ struct mdm_InputOptions {
 	mdm_input_doubles repeatValues = mdm_input_doubles(
 		mdm_input_double_list(std::vector<double>{}), "repeat_values", "",
 		"Values for repeat parameter"); //!< See initial value
+	mdm_input_bool repeatPruning = mdm_input_bool(
+		false, "repeat_prune", "",
+		"Flag to stop repeat fits early if they are unlikely to beat the best fit so far. Faster, but may miss the best fit, default false"); //!< See initial value
 	mdm_input_doubles lowerBounds = mdm_input_doubles(
 		mdm_input_double_list(std::vector<double>{}), "lower_bounds", "",
 		"Lower bounds for each parameter during optimisation"); //!< See initial value
@@ -202,7 +220,7 @@ struct mdm_InputOptions {
 		"Max iterations per voxel in optimisation - 0 for no limit"); //!< See initial value
 	mdm_input_string optimisationType = mdm_input_string(
 		mdm_input_str("BLEIC"), "opt_type", "",
-		"Type of optimisation to use. LLS fastest but only available for some models. NS slowest but most robust"); //!< See initial value
+		"Type of optimisation to use. LLS fastest but only available for some models. NS slowest but most robust. LM uses Levenberg-Marquardt on the fit residuals"); //!< See initial value
 
 	//DCE only output options
 	mdm_input_bool outputCt_sig = mdm_input_bool(
@@ -272,6 +290,15 @@ struct mdm_InputOptions {
 	mdm_input_bool useBIDS = mdm_input_bool(
 		false, "use_BIDS", "",
 		"If set, writes images using BIDS json meta info"); //!< See initial value
+	mdm_input_bool floatStorage = mdm_input_bool(
+		false, "float_storage", "",
+		"If set, stores dynamic images, and their time-series packed for an ROI, in single precision. Halves their memory use, but per-voxel fitting buffers are still double"); //!< See initial value
+	mdm_input_int writeThreads = mdm_input_int(
+		1, "write_threads", "",
+		"Number of background threads writing output maps - 0 to write maps synchronously"); //!< See initial value
+	mdm_input_int compressionThreads = mdm_input_int(
+		1, "compression_threads", "",
+		"Number of threads compressing each NIFTI_GZ output map - 0 to use all available cores"); //!< See initial value
 
 	//Logging options
   mdm_input_bool voxelSizeWarnOnly = mdm_input_bool(
@@ -312,6 +339,9 @@ struct mdm_InputOptions {
 	//Lite options
 	mdm_input_string inputDataFile = mdm_input_string(
 		mdm_input_str(""), "data", "", "Input data filename, see notes for options"); //!< See initial value
+	mdm_input_string dataFormat = mdm_input_string(
+		mdm_input_str("TEXT"), "data_fmt", "",
+		"Format of input and output data files: TEXT, FLOAT64, FLOAT32 or NPY"); //!< See initial value
 	mdm_input_double FA = mdm_input_double(
 		0, "FA", "", "FA of dynamic series"); //!< See initial value
 	mdm_input_doubles VFAs = mdm_input_doubles(
@@ -0,0 +1,499 @@
+/**
+*  @file    mdm_LiteDataIO.cxx
+*  @brief   Implementation of mdm_LiteDataIO class
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_API_EXPORTS
+#define MDM_API_EXPORTS
+#endif // !MDM_API_EXPORTS
+
+#include "mdm_LiteDataIO.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <madym/utils/mdm_exception.h>
+#include <madym/utils/mdm_ThreadPool.h>
+
+#include <future>
+#include <iostream>
+
+namespace {
+	const char NPY_MAGIC[] = "\x93NUMPY";
+	const size_t NPY_MAGIC_SIZE = 6;
+
+	//Byte order character used in numpy type descriptions for this machine
+	char nativeByteOrder()
+	{
+		const uint16_t one = 1;
+		return *reinterpret_cast<const char*>(&one) ? '<' : '>';
+	}
+
+	//Return the value of a key in a numpy header dictionary, up to the next comma
+	//(or closing bracket for tuples)
+	std::string npyHeaderValue(const std::string &header, const std::string &key)
+	{
+		auto pos = header.find("'" + key + "'");
+		if (pos == std::string::npos)
+			return "";
+		pos = header.find(':', pos);
+		if (pos == std::string::npos)
+			return "";
+		pos = header.find_first_not_of(' ', pos + 1);
+		if (pos == std::string::npos)
+			return "";
+		const auto end = header[pos] == '(' ?
+			header.find(')', pos) + 1 : header.find(',', pos);
+		return header.substr(pos, end - pos);
+	}
+}
+
+//
+struct mdm_LiteDataIO::Reader::Mapping {
+	boost::interprocess::file_mapping file;
+	boost::interprocess::mapped_region region;
+};
+
+//
+MDM_API std::string mdm_LiteDataIO::toString(DataFormat fmt)
+{
+	switch (fmt)
+	{
+	case TEXT: return "TEXT";
+	case FLOAT64: return "FLOAT64";
+	case FLOAT32: return "FLOAT32";
+	case NPY: return "NPY";
+	default:
+		throw mdm_exception(__func__, boost::format("Unknown format %1%") % fmt);
+	}
+}
+
+//
+MDM_API mdm_LiteDataIO::DataFormat mdm_LiteDataIO::formatFromString(const std::string& fmt)
+{
+	if (fmt == toString(TEXT))
+		return TEXT;
+	else if (fmt == toString(FLOAT64))
+		return FLOAT64;
+	else if (fmt == toString(FLOAT32))
+		return FLOAT32;
+	else if (fmt == toString(NPY))
+		return NPY;
+	else
+		throw mdm_exception(__func__, "Unknown data format option " + fmt);
+}
+
+//
+MDM_API size_t mdm_LiteDataIO::processRows(Reader &inputs, Reader *initialParams, Writer &outputs,
+	size_t nThreads, const RowFunction &rowFunction, bool quiet, const std::string &rowName)
+{
+	nThreads = std::max(nThreads, size_t(1));
+	const size_t chunkSize = CHUNK_ROWS_PER_THREAD * nThreads;
+	Chunk chunks[2];
+	for (auto &chunk : chunks)
+	{
+		chunk.inputs.resize(chunkSize);
+		chunk.initialParams.resize(chunkSize);
+		chunk.outputs.resize(chunkSize);
+	}
+
+	auto readChunk = [&](Chunk &chunk)
+	{
+		chunk.numRows = 0;
+		while (chunk.numRows < chunkSize && inputs.readRow(chunk.inputs[chunk.numRows]))
+		{
+			if (initialParams && !initialParams->readRow(chunk.initialParams[chunk.numRows]))
+				throw mdm_exception("processRows", boost::format(
+					"no initial parameters for row %1% of input data") % (chunk.firstRow + chunk.numRows + 1));
+			chunk.numRows++;
+		}
+	};
+
+	auto writeChunk = [&](const Chunk &chunk)
+	{
+		for (size_t i = 0; i < chunk.numRows; i++)
+			outputs.writeRow(chunk.outputs[i]);
+	};
+
+	size_t row_counter = 0;
+	size_t next_report = 1000;
+	std::future<void> pendingRead = std::async(std::launch::async, readChunk, std::ref(chunks[0]));
+	std::future<void> pendingWrite;
+	for (size_t i_c = 0; ; i_c++)
+	{
+		pendingRead.get();
+		auto &chunk = chunks[i_c % 2];
+		if (!chunk.numRows)
+			break;
+
+		//Start reading the next chunk into the other buffer, once its output has been written
+		if (pendingWrite.valid())
+			pendingWrite.get();
+		chunks[(i_c + 1) % 2].firstRow = row_counter + chunk.numRows;
+		pendingRead = std::async(std::launch::async, readChunk, std::ref(chunks[(i_c + 1) % 2]));
+
+		//Process the rows in this chunk
+		mdm_ThreadPool::WorkQueue rowQueue(chunk.numRows);
+		mdm_ThreadPool::run(std::min(nThreads, chunk.numRows), [&](size_t i_t)
+		{
+			size_t begin, end;
+			while (rowQueue.next(begin, end))
+			{
+				for (size_t i = begin; i < end; i++)
+					rowFunction(i_t, chunk.inputs[i], chunk.initialParams[i], chunk.outputs[i]);
+			}
+		}, &rowQueue);
+
+		pendingWrite = std::async(std::launch::async, writeChunk, std::cref(chunk));
+
+		row_counter += chunk.numRows;
+		for (; !quiet && next_report <= row_counter; next_report += 1000)
+			std::cout << "Processed " << rowName << " " << next_report << std::endl;
+	}
+	if (pendingWrite.valid())
+		pendingWrite.get();
+
+	return row_counter;
+}
+
+//*******************************************************************************
+// Reader
+//*******************************************************************************
+MDM_API mdm_LiteDataIO::Reader::Reader(const std::string &fileName, DataFormat format,
+	size_t numColumns)
+	:
+	format_(format),
+	numColumns_(numColumns),
+	data_(NULL),
+	valueSize_(format == FLOAT32 ? sizeof(float) : sizeof(double)),
+	numRows_(0),
+	row_(0)
+{
+	if (!numColumns)
+		throw mdm_exception(__func__, "Number of columns must be positive");
+
+	if (format == TEXT)
+	{
+		textStream_.open(fileName, std::ios::in);
+		if (!textStream_.is_open())
+			throw mdm_exception(__func__, "Error opening " + fileName + ", check it exists");
+		return;
+	}
+
+	if (!boost::filesystem::exists(fileName))
+		throw mdm_exception(__func__, "Error opening " + fileName + ", check it exists");
+
+	const size_t offset = format == NPY ? readNpyHeader(fileName) : 0;
+	mapFile(fileName, offset);
+}
+
+//
+MDM_API mdm_LiteDataIO::Reader::Reader(const double *data, size_t numRows, size_t numColumns)
+	:
+	format_(FLOAT64),
+	numColumns_(numColumns),
+	data_(reinterpret_cast<const char*>(data)),
+	valueSize_(sizeof(double)),
+	numRows_(numRows),
+	row_(0)
+{
+	if (!numColumns)
+		throw mdm_exception(__func__, "Number of columns must be positive");
+
+	if (numRows && !data)
+		throw mdm_exception(__func__, "Input data not set");
+}
+
+//
+MDM_API mdm_LiteDataIO::Reader::~Reader()
+{
+}
+
+//
+MDM_API bool mdm_LiteDataIO::Reader::readRow(std::vector<double> &row)
+{
+	row.resize(numColumns_);
+	if (format_ == TEXT)
+	{
+		for (size_t i = 0; i < numColumns_; i++)
+		{
+			if (!(textStream_ >> row[i]))
+			{
+				if (!i && textStream_.eof())
+					return false;
+				throw mdm_exception(__func__, boost::format(
+					"Error reading column %1% of row %2%") % (i + 1) % (row_ + 1));
+			}
+		}
+		row_++;
+		return true;
+	}
+
+	if (row_ == numRows_)
+		return false;
+
+	const char *src = data_ + row_ * numColumns_ * valueSize_;
+	if (valueSize_ == sizeof(float))
+	{
+		for (size_t i = 0; i < numColumns_; i++, src += sizeof(float))
+		{
+			float f;
+			std::memcpy(&f, src, sizeof(float));
+			row[i] = f;
+		}
+	}
+	else
+		std::memcpy(row.data(), src, numColumns_ * sizeof(double));
+
+	row_++;
+	return true;
+}
+
+//
+void mdm_LiteDataIO::Reader::mapFile(const std::string &fileName, size_t offset)
+{
+	const size_t fileSize = boost::filesystem::file_size(fileName);
+	const size_t rowSize = numColumns_ * valueSize_;
+	if (fileSize < offset || (fileSize - offset) % rowSize)
+		throw mdm_exception(__func__, boost::format(
+			"Size of %1% (%2% bytes) is not a whole number of rows of %3% values")
+			% fileName % fileSize % numColumns_);
+
+	numRows_ = (fileSize - offset) / rowSize;
+	if (!numRows_)
+		return;
+
+	try
+	{
+		mapping_.reset(new Mapping);
+		mapping_->file = boost::interprocess::file_mapping(
+			fileName.c_str(), boost::interprocess::read_only);
+		mapping_->region = boost::interprocess::mapped_region(
+			mapping_->file, boost::interprocess::read_only, offset, numRows_ * rowSize);
+		mapping_->region.advise(boost::interprocess::mapped_region::advice_sequential);
+	}
+	catch (boost::interprocess::interprocess_exception &e)
+	{
+		throw mdm_exception(__func__, boost::format(
+			"Failed to map %1%: %2%") % fileName % e.what());
+	}
+	data_ = static_cast<const char*>(mapping_->region.get_address());
+}
+
+//
+size_t mdm_LiteDataIO::Reader::readNpyHeader(const std::string &fileName)
+{
+	std::ifstream ifs(fileName, std::ios::in | std::ios::binary);
+	if (!ifs.is_open())
+		throw mdm_exception(__func__, "Error opening " + fileName + ", check it exists");
+
+	char magic[NPY_MAGIC_SIZE];
+	unsigned char version[2];
+	ifs.read(magic, NPY_MAGIC_SIZE);
+	ifs.read(reinterpret_cast<char*>(version), 2);
+	if (!ifs || std::memcmp(magic, NPY_MAGIC, NPY_MAGIC_SIZE))
+		throw mdm_exception(__func__, fileName + " is not an NPY file");
+
+	//Header length is little-endian, 2 bytes in version 1, 4 bytes in later versions
+	const size_t lenBytes = version[0] == 1 ? 2 : 4;
+	unsigned char lenBuf[4] = { 0, 0, 0, 0 };
+	ifs.read(reinterpret_cast<char*>(lenBuf), lenBytes);
+	const size_t headerLen =
+		size_t(lenBuf[0]) | size_t(lenBuf[1]) << 8 | size_t(lenBuf[2]) << 16 | size_t(lenBuf[3]) << 24;
+
+	std::string header(headerLen, ' ');
+	ifs.read(&header[0], headerLen);
+	if (!ifs)
+		throw mdm_exception(__func__, "Error reading NPY header from " + fileName);
+
+	//Check the data are floats in C order and native byte order
+	const auto descr = npyHeaderValue(header, "descr");
+	const std::string native = std::string("'") + nativeByteOrder();
+	if (descr == native + "f8'" || descr == "'=f8'")
+		valueSize_ = sizeof(double);
+	else if (descr == native + "f4'" || descr == "'=f4'")
+		valueSize_ = sizeof(float);
+	else
+		throw mdm_exception(__func__, boost::format(
+			"NPY data type %1% in %2% not supported, must be float64 or float32 in native byte order")
+			% descr % fileName);
+
+	if (npyHeaderValue(header, "fortran_order") != "False")
+		throw mdm_exception(__func__, fileName + " is in Fortran order, only C order is supported");
+
+	//The shape must be (rows, numColumns), or (rows,) for a single column
+	auto shape = npyHeaderValue(header, "shape");
+	std::replace_if(shape.begin(), shape.end(),
+		[](char c) { return c == '(' || c == ')' || c == ','; }, ' ');
+	std::istringstream shapeStream(shape);
+	std::vector<size_t> dims;
+	size_t dim;
+	while (shapeStream >> dim)
+		dims.push_back(dim);
+
+	const size_t numColumns = dims.size() == 1 ? 1 : (dims.size() == 2 ? dims[1] : 0);
+	if (numColumns != numColumns_)
+		throw mdm_exception(__func__, boost::format(
+			"NPY array in %1% has shape %2%, expected 2D array with %3% columns")
+			% fileName % npyHeaderValue(header, "shape") % numColumns_);
+
+	return NPY_MAGIC_SIZE + 2 + lenBytes + headerLen;
+}
+
+//*******************************************************************************
+// Writer
+//*******************************************************************************
+MDM_API mdm_LiteDataIO::Writer::Writer(const std::string &fileName, DataFormat format)
+	:
+	format_(format),
+	memory_(NULL),
+	numColumns_(0),
+	numRows_(0)
+{
+	stream_.open(fileName, format == TEXT ?
+		std::ios::out : std::ios::out | std::ios::binary);
+	if (!stream_.is_open())
+		throw mdm_exception(__func__, "Error opening " + fileName + " for writing");
+
+	if (format == TEXT)
+		return;
+
+	buffer_.reserve(BUFFER_SIZE);
+
+	//Write a placeholder header, rewritten with the final shape on close
+	if (format == NPY)
+		writeNpyHeader();
+}
+
+//
+MDM_API mdm_LiteDataIO::Writer::Writer(std::vector<double> &data)
+	:
+	format_(FLOAT64),
+	memory_(&data),
+	numColumns_(0),
+	numRows_(0)
+{
+}
+
+//
+MDM_API mdm_LiteDataIO::Writer::~Writer()
+{
+	try
+	{
+		close();
+	}
+	catch (...)
+	{
+	}
+}
+
+//
+MDM_API void mdm_LiteDataIO::Writer::writeRow(const std::vector<double> &row)
+{
+	if (!numRows_)
+		numColumns_ = row.size();
+	else if (row.size() != numColumns_)
+		throw mdm_exception(__func__, boost::format(
+			"Row %1% has %2% values, previous rows had %3%") % (numRows_ + 1) % row.size() % numColumns_);
+
+	numRows_++;
+	if (memory_)
+	{
+		memory_->insert(memory_->end(), row.begin(), row.end());
+		return;
+	}
+
+	if (format_ == TEXT)
+	{
+		for (size_t i = 0; i < row.size(); i++)
+			stream_ << (i ? " " : "") << row[i];
+		stream_ << '\n';
+		return;
+	}
+
+	if (format_ == FLOAT32)
+	{
+		for (const auto v : row)
+		{
+			const float f = float(v);
+			const char *bytes = reinterpret_cast<const char*>(&f);
+			buffer_.insert(buffer_.end(), bytes, bytes + sizeof(float));
+		}
+	}
+	else
+	{
+		const char *bytes = reinterpret_cast<const char*>(row.data());
+		buffer_.insert(buffer_.end(), bytes, bytes + row.size() * sizeof(double));
+	}
+
+	if (buffer_.size() >= BUFFER_SIZE)
+		flush();
+}
+
+//
+MDM_API void mdm_LiteDataIO::Writer::close()
+{
+	if (!stream_.is_open())
+		return;
+
+	if (format_ != TEXT)
+		flush();
+
+	if (format_ == NPY)
+	{
+		stream_.seekp(0);
+		writeNpyHeader();
+	}
+
+	stream_.close();
+	if (stream_.fail())
+		throw mdm_exception(__func__, "Error writing output data");
+}
+
+//
+MDM_API size_t mdm_LiteDataIO::Writer::numColumns() const
+{
+	return numColumns_;
+}
+
+//
+void mdm_LiteDataIO::Writer::writeNpyHeader()
+{
+	std::ostringstream dict;
+	dict << "{'descr': '" << nativeByteOrder() << "f8', 'fortran_order': False, 'shape': ("
+		<< numRows_ << ", " << numColumns_ << "), }";
+
+	//Pad with spaces, terminated by a newline, to a fixed total size so the header can be
+	//rewritten in place once the number of rows is known
+	const size_t prefixSize = NPY_MAGIC_SIZE + 4;
+	auto header = dict.str();
+	if (header.size() + 1 > NPY_HEADER_SIZE - prefixSize)
+		throw mdm_exception(__func__, "NPY header too long");
+	header.resize(NPY_HEADER_SIZE - prefixSize - 1, ' ');
+	header += '\n';
+
+	const unsigned char version[2] = { 1, 0 };
+	const unsigned char len[2] = {
+		(unsigned char)(header.size() & 0xff), (unsigned char)(header.size() >> 8) };
+	stream_.write(NPY_MAGIC, NPY_MAGIC_SIZE);
+	stream_.write(reinterpret_cast<const char*>(version), 2);
+	stream_.write(reinterpret_cast<const char*>(len), 2);
+	stream_.write(header.data(), header.size());
+}
+
+//
+void mdm_LiteDataIO::Writer::flush()
+{
+	stream_.write(buffer_.data(), buffer_.size());
+	buffer_.clear();
+	if (stream_.fail())
+		throw mdm_exception(__func__, "Error writing output data");
+}
@@ -0,0 +1,225 @@
+/*!
+*  @file    mdm_LiteDataIO.h
+*  @brief   Row-wise readers and writers for the data files of the lite analysis tools
+*  @details More info...
+*  @author MA Berks (c) Copyright QBI Lab, University of Manchester 2022
+*/
+
+#ifndef MDM_LITEDATAIO_HDR
+#define MDM_LITEDATAIO_HDR
+#include <madym/utils/mdm_api.h>
+
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+//! Row-wise readers and writers for the data files of the lite analysis tools
+/*!
+Each sample processed by a lite tool is one row of its input file, and produces one row of
+its output file. Rows can be stored as:
+- TEXT: whitespace separated values, one row per line (the original format)
+- FLOAT64, FLOAT32: raw, native byte order, binary values, stored row by row with no header
+- NPY: a 2D numpy array (float64 or float32, C order, native byte order), as saved by numpy.save
+
+Binary input files are memory mapped, and binary output is buffered, so large numbers of
+samples can be processed without the cost of parsing and formatting text.
+
+Rows can also be read directly from, and written to, memory (see Arrays), so the lite tools can
+be run in-process (eg from the python bindings) without any data files.
+*/
+class mdm_LiteDataIO {
+
+public:
+	//! Enum of data file formats
+	enum DataFormat {
+		TEXT, ///< Whitespace separated text
+		FLOAT64, ///< Raw double precision binary
+		FLOAT32, ///< Raw single precision binary
+		NPY ///< Numpy array file
+	};
+
+	//! Convert format to string
+	/*!
+	\param fmt data format
+	\return string representation of format
+	*/
+	MDM_API static std::string toString(DataFormat fmt);
+
+	//! Convert string to format
+	/*!
+	\param fmt string representation of format, must match one of the formats, otherwise throws
+	mdm_exception
+	\return data format
+	*/
+	MDM_API static DataFormat formatFromString(const std::string& fmt);
+
+	//! In-memory data, used by a lite tool in place of its input and output data files
+	struct Arrays {
+		const double *inputs = NULL; ///< Input rows, stored row by row (C order)
+		size_t numRows = 0; ///< Number of input rows
+		size_t numInputColumns = 0; ///< Number of values in each input row
+		const double *initialParams = NULL; ///< Optional initial model parameters for each row (DCE only)
+		size_t numParamColumns = 0; ///< Number of parameters in each row of initialParams
+		std::vector<double> dynTimes; ///< Optional dynamic times, replacing the dynamic times file (DCE only)
+		std::vector<double> dynNoise; ///< Optional dynamic noise, replacing the dynamic noise file (DCE only)
+		std::vector<double> outputs; ///< Output rows, stored row by row, filled by the tool
+		size_t numOutputColumns = 0; ///< Number of values in each output row, set by the tool
+	};
+
+	//! Reads fixed length rows of values from a data file
+	class Reader {
+
+	public:
+		//! Open a data file for reading
+		/*!
+		\param fileName name of file to read
+		\param format format of the file
+		\param numColumns number of values in each row
+		*/
+		MDM_API Reader(const std::string &fileName, DataFormat format, size_t numColumns);
+
+		//! Read rows from memory
+		/*!
+		The data are not copied, so must remain valid for the lifetime of the reader
+		\param data values, stored row by row
+		\param numRows number of rows
+		\param numColumns number of values in each row
+		*/
+		MDM_API Reader(const double *data, size_t numRows, size_t numColumns);
+
+		//! Destructor, closes the file
+		MDM_API ~Reader();
+
+		//! Read the next row
+		/*!
+		Throws mdm_exception if the file ends part way through a row
+		\param row vector, resized to the number of columns, into which the row is read
+		\return false if there are no more rows, true otherwise
+		*/
+		MDM_API bool readRow(std::vector<double> &row);
+
+	private:
+		//Mapped file and region, hidden so platform specific headers aren't exposed
+		struct Mapping;
+
+		//Map a binary file, and check its size is a whole number of rows
+		void mapFile(const std::string &fileName, size_t offset);
+
+		//Parse the header of an NPY file, returning the offset of the data
+		size_t readNpyHeader(const std::string &fileName);
+
+		DataFormat format_;
+		size_t numColumns_;
+		std::ifstream textStream_;
+
+		std::unique_ptr<Mapping> mapping_;
+		const char *data_;
+		size_t valueSize_;
+		size_t numRows_;
+		size_t row_;
+	};
+
+	//! Writes rows of values to a data file
+	class Writer {
+
+	public:
+		//! Open a data file for writing
+		/*!
+		The number of columns is set from the first row written, all subsequent rows must match
+		\param fileName name of file to write
+		\param format format of the file. NPY files are written as float64 arrays
+		*/
+		MDM_API Writer(const std::string &fileName, DataFormat format);
+
+		//! Write rows to memory
+		/*!
+		\param data vector to which each row is appended. Must remain valid for the lifetime of the writer
+		*/
+		MDM_API Writer(std::vector<double> &data);
+
+		//! Destructor, closes the file if still open
+		MDM_API ~Writer();
+
+		//! Write a row
+		/*!
+		\param row values to write
+		*/
+		MDM_API void writeRow(const std::vector<double> &row);
+
+		//! Flush any buffered rows and close the file
+		/*!
+		For NPY files, writes the final array shape to the header
+		*/
+		MDM_API void close();
+
+		//! Return the number of columns
+		/*!
+		\return number of values in each row, 0 if no rows have been written
+		*/
+		MDM_API size_t numColumns() const;
+
+	private:
+		//Write the NPY header for the current number of rows
+		void writeNpyHeader();
+
+		//Write the binary buffer to file
+		void flush();
+
+		DataFormat format_;
+		std::ofstream stream_;
+		std::vector<char> buffer_;
+		std::vector<double> *memory_;
+		size_t numColumns_;
+		size_t numRows_;
+	};
+
+	//! Function processing a single row
+	/*!
+	Called with the index of the calling thread, the input row, initial parameters for the row
+	(empty if not set) and the output row to fill
+	*/
+	typedef std::function<void(size_t, const std::vector<double>&,
+		const std::vector<double>&, std::vector<double>&)> RowFunction;
+
+	//! Process every row of an input reader, writing the results to a writer
+	/*!
+	Rows are processed in chunks. While the worker threads process one chunk, the next chunk is
+	read and the previous chunk's output is written in the background. Output is always written
+	in input order. Throws the first exception thrown by any worker.
+	\param inputs reader of input rows
+	\param initialParams optional reader of initial parameters, which must have a row for every input
+	row. May be NULL
+	\param outputs writer of output rows
+	\param nThreads number of worker threads
+	\param rowFunction function processing each row. Each thread calls with its own thread index,
+	in the range [0, nThreads), so can use its own model and fitter objects
+	\param quiet if false, reports progress every 1000 rows
+	\param rowName name of a row in progress messages (eg "sample")
+	\return number of rows processed
+	*/
+	MDM_API static size_t processRows(Reader &inputs, Reader *initialParams, Writer &outputs,
+		size_t nThreads, const RowFunction &rowFunction, bool quiet, const std::string &rowName);
+
+private:
+	//Rows of input and output data processed together
+	struct Chunk {
+		std::vector<std::vector<double> > inputs;
+		std::vector<std::vector<double> > initialParams;
+		std::vector<std::vector<double> > outputs;
+		size_t firstRow = 0;
+		size_t numRows = 0;
+	};
+
+	//Number of rows per thread in each chunk of input data
+	static const size_t CHUNK_ROWS_PER_THREAD = 256;
+
+	//Total size in bytes of the NPY header we write
+	static const size_t NPY_HEADER_SIZE = 128;
+
+	//Size of the binary output buffer
+	static const size_t BUFFER_SIZE = 1 << 20;
+};
+
+#endif /* MDM_LITEDATAIO_HDR */
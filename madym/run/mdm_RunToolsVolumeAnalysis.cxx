@@ -36,6 +36,9 @@ void mdm_RunToolsVolumeAnalysis::setFileManagerParams()
   fileManager_.setImageReadFormat(options_.imageReadFormat());
   fileManager_.setImageWriteFormat(options_.imageWriteFormat());
   fileManager_.setApplyNiftiScaling(options_.niftiScaling());
+  fileManager_.setFloatStorage(options_.floatStorage());
+  fileManager_.setWriteThreads(options_.writeThreads());
+  fileManager_.setCompressionThreads(options_.compressionThreads());
   fileManager_.setXtrType(options_.useBIDS());
 }
 
@@ -154,7 +157,7 @@ void mdm_RunToolsVolumeAnalysis::mapT1()
   loadT1Inputs();
 
   //See if B1 correction map to load
-  loadB1(methodType == mdm_T1MethodGenerator::VFA_B1);
+  loadB1(mdm_T1MethodGenerator::usesB1(methodType));
 
   //For inversion recovery, override TR
   if (options_.TR())
@@ -163,6 +166,10 @@ void mdm_RunToolsVolumeAnalysis::mapT1()
   //FA images loaded, try computing T1 and M0 maps
   volumeAnalysis_.T1Mapper().setMethod(methodType);
   volumeAnalysis_.T1Mapper().setNoiseThreshold(options_.T1noiseThresh());
+  volumeAnalysis_.T1Mapper().setNumThreads(options_.nThreads());
+  volumeAnalysis_.T1Mapper().setClosedFormInit(options_.T1ClosedFormInit());
+  volumeAnalysis_.T1Mapper().setDictionaryRefine(options_.T1DictRefine());
+  volumeAnalysis_.T1Mapper().setLinearRefineTolerance(options_.T1LinearRefineTol());
   volumeAnalysis_.T1Mapper().mapT1(options_.T1InitialParams());
 }
 
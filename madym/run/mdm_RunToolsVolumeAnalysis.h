@@ -65,12 +65,16 @@ protected:
 
 	//Variables:
 
-	//! Object for managing all image volume IO
-	mdm_FileManager fileManager_;
-
 	//! Analysis object that performs specified analyses on all volume voxels
 	mdm_VolumeAnalysis volumeAnalysis_;
 
+	//! Object for managing all image volume IO
+	/*!
+	Declared after volumeAnalysis_ so it is destroyed first: its destructor waits for any
+	background writes, which read maps held in volumeAnalysis_, including on error paths
+	*/
+	mdm_FileManager fileManager_;
+
 private:
 	//fs::path errorTrackerPath_;
 };
@@ -99,6 +99,9 @@ MDM_API void mdm_RunTools_madym_AIF::run()
       options_.Ct_sigPrefix(), options_.Ct_modPrefix(),
       options_.sequenceFormat(), options_.sequenceStart(), options_.sequenceStep());
 
+  //Wait for the background writes, reporting any error
+  fileManager_.waitForWrites();
+
   //Reset the volume analysis
   volumeAnalysis_.reset();
 }
@@ -134,6 +137,9 @@ MDM_API int mdm_RunTools_madym_AIF::parseInputs(int argc, const char *argv[])
   options_parser_.add_option(config_options, options_.B1Name);
   options_parser_.add_option(config_options, options_.TR);
 	options_parser_.add_option(config_options, options_.T1InitialParams);
+	options_parser_.add_option(config_options, options_.T1ClosedFormInit);
+	options_parser_.add_option(config_options, options_.T1DictRefine);
+	options_parser_.add_option(config_options, options_.T1LinearRefineTol);
 
 	//Signal to concentration options_
   options_parser_.add_option(config_options, options_.M0Ratio);
@@ -164,6 +170,9 @@ MDM_API int mdm_RunTools_madym_AIF::parseInputs(int argc, const char *argv[])
   options_parser_.add_option(config_options, options_.niftiScaling);
   options_parser_.add_option(config_options, options_.nifti4D);
   options_parser_.add_option(config_options, options_.useBIDS);
+  options_parser_.add_option(config_options, options_.floatStorage);
+  options_parser_.add_option(config_options, options_.writeThreads);
+  options_parser_.add_option(config_options, options_.compressionThreads);
 
   //Logging options_
   options_parser_.add_option(config_options, options_.voxelSizeWarnOnly);
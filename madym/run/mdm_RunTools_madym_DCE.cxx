@@ -154,6 +154,9 @@ MDM_API int mdm_RunTools_madym_DCE::parseInputs(int argc, const char *argv[])
   options_parser_.add_option(config_options, options_.B1Name);
   options_parser_.add_option(config_options, options_.TR);
 	options_parser_.add_option(config_options, options_.T1InitialParams);
+	options_parser_.add_option(config_options, options_.T1ClosedFormInit);
+	options_parser_.add_option(config_options, options_.T1DictRefine);
+	options_parser_.add_option(config_options, options_.T1LinearRefineTol);
 
 	//Signal to concentration options_
 	options_parser_.add_option(config_options, options_.M0Ratio);
@@ -184,6 +187,7 @@ MDM_API int mdm_RunTools_madym_DCE::parseInputs(int argc, const char *argv[])
 	options_parser_.add_option(config_options, options_.relativeLimitValues);
 	options_parser_.add_option(config_options, options_.repeatParam);
 	options_parser_.add_option(config_options, options_.repeatValues);
+	options_parser_.add_option(config_options, options_.repeatPruning);
 	options_parser_.add_option(config_options, options_.firstImage);
 	options_parser_.add_option(config_options, options_.lastImage);
 
@@ -192,6 +196,7 @@ MDM_API int mdm_RunTools_madym_DCE::parseInputs(int argc, const char *argv[])
 	options_parser_.add_option(config_options, options_.testEnhancement);
 	options_parser_.add_option(config_options, options_.maxIterations);
 	options_parser_.add_option(config_options, options_.optimisationType);
+	options_parser_.add_option(config_options, options_.nThreads);
 
 		//DCE only output options_
 	options_parser_.add_option(config_options, options_.outputCt_sig);
@@ -212,6 +217,9 @@ MDM_API int mdm_RunTools_madym_DCE::parseInputs(int argc, const char *argv[])
 	options_parser_.add_option(config_options, options_.niftiScaling);
 	options_parser_.add_option(config_options, options_.nifti4D);
 	options_parser_.add_option(config_options, options_.useBIDS);
+	options_parser_.add_option(config_options, options_.floatStorage);
+	options_parser_.add_option(config_options, options_.writeThreads);
+	options_parser_.add_option(config_options, options_.compressionThreads);
 
 		//Logging options_
   options_parser_.add_option(config_options, options_.voxelSizeWarnOnly);
@@ -288,7 +296,9 @@ void mdm_RunTools_madym_DCE::setVolumeAnalysisParams()
 		volumeAnalysis_.setLastImage(options_.lastImage() - 1);
 	volumeAnalysis_.setIAUCtimes(options_.IAUCTimes(), true, options_.IAUCAtPeak());
 	volumeAnalysis_.setMaxIterations(options_.maxIterations());
+	volumeAnalysis_.setRepeatPruning(options_.repeatPruning());
 	volumeAnalysis_.setOptimisationType(options_.optimisationType());
+	volumeAnalysis_.setNumThreads(options_.nThreads());
 }
 
 //
@@ -356,4 +366,7 @@ void mdm_RunTools_madym_DCE::writeOutput()
 			options_.Ct_sigPrefix(), options_.Ct_modPrefix(),
 			options_.sequenceFormat(), options_.sequenceStart(), options_.sequenceStep());
 	fileManager_.saveDCEOutputMaps(outputPath_.string());
+
+	//Wait for the background writes, reporting any error
+	fileManager_.waitForWrites();
 }
\ No newline at end of file
@@ -11,12 +11,16 @@
 #endif // !MDM_API_EXPORTS
 
 #include "mdm_RunTools_madym_DCE_lite.h"
+#include "mdm_LiteDataIO.h"
 #include <madym/utils/mdm_exception.h>
+#include <madym/utils/mdm_ThreadPool.h>
 
 namespace fs = boost::filesystem;
 
 //
 MDM_API mdm_RunTools_madym_DCE_lite::mdm_RunTools_madym_DCE_lite()
+	:
+	arrays_(NULL)
 {
 }
 
@@ -33,7 +37,7 @@ MDM_API void mdm_RunTools_madym_DCE_lite::run()
 	{
     throw mdm_exception(__func__, "model (option -m) must be provided");
 	}
-	if (options_.inputDataFile().empty())
+	if (!arrays_ && options_.inputDataFile().empty())
 	{
     throw mdm_exception(__func__, "input data file (option -i) must be provided");
 	}
@@ -45,10 +49,14 @@ MDM_API void mdm_RunTools_madym_DCE_lite::run()
   //Set curent working dir
   set_up_cwd();
 
-	//Set-up output folder and output file
-	set_up_output_folder();
-	std::string outputDataFile = outputPath_.string() + "/" +
-		options_.model() + "_" + options_.outputName();
+	//Set-up output folder and output file, unless writing to memory
+	std::string outputDataFile;
+	if (!arrays_)
+	{
+		set_up_output_folder();
+		outputDataFile = outputPath_.string() + "/" +
+			options_.model() + "_" + options_.outputName();
+	}
 
   //Set up AIF, option from map is not allowed in lite analysis
   setAIF();
@@ -68,7 +76,15 @@ MDM_API void mdm_RunTools_madym_DCE_lite::run()
 
 	//If we're using an auto AIF read from file, it will use the times encoded in the file
 	//but if we're using a population AIF we need to read these times and set them in the AIF object
-	if (options_.aifName().empty())
+	if (options_.aifName().empty() && arrays_ && !arrays_->dynTimes.empty())
+	{
+		//Using population AIF, with times given in memory
+		if (arrays_->dynTimes.size() < size_t(options_.nDyns()))
+			throw mdm_exception(__func__, "fewer dynamic times than number of dynamics (option -n)");
+		AIF_.setAIFTimes(std::vector<double>(
+			arrays_->dynTimes.begin(), arrays_->dynTimes.begin() + options_.nDyns()));
+	}
+	else if (options_.aifName().empty())
 	{
 		//Using population AIF
 		if (options_.dynTimesFile().empty())
@@ -113,32 +129,15 @@ MDM_API void mdm_RunTools_madym_DCE_lite::run()
 	if (!options_.inputCt() && (!options_.TR() || !options_.FA() || !options_.r1Const()))
     throw mdm_exception(__func__, "TR, FA, r1 must be set to convert from signal concentration");
 
-	//Open the input data file
-	std::ifstream inputData(options_.inputDataFile(), std::ios::in);
-	if (!inputData.is_open())
-    throw mdm_exception(__func__, "error opening input data file, Check it exists");
-
-	//Open up an output file
-	std::ofstream outputData(outputDataFile, std::ios::out);
-	if (!outputData.is_open())
-    throw mdm_exception(__func__, "error opening ouput data file");
-
-	//If we've been given a initial parameters for every time-series open stream to file
-	//containing these
-	std::ifstream inputParams;
-	bool load_params = false;
-	if (!options_.initParamsFile().empty())
-	{
-		inputParams.open(options_.initParamsFile(), std::ios::in);
-		if (!inputParams.is_open())
-      throw mdm_exception(__func__, "error opening input parameter file, Check it exists");
-		
-		load_params = true;
-	}
-
 	//Check if we've been given a file defining varying dynamic noise
 	std::vector<double> noiseVar;
-	if (!options_.dynNoiseFile().empty())
+	if (arrays_ && !arrays_->dynNoise.empty())
+	{
+		if (arrays_->dynNoise.size() < size_t(options_.nDyns()))
+			throw mdm_exception(__func__, "fewer dynamic noise values than number of dynamics (option -n)");
+		noiseVar.assign(arrays_->dynNoise.begin(), arrays_->dynNoise.begin() + options_.nDyns());
+	}
+	else if (!options_.dynNoiseFile().empty())
 	{
 		//Try and open the file and read in the noise values
 		std::ifstream dynNoiseStream(options_.dynNoiseFile(), std::ios::in);
@@ -159,15 +158,8 @@ MDM_API void mdm_RunTools_madym_DCE_lite::run()
 	for (auto &t : iauc_t)
 		t /= 60;
 
-	std::vector<double> timeSeries(options_.nDyns(), 0);
-
-	double d;
-	double T1 = 0.0;
-	double M0 = 0.0;
-  double B1 = 1.0;
-	int col_counter = 0;
-	int row_counter = 0;
-
+	//Each row contains the time-series, then if converting from signal, T1, M0
+	//(unless using the M0 ratio method) and B1 (if using B1 correction)
 	int col_length = options_.nDyns();
 	if (!options_.inputCt())
 	{
@@ -179,88 +171,106 @@ MDM_API void mdm_RunTools_madym_DCE_lite::run()
       col_length++;
 	}
 
-  //Create a fitter
-  mdm_DCEModelFitter modelFitter(
-    *model_,
-    options_.firstImage(),
-    options_.lastImage() ? options_.lastImage() : options_.nDyns(),
-    noiseVar,
-		options_.optimisationType(),
-    options_.maxIterations()
-  );
-
-	//Loop through the file, reading in each line
-	while (true)
+	//Open the input data, from the in-memory arrays if set, otherwise from file
+	auto dataFormat = mdm_LiteDataIO::formatFromString(options_.dataFormat());
+	std::unique_ptr<mdm_LiteDataIO::Reader> inputData;
+	std::unique_ptr<mdm_LiteDataIO::Writer> outputData;
+	std::unique_ptr<mdm_LiteDataIO::Reader> inputParams;
+	if (arrays_)
 	{
-		if (col_counter == col_length)
+		if (arrays_->numInputColumns != size_t(col_length))
+			throw mdm_exception(__func__, boost::format(
+				"input data has %1% columns, expected %2%") % arrays_->numInputColumns % col_length);
+		inputData.reset(new mdm_LiteDataIO::Reader(
+			arrays_->inputs, arrays_->numRows, col_length));
+		outputData.reset(new mdm_LiteDataIO::Writer(arrays_->outputs));
+
+		if (arrays_->initialParams)
 		{
-			//Check if input parameters to read
-			if (load_params)
-			{
-				int n = model_->numParams();
-				std::vector<double> initialParams(n, 0);
-				double vox;
-				for (int i = 0; i < n; i++)
-				{
-					inputParams >> vox;
-					initialParams[i] = vox;
-				}
-				model_->setInitialParams(initialParams);
-			}
-
-      //Fit the series
-			fit_series(outputData, 
-        modelFitter,
-        timeSeries, 
-        options_.inputCt(),
-				T1, 
-        M0,
-        B1,
-				options_.r1Const(),
-				options_.TR(),
-				options_.FA(),
-				options_.testEnhancement(),
-				options_.M0Ratio(),
-				iauc_t,
-				options_.IAUCAtPeak(),
-				options_.outputCt_mod(),
-				options_.outputCt_sig(),
-				!options_.noOptimise());
-
-			col_counter = 0;
-
-			row_counter++;
-			if (!options_.quiet() && !fmod(row_counter, 1000))
-				std::cout << "Processed time-series " << row_counter << std::endl;
+			if (arrays_->numParamColumns != static_cast<size_t>(model_->numParams()))
+				throw mdm_exception(__func__, boost::format(
+					"initial parameters have %1% columns, expected %2%") 
+					% arrays_->numParamColumns % model_->numParams());
+			inputParams.reset(new mdm_LiteDataIO::Reader(
+				arrays_->initialParams, arrays_->numRows, model_->numParams()));
 		}
-		else
-		{
-			inputData >> d;
-
-			if (col_counter == options_.nDyns())
-				T1 = d;
-
-			else if (col_counter == options_.nDyns() + 1)
-				M0 = d;
-
-      else if (col_counter == options_.nDyns() + 2)
-        B1 = d;
+	}
+	else
+	{
+		inputData.reset(new mdm_LiteDataIO::Reader(
+			options_.inputDataFile(), dataFormat, col_length));
 
-			else //col_counter < nDyns()
-				timeSeries[col_counter] = d;
+		//Open up an output file
+		outputData.reset(new mdm_LiteDataIO::Writer(outputDataFile, dataFormat));
 
-			col_counter++;
+		//If we've been given a initial parameters for every time-series open the file
+		//containing these
+		if (!options_.initParamsFile().empty())
+			inputParams.reset(new mdm_LiteDataIO::Reader(
+				options_.initParamsFile(), dataFormat, model_->numParams()));
+	}
 
-			if (inputData.eof())
-				break;
+	//Set up a model and fitter for each thread. The first thread uses the main model,
+	//the others fit their own copy of the model, bound to their own copy of the AIF, so
+	//that AIF resampling and model evaluation are independent across threads
+	const auto nThreads = mdm_ThreadPool::numThreads(options_.nThreads(), size_t(-1));
+	std::vector<std::unique_ptr<mdm_AIF> > threadAIFs(nThreads);
+	std::vector<std::shared_ptr<mdm_DCEModelBase> > threadModels(nThreads);
+	std::vector<std::unique_ptr<mdm_DCEModelFitter> > threadFitters(nThreads);
+	for (size_t i_t = 0; i_t < nThreads; i_t++)
+	{
+		if (i_t)
+		{
+			threadAIFs[i_t].reset(new mdm_AIF(model_->AIF()));
+			threadModels[i_t] = model_->clone(*threadAIFs[i_t]);
 		}
+		else
+			threadModels[i_t] = model_;
+
+		threadFitters[i_t].reset(new mdm_DCEModelFitter(
+			*threadModels[i_t],
+			options_.firstImage(),
+			options_.lastImage() ? options_.lastImage() : options_.nDyns(),
+			noiseVar,
+			options_.optimisationType(),
+			options_.maxIterations()));
+		threadFitters[i_t]->setRepeatPruning(options_.repeatPruning());
 	}
 
-	//Close the input and output file
-	inputData.close();
-	outputData.close();
-	if (load_params)
-		inputParams.close();
+	//Fit each row, in parallel, writing output in input order
+	auto row_counter = mdm_LiteDataIO::processRows(*inputData, inputParams.get(), *outputData,
+		nThreads, [&](size_t i_t, const std::vector<double> &inputs,
+			const std::vector<double> &initialParams, std::vector<double> &outputs)
+	{
+		auto &model = *threadModels[i_t];
+
+		//Check if input parameters to set
+		if (inputParams)
+			model.setInitialParams(initialParams);
+
+		fit_series(outputs,
+			model,
+			*threadFitters[i_t],
+			inputs,
+			options_.nDyns(),
+			options_.inputCt(),
+			options_.r1Const(),
+			options_.TR(),
+			options_.FA(),
+			options_.testEnhancement(),
+			options_.M0Ratio(),
+			options_.B1Correction(),
+			iauc_t,
+			options_.IAUCAtPeak(),
+			options_.outputCt_mod(),
+			options_.outputCt_sig(),
+			!options_.noOptimise());
+	}, options_.quiet(), "time-series");
+
+	//Close the output file
+	outputData->close();
+	if (arrays_)
+		arrays_->numOutputColumns = outputData->numColumns();
 
   if (!options_.quiet())
   {
@@ -277,9 +287,11 @@ MDM_API int mdm_RunTools_madym_DCE_lite::parseInputs(int argc, const char *argv[
 	options_parser_.add_option(config_options, options_.help);
 	options_parser_.add_option(config_options, options_.version);
 	options_parser_.add_option(config_options, options_.dataDir);
+	options_parser_.add_option(config_options, options_.nThreads);
 
 		//DCE input options_
 	options_parser_.add_option(config_options, options_.inputDataFile);
+	options_parser_.add_option(config_options, options_.dataFormat);
 	options_parser_.add_option(config_options, options_.inputCt);
 	options_parser_.add_option(config_options, options_.dynTimesFile);
 	options_parser_.add_option(config_options, options_.nDyns);
@@ -311,6 +323,7 @@ MDM_API int mdm_RunTools_madym_DCE_lite::parseInputs(int argc, const char *argv[
 	options_parser_.add_option(config_options, options_.relativeLimitValues);
 	options_parser_.add_option(config_options, options_.repeatParam);
 	options_parser_.add_option(config_options, options_.repeatValues);
+	options_parser_.add_option(config_options, options_.repeatPruning);
 	options_parser_.add_option(config_options, options_.firstImage);
 	options_parser_.add_option(config_options, options_.lastImage);
 
@@ -344,44 +357,70 @@ MDM_API std::string mdm_RunTools_madym_DCE_lite::who() const
 	return "madym_DCE_lite";
 }
 
+//
+MDM_API void mdm_RunTools_madym_DCE_lite::runArrays(mdm_LiteDataIO::Arrays &arrays)
+{
+	arrays_ = &arrays;
+	try
+	{
+		run();
+	}
+	catch (...)
+	{
+		arrays_ = NULL;
+		throw;
+	}
+	arrays_ = NULL;
+}
+
 //*******************************************************************************
 // Private:
 //*******************************************************************************
 void mdm_RunTools_madym_DCE_lite::fit_series(
-  std::ostream &outputData,
+  std::vector<double> &outputRow,
+  mdm_DCEModelBase &model,
   mdm_DCEModelFitter &fitter,
-  const std::vector<double> &timeSeries,
+  const std::vector<double> &inputRow,
+  const int nDyns,
   const bool &inputCt,
-  const double &T1,
-  const double &M0,
-  const double &B1,
   const double &r1,
   const double &TR,
   const double & FA,
   const bool&testEnhancement,
   const bool&useM0Ratio,
+  const bool&useB1,
   const std::vector<double> &IAUCTimes,
 	const bool IAUCAtPeak,
   const bool &outputCt_mod,
   const bool &outputCt_sig,
   const bool &optimiseModel)
 {
+	//Split the input row into the time-series, then T1, M0 and B1 as required
 	std::vector<double> signalData;
 	std::vector<double> CtData;
+	double T1 = 0.0;
+	double M0 = 0.0;
+	double B1 = 1.0;
 
 	if (inputCt)
-		CtData = timeSeries;
+		CtData.assign(inputRow.begin(), inputRow.begin() + nDyns);
 	else
-		signalData = timeSeries;
-
-	const auto nDyns = timeSeries.size();
+	{
+		signalData.assign(inputRow.begin(), inputRow.begin() + nDyns);
+		auto val = inputRow.begin() + nDyns;
+		T1 = *val++;
+		if (!useM0Ratio)
+			M0 = *val++;
+		if (useB1)
+			B1 = *val;
+	}
 
 	//Create a perm object
 	mdm_DCEVoxel vox(
 		signalData,
 		CtData,
-		model_->AIF().prebolus(),
-		AIF_.AIFTimes(),
+		model.AIF().prebolus(),
+		model.AIF().AIFTimes(),
 		IAUCTimes,
 		IAUCAtPeak);
 
@@ -404,29 +443,25 @@ void mdm_RunTools_madym_DCE_lite::fit_series(
     fitter.fitModel(vox.status());
 
 	//Now write the output
-	outputData <<
-		vox.status() << " " <<
-		vox.enhancing() << " " <<
-		fitter.modelFitError() << " ";
+	outputRow.clear();
+	outputRow.push_back(vox.status());
+	outputRow.push_back(vox.enhancing());
+	outputRow.push_back(fitter.modelFitError());
 
 	for (size_t i = 0; i < IAUCTimes.size(); i++)
-		outputData << " " << vox.IAUCVal(i);
+		outputRow.push_back(vox.IAUCVal(i));
 
   if (IAUCAtPeak)
-    outputData << " " << vox.IAUCVal(IAUCTimes.size());
-
-	for (const auto p : model_->params())
-		outputData << " " << p; 
+    outputRow.push_back(vox.IAUCVal(IAUCTimes.size()));
 
+	for (const auto p : model.params())
+		outputRow.push_back(p);
 
 	if (outputCt_mod)
 	  for (const auto c : fitter.CtModel())
-			outputData << " " << c;
-	
+			outputRow.push_back(c);
 
 	if (outputCt_sig)
 	for (const auto c : vox.CtData())
-		outputData << " " << c;
-
-	outputData << std::endl;
+		outputRow.push_back(c);
 }
\ No newline at end of file
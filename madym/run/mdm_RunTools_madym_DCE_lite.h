@@ -9,6 +9,7 @@
 #define MDM_RUNTOOLS_MADYM_DCE_LITE_HDR
 #include <madym/utils/mdm_api.h>
 #include <madym/run/mdm_RunToolsDCEFit.h>
+#include <madym/run/mdm_LiteDataIO.h>
 
 //! Class to run the lite version of the DCE analysis tool
 /*!
@@ -42,6 +43,16 @@ public:
 	\return name of the tool 
   */
   MDM_API std::string who() const;
+
+	//! Run the lite version of DCE analysis on in-memory data, rather than data files
+	/*!
+	parseInputs must be called first. The input data and initial parameters are read from the
+	arrays instead of the input data and initial parameters files, and if set, the dynamic times
+	and noise in the arrays are used instead of their files. No output folder or file is created.
+	Throws mdm_exception if errors encountered
+	\param arrays input data, and output data filled by the analysis
+	*/
+	MDM_API void runArrays(mdm_LiteDataIO::Arrays &arrays);
 	
 protected:
   //! Runs the lite version of DCE analysis
@@ -50,7 +61,8 @@ protected:
   2. Sets specified tracer-kinetic model
   3. Opens input data file
   4. Processes each line in input data file, fitting tracer-kineti model to input signals/concentrations,
-  writing fited parameters and IAUC measurements to output file
+  writing fited parameters and IAUC measurements to output file. Lines are read in chunks, fitted in
+  parallel if more than one thread is set, and written in input order (see mdm_LiteDataIO::processRows)
   5. Closes input/output file and reports the number of samples processed.
   Throws mdm_exception if errors encountered
   */
@@ -58,18 +70,18 @@ protected:
 
 private:
   //Methods:
-	void fit_series(std::ostream &outputData,
+	void fit_series(std::vector<double> &outputRow,
+    mdm_DCEModelBase &model,
     mdm_DCEModelFitter &fitter,
-		const std::vector<double> &timeSeries, 
+		const std::vector<double> &inputRow,
+    const int nDyns,
     const bool &inputCt,
-		const double &T1, 
-    const double &M0,
-    const double &B1,
     const double &r1,
 		const double &TR,
 		const double & FA,
 		const bool&testEnhancement,
 		const bool&useM0Ratio,
+		const bool&useB1,
 		const std::vector<double> &IAUCTimes,
 		const bool IAUCAtPeak,
   	const bool &outputCt_mod,
@@ -77,6 +89,8 @@ private:
 		const bool &optimiseModel);
 
 	//Variables:
+	//In-memory data, set while running from runArrays
+	mdm_LiteDataIO::Arrays *arrays_;
 };
 
 #endif
@@ -56,6 +56,7 @@ MDM_API void mdm_RunTools_madym_DWI::run()
 	//Write output
 	fileManager_.saveGeneralOutputMaps(outputPath_.string());
 	fileManager_.saveDWIOutputMaps(outputPath_.string());
+	fileManager_.waitForWrites();
 
 	//Reset the volume analysis
 	volumeAnalysis_.reset();
@@ -73,6 +74,7 @@ MDM_API int mdm_RunTools_madym_DWI::parseInputs(int argc, const char *argv[])
 	options_parser_.add_option(cmdline_options, options_.version);
 	options_parser_.add_option(cmdline_options, options_.configFile);
 	options_parser_.add_option(cmdline_options, options_.dataDir);
+	options_parser_.add_option(config_options, options_.nThreads);
 
 	//ROI options_
 	options_parser_.add_option(config_options, options_.roiName);
@@ -83,6 +85,7 @@ MDM_API int mdm_RunTools_madym_DWI::parseInputs(int argc, const char *argv[])
 	options_parser_.add_option(config_options, options_.DWIDir);
 	options_parser_.add_option(config_options, options_.DWIinputNames);
 	options_parser_.add_option(config_options, options_.BvalsThresh);
+	options_parser_.add_option(config_options, options_.IVIMRestartTol);
   
 
 	//General output options_
@@ -96,6 +99,8 @@ MDM_API int mdm_RunTools_madym_DWI::parseInputs(int argc, const char *argv[])
 	options_parser_.add_option(config_options, options_.niftiScaling);
 	options_parser_.add_option(config_options, options_.nifti4D);
 	options_parser_.add_option(config_options, options_.useBIDS);
+	options_parser_.add_option(config_options, options_.writeThreads);
+	options_parser_.add_option(config_options, options_.compressionThreads);
 
 	//Logging options_
 	options_parser_.add_option(config_options, options_.voxelSizeWarnOnly);
@@ -154,6 +159,8 @@ void mdm_RunTools_madym_DWI::mapDWI()
 
 	//Set B-vals thresh - only needed for ivim but negligible cost to set for all methods
 	volumeAnalysis_.DWIMapper().setBvalsThresh(options_.BvalsThresh());
+	volumeAnalysis_.DWIMapper().setRestartTolerance(options_.IVIMRestartTol());
+	volumeAnalysis_.DWIMapper().setNumThreads(options_.nThreads());
 
 	//Load DWI inputs
 	loadDWIInputs();
@@ -11,15 +11,19 @@
 #endif // !MDM_API_EXPORTS
 
 #include "mdm_RunTools_madym_DWI_lite.h"
+#include "mdm_LiteDataIO.h"
 
 #include <madym/utils/mdm_ProgramLogger.h>
 #include <madym/dwi/mdm_DWIModelGenerator.h>
 #include <madym/utils/mdm_exception.h>
+#include <madym/utils/mdm_ThreadPool.h>
 
 namespace fs = boost::filesystem;
 
 //
 MDM_API mdm_RunTools_madym_DWI_lite::mdm_RunTools_madym_DWI_lite()
+	:
+	arrays_(NULL)
 {
 }
 
@@ -32,7 +36,7 @@ MDM_API mdm_RunTools_madym_DWI_lite::~mdm_RunTools_madym_DWI_lite()
 MDM_API void mdm_RunTools_madym_DWI_lite::run()
 {
 	//Check required fields are set
-	if (options_.inputDataFile().empty())
+	if (!arrays_ && options_.inputDataFile().empty())
     throw mdm_exception(__func__, "input data file (option --data) must be provided");
 	
 	const int &nSignals = options_.nDWIInputs();
@@ -45,59 +49,66 @@ MDM_API void mdm_RunTools_madym_DWI_lite::run()
 	//Parse DWI model from string, will abort if model type not recognised
 	auto modelType = mdm_DWIModelGenerator::parseModelName(options_.DWImodel());
 
-	//Instantiate DWI fitter of desired type
-	auto DWIFitter = mdm_DWIModelGenerator::createFitter(modelType, options_.BvalsThresh());
+	//Instantiate a DWI fitter of desired type for each thread
+	const auto nThreads = mdm_ThreadPool::numThreads(options_.nThreads(), size_t(-1));
+	std::vector<std::unique_ptr<mdm_DWIFitterBase> > DWIFitters(nThreads);
+	for (auto &DWIFitter : DWIFitters)
+		DWIFitter = mdm_DWIModelGenerator::createFitter(modelType, options_.BvalsThresh(), options_.IVIMRestartTol());
 
 	//Check number of inputs is valid
-	if (nSignals < DWIFitter->minimumInputs())
+	if (nSignals < DWIFitters[0]->minimumInputs())
 		throw mdm_exception(__func__, "not enough signal inputs for DWI model " + options_.DWImodel());
 
-	else if (nSignals > DWIFitter->maximumInputs())
+	else if (nSignals > DWIFitters[0]->maximumInputs())
 		throw mdm_exception(__func__, "too many signal inputs for DWI model " + options_.DWImodel());
 
-	//Set up output path and output file
-	set_up_output_folder();
+	const size_t numInputs = DWIFitters[0]->numInputValues(nSignals);
 
-	std::string outputDataFile = outputPath_.string() + "/" +
-		options_.DWImodel() + "_" + options_.outputName();
+	//Open the input data (B-values and signals), from the in-memory arrays if set, otherwise
+	//from file, and the output data
+	std::unique_ptr<mdm_LiteDataIO::Reader> inputData;
+	std::unique_ptr<mdm_LiteDataIO::Writer> outputData;
+	if (arrays_)
+	{
+		if (arrays_->numInputColumns != numInputs)
+			throw mdm_exception(__func__, boost::format(
+				"input data has %1% columns, expected %2%") % arrays_->numInputColumns % numInputs);
+		inputData.reset(new mdm_LiteDataIO::Reader(arrays_->inputs, arrays_->numRows, numInputs));
+		outputData.reset(new mdm_LiteDataIO::Writer(arrays_->outputs));
+	}
+	else
+	{
+		//Set up output path and output file
+		set_up_output_folder();
 
-	//Open the input data (FA and signals) file
-	std::ifstream inputData(options_.inputDataFile(), std::ios::in);
-	if (!inputData.is_open())
-    throw mdm_exception(__func__, "Error opening input data file, Check it exists");
-	
-	//Open up an output file
-	std::ofstream outputData(outputDataFile, std::ios::out);
-	if (!outputData.is_open())
-    throw mdm_exception(__func__, "Error opening ouput data file");
+		std::string outputDataFile = outputPath_.string() + "/" +
+			options_.DWImodel() + "_" + options_.outputName();
 
-	int row_counter = 0;
-	
-	//Loop through the file, reading in each line
-	while (!inputData.eof())
+		auto dataFormat = mdm_LiteDataIO::formatFromString(options_.dataFormat());
+		inputData.reset(new mdm_LiteDataIO::Reader(options_.inputDataFile(), dataFormat, numInputs));
+		outputData.reset(new mdm_LiteDataIO::Writer(outputDataFile, dataFormat));
+	}
+
+	//Fit the model to each row, in parallel, writing output in input order
+	auto row_counter = mdm_LiteDataIO::processRows(*inputData, NULL, *outputData,
+		nThreads, [&](size_t i_t, const std::vector<double> &inputs,
+			const std::vector<double> &, std::vector<double> &outputs)
 	{
-		//Get fitter to munch line of inputs from datastream, if EOF reached break
-		if (!DWIFitter->setInputsFromStream(inputData, nSignals))
-			break;
+		//Set the inputs, fit DWI model and write to output
+		auto &DWIFitter = *DWIFitters[i_t];
+		DWIFitter.setInputsFromRow(inputs, nSignals);
 
-		//If valid inputs, fit DWI model and write to output stream
-		std::vector<double> params;
 		double ssr;
-		int errCode = DWIFitter->fitModel(params, ssr);
-
-		for (auto p : params)
-			outputData << p << " ";
-		outputData << ssr << " " << errCode << std::endl;
-
-		row_counter++;
-		if (!options_.quiet() && !fmod(row_counter, 1000))
-			std::cout << "Processed sample " << row_counter << std::endl;
+		int errCode = DWIFitter.fitModel(outputs, ssr);
 
-	}
+		outputs.push_back(ssr);
+		outputs.push_back(errCode);
+	}, options_.quiet(), "sample");
 
-	//Close the input and output file
-	inputData.close();
-	outputData.close();
+	//Close the output file
+	outputData->close();
+	if (arrays_)
+		arrays_->numOutputColumns = outputData->numColumns();
 
   if (!options_.quiet())
   {
@@ -113,10 +124,13 @@ MDM_API int mdm_RunTools_madym_DWI_lite::parseInputs(int argc, const char *argv[
 	options_parser_.add_option(config_options, options_.help);
 	options_parser_.add_option(config_options, options_.version);
 	options_parser_.add_option(config_options, options_.dataDir);
+	options_parser_.add_option(config_options, options_.nThreads);
 	options_parser_.add_option(config_options, options_.inputDataFile);
+	options_parser_.add_option(config_options, options_.dataFormat);
 	options_parser_.add_option(config_options, options_.DWImodel);
 	options_parser_.add_option(config_options, options_.nDWIInputs);
 	options_parser_.add_option(config_options, options_.BvalsThresh);
+	options_parser_.add_option(config_options, options_.IVIMRestartTol);
 	
 	options_parser_.add_option(config_options, options_.outputDir);
 	options_parser_.add_option(config_options, options_.outputName);
@@ -134,6 +148,22 @@ MDM_API std::string mdm_RunTools_madym_DWI_lite::who() const
 {
 	return "madym_DWI_lite";
 }
+
+//
+MDM_API void mdm_RunTools_madym_DWI_lite::runArrays(mdm_LiteDataIO::Arrays &arrays)
+{
+	arrays_ = &arrays;
+	try
+	{
+		run();
+	}
+	catch (...)
+	{
+		arrays_ = NULL;
+		throw;
+	}
+	arrays_ = NULL;
+}
 //*******************************************************************************
 // Private:
 //*******************************************************************************
@@ -9,6 +9,7 @@
 #define MDM_RUNTOOLS_MADYM_DWI_LITE_HDR
 #include <madym/utils/mdm_api.h>
 #include <madym/run/mdm_RunTools.h>
+#include <madym/run/mdm_LiteDataIO.h>
 
 //! Class to run the lite version of the DWI models tool
 /*!
@@ -44,6 +45,15 @@ public:
 	\return name of the tool 
   */
   MDM_API std::string who() const;
+
+	//! Run the lite version of DWI modelling on in-memory data, rather than data files
+	/*!
+	parseInputs must be called first. The input data are read from the arrays instead of the
+	input data file, and no output folder or file is created.
+	Throws mdm_exception if errors encountered
+	\param arrays input data, and output data filled by the analysis
+	*/
+	MDM_API void runArrays(mdm_LiteDataIO::Arrays &arrays);
 	
 protected:
   //! Runs the lite version of DWI modelling
@@ -51,7 +61,8 @@ protected:
   1. Parses and validates input options
   2. Sets specified DWI method
   3. Opens input data file
-  4. Processes each line in input data file, fitting DWI model to input signals, writing fitted parameters values to output file
+  4. Processes each line in input data file, fitting DWI model to input signals, writing fitted parameters values to output file. Lines are read in
+  chunks, processed in parallel if more than one thread is set, and written in input order
   5. Closes input/output file and reports the number of samples processed.
   
   Throws mdm_exception if errors encountered
@@ -59,7 +70,9 @@ protected:
   MDM_API void run();
 
 private:
-
+	//Variables:
+	//In-memory data, set while running from runArrays
+	mdm_LiteDataIO::Arrays *arrays_;
 };
 
 #endif
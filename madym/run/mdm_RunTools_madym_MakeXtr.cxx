@@ -171,9 +171,15 @@ void mdm_RunTools_madym_MakeXtr::makeT1InputXtr()
   switch (methodType)
   {
   case mdm_T1MethodGenerator::VFA:; //fall through
-  case mdm_T1MethodGenerator::VFA_B1:
+  case mdm_T1MethodGenerator::VFA_B1:; //fall through
+  case mdm_T1MethodGenerator::VFA_DICT:; //fall through
+  case mdm_T1MethodGenerator::VFA_B1_DICT:; //fall through
+  case mdm_T1MethodGenerator::VFA_LINEAR:; //fall through
+  case mdm_T1MethodGenerator::VFA_B1_LINEAR:
     makeVFAXtr(); break;
-  case mdm_T1MethodGenerator::IR: makeIRXtr(); break;
+  case mdm_T1MethodGenerator::IR:; //fall through
+  case mdm_T1MethodGenerator::IR_DICT:
+    makeIRXtr(); break;
   default:
     throw mdm_exception(__func__, "T1 method not recognised");
   }
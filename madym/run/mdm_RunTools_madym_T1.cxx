@@ -56,6 +56,7 @@ MDM_API void mdm_RunTools_madym_T1::run()
 	//Write output
 	fileManager_.saveGeneralOutputMaps(outputPath_.string());
 	fileManager_.saveT1OutputMaps(outputPath_.string());
+	fileManager_.waitForWrites();
 
   //Reset the volume analysis
   volumeAnalysis_.reset();
@@ -87,6 +88,10 @@ MDM_API int mdm_RunTools_madym_T1::parseInputs(int argc, const char *argv[])
 	options_parser_.add_option(config_options, options_.B1Name);
 	options_parser_.add_option(config_options, options_.TR);
 	options_parser_.add_option(config_options, options_.T1InitialParams);
+	options_parser_.add_option(config_options, options_.T1ClosedFormInit);
+	options_parser_.add_option(config_options, options_.T1DictRefine);
+	options_parser_.add_option(config_options, options_.T1LinearRefineTol);
+	options_parser_.add_option(config_options, options_.nThreads);
 
 	//General output options_
 	options_parser_.add_option(config_options, options_.outputRoot);
@@ -99,6 +104,8 @@ MDM_API int mdm_RunTools_madym_T1::parseInputs(int argc, const char *argv[])
 	options_parser_.add_option(config_options, options_.niftiScaling);
 	options_parser_.add_option(config_options, options_.nifti4D);
 	options_parser_.add_option(config_options, options_.useBIDS);
+	options_parser_.add_option(config_options, options_.writeThreads);
+	options_parser_.add_option(config_options, options_.compressionThreads);
 
 	//Logging options_
 	options_parser_.add_option(config_options, options_.voxelSizeWarnOnly);
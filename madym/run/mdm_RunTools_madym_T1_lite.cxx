@@ -11,15 +11,19 @@
 #endif // !MDM_API_EXPORTS
 
 #include "mdm_RunTools_madym_T1_lite.h"
+#include "mdm_LiteDataIO.h"
 
 #include <madym/utils/mdm_ProgramLogger.h>
 #include <madym/t1/mdm_T1MethodGenerator.h>
 #include <madym/utils/mdm_exception.h>
+#include <madym/utils/mdm_ThreadPool.h>
 
 namespace fs = boost::filesystem;
 
 //
 MDM_API mdm_RunTools_madym_T1_lite::mdm_RunTools_madym_T1_lite()
+	:
+	arrays_(NULL)
 {
 }
 
@@ -32,7 +36,7 @@ MDM_API mdm_RunTools_madym_T1_lite::~mdm_RunTools_madym_T1_lite()
 MDM_API void mdm_RunTools_madym_T1_lite::run()
 {
 	//Check required fields are set
-	if (options_.inputDataFile().empty())
+	if (!arrays_ && options_.inputDataFile().empty())
     throw mdm_exception(__func__, "input data file (option --data) must be provided");
 	
 	const int &nSignals = options_.nT1Inputs();
@@ -48,55 +52,63 @@ MDM_API void mdm_RunTools_madym_T1_lite::run()
 	//Parse T1 method from string, will abort if method type not recognised
 	auto methodType = mdm_T1MethodGenerator::parseMethodName(options_.T1method(), options_.B1Correction());
 
-	//Instantiate T1 fitter of desired type
-	auto T1Fitter = mdm_T1MethodGenerator::createFitter(methodType, options_);
+	//Instantiate a T1 fitter of desired type for each thread
+	const auto nThreads = mdm_ThreadPool::numThreads(options_.nThreads(), size_t(-1));
+	std::vector<std::unique_ptr<mdm_T1FitterBase> > T1Fitters(nThreads);
+	for (auto &T1Fitter : T1Fitters)
+		T1Fitter = mdm_T1MethodGenerator::createFitter(methodType, options_);
 
 	//Check number of inputs is valid
 	checkNumInputs(methodType, nSignals);
+	const size_t numInputs = T1Fitters[0]->numInputValues(nSignals);
 
-	//Set up output path and output file
-	set_up_output_folder();
+	//Open the input data (FA and signals), from the in-memory arrays if set, otherwise
+	//from file, and the output data
+	std::unique_ptr<mdm_LiteDataIO::Reader> inputData;
+	std::unique_ptr<mdm_LiteDataIO::Writer> outputData;
+	if (arrays_)
+	{
+		if (arrays_->numInputColumns != numInputs)
+			throw mdm_exception(__func__, boost::format(
+				"input data has %1% columns, expected %2%") % arrays_->numInputColumns % numInputs);
+		inputData.reset(new mdm_LiteDataIO::Reader(arrays_->inputs, arrays_->numRows, numInputs));
+		outputData.reset(new mdm_LiteDataIO::Writer(arrays_->outputs));
+	}
+	else
+	{
+		//Set up output path and output file
+		set_up_output_folder();
 
-	std::string outputDataFile = outputPath_.string() + "/" +
-		options_.T1method() + "_" + options_.outputName();
+		std::string outputDataFile = outputPath_.string() + "/" +
+			options_.T1method() + "_" + options_.outputName();
 
-	//Open the input data (FA and signals) file
-	std::ifstream inputData(options_.inputDataFile(), std::ios::in);
-	if (!inputData.is_open())
-    throw mdm_exception(__func__, "Error opening input data file, Check it exists");
-	
-	//Open up an output file
-	std::ofstream outputData(outputDataFile, std::ios::out);
-	if (!outputData.is_open())
-    throw mdm_exception(__func__, "Error opening ouput data file");
+		auto dataFormat = mdm_LiteDataIO::formatFromString(options_.dataFormat());
+		inputData.reset(new mdm_LiteDataIO::Reader(options_.inputDataFile(), dataFormat, numInputs));
+		outputData.reset(new mdm_LiteDataIO::Writer(outputDataFile, dataFormat));
+	}
 
-	int row_counter = 0;
-	
-	//Loop through the file, reading in each line
-	while (!inputData.eof())
+	//Fit T1 to each row, in parallel, writing output in input order
+	auto row_counter = mdm_LiteDataIO::processRows(*inputData, NULL, *outputData,
+		nThreads, [&](size_t i_t, const std::vector<double> &inputs,
+			const std::vector<double> &, std::vector<double> &outputs)
 	{
-		//Get fitter to munch line of inputs from datastream, if EOF reached break
-		if (!T1Fitter->setInputsFromStream(inputData, nSignals))
-			break;
+		//Set the inputs, fit T1 and write to output
+		auto &T1Fitter = *T1Fitters[i_t];
+		T1Fitter.setInputsFromRow(inputs, nSignals);
 
-		//If valid inputs, fit T1 and write to output stream
 		double T1, M0, EW;
-		int errCode = T1Fitter->fitT1(T1, M0, EW);
-
-		outputData <<
-			T1 << " " <<
-			M0 << " " <<
-			errCode << std::endl;
+		int errCode = T1Fitter.fitT1(T1, M0, EW);
 
-		row_counter++;
-		if (!options_.quiet() && !fmod(row_counter, 1000))
-			std::cout << "Processed sample " << row_counter << std::endl;
-
-	}
+		outputs.resize(3);
+		outputs[0] = T1;
+		outputs[1] = M0;
+		outputs[2] = errCode;
+	}, options_.quiet(), "sample");
 
-	//Close the input and output file
-	inputData.close();
-	outputData.close();
+	//Close the output file
+	outputData->close();
+	if (arrays_)
+		arrays_->numOutputColumns = outputData->numColumns();
 
   if (!options_.quiet())
   {
@@ -113,11 +125,16 @@ MDM_API int mdm_RunTools_madym_T1_lite::parseInputs(int argc, const char *argv[]
 	options_parser_.add_option(config_options, options_.version);
 
 	options_parser_.add_option(config_options, options_.dataDir);
+	options_parser_.add_option(config_options, options_.nThreads);
 	options_parser_.add_option(config_options, options_.inputDataFile);
+	options_parser_.add_option(config_options, options_.dataFormat);
 	options_parser_.add_option(config_options, options_.T1method);
 	options_parser_.add_option(config_options, options_.FA);
 	options_parser_.add_option(config_options, options_.TR);
 	options_parser_.add_option(config_options, options_.T1InitialParams);
+	options_parser_.add_option(config_options, options_.T1ClosedFormInit);
+	options_parser_.add_option(config_options, options_.T1DictRefine);
+	options_parser_.add_option(config_options, options_.T1LinearRefineTol);
 	options_parser_.add_option(config_options, options_.B1Correction);
 	options_parser_.add_option(config_options, options_.T1noiseThresh);
 	options_parser_.add_option(config_options, options_.nT1Inputs);
@@ -137,6 +154,22 @@ MDM_API std::string mdm_RunTools_madym_T1_lite::who() const
 {
 	return "madym_T1_lite";
 }
+
+//
+MDM_API void mdm_RunTools_madym_T1_lite::runArrays(mdm_LiteDataIO::Arrays &arrays)
+{
+	arrays_ = &arrays;
+	try
+	{
+		run();
+	}
+	catch (...)
+	{
+		arrays_ = NULL;
+		throw;
+	}
+	arrays_ = NULL;
+}
 //*******************************************************************************
 // Private:
 //*******************************************************************************
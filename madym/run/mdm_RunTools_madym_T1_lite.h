@@ -9,6 +9,7 @@
 #define MDM_RUNTOOLS_MADYM_T1_LITE_HDR
 #include <madym/utils/mdm_api.h>
 #include <madym/run/mdm_RunToolsT1Fit.h>
+#include <madym/run/mdm_LiteDataIO.h>
 
 //! Class to run the lite version of the T1 mapping tool
 /*!
@@ -44,6 +45,15 @@ public:
 	\return name of the tool 
   */
   MDM_API std::string who() const;
+
+	//! Run the lite version of T1 mapping on in-memory data, rather than data files
+	/*!
+	parseInputs must be called first. The input data are read from the arrays instead of the
+	input data file, and no output folder or file is created.
+	Throws mdm_exception if errors encountered
+	\param arrays input data, and output data filled by the analysis
+	*/
+	MDM_API void runArrays(mdm_LiteDataIO::Arrays &arrays);
 	
 protected:
   //! Runs the lite version of T1 mapping
@@ -51,7 +61,8 @@ protected:
   1. Parses and validates input options
   2. Sets specified T1 method
   3. Opens input data file
-  4. Processes each line in input data file, mapping T1 from input signals, writing T1 and M0 values to output file
+  4. Processes each line in input data file, mapping T1 from input signals, writing T1 and M0 values to output file. Lines are read in
+  chunks, processed in parallel if more than one thread is set, and written in input order
   5. Closes input/output file and reports the number of samples processed.
   
   Throws mdm_exception if errors encountered
@@ -59,7 +70,9 @@ protected:
   MDM_API void run();
 
 private:
-
+	//Variables:
+	//In-memory data, set while running from runArrays
+	mdm_LiteDataIO::Arrays *arrays_;
 };
 
 #endif
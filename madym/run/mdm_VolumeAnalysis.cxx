@@ -18,10 +18,12 @@
 #include <sstream> // stringstream
 #include <algorithm>
 #include <numeric>
+#include <mutex>
 #include <boost/format.hpp>
 
 #include <madym/utils/mdm_exception.h>
 #include <madym/utils/mdm_ProgramLogger.h>
+#include <madym/utils/mdm_ThreadPool.h>
 #include <madym/dce/mdm_AIF.h>
 
 //Names of output maps
@@ -52,7 +54,9 @@ MDM_API mdm_VolumeAnalysis::mdm_VolumeAnalysis()
   firstImage_(0),
   lastImage_(0),
 	maxIterations_(0),
-  model_(NULL)
+	repeatPruning_(false),
+  model_(NULL),
+  numThreads_(1)
 {
 	setIAUCtimes({ 60.0, 90.0, 120.0 }, true, false);
 }
@@ -69,6 +73,8 @@ MDM_API void mdm_VolumeAnalysis::reset()
   StDataMaps_.clear();
   CtDataMaps_.clear();
   CtModelMaps_.clear();
+  dynamicSeries_.reset();
+  resetConvertedCt();
   dynamicTimes_.clear();
   noiseVar_.clear();
   dynamicMetaData_.reset();
@@ -175,6 +181,8 @@ MDM_API void mdm_VolumeAnalysis::addStDataMap(const mdm_Image3D dynImg)
 
 	//Add the image to the list
 	StDataMaps_.push_back(dynImg);
+  dynamicSeries_.reset();
+  resetConvertedCt();
 
   //First map we add, set the reference image
   if (!dynamicMetaData_)
@@ -297,6 +305,7 @@ MDM_API void mdm_VolumeAnalysis::addCtDataMap(const mdm_Image3D ctMap)
 
 	//Add the image to the list
 	CtDataMaps_.push_back(ctMap);
+  dynamicSeries_.reset();
 
   //First map we add, set the reference image
   if (!dynamicMetaData_)
@@ -356,6 +365,25 @@ MDM_API const std::vector<mdm_Image3D> & mdm_VolumeAnalysis::CtModelMaps() const
   return CtModelMaps_;
 }
 
+//
+MDM_API void mdm_VolumeAnalysis::packDynamics()
+{
+  //Without an ROI, packing would hold a second copy of the whole dynamic series, so
+  //voxels are read from the dynamic maps instead
+  dynamicSeries_.reset();
+  if (!ROI_)
+    return;
+
+  const auto &dynMaps = StDataMaps_.empty() ? CtDataMaps_ : StDataMaps_;
+  dynamicSeries_.pack(dynMaps, getVoxelsToFit());
+}
+
+//
+MDM_API const mdm_DynamicSeries& mdm_VolumeAnalysis::dynamicSeries() const
+{
+  return dynamicSeries_;
+}
+
 //
 MDM_API mdm_Image3D mdm_VolumeAnalysis::DCEMap(const std::string &mapName) const
 {
@@ -580,6 +608,18 @@ MDM_API void mdm_VolumeAnalysis::setMaxIterations(int maxItr)
 	maxIterations_ = maxItr;
 }
 
+//
+MDM_API void mdm_VolumeAnalysis::setRepeatPruning(bool prune)
+{
+	repeatPruning_ = prune;
+}
+
+//
+MDM_API void mdm_VolumeAnalysis::setNumThreads(int nThreads)
+{
+  numThreads_ = nThreads;
+}
+
 //
 MDM_API void mdm_VolumeAnalysis::setInitMapParams(const std::vector<int> &params)
 {
@@ -596,9 +636,15 @@ MDM_API void  mdm_VolumeAnalysis::fitDCEModel(
   //
   initialiseParameterMaps(*model_);
 
+  //Convert signal to concentration for the whole volume
+  convertStToCt();
+
   //Fit the model
   fitModel(*model_, optimiseModel);
 
+  //The converted concentration depends on the current T1 maps and settings,
+  //so is only kept for this fit
+  resetConvertedCt();
 }
 
 //------------------------------------------------------------------
@@ -690,10 +736,122 @@ void mdm_VolumeAnalysis::initialiseParameterMaps(
   createMap(enhVoxMap_);
 }
 
+//
+void mdm_VolumeAnalysis::convertStToCt()
+{
+  resetConvertedCt();
+  if (!computeCt_ || StDataMaps_.empty())
+    return;
+
+  if (!dynamicMetaData_)
+    throw mdm_exception(__func__,
+      "Attempting to convert to signal with no dynamic meta data set (eg TR, FA)");
+
+  const auto TR = dynamicMetaData_->TR.value();
+  const auto FA = dynamicMetaData_->flipAngle.value();
+  const auto nTimes = numSt();
+  const auto numImageVoxels = StDataMaps_[0].numVoxels();
+
+  //Read baseline T1, M0 and B1 of each voxel into arrays
+  const auto selectedVoxels = getVoxelsToFit();
+  const auto numVoxels = selectedVoxels.size();
+  std::vector<double> T1s(numVoxels), M0s(numVoxels, 0.0), B1s(numVoxels, 1.0);
+  for (size_t i = 0; i < numVoxels; i++)
+  {
+    T1s[i] = T1Mapper_.T1(selectedVoxels[i]);
+    if (!useM0Ratio_)
+      M0s[i] = T1Mapper_.M0(selectedVoxels[i]);
+    if (useB1correction_)
+      B1s[i] = T1Mapper_.B1(selectedVoxels[i]);
+  }
+
+  //Without B1 correction, the flip-angle is the same in every voxel
+  const auto PI = acos(-1.0);
+  const double sinFA = sin(FA * PI / 180);
+  const double cosFA = cos(FA * PI / 180);
+
+  CtSignalSeries_.allocate(nTimes, numImageVoxels,
+    ROI_ ? selectedVoxels : std::vector<size_t>());
+  CtSignalStatus_.assign(numImageVoxels, mdm_DCEVoxel::OK);
+
+  //Each voxel writes only to its own time-series, status and location in the error
+  //map, so threads can claim chunks of voxels without further synchronisation
+  auto convert_start = std::chrono::system_clock::now();
+  const auto nThreads = mdm_ThreadPool::numThreads(numThreads_, numVoxels);
+  const size_t chunkSize = 256;
+  mdm_ThreadPool::WorkQueue voxelQueue(numVoxels, chunkSize);
+  mdm_ThreadPool::run(nThreads, [&](size_t)
+  {
+    std::vector<double> St;
+    size_t begin, end;
+    while (voxelQueue.next(begin, end))
+    {
+      for (size_t i = begin; i < end; i++)
+      {
+        const auto voxelIndex = selectedVoxels[i];
+
+        //Signals are read in place if packed as double, otherwise copied
+        const double *voxelSt;
+        if (dynamicSeries_.contains(voxelIndex) &&
+          dynamicSeries_.storageType() == mdm_Image3D::STORAGE_DOUBLE)
+          voxelSt = dynamicSeries_.voxelData(voxelIndex);
+        else
+        {
+          voxelStData(voxelIndex, St);
+          voxelSt = St.data();
+        }
+
+        double voxelSinFA = sinFA;
+        double voxelCosFA = cosFA;
+        if (useB1correction_)
+        {
+          voxelSinFA = sin(B1s[i] * FA * PI / 180);
+          voxelCosFA = cos(B1s[i] * FA * PI / 180);
+        }
+
+        auto status = mdm_DCEVoxel::signalToConcentration(
+          voxelSt, CtSignalSeries_.voxelData(voxelIndex), nTimes,
+          T1s[i], M0s[i], voxelCosFA, voxelSinFA, TR, r1Const_, prebolusImage_, firstImage_);
+
+        CtSignalStatus_[voxelIndex] = status;
+        setVoxelErrors(voxelIndex, status);
+      }
+    }
+  }, &voxelQueue);
+
+  std::chrono::duration<double> elapsed_seconds = std::chrono::system_clock::now() - convert_start;
+  mdm_ProgramLogger::logProgramMessage((boost::format(
+    "Converted S(t) to C(t) in %1% voxels in %2%s%3%")
+    % numVoxels % elapsed_seconds.count()
+    % (nThreads > 1 ? " using " + std::to_string(nThreads) + " threads" : "")).str());
+}
+
+//
+void mdm_VolumeAnalysis::resetConvertedCt()
+{
+  CtSignalSeries_.reset();
+  CtSignalStatus_.clear();
+}
+
 //
 mdm_DCEVoxel mdm_VolumeAnalysis::setUpVoxel(size_t voxelIndex) const
 {
   std::vector<double> St, Ct;
+
+  //If the whole volume has been converted to concentration, use the converted values
+  if (computeCt_ && CtSignalSeries_.contains(voxelIndex))
+  {
+    CtSignalSeries_.voxelData(voxelIndex, Ct);
+    return mdm_DCEVoxel(
+      std::move(St),//dynSignals
+      std::move(Ct),//dynConc
+      prebolusImage_,//bolus_time
+      dynamicTimes_,//dynamicTimings
+      IAUCTMinutes_,
+      IAUCAtPeak_,//IAUC_times
+      CtSignalStatus_[voxelIndex]);
+  }
+
   if (computeCt_)
     voxelStData(voxelIndex, St);
 
@@ -701,8 +859,8 @@ mdm_DCEVoxel mdm_VolumeAnalysis::setUpVoxel(size_t voxelIndex) const
     voxelCtData(voxelIndex, Ct);
 
   mdm_DCEVoxel vox(
-    St,//dynSignals
-    Ct,//dynConc
+    std::move(St),//dynSignals
+    std::move(Ct),//dynConc
     prebolusImage_,//bolus_time
     dynamicTimes_,//dynamicTimings
     IAUCTMinutes_,
@@ -731,6 +889,12 @@ mdm_DCEVoxel mdm_VolumeAnalysis::setUpVoxel(size_t voxelIndex) const
 //
 void  mdm_VolumeAnalysis::voxelStData(size_t voxelIndex, std::vector<double> &data) const
 {
+  if (dynamicSeries_.contains(voxelIndex))
+  {
+    dynamicSeries_.voxelData(voxelIndex, data);
+    return;
+  }
+
 	size_t n = numSt();
 
 	data.resize(n);
@@ -741,6 +905,13 @@ void  mdm_VolumeAnalysis::voxelStData(size_t voxelIndex, std::vector<double> &da
 //
 void  mdm_VolumeAnalysis::voxelCtData(size_t voxelIndex, std::vector<double> &data) const
 {
+  //Packed series only holds C(t) if it is the input (ie no signal maps set)
+  if (StDataMaps_.empty() && dynamicSeries_.contains(voxelIndex))
+  {
+    dynamicSeries_.voxelData(voxelIndex, data);
+    return;
+  }
+
 	size_t n = CtDataMaps_.size();
 
 	data.resize(n);
@@ -761,8 +932,13 @@ void  mdm_VolumeAnalysis::voxelCtModel(size_t voxelIndex, std::vector<double> &d
 //
 void mdm_VolumeAnalysis::setVoxelErrors(size_t voxelIndex, const mdm_DCEVoxel &vox)
 {
-	//
-  auto status = vox.status();
+  setVoxelErrors(voxelIndex, vox.status());
+}
+
+//
+void mdm_VolumeAnalysis::setVoxelErrors(size_t voxelIndex,
+  const mdm_DCEVoxel::mdm_DCEVoxelStatus status)
+{
   if (status == mdm_DCEVoxel::CA_NAN)
     errorTracker_.updateVoxel(voxelIndex, mdm_ErrorTracker::CA_IS_NAN);
 
@@ -884,72 +1060,138 @@ void mdm_VolumeAnalysis::logProgress(
     
 }
 
+//
+bool mdm_VolumeAnalysis::fitVoxel(size_t voxelIndex,
+  mdm_DCEModelBase &model, mdm_DCEModelFitter &modelFitter,
+  bool optimiseModel, int &numErrors)
+{
+  //If compute Ct from signal, skip voxels with invalid T1    
+  if (computeCt_ && T1Mapper_.T1(voxelIndex) <= 0.0)
+    return false;
+
+  //Check if we've got parameter maps with values to initialise each voxel
+  //if not the existing values set in the model will be used
+  if (!initMapParams_.empty())
+    initialiseModelParams(voxelIndex, model);
+
+  //Set up the DCE voxel object
+  mdm_DCEVoxel vox(setUpVoxel(voxelIndex));
+
+  //Compute IAUC
+  vox.computeIAUC();
+
+  //Run an initial fit (does not optimise parameters, but
+  //sets bounds on model parameters, and compute the model residual
+  //for the initial model parameters
+  modelFitter.initialiseModelFit(vox.CtData());
+
+  //Test enhancement
+  if (testEnhancement_)
+    vox.testEnhancing();
+
+  //Set values that don't depend on model fitting
+  setVoxelPreFit(voxelIndex, vox, modelFitter);
+
+  //The main event: If optimising the model fit, do so now
+  if (optimiseModel)
+    modelFitter.fitModel(vox.status());
+
+  //Set all the necessary values in the output maps
+  setVoxelPostFit(voxelIndex, model, vox, modelFitter, numErrors);
+
+  return true;
+}
+
 //
 void  mdm_VolumeAnalysis::fitModel(
   mdm_DCEModelBase &model,
   bool optimiseModel)
 {
-  //Create a new fitter object
-  mdm_DCEModelFitter modelFitter(
-    model,
-    firstImage_,
-    lastImage_ ? lastImage_ : numDynamics(),
-    noiseVar_,
-    optimisationType_,
-    maxIterations_
-  );
-
   // Get list of voxels to fit
   std::vector<size_t> selectedVoxels = getVoxelsToFit();
   auto numVoxels = selectedVoxels.size();
 	double numProcessed = 0;
 	int numErrors = 0;
   pctTarget_ = 10;
-  bool paramMapsInitialised = !initMapParams_.empty();
+  auto nThreads = mdm_ThreadPool::numThreads(numThreads_, numVoxels);
+  auto timepointN = lastImage_ ? lastImage_ : numDynamics();
 
   //Away we go...
   mdm_ProgramLogger::logProgramMessage(
-    "Fitting " + modelType() + " to " + std::to_string(numVoxels) + " voxels");
+    "Fitting " + modelType() + " to " + std::to_string(numVoxels) + " voxels"
+    + (nThreads > 1 ? " using " + std::to_string(nThreads) + " threads" : ""));
 	auto fit_start = std::chrono::system_clock::now();
-  for(const auto voxelIndex : selectedVoxels)
+  if (nThreads == 1)
   {
-    //If compute Ct from signal, skip voxels with invalid T1    
-    if (computeCt_ && T1Mapper_.T1(voxelIndex) <= 0.0)
-      continue;
-    
-    //Check if we've got parameter maps with values to initialise each voxel
-    //if not the existing values set in the model will be used
-    if (paramMapsInitialised)
-      initialiseModelParams(voxelIndex, model);
-          
-    //Set up the DCE voxel object
-    mdm_DCEVoxel vox(setUpVoxel(voxelIndex));
-
-    //Compute IAUC
-    vox.computeIAUC();
-
-    //Run an initial fit (does not optimise parameters, but
-    //sets bounds on model parameters, and compute the model residual
-    //for the initial model parameters
-    modelFitter.initialiseModelFit(vox.CtData());
-
-    //Test enhancement
-    if (testEnhancement_)
-      vox.testEnhancing();
-      
-    //Set values that don't depend on model fitting
-    setVoxelPreFit(voxelIndex, vox, modelFitter);
-
-    //The main event: If optimising the model fit, do so now
-    if (optimiseModel)
-      modelFitter.fitModel(vox.status());
+    //Create a new fitter object
+    mdm_DCEModelFitter modelFitter(
+      model,
+      firstImage_,
+      timepointN,
+      noiseVar_,
+      optimisationType_,
+      maxIterations_
+    );
+    modelFitter.setRepeatPruning(repeatPruning_);
+
+    for (const auto voxelIndex : selectedVoxels)
+    {
+      if (fitVoxel(voxelIndex, model, modelFitter, optimiseModel, numErrors))
+        logProgress(numProcessed, double(numVoxels));
+    }
+  }
+  else
+  {
+    //Each thread fits its own copy of the model, bound to its own copy of the AIF, so
+    //that AIF resampling and model evaluation are independent across threads. Threads
+    //claim small chunks of voxels from a shared queue until all voxels are fitted. Each
+    //voxel writes only to its own location in the output maps, so only progress logging
+    //and the error count need guarding.
+    const size_t chunkSize = 16;
+    mdm_ThreadPool::WorkQueue voxelQueue(numVoxels, chunkSize);
+    std::mutex progressMutex;
+
+    mdm_ThreadPool::run(nThreads, [&](size_t) 
+    {
+      mdm_AIF threadAIF(model.AIF());
+      auto threadModel = model.clone(threadAIF);
+      mdm_DCEModelFitter threadFitter(
+        *threadModel,
+        firstImage_,
+        timepointN,
+        noiseVar_,
+        optimisationType_,
+        maxIterations_
+      );
+      threadFitter.setRepeatPruning(repeatPruning_);
+
+      int threadErrors = 0;
+      size_t begin, end;
+      while (voxelQueue.next(begin, end))
+      {
+        size_t numFitted = 0;
+        for (size_t i = begin; i < end; i++)
+        {
+          if (fitVoxel(selectedVoxels[i], *threadModel, threadFitter, optimiseModel, threadErrors))
+            numFitted++;
+        }
 
-    //Set all the necessary values in the output maps
-    setVoxelPostFit(voxelIndex, model, vox, modelFitter, numErrors);
+        std::lock_guard<std::mutex> lock(progressMutex);
+        for (size_t i = 0; i < numFitted; i++)
+          logProgress(numProcessed, double(numVoxels));
+      }
 
-		logProgress(numProcessed, double(numVoxels));
+      std::lock_guard<std::mutex> lock(progressMutex);
+      numErrors += threadErrors;
+    }, &voxelQueue);
   }
 
+  //Leave the model in the same state whether or not voxels were fitted on separate
+  //threads: reset to its initial parameters, and evaluated once so its AIF is resampled
+  //(eg so it can be written to file)
+  model.reset(timepointN);
+  model.computeCtModel(timepointN);
+
 	// Get end time and log results
 	auto fit_end = std::chrono::system_clock::now();
 	std::chrono::duration<double> elapsed_seconds = fit_end - fit_start;
@@ -12,6 +12,7 @@
 #include <madym/utils/mdm_Image3D.h>
 
 #include <madym/utils/mdm_ErrorTracker.h>
+#include <madym/utils/mdm_DynamicSeries.h>
 #include <madym/dce/mdm_DCEVoxel.h>
 #include <madym/dce/mdm_DCEModelBase.h>
 #include <madym/dce/mdm_DCEModelFitter.h>
@@ -185,6 +186,26 @@ public:
 	*/
 	MDM_API const std::vector<mdm_Image3D> &CtModelMaps() const;
 
+	//! Pack the input dynamic series in the ROI into voxel-major storage
+	/*!
+	Packs the input signal maps (or concentration maps if no signal maps set) at voxels in the
+	ROI, so that the time-series at each voxel is stored contiguously for model fitting. The
+	packed series is a copy, held as well as the dynamic maps (which are still needed for output
+	and by the AIF tool), so it is only worth its memory for an ROI smaller than the volume. If no
+	ROI is set nothing is packed. The series is packed as float if the dynamic maps are stored as
+	float. Should be called once all dynamic maps and the ROI are set. Adding
+	further dynamic maps clears the packed series. Voxels not packed are read directly from the 
+	dynamic maps.
+	*/
+	MDM_API void packDynamics();
+
+	//! Get packed dynamic series
+	/*!
+	\return voxel-major packed input dynamic series, empty if packDynamics not called or no ROI set
+	\see packDynamics
+	*/
+	MDM_API const mdm_DynamicSeries &dynamicSeries() const;
+
 	//! Return specified DCE-map given name
 	/*!
 	
@@ -336,6 +357,20 @@ public:
 	*/
 	MDM_API void setMaxIterations(int maxItr);
 
+	//! Set whether repeat fits that are unlikely to beat the best fit so far are stopped early
+	/*!
+	\param prune if true, prune repeat fits (off by default)
+	\see mdm_DCEModelFitter::setRepeatPruning
+	*/
+	MDM_API void setRepeatPruning(bool prune);
+
+  //! Set number of threads used to fit voxels
+  /*!
+  \param nThreads number of worker threads. If 1, voxels are fitted serially in the calling thread.
+  If 0, uses all available hardware threads. Fitted maps are identical whatever the number of threads.
+  */
+  MDM_API void setNumThreads(int nThreads);
+
   //! Set initial parameters loaded from maps
   /*!
   \param params indices of parameters set from initial maps
@@ -394,6 +429,22 @@ private:
   */
   void initialiseParameterMaps(const mdm_DCEModelBase &model);
 
+  //! Convert the dynamic signal series to concentration in all voxels to be fitted
+  /*!
+  Converts every voxel in one pass over the packed signal series, split across threads,
+  with each voxel's baseline T1, M0 and B1 read into arrays first. Concentration is stored
+  voxel-major in CtSignalSeries_, and each voxel's status in CtSignalStatus_ and the error
+  tracker. Does nothing if not computing concentration from signal.
+
+  CtSignalSeries_ is held in double alongside the signal maps, the concentration maps and any
+  packed signal series, adding 8 bytes per fitted voxel per time-point to peak memory until
+  resetConvertedCt is called after fitting.
+  */
+  void convertStToCt();
+
+  //! Clear concentration converted by convertStToCt
+  void resetConvertedCt();
+
   mdm_DCEVoxel setUpVoxel(size_t voxelIndex) const;
 
 
@@ -409,6 +460,8 @@ private:
 	*/
 	void setVoxelErrors(size_t voxelIndex, const mdm_DCEVoxel &p);
 
+  void setVoxelErrors(size_t voxelIndex, const mdm_DCEVoxel::mdm_DCEVoxelStatus status);
+
   /*!
   */
   void setVoxelPreFit(size_t voxelIndex,
@@ -433,6 +486,13 @@ private:
   */
   void logProgress(double &numProcessed, const double numVoxels);
 
+  /*!
+  Returns false if voxel skipped because it has invalid T1, true otherwise
+  */
+  bool fitVoxel(size_t voxelIndex,
+    mdm_DCEModelBase &model, mdm_DCEModelFitter &fitter,
+    bool optimiseModel, int &numErrors);
+
 	/*!
 	*/
 	void  fitModel(
@@ -454,6 +514,15 @@ private:
 	std::vector<mdm_Image3D> StDataMaps_;
 	std::vector<mdm_Image3D> CtDataMaps_;
   std::vector<mdm_Image3D> CtModelMaps_;
+
+  //Input dynamic series in the ROI, packed voxel-major for fast per-voxel access
+  mdm_DynamicSeries dynamicSeries_;
+
+  //Concentration converted from the input signal series for model fitting, packed
+  //voxel-major, and the conversion status of each voxel. Only held while fitting
+  mdm_DynamicSeries CtSignalSeries_;
+  std::vector<mdm_DCEVoxel::mdm_DCEVoxelStatus> CtSignalStatus_;
+
   std::vector<double> dynamicTimes_;
   std::vector<double> noiseVar_;
 	std::shared_ptr < mdm_DCEModelBase > model_;
@@ -509,6 +578,12 @@ private:
 	//Maximum number of iterations applied
 	int maxIterations_;
 
+	//Flag to stop repeat fits early that are unlikely to beat the best fit
+	bool repeatPruning_;
+
+  //Number of threads used to fit voxels
+  int numThreads_;
+
   //Counter to keep tracker of progress logging
   double pctTarget_;
 };
@@ -29,6 +29,24 @@ MDM_API mdm_T1FitterBase::~mdm_T1FitterBase()
 
 }
 
+//
+MDM_API void mdm_T1FitterBase::fitT1Batch(const double *inputs, const size_t nVoxels, const size_t nInputs,
+	double *T1values, double *M0values, double *EWvalues, mdm_ErrorTracker::ErrorCode *errCodes)
+{
+	for (size_t i = 0; i < nVoxels; i++)
+	{
+		batchInputs_.assign(inputs + i * nInputs, inputs + (i + 1) * nInputs);
+		setInputs(batchInputs_);
+		errCodes[i] = fitT1(T1values[i], M0values[i], EWvalues[i]);
+	}
+}
+
+//
+MDM_API int mdm_T1FitterBase::numInputValues(const int nSignals) const
+{
+	return 2 * nSignals;
+}
+
 //****************************************************************
 // Protected methods
 //****************************************************************
@@ -48,6 +48,22 @@ public:
 	*/
 	MDM_API virtual mdm_ErrorTracker::ErrorCode fitT1(double &T1value, double &M0value, double& EWvalue) = 0;
 
+	//! Fit T1 for a batch of voxels
+	/*!
+	The default implementation sets the inputs and fits T1 for each voxel in turn. Sub-classes
+	that can fit many voxels together should override this.
+
+	\param inputs inputs of each voxel, ordered as in setInputs, stored voxel by voxel
+	\param nVoxels number of voxels in the batch
+	\param nInputs number of inputs per voxel
+	\param T1values array of length nVoxels to hold computed T1
+	\param M0values array of length nVoxels to hold computed M0
+	\param EWvalues array of length nVoxels to hold computed efficiency weighting
+	\param errCodes array of length nVoxels to hold the error code of each voxel's fit
+	*/
+	MDM_API virtual void fitT1Batch(const double *inputs, const size_t nVoxels, const size_t nInputs,
+		double *T1values, double *M0values, double *EWvalues, mdm_ErrorTracker::ErrorCode *errCodes);
+
 	//! Set inputs for computing T1 from a single line of an input data stream buffer
 	/*!
 	All sub-classes must implement this method.
@@ -59,6 +75,23 @@ public:
 	MDM_API virtual bool setInputsFromStream(std::istream& ifs, 
 		const int nSignals) = 0;
 
+	//! Set inputs for computing T1 from a row of input data
+	/*!
+	All sub-classes must implement this method.
+
+	\param row input values, ordered as in a single line of an input data stream
+	\param nSignals number of signals in sample
+	*/
+	MDM_API virtual void setInputsFromRow(const std::vector<double> &row,
+		const int nSignals) = 0;
+
+	//! Return the number of input values in each sample (ie line of an input data stream)
+	/*!
+	\param nSignals number of signals in sample
+	\return number of input values, by default the signals and their acquisition parameters
+	*/
+	MDM_API virtual int numInputValues(const int nSignals) const;
+
 	//! Return minimum inputs required, must be implemented by derived subclass
 	/*
 	\return minimum number of input signals required for T1 fitting method
@@ -87,6 +120,9 @@ protected:
 	int maxIterations_;
 
 private:
+
+	//Inputs of the current voxel in the default batch fit
+	std::vector<double> batchInputs_;
 	
 };
 
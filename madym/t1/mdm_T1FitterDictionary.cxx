@@ -0,0 +1,473 @@
+/**
+*  @file    mdm_T1FitterDictionary.cxx
+*  @brief   Implementation of the mdm_T1FitterDictionary class
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_API_EXPORTS
+#define MDM_API_EXPORTS
+#endif // !MDM_API_EXPORTS
+
+#include "mdm_T1FitterDictionary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <madym/utils/mdm_exception.h>
+
+const size_t mdm_T1FitterDictionary::T1GridSize = 1000;
+const size_t mdm_T1FitterDictionary::T1SearchStride = 8;
+const double mdm_T1FitterDictionary::T1GridMin = 10.0;
+const double mdm_T1FitterDictionary::T1GridMax = 10000.0;
+const size_t mdm_T1FitterDictionary::B1GridSize = 101;
+const double mdm_T1FitterDictionary::B1GridMin = 0.5;
+const double mdm_T1FitterDictionary::B1GridMax = 1.5;
+const size_t mdm_T1FitterDictionary::EWGridSize = 21;
+const double mdm_T1FitterDictionary::EWGridMin = 0.5;
+
+namespace {
+	//Solve the n x n (n <= 3) system A x = b in place by Gaussian elimination with partial
+	//pivoting, returning false if A is singular
+	bool solveLinearSystem(double A[3][3], double b[3], const int n)
+	{
+		for (int c = 0; c < n; c++)
+		{
+			int pivot = c;
+			for (int r = c + 1; r < n; r++)
+				if (std::abs(A[r][c]) > std::abs(A[pivot][c]))
+					pivot = r;
+
+			if (!(std::abs(A[pivot][c]) > 0))
+				return false;
+
+			if (pivot != c)
+			{
+				for (int k = 0; k < n; k++)
+					std::swap(A[c][k], A[pivot][k]);
+				std::swap(b[c], b[pivot]);
+			}
+
+			for (int r = c + 1; r < n; r++)
+			{
+				const double f = A[r][c] / A[c][c];
+				for (int k = c; k < n; k++)
+					A[r][k] -= f * A[c][k];
+				b[r] -= f * b[c];
+			}
+		}
+		for (int c = n - 1; c >= 0; c--)
+		{
+			for (int k = c + 1; k < n; k++)
+				b[c] -= A[c][k] * b[k];
+			b[c] /= A[c][c];
+		}
+		return true;
+	}
+}
+
+//
+MDM_API mdm_T1FitterDictionary::mdm_T1FitterDictionary(SignalModel model,
+	const std::vector<double> &acquisitionParams, const double TR,
+	const bool extraDimension, const bool refine)
+	:
+	mdm_T1FitterBase(),
+	model_(model),
+	acquisitionParams_(acquisitionParams),
+	TR_(TR),
+	extraDimension_(extraDimension),
+	refine_(refine),
+	B1_(1.0),
+	nSlices_(extraDimension ? (model == VFA ? B1GridSize : EWGridSize) : 1),
+	dictTR_(0.0)
+{
+	//Log-spaced T1 grid
+	T1s_.resize(T1GridSize);
+	const double logStep = std::log(T1GridMax / T1GridMin) / (T1GridSize - 1);
+	for (size_t i = 0; i < T1GridSize; i++)
+		T1s_[i] = T1GridMin * std::exp(i * logStep);
+	dots_.resize(T1GridSize);
+
+	//If the acquisition parameters are known, compute the dictionary now, otherwise
+	//it is computed when they are set from the first input sample
+	if (!acquisitionParams_.empty())
+		buildDictionary();
+}
+
+//
+MDM_API mdm_T1FitterDictionary::~mdm_T1FitterDictionary()
+{
+
+}
+
+//
+MDM_API void mdm_T1FitterDictionary::setAcquisitionParams(const std::vector<double> &acquisitionParams)
+{
+	acquisitionParams_ = acquisitionParams;
+}
+
+//
+MDM_API void mdm_T1FitterDictionary::setTR(const double TR)
+{
+	TR_ = TR;
+}
+
+//
+MDM_API void mdm_T1FitterDictionary::setInputs(const std::vector<double> &inputs)
+{
+	if (inputs.size() < size_t(minimumInputs()))
+		throw mdm_exception(__func__, "Fewer input signals (" + std::to_string(inputs.size()) +
+			") than minimum required (" + std::to_string(minimumInputs()) + ")");
+
+	if (inputs.size() > size_t(maximumInputs()))
+		throw mdm_exception(__func__, "More input signals (" + std::to_string(inputs.size()) +
+			") than maximum allowed (" + std::to_string(maximumInputs()) + ")");
+
+	if (model_ == VFA && extraDimension_)
+	{
+		//First n-1 inputs are signals, last input is B1
+		signals_.assign(inputs.begin(), inputs.end() - 1);
+		B1_ = inputs.back();
+	}
+	else
+		signals_ = inputs;
+}
+
+//
+MDM_API mdm_ErrorTracker::ErrorCode mdm_T1FitterDictionary::fitT1(
+	double &T1value, double &M0value, double &EWvalue)
+{
+	EWvalue = 1.0;
+	if (signals_.size() != acquisitionParams_.size())
+		throw mdm_exception(__func__, "Number of signals (" + std::to_string(signals_.size()) +
+			") does not match number of acquisition parameters (" + std::to_string(acquisitionParams_.size()) + ")");
+
+	//Acquisition parameters may have been reset since the last voxel (eg in lite analysis)
+	if (acquisitionParams_ != dictParams_ || TR_ != dictTR_)
+		buildDictionary();
+
+	//For B1 correction, search the slice nearest the voxel's B1, otherwise search all slices.
+	//The search is coarse-to-fine: first match to every T1SearchStride'th T1 value, then to
+	//all T1 values either side of the best coarse match
+	const auto nSignals = signals_.size();
+	const size_t nCoarse = (T1GridSize - 1) / T1SearchStride + 1;
+	size_t firstSlice = 0, endSlice = nSlices_;
+	if (model_ == VFA && extraDimension_)
+	{
+		double b = std::round((B1_ - B1GridMin) / (B1GridMax - B1GridMin) * (B1GridSize - 1));
+		firstSlice = size_t(std::min(std::max(b, 0.0), double(B1GridSize - 1)));
+		endSlice = firstSlice + 1;
+	}
+
+	size_t bestSlice = firstSlice, bestIdx = 0;
+	double bestDot = -std::numeric_limits<double>::infinity();
+	for (size_t slice = firstSlice; slice < endSlice; slice++)
+	{
+		double dot;
+		auto idx = searchAtoms(&coarseAtoms_[slice * nSignals * nCoarse], nCoarse, 0, nCoarse, dot);
+		if (dot > bestDot)
+		{
+			bestDot = dot;
+			bestIdx = idx;
+			bestSlice = slice;
+		}
+	}
+
+	//Signals don't match any atom (eg all zero, negative or NaN)
+	if (!(bestDot > 0))
+	{
+		setErrorValuesAndTidyUp(T1value, M0value);
+		return mdm_ErrorTracker::T1_FIT_FAIL;
+	}
+
+	const size_t coarseIdx = bestIdx * T1SearchStride;
+	const size_t begin = coarseIdx > T1SearchStride ? coarseIdx - T1SearchStride : 0;
+	const size_t end = std::min(coarseIdx + T1SearchStride + 1, T1GridSize);
+	bestIdx = searchAtoms(&atoms_[bestSlice * nSignals * T1GridSize], T1GridSize, begin, end, bestDot);
+
+	//Best match at the edge of the grid, so T1 is outside the dictionary range
+	if (bestIdx == 0 || bestIdx == T1GridSize - 1)
+	{
+		setErrorValuesAndTidyUp(T1value, M0value);
+		return mdm_ErrorTracker::T1_MAD_VALUE;
+	}
+
+	double T1 = T1s_[bestIdx];
+	double M0 = bestDot / norms_[bestSlice * T1GridSize + bestIdx];
+	double p = model_ == VFA ? B1_ : extraParamValue(bestSlice);
+
+	if (refine_)
+		refineFit(T1, M0, p);
+
+	// Check for crap fit or bonkers result
+	if (!(T1 > 0.0) || T1 > 10000.0)
+	{
+		setErrorValuesAndTidyUp(T1value, M0value);
+		return mdm_ErrorTracker::T1_MAD_VALUE;
+	}
+
+	T1value = T1;
+	M0value = M0;
+	if (model_ == IR && extraDimension_)
+		EWvalue = p;
+	return mdm_ErrorTracker::OK;
+}
+
+//
+MDM_API bool mdm_T1FitterDictionary::setInputsFromStream(std::istream& ifs,
+	const int nSignals)
+{
+	const double PI = acos(-1.0);
+	acquisitionParams_.resize(nSignals);
+	signals_.resize(nSignals);
+	for (auto &acq : acquisitionParams_)
+	{
+		ifs >> acq;
+		if (ifs.eof())
+			return false;
+
+		//Flip-angles are input in degrees
+		if (model_ == VFA)
+			acq *= (PI / 180);
+	}
+	for (auto &si : signals_)
+		ifs >> si;
+
+	if (model_ == VFA && extraDimension_)
+		ifs >> B1_;
+
+	return true;
+}
+
+//
+MDM_API void mdm_T1FitterDictionary::setInputsFromRow(const std::vector<double> &row,
+	const int nSignals)
+{
+	if (row.size() < size_t(numInputValues(nSignals)))
+		throw mdm_exception(__func__, boost::format(
+			"Row has %1% values, %2% required") % row.size() % numInputValues(nSignals));
+
+	const double PI = acos(-1.0);
+	auto val = row.begin();
+	acquisitionParams_.resize(nSignals);
+	signals_.resize(nSignals);
+	for (auto &acq : acquisitionParams_)
+		acq = model_ == VFA ? *val++ * (PI / 180) : *val++;
+
+	for (auto &si : signals_)
+		si = *val++;
+
+	if (model_ == VFA && extraDimension_)
+		B1_ = *val;
+}
+
+//
+MDM_API int mdm_T1FitterDictionary::numInputValues(const int nSignals) const
+{
+	return model_ == VFA && extraDimension_ ? 2 * nSignals + 1 : 2 * nSignals;
+}
+
+//
+MDM_API int mdm_T1FitterDictionary::minimumInputs() const
+{
+	return 3;
+}
+
+//
+MDM_API int mdm_T1FitterDictionary::maximumInputs() const
+{
+	return 50;
+}
+
+//**********************************************************************
+//Private methods
+//**********************************************************************
+
+//
+void mdm_T1FitterDictionary::computeSignalGradient(const double &T1, const double &p,
+	const double &acq, double &signal, double &signal_dT1, double &signal_dp) const
+{
+	if (model_ == VFA)
+	{
+		//SPGR signal, p is B1, which is never fitted
+		double FA = p * acq;
+		double cosFA = std::cos(FA);
+		double sinFA = std::sin(FA);
+		double E = std::exp(-TR_ / T1);
+		double A = 1.0 - E * cosFA;
+
+		signal = sinFA * (1 - E) / A;
+		signal_dT1 = sinFA * TR_ * E * (cosFA - 1) / (A * A * T1 * T1);
+		signal_dp = 0;
+	}
+	else
+	{
+		//Inversion recovery magnitude signal, p is the efficiency weighting
+		double E_TI = std::exp(-acq / T1);
+		double E_TR = std::exp(-TR_ / T1);
+
+		signal = 1 - 2 * p * E_TI + E_TR;
+		signal_dT1 = (-2 * p * E_TI * acq + E_TR * TR_) / (T1 * T1);
+		signal_dp = -2 * E_TI;
+
+		if (signal < 0)
+		{
+			signal *= -1;
+			signal_dT1 *= -1;
+			signal_dp *= -1;
+		}
+	}
+}
+
+//
+void mdm_T1FitterDictionary::buildDictionary()
+{
+	const auto nSignals = acquisitionParams_.size();
+	if (nSignals < size_t(minimumInputs()))
+		throw mdm_exception(__func__, "Fewer acquisition parameters (" + std::to_string(nSignals) +
+			") than minimum required (" + std::to_string(minimumInputs()) + ")");
+
+	if (nSignals > size_t(maximumInputs()))
+		throw mdm_exception(__func__, "More acquisition parameters (" + std::to_string(nSignals) +
+			") than maximum allowed (" + std::to_string(maximumInputs()) + ")");
+
+	const size_t nCoarse = (T1GridSize - 1) / T1SearchStride + 1;
+	atoms_.resize(nSlices_ * nSignals * T1GridSize);
+	coarseAtoms_.resize(nSlices_ * nSignals * nCoarse);
+	norms_.resize(nSlices_ * T1GridSize);
+
+	double s, s_dT1, s_dp;
+	for (size_t slice = 0; slice < nSlices_; slice++)
+	{
+		const double p = extraParamValue(slice);
+		double *atoms = &atoms_[slice * nSignals * T1GridSize];
+		double *norms = &norms_[slice * T1GridSize];
+		for (size_t a = 0; a < T1GridSize; a++)
+		{
+			double sumSq = 0;
+			for (size_t i = 0; i < nSignals; i++)
+			{
+				computeSignalGradient(T1s_[a], p, acquisitionParams_[i], s, s_dT1, s_dp);
+				atoms[i * T1GridSize + a] = s;
+				sumSq += s * s;
+			}
+			norms[a] = std::sqrt(sumSq);
+
+			//Normalise, atoms with zero norm (all signals zero) never match
+			const double scale = norms[a] > 0 ? 1.0 / norms[a] : 0.0;
+			for (size_t i = 0; i < nSignals; i++)
+				atoms[i * T1GridSize + a] *= scale;
+		}
+
+		//Copy every T1SearchStride'th atom to the coarse dictionary
+		double *coarseAtoms = &coarseAtoms_[slice * nSignals * nCoarse];
+		for (size_t i = 0; i < nSignals; i++)
+			for (size_t c = 0; c < nCoarse; c++)
+				coarseAtoms[i * nCoarse + c] = atoms[i * T1GridSize + c * T1SearchStride];
+	}
+	dictParams_ = acquisitionParams_;
+	dictTR_ = TR_;
+}
+
+//
+size_t mdm_T1FitterDictionary::searchAtoms(const double *atoms, const size_t nAtoms,
+	const size_t begin, const size_t end, double &bestDot)
+{
+	//Accumulate inner products signal by signal, so the inner loop runs over contiguous
+	//atoms and can be vectorised
+	const auto nSignals = signals_.size();
+	double *dots = dots_.data();
+	const double s0 = signals_[0];
+	for (size_t a = begin; a < end; a++)
+		dots[a] = s0 * atoms[a];
+
+	for (size_t i = 1; i < nSignals; i++)
+	{
+		const double si = signals_[i];
+		const double *atoms_i = atoms + i * nAtoms;
+		for (size_t a = begin; a < end; a++)
+			dots[a] += si * atoms_i[a];
+	}
+
+	size_t bestIdx = begin;
+	bestDot = dots[begin];
+	for (size_t a = begin + 1; a < end; a++)
+	{
+		if (dots[a] > bestDot)
+		{
+			bestDot = dots[a];
+			bestIdx = a;
+		}
+	}
+	return bestIdx;
+}
+
+//
+void mdm_T1FitterDictionary::refineFit(double &T1, double &M0, double &p)
+{
+	//Gauss-Newton step: solve (J'J) delta = J'r for the residuals r = signals - M0 * model,
+	//where J has columns dS/dT1, dS/dM0 and, if fitting efficiency weighting, dS/dEW
+	const int nParams = model_ == IR && extraDimension_ ? 3 : 2;
+	double JtJ[3][3] = { { 0 } };
+	double Jtr[3] = { 0 };
+	double s, s_dT1, s_dp;
+	for (size_t i = 0; i < signals_.size(); i++)
+	{
+		computeSignalGradient(T1, p, acquisitionParams_[i], s, s_dT1, s_dp);
+		const double J[3] = { M0 * s_dT1, s, M0 * s_dp };
+		const double r = signals_[i] - M0 * s;
+		for (int j = 0; j < nParams; j++)
+		{
+			Jtr[j] += J[j] * r;
+			for (int k = j; k < nParams; k++)
+				JtJ[j][k] += J[j] * J[k];
+		}
+	}
+	for (int j = 0; j < nParams; j++)
+		for (int k = 0; k < j; k++)
+			JtJ[j][k] = JtJ[k][j];
+
+	if (!solveLinearSystem(JtJ, Jtr, nParams))
+		return;
+
+	double T1_new = T1 + Jtr[0];
+	double M0_new = M0 + Jtr[1];
+	double p_new = nParams > 2 ? std::min(std::max(p + Jtr[2], 0.0), 1.0) : p;
+	if (!(T1_new > 0) || !(M0_new > 0))
+		return;
+
+	//Only accept the step if it reduces the residual
+	if (computeSSE(T1_new, M0_new, p_new) < computeSSE(T1, M0, p))
+	{
+		T1 = T1_new;
+		M0 = M0_new;
+		p = p_new;
+	}
+}
+
+//
+double mdm_T1FitterDictionary::computeSSE(const double &T1, const double &M0, const double &p) const
+{
+	double sse = 0;
+	double s, s_dT1, s_dp;
+	for (size_t i = 0; i < signals_.size(); i++)
+	{
+		computeSignalGradient(T1, p, acquisitionParams_[i], s, s_dT1, s_dp);
+		const double r = signals_[i] - M0 * s;
+		sse += r * r;
+	}
+	return sse;
+}
+
+//
+double mdm_T1FitterDictionary::extraParamValue(size_t slice) const
+{
+	if (!extraDimension_)
+		return 1.0;
+
+	if (model_ == VFA)
+		return B1GridMin + slice * (B1GridMax - B1GridMin) / (B1GridSize - 1);
+	else
+		return EWGridMin + slice * (1.0 - EWGridMin) / (EWGridSize - 1);
+}
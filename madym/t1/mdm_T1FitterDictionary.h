@@ -0,0 +1,186 @@
+/*!
+*  @file    mdm_T1FitterDictionary.h
+*  @brief   Class for estimating T1 (and M0) in a single voxel by matching to a precomputed signal dictionary
+*  @details
+*  @author MA Berks (c) Copyright QBI Lab, University of Manchester 2022
+*/
+
+#ifndef MDM_T1FITTERDICTIONARY_HDR
+#define MDM_T1FITTERDICTIONARY_HDR
+#include <madym/utils/mdm_api.h>
+#include "mdm_T1FitterBase.h"
+#include <madym/utils/mdm_ErrorTracker.h>
+
+//! Class for estimating T1 (and M0) in a single voxel by matching to a precomputed signal dictionary
+/*!
+For a given set of acquisition parameters (flip-angles or inversion times) and TR, the signal
+model is linear in M0, so a dictionary of model signals with M0 = 1 is precomputed over a
+log-spaced grid of T1 values. Each voxel is matched to the dictionary atom with the largest
+normalised inner product with its signals, which gives T1, and M0 is the projection of the
+signals onto that atom. Matching is coarse-to-fine, searching a subsampled T1 grid, then the
+full grid around the best coarse match. The estimate may then be refined by a single Gauss-Newton step on the
+sum-of-squared residuals, using the analytic signal model.
+
+For variable flip-angle with B1 correction, the dictionary also spans a grid of B1 values, and
+the slice nearest the voxel's B1 is searched (the refinement step uses the exact B1). For inversion
+recovery with efficiency weighting, the dictionary spans a grid of efficiency weightings, all of
+which are searched.
+
+The T1 grid has 1000 values log-spaced from 10 to 10000 ms, which bounds the error of unrefined
+estimates on noise-free data to half a grid step, ~0.35%. The refinement step reduces this to
+below the tolerance of the iterative fitters (mdm_T1FitterVFA, mdm_T1FitterIR).
+*/
+class mdm_T1FitterDictionary : public mdm_T1FitterBase {
+
+public:
+
+	//! Signal models supported by the dictionary
+	enum SignalModel {
+		VFA, ///> Variable flip-angle SPGR signal
+		IR ///> Inversion recovery signal
+	};
+
+	//! Constructor from signal model, acquisition parameters and repetition time
+	/*!
+	\param model signal model used to compute the dictionary
+	\param acquisitionParams flip-angles in radians (VFA) or inversion times in ms (IR)
+	\param TR repetition time in ms
+	\param extraDimension if true, the dictionary also spans B1 (VFA) or efficiency weighting (IR)
+	\param refine if true, refine the dictionary estimate with a single Gauss-Newton step
+	*/
+	MDM_API mdm_T1FitterDictionary(SignalModel model, const std::vector<double> &acquisitionParams,
+		const double TR, const bool extraDimension, const bool refine = true);
+
+	//! Default destructor
+	/*!
+	*/
+	MDM_API ~mdm_T1FitterDictionary();
+
+	//! Set acquisition parameters
+	/*!
+	The dictionary is recomputed on the next fit if these differ from the current dictionary
+	\param acquisitionParams flip-angles in radians (VFA) or inversion times in ms (IR)
+	*/
+	MDM_API void setAcquisitionParams(const std::vector<double> &acquisitionParams);
+
+	//! Set repetition time
+	/*!
+	The dictionary is recomputed on the next fit if this differs from the current dictionary
+	\param TR repetition time in ms
+	*/
+	MDM_API void setTR(const double TR);
+
+	//! Set inputs that vary on per voxel basis from which T1 will be estimated
+	/*!
+	If using B1 correction, inputs should be an n + 1 element vector, with signals in the first
+	n elements and the B1 correction at the end. Otherwise an n element vector signals.
+	\param inputs vector of signals (and B1 correction) from which T1 will be estimated
+	*/
+	MDM_API void setInputs(const std::vector<double> &inputs);
+
+	//! Estimate T1 by matching the signals to the dictionary
+	/*!
+	\param T1value reference to hold computed T1
+	\param M0value reference to hold computed M0
+	\param EWvalue reference to hold computed efficiency weighting (1 if not fitted)
+	\return error code, T1_FIT_FAIL if the signals do not match any atom, T1_MAD_VALUE if the
+	best match is at the edge of the T1 grid
+	*/
+	MDM_API mdm_ErrorTracker::ErrorCode fitT1(double &T1value, double &M0value, double &EWvalue);
+
+	//! Set inputs for computing T1 from a single line of an input data stream buffer
+	/*!
+	\param ifs input data stream
+	\param nSignals number of signals in sample
+	\return false if streams EOF flag is reached, true otherwise
+	*/
+	MDM_API virtual bool setInputsFromStream(std::istream& ifs,
+		const int nSignals);
+
+	//! Set inputs for computing T1 from a row of input data
+	/*!
+	\param row input values, ordered as in a single line of an input data stream
+	\param nSignals number of signals in sample
+	*/
+	MDM_API virtual void setInputsFromRow(const std::vector<double> &row,
+		const int nSignals);
+
+	//! Return the number of input values in each sample
+	/*!
+	\param nSignals number of signals in sample
+	\return number of input values: acquisition parameters, signals and B1 if using B1 correction
+	*/
+	MDM_API virtual int numInputValues(const int nSignals) const;
+
+	//! Return minimum inputs required
+	/*
+	\return minimum number of input signals required for T1 fitting method
+	*/
+	MDM_API int minimumInputs() const;
+
+	//! Return maximum inputs allowed
+	/*
+	\return maximum number of input signals allowed in T1 fitting method
+	*/
+	MDM_API int maximumInputs() const;
+
+private:
+
+	//Model signal with M0 = 1, and its derivatives with respect to T1 and the extra parameter
+	void computeSignalGradient(const double &T1, const double &p, const double &acq,
+		double &signal, double &signal_dT1, double &signal_dp) const;
+
+	void buildDictionary();
+
+	//Search atoms [begin, end) of a dictionary slice with nAtoms atoms per signal, returning the
+	//index of the best match and its inner product
+	size_t searchAtoms(const double *atoms, const size_t nAtoms,
+		const size_t begin, const size_t end, double &bestDot);
+
+	//Single Gauss-Newton step on (T1, M0[, EW]), only accepted if it reduces the residual
+	void refineFit(double &T1, double &M0, double &p);
+
+	double computeSSE(const double &T1, const double &M0, const double &p) const;
+
+	double extraParamValue(size_t slice) const;
+
+	//Dictionary grids
+	static const size_t T1GridSize;
+	static const size_t T1SearchStride;
+	static const double T1GridMin;
+	static const double T1GridMax;
+	static const size_t B1GridSize;
+	static const double B1GridMin;
+	static const double B1GridMax;
+	static const size_t EWGridSize;
+	static const double EWGridMin;
+
+	SignalModel model_;
+	std::vector<double> acquisitionParams_;
+	double TR_;
+	bool extraDimension_;
+	bool refine_;
+
+	//B1 correction of the current voxel, only used by VFA with B1 correction
+	double B1_;
+
+	//Dictionary of normalised atoms, stored slice by slice (B1 or efficiency weighting), and
+	//within each slice signal by signal, so the inner products for all T1 values accumulate
+	//over contiguous memory. The norms of the unnormalised atoms give M0. The coarse dictionary
+	//holds every T1SearchStride'th atom, stored in the same order.
+	std::vector<double> T1s_;
+	std::vector<double> atoms_;
+	std::vector<double> coarseAtoms_;
+	std::vector<double> norms_;
+	size_t nSlices_;
+
+	//Acquisition parameters and TR the dictionary was computed for
+	std::vector<double> dictParams_;
+	double dictTR_;
+
+	//Scratch space for inner products, reused for every voxel
+	std::vector<double> dots_;
+
+};
+
+#endif /* MDM_T1FITTERDICTIONARY_HDR */
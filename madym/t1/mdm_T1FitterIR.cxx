@@ -20,13 +20,14 @@
 #include <madym/utils/mdm_exception.h>
 //
 MDM_API mdm_T1FitterIR::mdm_T1FitterIR(const std::vector<double> &TIs, const double TR, 
-	const bool fitEfficiencyWeighting, const std::vector<double>& init_params)
+	const bool fitEfficiencyWeighting, const std::vector<double>& init_params, const bool closedFormInit)
   :
   mdm_T1FitterBase(),
   TIs_(TIs),
   TR_(TR),
 	fitEfficiencyWeighting_(fitEfficiencyWeighting),
-	init_params_(init_params)
+	init_params_(init_params),
+	closedFormInit_(closedFormInit)
 {
 	//Pre-initialise the alglib state
 	int nParams = fitEfficiencyWeighting_ ? 3 : 2;
@@ -58,6 +59,13 @@ MDM_API mdm_T1FitterIR::mdm_T1FitterIR(const std::vector<double> &TIs, const dou
 	alglib::minbcsetcond(state_, epsg, epsf, epsx, maxits);
 	alglib::minbcsetprecscale(state_);
 
+	x_.setlength(nParams);
+	scale_.setlength(nParams);
+
+	//The initialising fit only needs creating once, its optimiser is restarted for each voxel
+	if (fitEfficiencyWeighting_ && !closedFormInit_)
+		prefitter_.reset(new mdm_T1FitterIR(TIs_, TR_, false, init_params_));
+
 #if _DEBUG
 	//Provides numerical check of analytic gradient, useful in debugging, but should not be
 	//used in release versions
@@ -121,13 +129,18 @@ MDM_API mdm_ErrorTracker::ErrorCode mdm_T1FitterIR::fitT1(
 
 	if (fitEfficiencyWeighting_)
 	{
-		//Run an initial fit with efficiency fixed to 1.0 to get
-		//initial values for T1 and M0
-		
-		mdm_T1FitterIR* fitter = new mdm_T1FitterIR(TIs_, TR_, false, init_params_);
-		fitter->setInputs(signals_);
-		fitter->fitT1(init_T1, init_M0, init_EW);
-		delete fitter;
+		//Get initial values for T1 and M0, either from a closed-form estimate, or by running
+		//an initial fit with efficiency fixed to 1.0. TIs and TR may have been reset
+		//since the last voxel (eg in lite analysis)
+		if (closedFormInit_)
+			closedFormEstimate(init_T1, init_M0);
+		else
+		{
+			prefitter_->TIs_ = TIs_;
+			prefitter_->TR_ = TR_;
+			prefitter_->signals_ = signals_;
+			prefitter_->fitT1(init_T1, init_M0, init_EW);
+		}
 
 		n_params = 3;
 		
@@ -156,20 +169,26 @@ MDM_API mdm_ErrorTracker::ErrorCode mdm_T1FitterIR::fitT1(
 		n_params = 2;
 	}
 
-	std::vector<double> init_vals = { init_T1, init_M0, init_EW };
-	std::vector<double> init_scale = { get_scale(init_T1), get_scale(init_M0), 1 };
-	alglib::real_1d_array x;
-	alglib::real_1d_array s;
+	//Set initial values and scales in the pre-allocated arrays, then restart
+	//the optimiser from these
+	auto &x = x_;
+	x[0] = init_T1;
+	x[1] = init_M0;
+	scale_[0] = get_scale(init_T1);
+	scale_[1] = get_scale(init_M0);
+	if (n_params > 2)
+	{
+		x[2] = init_EW;
+		scale_[2] = 1;
+	}
 	
 	// Optimize and evaluate results
 	try
 	{
-		x.setcontent(n_params, init_vals.data());
-		s.setcontent(n_params, init_scale.data());
-		alglib::minbcsetscale(state_, s);
+		alglib::minbcsetscale(state_, scale_);
 		minbcrestartfrom(state_, x);
 		alglib::minbcoptimize(state_, &computeSSEGradientAlglib, NULL, this);
-		minbcresults(state_, x, rep_);	
+		minbcresultsbuf(state_, x, rep_);	
 
 #if _DEBUG
 		//
@@ -182,8 +201,8 @@ MDM_API mdm_ErrorTracker::ErrorCode mdm_T1FitterIR::fitT1(
 		std::cout << "Non c0 suspected:" << (ogrep.nonc0suspected ? "true" : "false") << "\n"; // EXPECTED: false
 		std::cout << "Non c1 suspected:" << (ogrep.nonc1suspected ? "true" : "false") << "\n"; // EXPECTED: false
 
-		std::cout << "T1 initalised to " << init_vals[0] << ", scale = " << init_scale[0] << '\n';
-		std::cout << "M0 initalised to " << init_vals[1] << ", scale = " << init_scale[1] << '\n';
+		std::cout << "T1 initalised to " << init_T1 << ", scale = " << scale_[0] << '\n';
+		std::cout << "M0 initalised to " << init_M0 << ", scale = " << scale_[1] << '\n';
 		std::cout << "Fitting to [" << signals_.front() << ", " << signals_.back() << "], with TR = " << TR_ << "\n";
 #endif
 	}
@@ -237,6 +256,18 @@ MDM_API bool mdm_T1FitterIR::setInputsFromStream(std::istream& ifs,
   return true;
 }
 
+//
+MDM_API void mdm_T1FitterIR::setInputsFromRow(const std::vector<double> &row,
+	const int nSignals)
+{
+	if (row.size() < size_t(numInputValues(nSignals)))
+		throw mdm_exception(__func__, boost::format(
+			"Row has %1% values, %2% required") % row.size() % numInputValues(nSignals));
+
+	TIs_.assign(row.begin(), row.begin() + nSignals);
+	signals_.assign(row.begin() + nSignals, row.begin() + 2 * nSignals);
+}
+
 //
 MDM_API int mdm_T1FitterIR::minimumInputs() const
 {
@@ -338,4 +369,39 @@ void mdm_T1FitterIR::computeSSEGradient(
 		if (fitEfficiencyWeighting_)
 			grad[2] += 2 * s_dEW * diff;
 	}
-}
\ No newline at end of file
+}
+
+//
+void mdm_T1FitterIR::closedFormEstimate(double &T1, double &M0) const
+{
+	//Take M0 from the signal at the longest TI, where magnetisation has (nearly) recovered,
+	//and the null point from the smallest signal
+	const auto nTIs = TIs_.size();
+	size_t iMax = 0, iNull = 0;
+	for (size_t i = 1; i < nTIs; i++)
+	{
+		if (TIs_[i] > TIs_[iMax])
+			iMax = i;
+		if (signals_[i] < signals_[iNull])
+			iNull = i;
+	}
+	M0 = signals_[iMax];
+
+	//Restore the polarity of signals acquired before the null point, then with efficiency 1 and
+	//exp(-TR/T1) ~ 0, log((M0 - S) / 2M0) = -TI/T1, so fit a line through the origin
+	double sumTT = 0, sumTL = 0;
+	for (size_t i = 0; i < nTIs; i++)
+	{
+		if (i == iNull)
+			continue;
+
+		double s = TIs_[i] < TIs_[iNull] ? -signals_[i] : signals_[i];
+		double y = (M0 - s) / (2 * M0);
+		if (y <= 0 || y >= 1)
+			continue;
+
+		sumTT += TIs_[i] * TIs_[i];
+		sumTL += TIs_[i] * std::log(y);
+	}
+	T1 = sumTL < 0 ? -sumTT / sumTL : 1000.0;
+}
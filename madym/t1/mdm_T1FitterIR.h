@@ -10,6 +10,7 @@
 #include <madym/utils/mdm_api.h>
 #include "mdm_T1FitterBase.h"
 #include <madym/utils/mdm_ErrorTracker.h>
+#include <memory>
 
 //! Class for estimating T1 (and M0) in a single voxel using inversion recovery method
 class mdm_T1FitterIR : public mdm_T1FitterBase {
@@ -22,8 +23,12 @@ public:
 	\param TIs vector of inversion recovery times in ms
 	\param TR repetition time in ms
 	\param fitEfficiencyWeighting flag to fit efficiency weighting
+	\param init_params initial values for T1 and M0, if empty set from the signals
+	\param closedFormInit if fitting efficiency weighting, initialise T1 and M0 from a closed-form
+	estimate, rather than an initial fit with efficiency weighting fixed to 1
 	*/
-	MDM_API mdm_T1FitterIR(const std::vector<double> &TIs, const double TR, const bool fitEfficiencyWeighting, const std::vector<double>& init_params);
+	MDM_API mdm_T1FitterIR(const std::vector<double> &TIs, const double TR, const bool fitEfficiencyWeighting, const std::vector<double>& init_params,
+		const bool closedFormInit = false);
 
 	//! Default denstructor
 	/*!
@@ -69,6 +74,14 @@ public:
 	MDM_API virtual bool setInputsFromStream(std::istream& ifs,
 		const int nSignals);
 
+	//! Set inputs for computing T1 from a row of input data
+	/*!
+	\param row input values, ordered as in a single line of an input data stream
+	\param nSignals number of signals in sample
+	*/
+	MDM_API virtual void setInputsFromRow(const std::vector<double> &row,
+		const int nSignals);
+
 	//! Return minimum inputs required, must be implemented by derived subclass
 	/*
 	\return minimum number of input signals required for T1 fitting method
@@ -102,6 +115,9 @@ private:
 	void computeSSEGradient(
 		const alglib::real_1d_array &x, double &func, alglib::real_1d_array &grad);
 
+	//Estimate T1 and M0 from a log-linear fit, assuming efficiency 1 and TR >> T1
+	void closedFormEstimate(double &T1, double &M0) const;
+
 	static void computeSSEGradientAlglib(
 		const alglib::real_1d_array &x, double &func, alglib::real_1d_array &grad,
 		void *context) {
@@ -116,6 +132,17 @@ private:
 
 	alglib::minbcstate  state_; //!< Cached ALGLIB internal
 	alglib::minbcreport rep_; //!< Cached ALGLIB internal
+
+	//Scratch arrays for optimiser parameters and scales, allocated once
+	alglib::real_1d_array x_;
+	alglib::real_1d_array scale_;
+
+	//When fitting efficiency weighting, fitter with efficiency fixed to 1 used to
+	//initialise T1 and M0. Created with this fitter and reused for every voxel
+	std::unique_ptr<mdm_T1FitterIR> prefitter_;
+
+	//If true, initialise efficiency weighting fits with a closed-form estimate instead
+	bool closedFormInit_;
 	
 };
 
@@ -231,6 +231,35 @@ MDM_API bool mdm_T1FitterVFA::setInputsFromStream(std::istream& ifs,
 	return true;
 }
 
+//
+MDM_API void mdm_T1FitterVFA::setInputsFromRow(const std::vector<double> &row,
+	const int nSignals)
+{
+	if (row.size() < size_t(numInputValues(nSignals)))
+		throw mdm_exception(__func__, boost::format(
+			"Row has %1% values, %2% required") % row.size() % numInputValues(nSignals));
+
+	auto val = row.begin();
+	FAs_.resize(nSignals);
+	signals_.resize(nSignals);
+	for (auto &fa : FAs_)
+		fa = *val++ * (PI / 180);
+
+	for (auto &si : signals_)
+		si = *val++;
+
+	if (usingB1_)
+		B1_ = *val;
+
+	initFAs();
+}
+
+//
+MDM_API int mdm_T1FitterVFA::numInputValues(const int nSignals) const
+{
+	return usingB1_ ? 2 * nSignals + 1 : 2 * nSignals;
+}
+
 //
 MDM_API int mdm_T1FitterVFA::minimumInputs() const
 {
@@ -75,6 +75,21 @@ public:
 	MDM_API virtual bool setInputsFromStream(std::istream& ifs,
 		const int nSignals);
 
+	//! Set inputs for computing T1 from a row of input data
+	/*!
+	\param row input values, ordered as in a single line of an input data stream
+	\param nSignals number of signals in sample
+	*/
+	MDM_API virtual void setInputsFromRow(const std::vector<double> &row,
+		const int nSignals);
+
+	//! Return the number of input values in each sample
+	/*!
+	\param nSignals number of signals in sample
+	\return number of input values: FAs, signals and B1 if using B1 correction
+	*/
+	MDM_API virtual int numInputValues(const int nSignals) const;
+
 	//! Return minimum inputs required, must be implemented by derived subclass
 	/*
 	\return minimum number of input signals required for T1 fitting method
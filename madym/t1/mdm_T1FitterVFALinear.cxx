@@ -0,0 +1,390 @@
+/**
+*  @file    mdm_T1FitterVFALinear.cxx
+*  @brief   Implementation of the mdm_T1FitterVFALinear class
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_API_EXPORTS
+#define MDM_API_EXPORTS
+#endif // !MDM_API_EXPORTS
+
+#include "mdm_T1FitterVFALinear.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <madym/utils/mdm_exception.h>
+
+const double mdm_T1FitterVFALinear::PI = acos(-1.0);
+
+//
+MDM_API mdm_T1FitterVFALinear::mdm_T1FitterVFALinear(const std::vector<double> &FAs, const double TR,
+	const bool usingB1, const double refineTol)
+	:
+	mdm_T1FitterBase(),
+	FAs_(FAs),
+	TR_(TR),
+	B1_(1.0),
+	usingB1_(usingB1),
+	refineTol_(refineTol),
+	nFAs_(0),
+	residuals_(BlockSize)
+{
+	if (refineTol_ < 0)
+		throw mdm_exception(__func__, boost::format(
+			"Refinement tolerance (%1%) must be >= 0") % refineTol_);
+
+	if (refineTol_ > 0)
+		nonlinearFitter_.reset(new mdm_T1FitterVFA(FAs_, TR_, usingB1_, {}));
+
+	if (!FAs_.empty())
+		initFAs();
+}
+
+//
+MDM_API mdm_T1FitterVFALinear::~mdm_T1FitterVFALinear()
+{
+
+}
+
+//
+MDM_API void mdm_T1FitterVFALinear::setFAs(const std::vector<double> &FAs)
+{
+	FAs_ = FAs;
+	initFAs();
+}
+
+//
+MDM_API void mdm_T1FitterVFALinear::setTR(const double TR)
+{
+	TR_ = TR;
+	if (nonlinearFitter_)
+		nonlinearFitter_->setTR(TR);
+}
+
+//
+MDM_API void mdm_T1FitterVFALinear::setInputs(const std::vector<double> &inputs)
+{
+	if (inputs.size() < size_t(minimumInputs()))
+		throw mdm_exception(__func__, "Fewer input signals (" + std::to_string(inputs.size()) +
+			") than minimum required (" + std::to_string(minimumInputs()) + ")");
+
+	if (inputs.size() > size_t(maximumInputs()))
+		throw mdm_exception(__func__, "More input signals (" + std::to_string(inputs.size()) +
+			") than maximum allowed (" + std::to_string(maximumInputs()) + ")");
+
+	if (usingB1_)
+	{
+		//First n-1 inputs are signals, last input is B1
+		signals_.assign(inputs.begin(), inputs.end() - 1);
+		B1_ = inputs.back();
+	}
+	else
+		signals_ = inputs;
+}
+
+//
+MDM_API mdm_ErrorTracker::ErrorCode mdm_T1FitterVFALinear::fitT1(
+	double &T1value, double &M0value, double &EWvalue)
+{
+	if (signals_.size() != size_t(nFAs_))
+		throw mdm_exception(__func__, "Number of signals (" + std::to_string(signals_.size()) +
+			") does not match number of FAs (" + std::to_string(nFAs_) + ")");
+
+	//Fit as a batch of one voxel
+	inputs_ = signals_;
+	if (usingB1_)
+		inputs_.push_back(B1_);
+
+	mdm_ErrorTracker::ErrorCode errCode;
+	fitT1Batch(inputs_.data(), 1, inputs_.size(), &T1value, &M0value, &EWvalue, &errCode);
+	return errCode;
+}
+
+//
+MDM_API void mdm_T1FitterVFALinear::fitT1Batch(const double *inputs, const size_t nVoxels, const size_t nInputs,
+	double *T1values, double *M0values, double *EWvalues, mdm_ErrorTracker::ErrorCode *errCodes)
+{
+	//An empty batch (eg a slab with no voxels to fit) has nothing to check
+	if (!nVoxels)
+		return;
+
+	if (nInputs != size_t(usingB1_ ? nFAs_ + 1 : nFAs_))
+		throw mdm_exception(__func__, boost::format(
+			"Number of inputs (%1%) does not match number of FAs (%2%)%3%")
+			% nInputs % nFAs_ % (usingB1_ ? " + B1" : ""));
+
+	for (size_t start = 0; start < nVoxels; start += BlockSize)
+	{
+		const size_t n = std::min(BlockSize, nVoxels - start);
+		const double *blockInputs = inputs + start * nInputs;
+
+		//Transpose the block's signals so each flip-angle's signals are contiguous. With B1
+		//correction the flip-angles vary by voxel, otherwise the cos and sin arrays are
+		//constant, set when the FAs are set
+		for (size_t v = 0; v < n; v++)
+		{
+			const double *voxelInputs = blockInputs + v * nInputs;
+			for (int i = 0; i < nFAs_; i++)
+				blockSignals_[i * BlockSize + v] = voxelInputs[i];
+
+			if (usingB1_)
+			{
+				const double B1 = voxelInputs[nFAs_];
+				for (int i = 0; i < nFAs_; i++)
+				{
+					blockCos_[i * BlockSize + v] = std::cos(B1 * FAs_[i]);
+					blockSin_[i * BlockSize + v] = std::sin(B1 * FAs_[i]);
+				}
+			}
+		}
+
+		double *T1 = T1values + start;
+		double *M0 = M0values + start;
+		fitBlock(n, T1, M0, residuals_.data());
+
+		for (size_t v = 0; v < n; v++)
+		{
+			EWvalues[start + v] = 1.0;
+
+			// Check for crap fit or bonkers result
+			bool valid = T1[v] > 0.0 && T1[v] <= 10000.0 && M0[v] > 0.0;
+
+			//Refine poor linear fits with the nonlinear fit
+			if (nonlinearFitter_ && (!valid || residuals_[v] > refineTol_))
+			{
+				const double *voxelInputs = blockInputs + v * nInputs;
+				refineInputs_.assign(voxelInputs, voxelInputs + nInputs);
+				nonlinearFitter_->setInputs(refineInputs_);
+				errCodes[start + v] = nonlinearFitter_->fitT1(T1[v], M0[v], EWvalues[start + v]);
+			}
+			else if (!valid)
+			{
+				setErrorValuesAndTidyUp(T1[v], M0[v]);
+				errCodes[start + v] = mdm_ErrorTracker::T1_MAD_VALUE;
+			}
+			else
+				errCodes[start + v] = mdm_ErrorTracker::OK;
+		}
+	}
+}
+
+//
+MDM_API bool mdm_T1FitterVFALinear::setInputsFromStream(std::istream& ifs,
+	const int nSignals)
+{
+	FAs_.resize(nSignals);
+	signals_.resize(nSignals);
+	for (auto &fa : FAs_)
+	{
+		ifs >> fa;
+		if (ifs.eof())
+			return false;
+
+		fa *= (PI / 180);
+	}
+	for (auto &si : signals_)
+		ifs >> si;
+
+	if (usingB1_)
+		ifs >> B1_;
+
+	initFAs();
+	return true;
+}
+
+//
+MDM_API void mdm_T1FitterVFALinear::setInputsFromRow(const std::vector<double> &row,
+	const int nSignals)
+{
+	if (row.size() < size_t(numInputValues(nSignals)))
+		throw mdm_exception(__func__, boost::format(
+			"Row has %1% values, %2% required") % row.size() % numInputValues(nSignals));
+
+	//Rows usually share the same FAs, so only recompute their cos and sin if they change
+	auto val = row.begin();
+	bool FAsChanged = nFAs_ != nSignals;
+	FAs_.resize(nSignals);
+	signals_.resize(nSignals);
+	for (auto &fa : FAs_)
+	{
+		const double rowFA = *val++ * (PI / 180);
+		FAsChanged |= rowFA != fa;
+		fa = rowFA;
+	}
+
+	for (auto &si : signals_)
+		si = *val++;
+
+	if (usingB1_)
+		B1_ = *val;
+
+	if (FAsChanged)
+		initFAs();
+}
+
+//
+MDM_API int mdm_T1FitterVFALinear::numInputValues(const int nSignals) const
+{
+	return usingB1_ ? 2 * nSignals + 1 : 2 * nSignals;
+}
+
+//
+MDM_API int mdm_T1FitterVFALinear::minimumInputs() const
+{
+	return 3;
+}
+
+//
+MDM_API int mdm_T1FitterVFALinear::maximumInputs() const
+{
+	return 50;
+}
+
+//**********************************************************************
+//Private methods
+//**********************************************************************
+
+//
+void mdm_T1FitterVFALinear::fitBlock(const size_t n, double *T1, double *M0, double *residual)
+{
+	//Sums for the straight line fit of y = S/sin(a) against x = S/tan(a), for each voxel. These
+	//are local, so the compiler knows they don't alias the block arrays
+	double sumW[BlockSize], sumX[BlockSize], sumY[BlockSize], sumXX[BlockSize], sumXY[BlockSize];
+	double E1[BlockSize], intercept[BlockSize];
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (size_t v = 0; v < n; v++)
+		{
+			sumW[v] = 0;
+			sumX[v] = 0;
+			sumY[v] = 0;
+			sumXX[v] = 0;
+			sumXY[v] = 0;
+		}
+
+		for (int i = 0; i < nFAs_; i++)
+		{
+			const double *S = &blockSignals_[i * BlockSize];
+			const double *c = &blockCos_[i * BlockSize];
+			const double *s = &blockSin_[i * BlockSize];
+			if (!pass)
+			{
+				//Unweighted fit
+				for (size_t v = 0; v < n; v++)
+				{
+					const double y = S[v] / s[v];
+					const double x = y * c[v];
+					sumW[v] += 1.0;
+					sumX[v] += x;
+					sumY[v] += y;
+					sumXX[v] += x * x;
+					sumXY[v] += x * y;
+				}
+			}
+			else
+			{
+				//Weighted by the inverse variance of y, given E1 from the unweighted fit
+				for (size_t v = 0; v < n; v++)
+				{
+					const double y = S[v] / s[v];
+					const double x = y * c[v];
+					const double d = s[v] / (1.0 - E1[v] * c[v]);
+					const double w = d * d;
+					sumW[v] += w;
+					sumX[v] += w * x;
+					sumY[v] += w * y;
+					sumXX[v] += w * x * x;
+					sumXY[v] += w * x * y;
+				}
+			}
+		}
+
+		for (size_t v = 0; v < n; v++)
+		{
+			const double det = sumW[v] * sumXX[v] - sumX[v] * sumX[v];
+			E1[v] = (sumW[v] * sumXY[v] - sumX[v] * sumY[v]) / det;
+			intercept[v] = (sumY[v] - E1[v] * sumX[v]) / sumW[v];
+		}
+
+		//Keep the weights finite if the unweighted fit is invalid
+		if (!pass)
+		{
+			for (size_t v = 0; v < n; v++)
+				E1[v] = std::min(std::max(E1[v], 0.0), 0.9999);
+		}
+	}
+
+	//M0 from the intercept, and the residual of the modelled signals relative to the signals.
+	//The sums are reused
+	double m0[BlockSize];
+	double *ssr = sumX;
+	double *sss = sumY;
+	for (size_t v = 0; v < n; v++)
+	{
+		m0[v] = intercept[v] / (1.0 - E1[v]);
+		ssr[v] = 0;
+		sss[v] = 0;
+	}
+
+	for (int i = 0; i < nFAs_; i++)
+	{
+		const double *S = &blockSignals_[i * BlockSize];
+		const double *c = &blockCos_[i * BlockSize];
+		const double *s = &blockSin_[i * BlockSize];
+		for (size_t v = 0; v < n; v++)
+		{
+			const double model = m0[v] * s[v] * (1.0 - E1[v]) / (1.0 - E1[v] * c[v]);
+			const double r = S[v] - model;
+			ssr[v] += r * r;
+			sss[v] += S[v] * S[v];
+		}
+	}
+
+	for (size_t v = 0; v < n; v++)
+	{
+		T1[v] = -TR_ / std::log(E1[v]);
+		M0[v] = m0[v];
+		residual[v] = std::sqrt(ssr[v] / sss[v]);
+	}
+}
+
+//
+void mdm_T1FitterVFALinear::initFAs()
+{
+	nFAs_ = int(FAs_.size());
+	if (nFAs_ < minimumInputs())
+		throw mdm_exception(__func__, "Fewer FAs (" + std::to_string(nFAs_) +
+			") than minimum required (" + std::to_string(minimumInputs()) + ")");
+
+	if (nFAs_ > maximumInputs())
+		throw mdm_exception(__func__, "More FAs (" + std::to_string(nFAs_) +
+			") than maximum allowed (" + std::to_string(maximumInputs()) + ")");
+
+	cosFAs_.resize(nFAs_);
+	sinFAs_.resize(nFAs_);
+	for (int i = 0; i < nFAs_; i++)
+	{
+		cosFAs_[i] = std::cos(FAs_[i]);
+		sinFAs_[i] = std::sin(FAs_[i]);
+	}
+
+	blockSignals_.resize(nFAs_ * BlockSize);
+	blockCos_.resize(nFAs_ * BlockSize);
+	blockSin_.resize(nFAs_ * BlockSize);
+
+	//Without B1 correction, the block cos and sin arrays are the same for every voxel
+	if (!usingB1_)
+	{
+		for (int i = 0; i < nFAs_; i++)
+		{
+			std::fill_n(&blockCos_[i * BlockSize], BlockSize, cosFAs_[i]);
+			std::fill_n(&blockSin_[i * BlockSize], BlockSize, sinFAs_[i]);
+		}
+	}
+
+	if (nonlinearFitter_)
+		nonlinearFitter_->setFAs(FAs_);
+}
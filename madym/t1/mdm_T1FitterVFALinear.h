@@ -0,0 +1,169 @@
+/*!
+*  @file    mdm_T1FitterVFALinear.h
+*  @brief   Class for estimating T1 (and M0) using the closed-form linearised variable flip angle method
+*  @details
+*  @author MA Berks (c) Copyright QBI Lab, University of Manchester 2022
+*/
+
+#ifndef MDM_T1FITTERVFALINEAR_HDR
+#define MDM_T1FITTERVFALINEAR_HDR
+#include <madym/utils/mdm_api.h>
+#include "mdm_T1FitterBase.h"
+#include "mdm_T1FitterVFA.h"
+#include <madym/utils/mdm_ErrorTracker.h>
+#include <memory>
+
+//! Class for estimating T1 (and M0) using the closed-form linearised variable flip angle method
+/*!
+Rearranging the SPGR equation, S/sin(a) = E1.S/tan(a) + M0.(1 - E1), with E1 = exp(-TR/T1), so
+T1 and M0 follow from a straight line fit of S/sin(a) against S/tan(a) (DESPOT1). The line is
+first fitted unweighted, then refitted with each flip-angle weighted by (sin(a) / (1 - E1.cos(a)))^2,
+so that signal noise at each flip-angle contributes equally.
+
+Batches of voxels are fitted together in blocks, with the signals transposed so that each
+flip-angle's signals are contiguous, and the fit computed over the voxels of a block in each
+loop, which compilers can vectorise.
+
+Optionally, voxels whose linear fit is poor are refined with the nonlinear fit of mdm_T1FitterVFA.
+The fit is poor if the RMS residual of the modelled signals, relative to the RMS signal, exceeds
+the refinement tolerance, or if the linear fit does not give a valid T1.
+*/
+class mdm_T1FitterVFALinear : public mdm_T1FitterBase {
+
+public:
+
+	//! Constructor from set of FAs and repetition time
+	/*!
+	\param FAs vector of flip-angles in radians
+	\param TR repetition time in ms
+	\param usingB1 flag if we're correcting for B1
+	\param refineTol if > 0, voxels with relative RMS residual above this are refined with a nonlinear fit
+	*/
+	MDM_API mdm_T1FitterVFALinear(const std::vector<double> &FAs, const double TR,
+		const bool usingB1, const double refineTol = 0.0);
+
+	//! Default destructor
+	/*!
+	*/
+	MDM_API ~mdm_T1FitterVFALinear();
+
+	//! Set flip angles
+	/*!
+	\param FAs vector of flip-angles in radians
+	*/
+	MDM_API void setFAs(const std::vector<double> &FAs);
+
+	//! Set repetition time
+	/*!
+	\param TR repetition time
+	*/
+	MDM_API void setTR(const double TR);
+
+	//! Set inputs that vary on per voxel basis from which T1 will be estimated
+	/*!
+	If using B1 correction, inputs should be an nFA + 1 element vector, with signals in the first
+	nFA elements and the B1 correction at the end. Otherwise an nFA element vector signals.
+	\param inputs vector of signals (and B1 correction) from which T1 will be estimated
+	*/
+	MDM_API void setInputs(const std::vector<double> &inputs);
+
+	//! Perform T1 fit using the linearised variable flip angle method
+	/*!
+	\param T1value reference to hold computed T1
+	\param M0value reference to hold computed M0
+	\param EWvalue reference to hold computed efficiency weighting (always 1)
+	\return error code, T1_MAD_VALUE if the linear fit does not give a valid T1 and is not refined
+	*/
+	MDM_API mdm_ErrorTracker::ErrorCode fitT1(double &T1value, double &M0value, double &EWvalue);
+
+	//! Fit T1 for a batch of voxels
+	/*!
+	\param inputs inputs of each voxel, ordered as in setInputs, stored voxel by voxel
+	\param nVoxels number of voxels in the batch
+	\param nInputs number of inputs per voxel
+	\param T1values array of length nVoxels to hold computed T1
+	\param M0values array of length nVoxels to hold computed M0
+	\param EWvalues array of length nVoxels to hold computed efficiency weighting (always 1)
+	\param errCodes array of length nVoxels to hold the error code of each voxel's fit
+	*/
+	MDM_API void fitT1Batch(const double *inputs, const size_t nVoxels, const size_t nInputs,
+		double *T1values, double *M0values, double *EWvalues, mdm_ErrorTracker::ErrorCode *errCodes);
+
+	//! Set inputs for computing T1 from a single line of an input data stream buffer
+	/*!
+	\param ifs input data stream
+	\param nSignals number of signals in sample
+	\return false if streams EOF flag is reached, true otherwise
+	*/
+	MDM_API virtual bool setInputsFromStream(std::istream& ifs,
+		const int nSignals);
+
+	//! Set inputs for computing T1 from a row of input data
+	/*!
+	\param row input values, ordered as in a single line of an input data stream
+	\param nSignals number of signals in sample
+	*/
+	MDM_API virtual void setInputsFromRow(const std::vector<double> &row,
+		const int nSignals);
+
+	//! Return the number of input values in each sample
+	/*!
+	\param nSignals number of signals in sample
+	\return number of input values: FAs, signals and B1 if using B1 correction
+	*/
+	MDM_API virtual int numInputValues(const int nSignals) const;
+
+	//! Return minimum inputs required
+	/*
+	\return minimum number of input signals required for T1 fitting method
+	*/
+	MDM_API int minimumInputs() const;
+
+	//! Return maximum inputs allowed
+	/*
+	\return maximum number of input signals allowed in T1 fitting method
+	*/
+	MDM_API int maximumInputs() const;
+
+private:
+
+	//Fit a block of at most BlockSize voxels, with signals, cos and sin of the (B1 corrected)
+	//flip-angles already transposed into the block arrays
+	void fitBlock(const size_t n, double *T1, double *M0, double *residual);
+
+	void initFAs();
+
+	//Number of voxels fitted together
+	static constexpr size_t BlockSize = 64;
+
+	std::vector<double> FAs_;
+	double TR_;
+	double B1_;
+	bool usingB1_;
+	double refineTol_;
+
+	//Cached when FAs set
+	int nFAs_;
+	std::vector<double> cosFAs_;
+	std::vector<double> sinFAs_;
+
+	//Block arrays, stored flip-angle by flip-angle, so that element [i*BlockSize + v] is
+	//for flip-angle i of voxel v
+	std::vector<double> blockSignals_;
+	std::vector<double> blockCos_;
+	std::vector<double> blockSin_;
+
+	//Scratch for the linear fit residuals, the single voxel inputs, and the inputs of
+	//voxels refined by the nonlinear fit
+	std::vector<double> residuals_;
+	std::vector<double> inputs_;
+	std::vector<double> refineInputs_;
+
+	//Nonlinear fitter for refining poor linear fits, only created if refining
+	std::unique_ptr<mdm_T1FitterVFA> nonlinearFitter_;
+
+	static const double PI;
+
+};
+
+#endif /* MDM_T1FITTERVFALINEAR_HDR */
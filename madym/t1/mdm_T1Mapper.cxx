@@ -13,10 +13,12 @@
 
 #include <cassert>
 #include <chrono>  // chrono::system_clock
+#include <mutex>
 
 #include <madym/utils/mdm_ErrorTracker.h>
 #include <madym/utils/mdm_ProgramLogger.h>
 #include <madym/utils/mdm_exception.h>
+#include <madym/utils/mdm_ThreadPool.h>
 #include <boost/format.hpp>
 
 //
@@ -26,7 +28,11 @@ MDM_API mdm_T1Mapper::mdm_T1Mapper(mdm_ErrorTracker &errorTracker, mdm_Image3D &
   ROI_(ROI),
 	noiseThreshold_(0),
 	method_(mdm_T1MethodGenerator::T1Methods::VFA),
-	bigTR_(1e5)
+	bigTR_(1e5),
+  numThreads_(1),
+	closedFormInit_(false),
+	dictRefine_(true),
+	linearRefineTol_(0.0)
 {}
 
 //
@@ -83,14 +89,6 @@ MDM_API void mdm_T1Mapper::setB1(mdm_Image3D B1)
 //
 MDM_API void  mdm_T1Mapper::mapT1(mdm_T1MethodGenerator::T1Methods method, const std::vector<double>& init_params)
 {
-	//
-	auto nSignals = inputImages_.size();
-
-	//Instantiate T1 fitter object of required method type
-	auto T1Fitter = mdm_T1MethodGenerator::createFitter(method, inputImages_, bigTR_, init_params);
-
-	mdm_ErrorTracker::ErrorCode errCode = mdm_ErrorTracker::OK;
-
 	//
 	T1_.copy(inputImages_[0]);
 	T1_.setType(mdm_Image3D::ImageType::TYPE_T1BASELINE);
@@ -98,89 +96,109 @@ MDM_API void  mdm_T1Mapper::mapT1(mdm_T1MethodGenerator::T1Methods method, const
 	M0_.copy(inputImages_[0]);
 	M0_.setType(mdm_Image3D::ImageType::TYPE_M0MAP);
 
-  bool useROI = (bool)ROI_;
-  bool useB1_ = (bool)B1_ && method == mdm_T1MethodGenerator::VFA_B1;
-	bool fitEfficiencyWeighting = method == mdm_T1MethodGenerator::IR_E;
-
 	//Only initialise the efficiency weighting map if it is being fitted
-	if (fitEfficiencyWeighting)
+	if (mdm_T1MethodGenerator::fitsEfficiencyWeighting(method))
 	{
 		efficiencyWeighting_.copy(inputImages_[0]);
 		efficiencyWeighting_.setType(mdm_Image3D::ImageType::TYPE_M0MAP);
 	}
-		
+
+	//Partition the volume into slabs of whole slices (or rows if there are fewer
+	//slices than threads), which threads claim in turn until the volume is done
+	size_t nX, nY, nZ;
+	M0_.getDimensions(nX, nY, nZ);
+	const auto numVoxels = M0_.numVoxels();
+	auto nThreads = mdm_ThreadPool::numThreads(numThreads_, numVoxels);
+	const size_t slabSize = nZ >= nThreads ? nX * nY : nX;
+	mdm_ThreadPool::WorkQueue slabQueue(numVoxels, slabSize);
 
 	int numFitted = 0;
 	int numErrors = 0;
+	std::vector<std::pair<size_t, mdm_ErrorTracker::ErrorCode>> errors;
+	std::mutex resultsMutex;
+
 	auto fit_start = std::chrono::system_clock::now();
-	for (size_t voxelIndex = 0, n = M0_.numVoxels(); voxelIndex < n; voxelIndex++)
+	mdm_ThreadPool::run(nThreads, [&](size_t)
 	{
-		if (useROI && !ROI_.voxel(voxelIndex))
-			continue;
-
-		//Get signals at this voxel
-		std::vector<double> signal(nSignals);
-		bool valid_signal = true;
-		for (size_t i_f = 0; i_f < nSignals; i_f++)
+		//Instantiate T1 fitter object of required method type for this thread
+		auto T1Fitter = mdm_T1MethodGenerator::createFitter(method, inputImages_, bigTR_, init_params,
+			closedFormInit_, dictRefine_, linearRefineTol_);
+
+		//Errors are stored by each thread and merged into the error tracker afterwards
+		int threadFitted = 0;
+		std::vector<std::pair<size_t, mdm_ErrorTracker::ErrorCode>> threadErrors;
+		std::vector<double> inputs;
+
+		//Inputs of the voxels to fit in each slab are gathered, then fitted as a batch
+		std::vector<size_t> batchVoxels;
+		std::vector<double> batchInputs, batchT1, batchM0, batchEW;
+		std::vector<mdm_ErrorTracker::ErrorCode> batchErrors;
+
+		size_t begin, end;
+		while (slabQueue.next(begin, end))
 		{
-			signal[i_f] = inputImages_[i_f].voxel(voxelIndex);   /* sig FA_1 */
-			if (std::isnan(signal[i_f]) || std::isinf(signal[i_f]))
+			batchVoxels.clear();
+			batchInputs.clear();
+			size_t nInputs = 0;
+			for (size_t voxelIndex = begin; voxelIndex < end; voxelIndex++)
 			{
-				valid_signal = false;
-				break;
+				auto status = voxelInputs(voxelIndex, method, inputs, threadErrors);
+				if (status != NOT_MAPPED)
+					threadFitted++;
+
+				if (status == FIT)
+				{
+					batchVoxels.push_back(voxelIndex);
+					batchInputs.insert(batchInputs.end(), inputs.begin(), inputs.end());
+					nInputs = inputs.size();
+				}
 			}
-		}
 
-		//TODO - MB, why only check the first signal?				
-		if (valid_signal && (signal[0] > noiseThreshold_))
-		{
-      //If using B1 correction, add this to the inputs
-      if (useB1_)
-      {
-        auto B1 = B1_.voxel(voxelIndex);
-        if (B1 > 0)
-          signal.push_back(B1);
-        else
-        {
-          errorTracker_.updateVoxel(voxelIndex, mdm_ErrorTracker::B1_INVALID);
-          numErrors++;
-          continue;
-        }
-      }
-
-			//Compute T1 and M0
-			double T1, M0, EW;
-			T1Fitter->setInputs(signal);
-			errCode = T1Fitter->fitT1(T1, M0, EW);
-
-			//Check for errors
-			if (errCode != mdm_ErrorTracker::OK)
+			//Compute T1 and M0, skipping slabs with no voxels to fit (eg outside the ROI)
+			const auto nBatch = batchVoxels.size();
+			if (!nBatch)
+				continue;
+
+			batchT1.resize(nBatch);
+			batchM0.resize(nBatch);
+			batchEW.resize(nBatch);
+			batchErrors.resize(nBatch);
+			T1Fitter->fitT1Batch(batchInputs.data(), nBatch, nInputs,
+				batchT1.data(), batchM0.data(), batchEW.data(), batchErrors.data());
+
+			for (size_t i = 0; i < nBatch; i++)
 			{
-				errorTracker_.updateVoxel(voxelIndex, errCode);
-				numErrors++;
-			}
+				const auto voxelIndex = batchVoxels[i];
 
-			//Fill the image maps.
-			T1_.setVoxel(voxelIndex, T1);
-			M0_.setVoxel(voxelIndex, M0);
+				//Check for errors
+				if (batchErrors[i] != mdm_ErrorTracker::OK)
+					threadErrors.push_back({ voxelIndex, batchErrors[i] });
 
-			if (fitEfficiencyWeighting)
-				efficiencyWeighting_.setVoxel(voxelIndex, EW);
-		}
-		else
-		{
-			errorTracker_.updateVoxel(voxelIndex, mdm_ErrorTracker::VFA_THRESH_FAIL);
-			numErrors++;
+				//Fill the image maps.
+				T1_.setVoxel(voxelIndex, batchT1[i]);
+				M0_.setVoxel(voxelIndex, batchM0[i]);
+
+				if (mdm_T1MethodGenerator::fitsEfficiencyWeighting(method))
+					efficiencyWeighting_.setVoxel(voxelIndex, batchEW[i]);
+			}
 		}
-		numFitted++;
-	}
+
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		numFitted += threadFitted;
+		errors.insert(errors.end(), threadErrors.begin(), threadErrors.end());
+	}, &slabQueue);
+
+	for (const auto &error : errors)
+		errorTracker_.updateVoxel(error.first, error.second);
+	numErrors = (int)errors.size();
 
 	// Get end time and log results
 	auto fit_end = std::chrono::system_clock::now();
 	std::chrono::duration<double> elapsed_seconds = fit_end - fit_start;
 
 	mdm_ProgramLogger::logProgramMessage("Fitted " +
-    std::to_string(numFitted) + " voxels in " + std::to_string(elapsed_seconds.count()) + "s");
+    std::to_string(numFitted) + " voxels in " + std::to_string(elapsed_seconds.count()) + "s"
+		+ (nThreads > 1 ? " using " + std::to_string(nThreads) + " threads" : ""));
   if (numErrors)
     mdm_ProgramLogger::logProgramWarning(__func__, 
       std::to_string(numErrors) + " voxels returned fit errors");
@@ -288,6 +306,79 @@ MDM_API void  mdm_T1Mapper::setBigTR(double TR)
 {
 	bigTR_ = TR;
 }
+
+//
+MDM_API void  mdm_T1Mapper::setNumThreads(int nThreads)
+{
+	numThreads_ = nThreads;
+}
+
+//
+MDM_API void  mdm_T1Mapper::setClosedFormInit(bool flag)
+{
+	closedFormInit_ = flag;
+}
+
+//
+MDM_API void  mdm_T1Mapper::setDictionaryRefine(bool flag)
+{
+	dictRefine_ = flag;
+}
+
+//
+MDM_API void  mdm_T1Mapper::setLinearRefineTolerance(double tol)
+{
+	if (tol < 0)
+		throw mdm_exception(__func__, boost::format(
+			"Linear fit refinement tolerance (%1%) must be >= 0") % tol);
+	linearRefineTol_ = tol;
+}
 //******************************************************************
 //Private methods
-//******************************************************************
\ No newline at end of file
+//******************************************************************
+
+//
+mdm_T1Mapper::VoxelStatus mdm_T1Mapper::voxelInputs(size_t voxelIndex,
+	mdm_T1MethodGenerator::T1Methods method,
+	std::vector<double> &inputs,
+	std::vector<std::pair<size_t, mdm_ErrorTracker::ErrorCode>> &errors)
+{
+	if (ROI_ && !ROI_.voxel(voxelIndex))
+		return NOT_MAPPED;
+
+	//Get signals at this voxel
+	auto nSignals = inputImages_.size();
+	inputs.resize(nSignals);
+	bool valid_signal = true;
+	for (size_t i_f = 0; i_f < nSignals; i_f++)
+	{
+		inputs[i_f] = inputImages_[i_f].voxel(voxelIndex);   /* sig FA_1 */
+		if (std::isnan(inputs[i_f]) || std::isinf(inputs[i_f]))
+		{
+			valid_signal = false;
+			break;
+		}
+	}
+
+	//TODO - MB, why only check the first signal?				
+	if (!valid_signal || !(inputs[0] > noiseThreshold_))
+	{
+		errors.push_back({ voxelIndex, mdm_ErrorTracker::VFA_THRESH_FAIL });
+		return NOT_FITTED;
+	}
+
+  //If using B1 correction, add this to the inputs
+  if (B1_ && mdm_T1MethodGenerator::usesB1(method))
+  {
+    auto B1 = B1_.voxel(voxelIndex);
+    if (B1 > 0)
+      inputs.push_back(B1);
+    else
+    {
+      errors.push_back({ voxelIndex, mdm_ErrorTracker::B1_INVALID });
+      return NOT_MAPPED;
+    }
+  }
+
+	return FIT;
+}
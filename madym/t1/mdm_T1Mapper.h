@@ -174,11 +174,50 @@ public:
   */
   MDM_API void  setBigTR(double TR);
 
+  //! Set number of threads used to map T1
+  /*!
+  \param nThreads number of worker threads. If 0, uses all available hardware threads
+  */
+  MDM_API void  setNumThreads(int nThreads);
+
+  //! Set whether IR_E fits are initialised from a closed-form estimate
+  /*!
+  \param flag if true, T1 and M0 are initialised from a closed-form estimate, rather than an
+  initial inversion recovery fit with efficiency weighting fixed to 1
+  */
+  MDM_API void  setClosedFormInit(bool flag);
+
+  //! Set whether T1 matched by dictionary methods is refined
+  /*!
+  \param flag if true, T1 matched to the dictionary is refined with a single Gauss-Newton step
+  */
+  MDM_API void  setDictionaryRefine(bool flag);
+
+  //! Set tolerance for refining linear VFA fits
+  /*!
+  \param tol if > 0, linear VFA fits with RMS residual, relative to RMS signal, above this are
+  refined with a nonlinear fit. Must be >= 0
+  */
+  MDM_API void  setLinearRefineTolerance(double tol);
+
 protected:
 
 private:
 
+	//Status of a voxel's inputs
+	enum VoxelStatus {
+		NOT_MAPPED, //Outside ROI, or B1 invalid, not included in fitted count
+		NOT_FITTED, //Signals invalid or below noise threshold
+		FIT //Inputs valid to fit
+	};
+
 	//Methods:
+	//Get the inputs (signals, and B1 if used) to fit T1 at a single voxel
+	VoxelStatus voxelInputs(size_t voxelIndex,
+		mdm_T1MethodGenerator::T1Methods method,
+		std::vector<double> &inputs,
+		std::vector<std::pair<size_t, mdm_ErrorTracker::ErrorCode>> &errors);
+
 
 	//
 	std::vector<mdm_Image3D> inputImages_;
@@ -202,5 +241,17 @@ private:
 
 	double bigTR_;
 
+	//Number of threads used to map T1
+	int numThreads_;
+
+	//Initialise IR_E fits from a closed-form estimate
+	bool closedFormInit_;
+
+	//Refine T1 matched by dictionary methods
+	bool dictRefine_;
+
+	//Relative residual above which linear VFA fits are refined
+	double linearRefineTol_;
+
 };
 #endif /* mdm_T1VolumeAnalysis_HDR */
@@ -19,6 +19,8 @@
 #include <madym/t1/mdm_T1FitterBase.h>
 #include <madym/t1/mdm_T1FitterVFA.h>
 #include <madym/t1/mdm_T1FitterIR.h>
+#include <madym/t1/mdm_T1FitterDictionary.h>
+#include <madym/t1/mdm_T1FitterVFALinear.h>
 
 //!Header only class to generate specific instances of DCE models
 /*! 
@@ -45,6 +47,12 @@ public:
     VFA_B1, ///> Variable flip-angle method B1 corrected
 		IR, ///> Inversion recovery method
 		IR_E, ///> Inversion recovery method with efficieny weighting
+		VFA_DICT, ///> Variable flip-angle method, matched to a signal dictionary
+		VFA_B1_DICT, ///> Variable flip-angle method B1 corrected, matched to a signal dictionary
+		IR_DICT, ///> Inversion recovery method, matched to a signal dictionary
+		IR_E_DICT, ///> Inversion recovery method with efficieny weighting, matched to a signal dictionary
+		VFA_LINEAR, ///> Variable flip-angle method, closed-form linear fit
+		VFA_B1_LINEAR, ///> Variable flip-angle method B1 corrected, closed-form linear fit
 	};
 
   //! Returns list of implemented model names
@@ -57,7 +65,13 @@ public:
 	    toString(VFA),
       toString(VFA_B1),
       toString(IR),
-			toString(IR_E)
+			toString(IR_E),
+			toString(VFA_DICT),
+			toString(VFA_B1_DICT),
+			toString(IR_DICT),
+			toString(IR_E_DICT),
+			toString(VFA_LINEAR),
+			toString(VFA_B1_LINEAR)
 		};
 	}
 
@@ -74,6 +88,12 @@ public:
     case VFA_B1: return "VFA_B1";
     case IR: return "IR";
 		case IR_E: return "IR_E";
+		case VFA_DICT: return "VFA_DICT";
+		case VFA_B1_DICT: return "VFA_B1_DICT";
+		case IR_DICT: return "IR_DICT";
+		case IR_E_DICT: return "IR_E_DICT";
+		case VFA_LINEAR: return "VFA_LINEAR";
+		case VFA_B1_LINEAR: return "VFA_B1_LINEAR";
     default:
       throw mdm_exception(__func__, "T1 method " + std::to_string(methodType) + " not valid");
     }
@@ -106,10 +126,66 @@ public:
 		else if (method == toString(IR_E))
 			return IR_E;
 
+		else if (method == toString(VFA_DICT))
+		{
+			if (B1Correction)
+			{
+				mdm_ProgramLogger::logProgramWarning(__func__,
+					"T1 mapping method VFA_DICT selected, with B1 correction set to true. Using method VFA_B1_DICT instead.");
+				return VFA_B1_DICT;
+			}
+			return VFA_DICT;
+		}
+
+		else if (method == toString(VFA_B1_DICT))
+			return VFA_B1_DICT;
+
+		else if (method == toString(IR_DICT))
+			return IR_DICT;
+
+		else if (method == toString(IR_E_DICT))
+			return IR_E_DICT;
+
+		else if (method == toString(VFA_LINEAR))
+		{
+			if (B1Correction)
+			{
+				mdm_ProgramLogger::logProgramWarning(__func__,
+					"T1 mapping method VFA_LINEAR selected, with B1 correction set to true. Using method VFA_B1_LINEAR instead.");
+				return VFA_B1_LINEAR;
+			}
+			return VFA_LINEAR;
+		}
+
+		else if (method == toString(VFA_B1_LINEAR))
+			return VFA_B1_LINEAR;
+
 		else
 			throw mdm_exception(__func__, "T1 method " + method + " not recognised");
 	}
 
+	//! Return true if T1 method uses a B1 correction input
+	/*
+	\param method enum code of T1 method
+	
+eturn true if method is B1 corrected
+	*/
+	MDM_API static bool usesB1(T1Methods method)
+	{
+		return method == VFA_B1 || method == VFA_B1_DICT || method == VFA_B1_LINEAR;
+	}
+
+	//! Return true if T1 method fits efficiency weighting
+	/*
+	\param method enum code of T1 method
+	
+eturn true if method fits efficiency weighting as well as T1 and M0
+	*/
+	MDM_API static bool fitsEfficiencyWeighting(T1Methods method)
+	{
+		return method == IR_E || method == IR_E_DICT;
+	}
+
   //! Factory method for creating specific T1 mapping object given user specified method
 	/*! 
 	This overload is for use with volume analysis, and in addition to returning an object of
@@ -118,10 +194,15 @@ public:
 	\param methodType enum code of specified T1 method
 	\param inputImages signal input images
 	\param bigTR TR used by inversion recovery methods
+	\param init_params initial values for T1 and M0
+	\param closedFormInit if true, IR_E fits are initialised from a closed-form estimate of T1 and M0
+	\param dictRefine if true, dictionary methods refine the matched T1 with a Gauss-Newton step
+	\param linearRefineTol if > 0, linear VFA fits with relative residual above this are refined with a nonlinear fit
 	\return shared pointer to T1 fitter using specified method
 	*/
 	MDM_API static std::unique_ptr<mdm_T1FitterBase> createFitter( 
-		T1Methods methodType, const std::vector<mdm_Image3D> &inputImages, const double &bigTR, const std::vector<double>& init_params)
+		T1Methods methodType, const std::vector<mdm_Image3D> &inputImages, const double &bigTR, const std::vector<double>& init_params,
+		bool closedFormInit = false, bool dictRefine = true, double linearRefineTol = 0.0)
   {
 		const auto &nSignals = inputImages.size();
     const auto PI = acos(-1.0);
@@ -131,7 +212,7 @@ public:
 		case VFA:
 		{
 			std::vector<double> FAs;
-			for (auto img : inputImages)
+			for (const auto &img : inputImages)
 				FAs.push_back(img.info().flipAngle.value()  * PI / 180);
 
 			//Get tr value from first FA image - assume same for all images?
@@ -142,7 +223,7 @@ public:
     case VFA_B1:
     {
       std::vector<double> FAs;
-      for (auto img : inputImages)
+      for (const auto &img : inputImages)
         FAs.push_back(img.info().flipAngle.value()  * PI / 180);
 
       //Get tr value from first FA image - assume same for all images?
@@ -153,7 +234,7 @@ public:
     case IR:
     {
       std::vector<double> TIs;
-      for (auto img : inputImages)
+      for (const auto &img : inputImages)
         TIs.push_back(img.info().TI.value());
 
       return std::make_unique<mdm_T1FitterIR>(TIs, bigTR, false, init_params);
@@ -161,10 +242,43 @@ public:
 		case IR_E:
 		{
 			std::vector<double> TIs;
-			for (auto img : inputImages)
+			for (const auto &img : inputImages)
 				TIs.push_back(img.info().TI.value());
 
-			return std::make_unique<mdm_T1FitterIR>(TIs, bigTR, true, init_params);
+			return std::make_unique<mdm_T1FitterIR>(TIs, bigTR, true, init_params, closedFormInit);
+		}
+		case VFA_DICT:
+		case VFA_B1_DICT:
+		{
+			std::vector<double> FAs;
+			for (const auto &img : inputImages)
+				FAs.push_back(img.info().flipAngle.value()  * PI / 180);
+
+			double TR = inputImages[0].info().TR.value();
+
+			return std::make_unique<mdm_T1FitterDictionary>(mdm_T1FitterDictionary::VFA,
+				FAs, TR, methodType == VFA_B1_DICT, dictRefine);
+		}
+		case IR_DICT:
+		case IR_E_DICT:
+		{
+			std::vector<double> TIs;
+			for (const auto &img : inputImages)
+				TIs.push_back(img.info().TI.value());
+
+			return std::make_unique<mdm_T1FitterDictionary>(mdm_T1FitterDictionary::IR,
+				TIs, bigTR, methodType == IR_E_DICT, dictRefine);
+		}
+		case VFA_LINEAR:
+		case VFA_B1_LINEAR:
+		{
+			std::vector<double> FAs;
+			for (const auto &img : inputImages)
+				FAs.push_back(img.info().flipAngle.value()  * PI / 180);
+
+			double TR = inputImages[0].info().TR.value();
+
+			return std::make_unique<mdm_T1FitterVFALinear>(FAs, TR, methodType == VFA_B1_LINEAR, linearRefineTol);
 		}
 		default:
       throw mdm_exception(__func__, "T1 method " + std::to_string(methodType) + " not valid");
@@ -206,7 +320,32 @@ public:
 		case IR_E:
 		{
 			std::vector<double> empty;
-			auto T1Fitter = std::make_unique<mdm_T1FitterIR>(empty, options.TR(), true, options.T1InitialParams());
+			auto T1Fitter = std::make_unique<mdm_T1FitterIR>(empty, options.TR(), true, options.T1InitialParams(),
+				options.T1ClosedFormInit());
+			return T1Fitter;
+		}
+		case VFA_DICT:
+		case VFA_B1_DICT:
+		{
+			std::vector<double> empty;
+			auto T1Fitter = std::make_unique<mdm_T1FitterDictionary>(mdm_T1FitterDictionary::VFA,
+				empty, options.TR(), method == VFA_B1_DICT, options.T1DictRefine());
+			return T1Fitter;
+		}
+		case IR_DICT:
+		case IR_E_DICT:
+		{
+			std::vector<double> empty;
+			auto T1Fitter = std::make_unique<mdm_T1FitterDictionary>(mdm_T1FitterDictionary::IR,
+				empty, options.TR(), method == IR_E_DICT, options.T1DictRefine());
+			return T1Fitter;
+		}
+		case VFA_LINEAR:
+		case VFA_B1_LINEAR:
+		{
+			std::vector<double> empty;
+			auto T1Fitter = std::make_unique<mdm_T1FitterVFALinear>(empty, options.TR(),
+				method == VFA_B1_LINEAR, options.T1LinearRefineTol());
 			return T1Fitter;
 		}
 		default:
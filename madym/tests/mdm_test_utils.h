@@ -9,6 +9,8 @@
 #include <boost/filesystem.hpp>
 #include "mdm_version.h"
 #include <random>
+#include <fstream>
+#include <madym/dce/mdm_AIF.h>
 
 //! Macro to make checking vectors are equal easier
 #define BOOST_CHECK_VECTORS(v1, v2) \
@@ -97,6 +99,44 @@ public:
 		return matched;
 	}
 
+	//! Create AIF from the calibration dynamic times and AIF files
+	/*!
+	Sets the AIF times, prebolus image, haematocrit and dose. The AIF and PIF types are
+	not set.
+	* \param AIF reference to AIF to set
+	*/
+	static void make_calibration_AIF(mdm_AIF &AIF)
+	{
+		//Read in dynamic times from calibration file
+		int nTimes;
+		std::string timesFileName(calibration_dir() + "dyn_times.dat");
+		std::ifstream timesFileStream(timesFileName, std::ios::in | std::ios::binary);
+		timesFileStream.read(reinterpret_cast<char*>(&nTimes), sizeof(int));
+
+		std::vector<double> dynTimes(nTimes);
+		for (double &t : dynTimes)
+			timesFileStream.read(reinterpret_cast<char*>(&t), sizeof(double));
+		timesFileStream.close();
+
+		//For the AIF, read in the injection image, haematocrit correction and dose
+		int injectionImage;
+		double hct;
+		double dose;
+
+		std::string aifFileName(calibration_dir() + "aif.dat");
+		std::ifstream aifFileStream(aifFileName, std::ios::in | std::ios::binary);
+		aifFileStream.read(reinterpret_cast<char*>(&injectionImage), sizeof(int));
+		aifFileStream.read(reinterpret_cast<char*>(&hct), sizeof(double));
+		aifFileStream.read(reinterpret_cast<char*>(&dose), sizeof(double));
+		aifFileStream.close();
+
+		//Set AIF
+		AIF.setAIFTimes(dynTimes);
+		AIF.setPrebolus(injectionImage);
+		AIF.setHct(hct);
+		AIF.setDose(dose);
+	}
+
 	//! Add random Gaussian noise to time-series data
 	/*!
 	* \param time_series reference to vector of data to which noise will be added
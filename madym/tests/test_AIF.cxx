@@ -2,7 +2,9 @@
 #include <boost/format.hpp>
 
 #include <iostream>
+#include <cmath>
 #include <madym/dce/mdm_AIF.h>
+#include <madym/dce/mdm_Convolution.h>
 #include <madym/tests/mdm_test_utils.h>
 
 BOOST_AUTO_TEST_SUITE(test_mdm)
@@ -85,6 +87,9 @@ BOOST_AUTO_TEST_CASE(test_AIF) {
 
 	//Repeat tests for PIF
 	AIF_pop.setPIFType(mdm_AIF::PIF_POP);
+
+	//Calibration PIF was generated by literal convolution, so use that to get identical values
+	AIF_pop.setPIFConvolution(mdm_Convolution::LITERAL);
 	AIF_pop.resample_PIF( 0);
 
 	BOOST_TEST_MESSAGE("Testing population PIF values match");
@@ -106,4 +111,185 @@ BOOST_AUTO_TEST_CASE(test_AIF) {
 
 }
 
+BOOST_AUTO_TEST_CASE(test_AIF_cache) {
+	BOOST_TEST_MESSAGE("======= Testing cached AIF resampling =======");
+
+	//Regular times, 2.5s apart, in minutes
+	const int nTimes = 100;
+	std::vector<double> dynTimes(nTimes);
+	for (int i = 0; i < nTimes; i++)
+		dynTimes[i] = i * 2.5 / 60;
+
+	auto make_AIF = [&](mdm_AIF &AIF) {
+		AIF.setAIFType(mdm_AIF::AIF_POP);
+		AIF.setPIFType(mdm_AIF::PIF_POP);
+		AIF.setPrebolus(8);
+		AIF.setAIFTimes(dynTimes);
+	};
+
+	//Visit more offsets than fit in the cache, then revisit them in reverse, so we get
+	//a mixture of unchanged, cached and evicted offsets. Each must match the input
+	//functions generated from scratch
+	std::vector<double> offsets;
+	for (int i = 0; i < 12; i++)
+		offsets.push_back(0.01 * i);
+	std::vector<double> revisits(offsets.rbegin(), offsets.rend());
+	offsets.insert(offsets.end(), revisits.begin(), revisits.end());
+
+	mdm_AIF AIF_cached;
+	make_AIF(AIF_cached);
+	bool aifMatch = true, pifMatch = true;
+	for (size_t i = 0; i < offsets.size(); i++)
+	{
+		const double tau_a = offsets[i];
+		const double tau_v = offsets[(i + 3) % offsets.size()];
+		AIF_cached.resample_AIF(tau_a);
+		AIF_cached.resample_AIF(tau_a);
+		AIF_cached.resample_PIF(tau_v, false, true);
+
+		mdm_AIF AIF_new;
+		make_AIF(AIF_new);
+		AIF_new.resample_AIF(tau_a);
+		AIF_new.resample_PIF(tau_v, false, true);
+
+		aifMatch = aifMatch && AIF_cached.AIF() == AIF_new.AIF();
+		pifMatch = pifMatch && AIF_cached.PIF() == AIF_new.PIF();
+	}
+	BOOST_TEST_MESSAGE("Testing cached AIF values match");
+	BOOST_CHECK(aifMatch);
+	BOOST_TEST_MESSAGE("Testing cached PIF values match");
+	BOOST_CHECK(pifMatch);
+
+	//Changing the dose must invalidate the cache - population AIF is linear in dose
+	BOOST_TEST_MESSAGE("Testing cache is invalidated when AIF parameters change");
+	AIF_cached.resample_AIF(0);
+	auto aif0 = AIF_cached.AIF();
+	AIF_cached.setDose(2 * AIF_cached.dose());
+	AIF_cached.resample_AIF(0);
+	for (auto &a : aif0)
+		a *= 2;
+	BOOST_CHECK(mdm_test_utils::vectors_near_equal(AIF_cached.AIF(), aif0, 1e-10));
+}
+
+BOOST_AUTO_TEST_CASE(test_AIF_resample) {
+	BOOST_TEST_MESSAGE("======= Testing linear resampling of AIF from file =======");
+
+	//High temporal resolution, irregularly spaced times, in minutes
+	const int nTimes = 600;
+	const double hct = 0.42;
+	std::vector<double> dynTimes(nTimes), aifVals(nTimes);
+	double t = 0;
+	for (int i = 0; i < nTimes; i++)
+	{
+		dynTimes[i] = t;
+		aifVals[i] = t * std::exp(-2 * t) + 0.1 * std::sin(10 * t);
+		t += (i % 3 + 1) / 60.0;
+	}
+
+	//Reference resampling, searching the full time series for each time-point
+	auto reference_resample = [&](double tOffset) {
+		std::vector<double> resampled(nTimes, 0);
+		for (int i = 1; i < nTimes; i++)
+		{
+			for (int j = 1; j < nTimes; j++)
+			{
+				double t0 = dynTimes[j - 1] + tOffset;
+				double t1 = dynTimes[j] + tOffset;
+				if (dynTimes[i] > t0 && dynTimes[i] <= t1)
+				{
+					double delta_t = t1 - t0;
+					double remainder = dynTimes[i] - t0;
+					resampled[i] = ((remainder / delta_t) * aifVals[j]
+						+ (1.0 - remainder / delta_t) * aifVals[j - 1])
+						/ (1.0 - hct);
+					break;
+				}
+			}
+		}
+		return resampled;
+	};
+
+	for (double tOffset : { 0.0, 0.01, -0.01, 0.123, -0.25, 0.5 })
+	{
+		mdm_AIF AIF;
+		AIF.setAIFTimes(dynTimes);
+		AIF.setHct(hct);
+		AIF.setBaseAIF(aifVals);
+		AIF.setAIFType(mdm_AIF::AIF_MAP);
+		AIF.resample_AIF(tOffset);
+
+		BOOST_TEST_MESSAGE(boost::format("Testing resampled AIF matches at offset %1%") % tOffset);
+		auto referenceAIF = reference_resample(tOffset);
+		BOOST_CHECK_VECTORS(AIF.AIF(), referenceAIF);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_AIF_PIF_convolution) {
+	BOOST_TEST_MESSAGE("======= Testing population PIF convolution methods =======");
+
+	//Check each method against the literal convolution, for an IRF with an arbitrary head
+	//and exponential tail
+	const size_t n = 200, nHead = 7;
+	std::vector<double> x(n), h(n), yLiteral(n), yRecursive(n), yFFT(n);
+	const double tailWeights[2] = { 0.3, 0.05 };
+	const double tailRatios[2] = { 0.6, 0.95 };
+	for (size_t i = 0; i < n; i++)
+	{
+		x[i] = std::sin(0.1 * i) + 0.01 * i;
+		if (i < nHead)
+			h[i] = 0.1 * i * (i % 2);
+		else
+			h[i] = tailWeights[0] * std::pow(tailRatios[0], i - nHead)
+				+ tailWeights[1] * std::pow(tailRatios[1], i - nHead);
+	}
+	mdm_Convolution::literal(x.data(), h.data(), n, yLiteral.data());
+	mdm_Convolution::recursive(x.data(), h.data(), nHead, tailWeights, tailRatios, 2, n,
+		yRecursive.data());
+	mdm_Convolution::fft(x.data(), h.data(), n, yFFT.data());
+
+	BOOST_TEST_MESSAGE("Testing recursive convolution matches literal convolution");
+	BOOST_CHECK(mdm_test_utils::vectors_near_equal(yRecursive, yLiteral, 1e-10));
+	BOOST_TEST_MESSAGE("Testing FFT convolution matches literal convolution");
+	BOOST_CHECK(mdm_test_utils::vectors_near_equal(yFFT, yLiteral, 1e-10));
+
+	//Now check population PIFs, for regular times (where the recursive method is used)
+	//and irregular times (where the recursive method falls back to literal convolution)
+	const int nTimes = 150;
+	std::vector<double> regularTimes(nTimes), irregularTimes(nTimes);
+	double t = 0;
+	for (int i = 0; i < nTimes; i++)
+	{
+		regularTimes[i] = i * 2.5 / 60;
+		irregularTimes[i] = t;
+		t += (i % 3 + 1) / 60.0;
+	}
+
+	auto make_PIF = [](const std::vector<double> &dynTimes,
+		mdm_Convolution::ConvolutionType convolution, double tOffset) {
+		mdm_AIF AIF;
+		AIF.setAIFType(mdm_AIF::AIF_POP);
+		AIF.setPIFType(mdm_AIF::PIF_POP);
+		AIF.setPrebolus(8);
+		AIF.setAIFTimes(dynTimes);
+		AIF.setPIFConvolution(convolution);
+		AIF.resample_PIF(tOffset);
+		return AIF.PIF();
+	};
+
+	for (const auto &dynTimes : { regularTimes, irregularTimes })
+	{
+		for (double tOffset : { 0.0, 0.05, 0.123, -0.1 })
+		{
+			auto pifLiteral = make_PIF(dynTimes, mdm_Convolution::LITERAL, tOffset);
+			auto pifRecursive = make_PIF(dynTimes, mdm_Convolution::RECURSIVE, tOffset);
+			auto pifFFT = make_PIF(dynTimes, mdm_Convolution::FFT, tOffset);
+
+			BOOST_TEST_MESSAGE(boost::format(
+				"Testing PIF convolution methods match at offset %1%") % tOffset);
+			BOOST_CHECK(mdm_test_utils::vectors_near_equal(pifRecursive, pifLiteral, 1e-10));
+			BOOST_CHECK(mdm_test_utils::vectors_near_equal(pifFFT, pifLiteral, 1e-10));
+		}
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END() //
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <iomanip>
 #include <string>
+#include <chrono>
 
 #include <madym/dce/mdm_AIF.h>
 #include <madym/tests/mdm_test_utils.h>
@@ -13,24 +14,21 @@
 #include <madym/dce/mdm_DCEModelFitter.h>
 
 
-void test_model_time_fit(
+//Read in the model calibration file - this has noise added to it
+static void read_calibration_fit_data(
 	const std::string &modelName,
-	const std::vector<int> fixedParams,
-	mdm_AIF &AIF,
-	const double paramTol,
-	const double sseTol,
-	bool test_IAUC = false)
+	const size_t nTimes,
+	std::vector<double> &trueParams,
+	std::vector<double> &CtCalibration)
 {
-	//Read in the model calibration file - this has noise added to it
-	auto nTimes = AIF.AIFTimes().size();
 	int nParams;
-	std::vector<double> CtCalibration(nTimes);
+	CtCalibration.resize(nTimes);
 	std::string modelFileName = mdm_test_utils::calibration_dir() + modelName + "_noise.dat";
 
 	std::ifstream modelFileStream(modelFileName, std::ios::in | std::ios::binary);
 	modelFileStream.read(reinterpret_cast<char*>(&nParams), sizeof(int));
 
-	std::vector<double> trueParams(nParams);
+	trueParams.resize(nParams);
 	for (double &p : trueParams)
 		modelFileStream.read(reinterpret_cast<char*>(&p), sizeof(double));
 	for (double &c : CtCalibration)
@@ -38,6 +36,21 @@ void test_model_time_fit(
 	modelFileStream.close();
 	BOOST_TEST_MESSAGE(boost::format(
 		"Read time series for %1% from binary calibration file") % modelName);
+}
+
+void test_model_time_fit(
+	const std::string &modelName,
+	const std::vector<int> fixedParams,
+	mdm_AIF &AIF,
+	const double paramTol,
+	const double sseTol,
+	bool test_IAUC = false,
+	const std::string &fitterType = "BLEIC")
+{
+	auto nTimes = AIF.AIFTimes().size();
+	std::vector<double> trueParams, CtCalibration;
+	read_calibration_fit_data(modelName, nTimes, trueParams, CtCalibration);
+	int nParams = (int)trueParams.size();
 
 	int nIAUC;
 	std::vector<double> IAUCTimes;
@@ -82,7 +95,7 @@ void test_model_time_fit(
     0,
     nTimes,
     {},
-		"BLEIC"
+		fitterType
   );
 
 	mdm_DCEVoxel vox(
@@ -106,7 +119,7 @@ void test_model_time_fit(
 	}
 
 	BOOST_TEST_MESSAGE(boost::format("Model SSE = %1$.4f") % fitter.modelFitError());
-	BOOST_TEST_MESSAGE("Test DCE models, values match: " + modelName);
+	BOOST_TEST_MESSAGE("Test DCE models, values match: " + modelName + ", " + fitterType);
 	BOOST_CHECK(mdm_test_utils::vectors_near_equal_rel(
 		model->params(), trueParams, paramTol));
 
@@ -126,40 +139,87 @@ void test_model_time_fit(
 	}
 }
 
+//Time repeated fits to the calibration time-series, returning the mean number of
+//optimiser iterations and wall time per voxel
+static void benchmark_model_fit(
+	const std::string &modelName,
+	const std::vector<int> fixedParams,
+	mdm_AIF &AIF,
+	const std::string &fitterType,
+	const int nRepeats,
+	double &iterationsPerVoxel,
+	double &timePerVoxel,
+	double &sse)
+{
+	auto nTimes = AIF.AIFTimes().size();
+	std::vector<double> trueParams, CtCalibration;
+	read_calibration_fit_data(modelName, nTimes, trueParams, CtCalibration);
+
+	AIF.setAIFType(mdm_AIF::AIF_TYPE::AIF_POP);
+	AIF.setPIFType(mdm_AIF::PIF_TYPE::PIF_POP);
+	auto model = mdm_DCEModelGenerator::createModel(AIF,
+		mdm_DCEModelGenerator::ParseModelName(modelName), {},
+		{}, fixedParams, {}, {}, {}, {}, {}, -1, {});
+
+	mdm_DCEModelFitter fitter(*model, 0, nTimes, {}, fitterType);
+	mdm_DCEVoxel vox({}, CtCalibration, AIF.prebolus(), AIF.AIFTimes(), {}, false);
+	vox.testEnhancing();
+
+	int iterations = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < nRepeats; i++)
+	{
+		fitter.initialiseModelFit(vox.CtData());
+		fitter.fitModel(vox.status());
+		iterations += fitter.numIterations();
+	}
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+	iterationsPerVoxel = double(iterations) / nRepeats;
+	timePerVoxel = elapsed.count() / nRepeats;
+	sse = fitter.modelFitError();
+}
+
+//Fit the calibration time-series with repeat starts for the bolus arrival time,
+//returning the fitted parameters, SSE and total optimiser iterations
+static void repeat_model_fit(
+	const std::string &modelName,
+	mdm_AIF &AIF,
+	const int repeatParam,
+	const std::vector<double> &repeatValues,
+	const bool prune,
+	std::vector<double> &params,
+	double &sse,
+	int &iterations)
+{
+	auto nTimes = AIF.AIFTimes().size();
+	std::vector<double> trueParams, CtCalibration;
+	read_calibration_fit_data(modelName, nTimes, trueParams, CtCalibration);
+
+	AIF.setAIFType(mdm_AIF::AIF_TYPE::AIF_POP);
+	AIF.setPIFType(mdm_AIF::PIF_TYPE::PIF_POP);
+	auto model = mdm_DCEModelGenerator::createModel(AIF,
+		mdm_DCEModelGenerator::ParseModelName(modelName), {},
+		{}, {}, {}, {}, {}, {}, {}, repeatParam, repeatValues);
+
+	mdm_DCEModelFitter fitter(*model, 0, nTimes, {}, "BLEIC");
+	fitter.setRepeatPruning(prune);
+	mdm_DCEVoxel vox({}, CtCalibration, AIF.prebolus(), AIF.AIFTimes(), {}, false);
+	vox.testEnhancing();
+	fitter.initialiseModelFit(vox.CtData());
+	fitter.fitModel(vox.status());
+
+	params = model->params();
+	sse = fitter.modelFitError();
+	iterations = fitter.numIterations();
+}
+
 BOOST_AUTO_TEST_SUITE(test_mdm)
 
 BOOST_AUTO_TEST_CASE(test_DCE_fit) {
 	BOOST_TEST_MESSAGE("======= Testing DCE model optimisation =======");
-	//Read in dynamic times from calibration file
-	int nTimes;
-	std::string timesFileName(mdm_test_utils::calibration_dir() + "dyn_times.dat");
-	std::ifstream timesFileStream(timesFileName, std::ios::in | std::ios::binary);
-	timesFileStream.read(reinterpret_cast<char*>(&nTimes), sizeof(int));
-
-	std::vector<double> dynTimes(nTimes);
-	for (double &t : dynTimes)
-		timesFileStream.read(reinterpret_cast<char*>(&t), sizeof(double));
-	timesFileStream.close();
-
-	//For the AIF, read in the injection image, haematocrit correction and dose
-	//then the values
-	int injectionImage;
-	double hct;
-	double dose;
-
-	std::string aifFileName(mdm_test_utils::calibration_dir() + "aif.dat");
-	std::ifstream aifFileStream(aifFileName, std::ios::in | std::ios::binary);
-	aifFileStream.read(reinterpret_cast<char*>(&injectionImage), sizeof(int));
-	aifFileStream.read(reinterpret_cast<char*>(&hct), sizeof(double));
-	aifFileStream.read(reinterpret_cast<char*>(&dose), sizeof(double));
-	aifFileStream.close();
-
-	//Create AIF
 	mdm_AIF AIF;
-	AIF.setAIFTimes(dynTimes);
-	AIF.setPrebolus(injectionImage);
-	AIF.setHct(hct);
-	AIF.setDose(dose);
+	mdm_test_utils::make_calibration_AIF(AIF);
 
 	//Create model concentrations for each model type
 	test_model_time_fit(
@@ -187,4 +247,161 @@ BOOST_AUTO_TEST_CASE(test_DCE_fit) {
     "PATLAK", {},
     AIF, 0.5, 0.0005);
 }
-BOOST_AUTO_TEST_SUITE_END() //
\ No newline at end of file
+
+BOOST_AUTO_TEST_CASE(test_DCE_fit_LM) {
+	BOOST_TEST_MESSAGE("======= Testing DCE model optimisation using Levenberg-Marquardt =======");
+	mdm_AIF AIF;
+	mdm_test_utils::make_calibration_AIF(AIF);
+
+	test_model_time_fit(
+		"ETM", {},
+		AIF, 0.1, 0.0005, false, "LM");
+	test_model_time_fit(
+		"DIETM", {6},
+		AIF, 0.5, 0.0005, false, "LM");
+	test_model_time_fit(
+		"AUEM", {7},
+		AIF, 0.5, 0.0005, false, "LM");
+	test_model_time_fit(
+		"2CXM", {},
+		AIF, 0.2, 0.0005, false, "LM");
+	test_model_time_fit(
+		"DIBEM", {7},
+		AIF, 0.5, 0.0005, false, "LM");
+	test_model_time_fit(
+		"PATLAK", {},
+		AIF, 0.5, 0.0005, false, "LM");
+
+	//LM should reach a fit at least as good as BLEIC, from a single fit of each
+	const std::vector<std::pair<std::string, std::vector<int>>> models = {
+		{"ETM", {}}, {"DIETM", {6}}, {"2CXM", {}}, {"DIBEM", {7}}, {"PATLAK", {}} };
+	for (const auto &m : models)
+	{
+		double bleicIterations, bleicTime, bleicSSE;
+		double lmIterations, lmTime, lmSSE;
+		benchmark_model_fit(m.first, m.second, AIF, "BLEIC", 1,
+			bleicIterations, bleicTime, bleicSSE);
+		benchmark_model_fit(m.first, m.second, AIF, "LM", 1,
+			lmIterations, lmTime, lmSSE);
+		BOOST_CHECK_LE(lmSSE, bleicSSE * 1.01 + 1e-6);
+	}
+}
+
+//Timing only, so disabled by default. Run with --run_test=test_mdm/test_DCE_fit_benchmark
+BOOST_AUTO_TEST_CASE(test_DCE_fit_benchmark, *boost::unit_test::disabled()) {
+	BOOST_TEST_MESSAGE("======= Benchmarking LM vs BLEIC DCE model optimisation =======");
+	mdm_AIF AIF;
+	mdm_test_utils::make_calibration_AIF(AIF);
+
+	const int nRepeats = 20;
+	const std::vector<std::pair<std::string, std::vector<int>>> models = {
+		{"ETM", {}}, {"DIETM", {6}}, {"2CXM", {}}, {"DIBEM", {7}}, {"PATLAK", {}} };
+
+	for (const auto &m : models)
+	{
+		double bleicIterations, bleicTime, bleicSSE;
+		double lmIterations, lmTime, lmSSE;
+		benchmark_model_fit(m.first, m.second, AIF, "BLEIC", nRepeats,
+			bleicIterations, bleicTime, bleicSSE);
+		benchmark_model_fit(m.first, m.second, AIF, "LM", nRepeats,
+			lmIterations, lmTime, lmSSE);
+
+		BOOST_TEST_MESSAGE(boost::format(
+			"%1%: BLEIC %2$.1f iterations, %3$.1f us per voxel, SSE %4$.6f; "
+			"LM %5$.1f iterations, %6$.1f us per voxel, SSE %7$.6f")
+			% m.first % bleicIterations % bleicTime % bleicSSE
+			% lmIterations % lmTime % lmSSE);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_DCE_fit_repeats) {
+	BOOST_TEST_MESSAGE("======= Testing DCE model optimisation with repeat starts =======");
+	mdm_AIF AIF;
+	mdm_test_utils::make_calibration_AIF(AIF);
+
+	//Repeat fit the ETM from 13 starts for tau_a
+	std::vector<double> repeatValues;
+	for (int i = 0; i <= 12; i++)
+		repeatValues.push_back(0.025*i);
+
+	std::vector<double> fullParams, prunedParams, prunedParams2;
+	double fullSSE, prunedSSE, prunedSSE2;
+	int fullIterations, prunedIterations, prunedIterations2;
+	repeat_model_fit("ETM", AIF, 3, repeatValues, false,
+		fullParams, fullSSE, fullIterations);
+	repeat_model_fit("ETM", AIF, 3, repeatValues, true,
+		prunedParams, prunedSSE, prunedIterations);
+	repeat_model_fit("ETM", AIF, 3, repeatValues, true,
+		prunedParams2, prunedSSE2, prunedIterations2);
+
+	BOOST_TEST_MESSAGE(boost::format(
+		"ETM repeats: %1% iterations, SSE %2$.6f without pruning; "
+		"%3% iterations, SSE %4$.6f with pruning")
+		% fullIterations % fullSSE % prunedIterations % prunedSSE);
+
+	//Pruning should find the same best fit in fewer iterations
+	BOOST_CHECK_LE(prunedSSE, fullSSE * 1.01 + 1e-6);
+	BOOST_CHECK(mdm_test_utils::vectors_near_equal_rel(prunedParams, fullParams, 0.05));
+	BOOST_CHECK_LE(prunedIterations, fullIterations);
+
+	//And results should be identical from run to run
+	BOOST_CHECK_EQUAL(prunedSSE, prunedSSE2);
+	BOOST_CHECK_EQUAL(prunedIterations, prunedIterations2);
+	BOOST_CHECK(prunedParams == prunedParams2);
+}
+
+BOOST_AUTO_TEST_CASE(test_DCE_fit_repeats_sequence) {
+	BOOST_TEST_MESSAGE("======= Testing DCE repeat fits are independent of previous voxels =======");
+	mdm_AIF AIF;
+	mdm_test_utils::make_calibration_AIF(AIF);
+	AIF.setAIFType(mdm_AIF::AIF_TYPE::AIF_POP);
+	AIF.setPIFType(mdm_AIF::PIF_TYPE::PIF_POP);
+	auto nTimes = AIF.AIFTimes().size();
+
+	std::vector<double> repeatValues;
+	for (int i = 0; i <= 12; i++)
+		repeatValues.push_back(0.025*i);
+
+	//Fit the ETM to two different voxels, generated from the ETM and 2CXM
+	std::vector<double> trueParams, CtA, CtB;
+	read_calibration_fit_data("ETM", nTimes, trueParams, CtA);
+	read_calibration_fit_data("2CXM", nTimes, trueParams, CtB);
+	mdm_DCEVoxel voxA({}, CtA, AIF.prebolus(), AIF.AIFTimes(), {}, false);
+	mdm_DCEVoxel voxB({}, CtB, AIF.prebolus(), AIF.AIFTimes(), {}, false);
+	voxA.testEnhancing();
+	voxB.testEnhancing();
+
+	for (bool prune : { false, true })
+	{
+		//Fit voxel B fresh
+		auto freshModel = mdm_DCEModelGenerator::createModel(AIF,
+			mdm_DCEModelGenerator::ParseModelName("ETM"), {},
+			{}, {}, {}, {}, {}, {}, {}, 3, repeatValues);
+		mdm_DCEModelFitter freshFitter(*freshModel, 0, nTimes, {}, "BLEIC");
+		freshFitter.setRepeatPruning(prune);
+		freshFitter.initialiseModelFit(voxB.CtData());
+		auto freshInitialSSE = freshFitter.modelFitError();
+		freshFitter.fitModel(voxB.status());
+
+		//Fit voxel A then voxel B with the same model and fitter
+		auto model = mdm_DCEModelGenerator::createModel(AIF,
+			mdm_DCEModelGenerator::ParseModelName("ETM"), {},
+			{}, {}, {}, {}, {}, {}, {}, 3, repeatValues);
+		mdm_DCEModelFitter fitter(*model, 0, nTimes, {}, "BLEIC");
+		fitter.setRepeatPruning(prune);
+		fitter.initialiseModelFit(voxA.CtData());
+		fitter.fitModel(voxA.status());
+		fitter.initialiseModelFit(voxB.CtData());
+		auto initialSSE = fitter.modelFitError();
+		fitter.fitModel(voxB.status());
+
+		//The second fit should start from, and match, the fresh fit exactly
+		BOOST_TEST_MESSAGE(boost::format("Checking sequential repeat fits, pruning %1%") % prune);
+		BOOST_CHECK(model->initialParams() == freshModel->initialParams());
+		BOOST_CHECK_EQUAL(initialSSE, freshInitialSSE);
+		BOOST_CHECK_EQUAL(fitter.modelFitError(), freshFitter.modelFitError());
+		BOOST_CHECK_EQUAL(fitter.numIterations(), freshFitter.numIterations());
+		BOOST_CHECK(model->params() == freshModel->params());
+	}
+}
+BOOST_AUTO_TEST_SUITE_END() //
@@ -0,0 +1,229 @@
+#define BOOST_TEST_MODULE "Test mdm allocations"
+#include <boost/test/unit_test.hpp>
+#include <boost/format.hpp>
+
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <fstream>
+
+#include <madym/tests/mdm_test_utils.h>
+#include <madym/dce/mdm_AIF.h>
+#include <madym/dce/mdm_DCEModelGenerator.h>
+#include <madym/dce/mdm_DCEVoxel.h>
+#include <madym/dce/mdm_DCEModelFitter.h>
+
+//Replace global operator new so heap allocations can be counted while a
+//model is evaluated or fitted. This is kept in its own executable so the
+//replacement doesn't affect the main test suite
+static size_t allocationCount = 0;
+static bool countAllocations = false;
+
+void* operator new(std::size_t size)
+{
+	if (countAllocations)
+		allocationCount++;
+
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+static void startCounting()
+{
+	allocationCount = 0;
+	countAllocations = true;
+}
+
+static size_t stopCounting()
+{
+	countAllocations = false;
+	return allocationCount;
+}
+
+//Read in the model calibration file - this has noise added to it
+static void read_calibration_fit_data(
+	const std::string &modelName,
+	const size_t nTimes,
+	std::vector<double> &CtCalibration)
+{
+	int nParams;
+	CtCalibration.resize(nTimes);
+	std::string modelFileName = mdm_test_utils::calibration_dir() + modelName + "_noise.dat";
+
+	std::ifstream modelFileStream(modelFileName, std::ios::in | std::ios::binary);
+	modelFileStream.read(reinterpret_cast<char*>(&nParams), sizeof(int));
+
+	std::vector<double> trueParams(nParams);
+	for (double &p : trueParams)
+		modelFileStream.read(reinterpret_cast<char*>(&p), sizeof(double));
+	for (double &c : CtCalibration)
+		modelFileStream.read(reinterpret_cast<char*>(&c), sizeof(double));
+	modelFileStream.close();
+}
+
+//Evaluate a model (and its Jacobian) repeatedly at perturbed parameters, returning
+//the number of heap allocations made after the first (warm-up) evaluation
+static void count_model_evaluation_allocations(
+	const std::string &modelName,
+	mdm_AIF &AIF,
+	const int nEvaluations,
+	size_t &modelAllocations,
+	size_t &jacobianAllocations)
+{
+	auto nTimes = AIF.AIFTimes().size();
+	auto model = mdm_DCEModelGenerator::createModel(AIF,
+		mdm_DCEModelGenerator::ParseModelName(modelName), {},
+		{}, {}, {}, {}, {}, {}, {}, -1, {});
+	model->reset(nTimes);
+
+	//Scale each parameter around its initial value, so bolus delays are also changed
+	const auto initParams = model->initialParams();
+	auto params = initParams;
+	std::vector<double> jacobian;
+
+	model->computeCtModel(nTimes);
+	model->computeCtModelAndJacobian(nTimes, jacobian);
+
+	startCounting();
+	for (int i = 0; i < nEvaluations; i++)
+	{
+		double scale = 1.0 + 0.1 * double(i % 10) / 10;
+		for (size_t i_p = 0; i_p < params.size(); i_p++)
+			params[i_p] = initParams[i_p] * scale;
+		model->setParams(params);
+		model->computeCtModel(nTimes);
+	}
+	modelAllocations = stopCounting();
+
+	startCounting();
+	for (int i = 0; i < nEvaluations; i++)
+	{
+		double scale = 1.0 + 0.1 * double(i % 10) / 10;
+		for (size_t i_p = 0; i_p < params.size(); i_p++)
+			params[i_p] = initParams[i_p] * scale;
+		model->setParams(params);
+		model->computeCtModelAndJacobian(nTimes, jacobian);
+	}
+	jacobianAllocations = stopCounting();
+}
+
+//Fit a model to its calibration time-series, returning the number of heap allocations
+//made during the fit, and the number of optimiser iterations
+static void count_model_fit_allocations(
+	const std::string &modelName,
+	const std::vector<int> fixedParams,
+	mdm_AIF &AIF,
+	const std::string &fitterType,
+	size_t &fitAllocations,
+	int &iterations)
+{
+	auto nTimes = AIF.AIFTimes().size();
+	std::vector<double> CtCalibration;
+	read_calibration_fit_data(modelName, nTimes, CtCalibration);
+
+	auto model = mdm_DCEModelGenerator::createModel(AIF,
+		mdm_DCEModelGenerator::ParseModelName(modelName), {},
+		{}, fixedParams, {}, {}, {}, {}, {}, -1, {});
+
+	mdm_DCEModelFitter fitter(*model, 0, nTimes, {}, fitterType);
+	mdm_DCEVoxel vox({}, CtCalibration, AIF.prebolus(), AIF.AIFTimes(), {}, false);
+	vox.testEnhancing();
+
+	//Warm-up fit sizes all the scratch buffers
+	fitter.initialiseModelFit(vox.CtData());
+	fitter.fitModel(vox.status());
+
+	startCounting();
+	fitter.initialiseModelFit(vox.CtData());
+	fitter.fitModel(vox.status());
+	fitAllocations = stopCounting();
+	iterations = fitter.numIterations();
+}
+
+BOOST_AUTO_TEST_SUITE(test_mdm_allocations)
+
+BOOST_AUTO_TEST_CASE(test_DCE_model_evaluation_allocations) {
+	BOOST_TEST_MESSAGE("======= Testing DCE model evaluation is allocation free =======");
+	mdm_AIF AIF;
+	mdm_test_utils::make_calibration_AIF(AIF);
+	AIF.setAIFType(mdm_AIF::AIF_TYPE::AIF_POP);
+	AIF.setPIFType(mdm_AIF::PIF_TYPE::PIF_POP);
+
+	const int nEvaluations = 100;
+	for (const std::string modelName : {
+		"ETM", "DIETM", "AUEM", "DISCM", "2CXM", "2CFM", "DI2CXM", "DIBEM", "DIBEM_FP",
+		"PATLAK", "MLDRW"})
+	{
+		size_t modelAllocations, jacobianAllocations;
+		count_model_evaluation_allocations(modelName, AIF, nEvaluations,
+			modelAllocations, jacobianAllocations);
+
+		BOOST_TEST_MESSAGE(boost::format(
+			"%1%: %2% allocations in %3% model evaluations, %4% in %3% Jacobian evaluations")
+			% modelName % modelAllocations % nEvaluations % jacobianAllocations);
+		BOOST_CHECK_MESSAGE(!modelAllocations,
+			modelName << " computeCtModel allocated " << modelAllocations << " times");
+		BOOST_CHECK_MESSAGE(!jacobianAllocations,
+			modelName << " computeCtModelAndJacobian allocated " << jacobianAllocations << " times");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(test_DCE_fit_allocations) {
+	BOOST_TEST_MESSAGE("======= Counting heap allocations per DCE model fit =======");
+	mdm_AIF AIF;
+	mdm_test_utils::make_calibration_AIF(AIF);
+	AIF.setAIFType(mdm_AIF::AIF_TYPE::AIF_POP);
+	AIF.setPIFType(mdm_AIF::PIF_TYPE::PIF_POP);
+
+	const std::vector<std::pair<std::string, std::vector<int>>> models = {
+		{"ETM", {}}, {"DIETM", {6}}, {"2CXM", {}}, {"DIBEM", {7}}, {"PATLAK", {}} };
+
+	for (const auto &m : models)
+	{
+		for (const std::string fitterType : { "BLEIC", "LM" })
+		{
+			size_t fitAllocations;
+			int iterations;
+			count_model_fit_allocations(m.first, m.second, AIF, fitterType,
+				fitAllocations, iterations);
+
+			BOOST_TEST_MESSAGE(boost::format(
+				"%1%, %2%: %3% allocations per fit, %4% iterations")
+				% m.first % fitterType % fitAllocations % iterations);
+
+			//Fit set-up may allocate a small fixed amount (ALGLIB's internal state uses
+			//malloc directly so isn't counted), but nothing should be allocated per
+			//objective function evaluation, so allocations must not grow with iterations
+			BOOST_CHECK_MESSAGE(fitAllocations < 10,
+				m.first << ", " << fitterType << " fit allocated " << fitAllocations << " times");
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END() //
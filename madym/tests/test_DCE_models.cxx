@@ -6,6 +6,7 @@
 #include <madym/tests/mdm_test_utils.h>
 #include <madym/dce/mdm_AIF.h>
 #include <madym/dce/mdm_DCEModelGenerator.h>
+#include <madym/dce/mdm_ExponentialKernels.h>
 
 void test_model_time_series(
 	const std::string &modelName,
@@ -47,43 +48,116 @@ void test_model_time_series(
         Ct, CtCalibration, 0.0001));
 }
 
+void test_model_jacobian(
+	const std::string &modelName,
+	const std::vector<double> &params,
+	mdm_AIF &AIF)
+{
+	auto nTimes = AIF.AIFTimes().size();
+	auto modelType = mdm_DCEModelGenerator::ParseModelName(modelName);
+	AIF.setAIFType(mdm_AIF::AIF_TYPE::AIF_POP);
+	AIF.setPIFType(mdm_AIF::PIF_TYPE::PIF_POP);
+	auto model = mdm_DCEModelGenerator::createModel(AIF,
+		modelType, {},
+		params, {}, {}, {}, {}, {}, {}, -1, {});
+	BOOST_CHECK_MESSAGE(model->hasAnalyticJacobian(),
+		"Model " << modelName << " has analytic Jacobian");
+
+	//Compute Cm(t) and Jacobian numerically, using the base class implementation,
+	//then analytically
+	std::vector<double> numericalJacobian, analyticJacobian;
+	model->mdm_DCEModelBase::computeCtModelAndJacobian(nTimes, numericalJacobian);
+	model->computeCtModel(nTimes);
+	std::vector<double> Ct = model->CtModel();
+
+	model->computeCtModelAndJacobian(nTimes, analyticJacobian);
+	BOOST_TEST_MESSAGE("Test DCE model Jacobians, Cm(t) values match: " + modelName);
+	BOOST_CHECK(mdm_test_utils::vectors_near_equal(
+		model->CtModel(), Ct, 1e-10));
+
+	//Scale tolerance by the size of the derivatives for each parameter
+	auto nParams = model->numParams();
+	BOOST_REQUIRE(analyticJacobian.size() == nTimes * nParams);
+	for (int i_p = 0; i_p < nParams; i_p++)
+	{
+		double maxDerivative = 0.0;
+		double maxError = 0.0;
+		for (size_t i_t = 0; i_t < nTimes; i_t++)
+		{
+			auto idx = i_t * nParams + i_p;
+			maxDerivative = std::max(maxDerivative, std::abs(numericalJacobian[idx]));
+			maxError = std::max(maxError, std::abs(analyticJacobian[idx] - numericalJacobian[idx]));
+		}
+		BOOST_CHECK_MESSAGE(maxError <= 1e-5 * std::max(maxDerivative, 1.0),
+			"Jacobian of " << modelName << " wrt " << model->paramName(i_p) <<
+			" matches numerical, max error " << maxError);
+	}
+}
+
+void test_model_batch(
+	const std::string &modelName,
+	const std::vector<double> &params,
+	mdm_AIF &AIF)
+{
+	auto nTimes = AIF.AIFTimes().size();
+	auto modelType = mdm_DCEModelGenerator::ParseModelName(modelName);
+	AIF.setAIFType(mdm_AIF::AIF_TYPE::AIF_POP);
+	AIF.setPIFType(mdm_AIF::PIF_TYPE::PIF_POP);
+	auto model = mdm_DCEModelGenerator::createModel(AIF,
+		modelType, {},
+		params, {}, {}, {}, {}, {}, {}, -1, {});
+
+	//Make a batch of sets by scaling all but the last (bolus delay) parameter, so sets share
+	//the same AIF, then a batch where the last parameter also varies, so each set has its
+	//own AIF. The final set is invalid, and should be zero
+	const size_t nParams = model->numParams();
+	const size_t nSets = 7;
+	for (bool varyDelay : { false, true })
+	{
+		std::vector<double> batchParams;
+		for (size_t k = 0; k < nSets; k++)
+		{
+			double scale = 0.5 + 0.25 * k;
+			for (size_t i_p = 0; i_p + 1 < nParams; i_p++)
+				batchParams.push_back(params[i_p] * scale);
+			batchParams.push_back(varyDelay ? params.back() + 0.02 * k : params.back());
+		}
+		batchParams[(nSets - 1) * nParams] = NAN;
+
+		for (auto simdType : { mdm_ExponentialKernels::SCALAR, mdm_ExponentialKernels::AVX2 })
+		{
+			if (!mdm_ExponentialKernels::setSIMDType(simdType))
+				continue;
+
+			std::vector<double> CtModels;
+			model->computeCtModelBatch(nTimes, batchParams, CtModels);
+			BOOST_REQUIRE(CtModels.size() == nSets * nTimes);
+
+			BOOST_TEST_MESSAGE(boost::format(
+				"Test DCE model batch, %1%, SIMD type %2%%3%") % modelName % simdType
+				% (varyDelay ? ", varying bolus delay" : ""));
+			for (size_t k = 0; k < nSets; k++)
+			{
+				model->setParams(std::vector<double>(
+					batchParams.begin() + k * nParams, batchParams.begin() + (k + 1) * nParams));
+				model->computeCtModel(nTimes);
+				std::vector<double> Ct(model->CtModel().begin(), model->CtModel().begin() + nTimes);
+				std::vector<double> CtBatch(CtModels.begin() + k * nTimes, CtModels.begin() + (k + 1) * nTimes);
+				BOOST_CHECK_MESSAGE(mdm_test_utils::vectors_near_equal(CtBatch, Ct, 1e-10),
+					"Batch set " << k << " of " << modelName << " matches computeCtModel");
+			}
+		}
+	}
+	mdm_ExponentialKernels::setSIMDType(mdm_ExponentialKernels::AVX2);
+}
+
 BOOST_AUTO_TEST_SUITE(test_mdm)
 
 BOOST_AUTO_TEST_CASE(test_DCE_models) {
 	BOOST_TEST_MESSAGE("======= Testing DCE models implemented in mdm library =======");
 	
-	//Read in dynamic times from calibration file
-	int nTimes;
-	std::string timesFileName(mdm_test_utils::calibration_dir() + "dyn_times.dat");
-	std::ifstream timesFileStream(timesFileName, std::ios::in | std::ios::binary);
-	timesFileStream.read(reinterpret_cast<char*>(&nTimes), sizeof(int));
-
-	std::vector<double> dynTimes(nTimes);
-	for (double &t : dynTimes)
-		timesFileStream.read(reinterpret_cast<char*>(&t), sizeof(double));
-	timesFileStream.close();
-
-	//For the AIF, read in the injection image, haematocrit correction and dose
-	//then the values
-	int injectionImage;
-	double hct;
-	double dose;
-	std::vector<double> aifVals(nTimes);
-	std::vector<double> pifVals(nTimes);
-
-	std::string aifFileName(mdm_test_utils::calibration_dir() + "aif.dat");
-	std::ifstream aifFileStream(aifFileName, std::ios::in | std::ios::binary);
-	aifFileStream.read(reinterpret_cast<char*>(&injectionImage), sizeof(int));
-	aifFileStream.read(reinterpret_cast<char*>(&hct), sizeof(double));
-	aifFileStream.read(reinterpret_cast<char*>(&dose), sizeof(double));
-	aifFileStream.close();
-
-	//Create AIF
 	mdm_AIF AIF;
-	AIF.setAIFTimes(dynTimes);
-	AIF.setPrebolus(injectionImage);
-	AIF.setHct(hct);
-	AIF.setDose(dose);
+	mdm_test_utils::make_calibration_AIF(AIF);
 
 	//Create model concentrations for each model type
 	test_model_time_series(
@@ -112,4 +186,31 @@ BOOST_AUTO_TEST_CASE(test_DCE_models) {
     AIF);
 }
 
+BOOST_AUTO_TEST_CASE(test_DCE_model_jacobians) {
+	BOOST_TEST_MESSAGE("======= Testing analytic Jacobians of DCE models =======");
+	mdm_AIF AIF;
+	mdm_test_utils::make_calibration_AIF(AIF);
+
+	test_model_jacobian("ETM", { 0.25, 0.2, 0.05, 0.1 }, AIF);
+	test_model_jacobian("PATLAK", { 0.1, 0.05, 0.1 }, AIF);
+	test_model_jacobian("2CXM", { 0.6, 0.2, 0.2, 0.05, 0.1 }, AIF);
+	test_model_jacobian("2CFM", { 0.6, 0.2, 0.2, 0.05, 0.1 }, AIF);
+	test_model_jacobian("DIETM", { 0.25, 0.2, 0.05, 0.7, 0.1, 0.05 }, AIF);
+	test_model_jacobian("DIBEM", { 0.2, 0.2, 0.5, 4.0, 0.7, 0.1, 0.05 }, AIF);
+}
+
+BOOST_AUTO_TEST_CASE(test_DCE_model_batch) {
+	BOOST_TEST_MESSAGE("======= Testing batched evaluation of DCE models =======");
+	mdm_AIF AIF;
+	mdm_test_utils::make_calibration_AIF(AIF);
+
+	test_model_batch("ETM", { 0.25, 0.2, 0.05, 0.1 }, AIF);
+	test_model_batch("ETM", { 0.0, 0.2, 0.05, 0.1 }, AIF);
+	test_model_batch("2CXM", { 0.6, 0.2, 0.2, 0.05, 0.1 }, AIF);
+	test_model_batch("2CFM", { 0.6, 0.2, 0.2, 0.05, 0.1 }, AIF);
+
+	//No batched kernel, so uses the base class evaluation of each set
+	test_model_batch("DIETM", { 0.25, 0.2, 0.05, 0.7, 0.1, 0.05 }, AIF);
+}
+
 BOOST_AUTO_TEST_SUITE_END() //
@@ -3,8 +3,10 @@
 
 #include <iostream>
 #include <vector>
+#include <cmath>
 #include <madym/dwi/mdm_DWIFitterADC.h>
 #include <madym/dwi/mdm_DWIFitterIVIM.h>
+#include <madym/dwi/mdm_DWIMapper.h>
 #include <madym/tests/mdm_test_utils.h>
 
 BOOST_AUTO_TEST_SUITE(test_mdm)
@@ -111,6 +113,97 @@ BOOST_AUTO_TEST_CASE(test_DWI_IVIM) {
   BOOST_TEST_MESSAGE("Testing fitted d match");
   BOOST_CHECK_CLOSE(IVIMfit[3], dstar, 0.5);
 
+  //Refit with the same fitter after changing B-values, as in lite analysis where each
+  //sample has its own B-values, results should match a newly created fitter
+  BOOST_TEST_MESSAGE("Testing IVIM refit with new B-values");
+  std::vector<double> Bvals2(Bvals.begin() + 1, Bvals.end());
+  auto signals2 = mdm_DWIFitterIVIM::modelToSignals({ S0, d, f, dstar }, Bvals2);
+  std::vector<double> row(Bvals2);
+  row.insert(row.end(), signals2.begin(), signals2.end());
+
+  std::vector<double> IVIMfit2, IVIMfitNew;
+  double ssr2, ssrNew;
+  DWIFitterIVIM.setInputsFromRow(row, (int)Bvals2.size());
+  DWIFitterIVIM.fitModel(IVIMfit2, ssr2);
+
+  mdm_DWIFitterIVIM DWIFitterIVIMNew(Bvals2, true, BvalsThresh);
+  DWIFitterIVIMNew.setSignals(signals2);
+  DWIFitterIVIMNew.fitModel(IVIMfitNew, ssrNew);
+  BOOST_CHECK_VECTORS(IVIMfit2, IVIMfitNew);
+  BOOST_CHECK_EQUAL(ssr2, ssrNew);
+
+}
+
+BOOST_AUTO_TEST_CASE(test_DWI_mapper_threads) {
+  BOOST_TEST_MESSAGE("======= Testing multi-threaded IVIM mapping =======");
+
+  //Generate a small volume of IVIM signals, varying D and f across voxels, with
+  //some zero-signal voxels to generate fit errors
+  std::vector<double> Bvals = { 0, 20, 40, 60, 80, 100, 150, 200, 400, 600, 800 };
+  const size_t nX = 4, nY = 3, nZ = 2;
+  std::vector<mdm_Image3D> BvalImgs(Bvals.size());
+  for (size_t i_b = 0; i_b < Bvals.size(); i_b++)
+  {
+    BvalImgs[i_b].setDimensions(nX, nY, nZ);
+    BvalImgs[i_b].setVoxelDims(1, 1, 1);
+    BvalImgs[i_b].info().B.setValue(Bvals[i_b]);
+    BvalImgs[i_b].setType(mdm_Image3D::ImageType::TYPE_DWI);
+  }
+  const auto nVoxels = BvalImgs[0].numVoxels();
+  for (size_t i_v = 0; i_v < nVoxels; i_v++)
+  {
+    auto signals = mdm_DWIFitterIVIM::modelToSignals(
+      { 100, 0.8e-3 + 0.05e-3 * i_v, 0.1 + 0.01 * i_v, 20e-3 }, Bvals);
+    for (size_t i_b = 0; i_b < Bvals.size(); i_b++)
+      BvalImgs[i_b].setVoxel(i_v, (i_v % 7) ? signals[i_b] : 0);
+  }
+
+  //Map IVIM serially, multi-threaded and with early termination of restarts
+  const std::vector<double> BvalsThresh = { 40.0, 60.0, 100.0, 150.0 };
+  auto mapIVIM = [&](int nThreads, double restartTol, mdm_Image3D &errors)
+  {
+    mdm_ErrorTracker errorTracker;
+    mdm_Image3D ROI;
+    mdm_DWIMapper mapper(errorTracker, ROI);
+    for (const auto &img : BvalImgs)
+      mapper.addInputImage(img);
+    errorTracker.initErrorImage(BvalImgs[0]);
+
+    mapper.setBvalsThresh(BvalsThresh);
+    mapper.setRestartTolerance(restartTol);
+    mapper.setNumThreads(nThreads);
+    mapper.mapDWI(mdm_DWIModelGenerator::IVIM);
+
+    errors = errorTracker.errorImage();
+    std::vector<mdm_Image3D> maps;
+    for (const auto &name : mapper.paramNames())
+      maps.push_back(mapper.model_map(name));
+    return maps;
+  };
+  mdm_Image3D serialErrors, threadedErrors, earlyErrors;
+  auto serialMaps = mapIVIM(1, 0, serialErrors);
+  auto threadedMaps = mapIVIM(3, 0, threadedErrors);
+  auto earlyMaps = mapIVIM(3, 1e-3, earlyErrors);
+
+  //Threaded maps and error codes should be identical, voxel for voxel, and early
+  //termination should only make negligible changes to the fitted parameters
+  BOOST_TEST_MESSAGE("Testing serial and threaded maps match");
+  for (size_t i_v = 0; i_v < nVoxels; i_v++)
+  {
+    BOOST_CHECK_EQUAL(serialErrors.voxel(i_v), threadedErrors.voxel(i_v));
+    BOOST_CHECK_EQUAL(serialErrors.voxel(i_v), earlyErrors.voxel(i_v));
+    for (size_t i_p = 0; i_p < serialMaps.size(); i_p++)
+    {
+      //Zero-signal voxels return NaN parameters
+      if (!(i_v % 7))
+      {
+        BOOST_CHECK(std::isnan(threadedMaps[i_p].voxel(i_v)));
+        continue;
+      }
+      BOOST_CHECK_EQUAL(serialMaps[i_p].voxel(i_v), threadedMaps[i_p].voxel(i_v));
+      BOOST_CHECK_CLOSE(serialMaps[i_p].voxel(i_v), earlyMaps[i_p].voxel(i_v), 1.0);
+    }
+  }
 }
 
 BOOST_AUTO_TEST_SUITE_END() //
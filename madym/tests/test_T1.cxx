@@ -5,6 +5,10 @@
 #include <vector>
 #include <madym/t1/mdm_T1FitterVFA.h>
 #include <madym/t1/mdm_T1FitterIR.h>
+#include <madym/t1/mdm_T1FitterDictionary.h>
+#include <madym/t1/mdm_T1FitterVFALinear.h>
+#include <madym/t1/mdm_T1Mapper.h>
+#include <madym/utils/mdm_exception.h>
 #include <madym/tests/mdm_test_utils.h>
 
 BOOST_AUTO_TEST_SUITE(test_mdm)
@@ -185,6 +189,309 @@ BOOST_AUTO_TEST_CASE(test_T1_IR_EW) {
   BOOST_TEST_MESSAGE("Testing fitted EW match using inversion recovery");
   BOOST_CHECK_CLOSE(EWfit, EW, 0.01);
 
+  //Refit, reusing the fitter, which should give the same result
+  double T1refit, M0refit, EWrefit;
+  T1CalculatorIR.fitT1(T1refit, M0refit, EWrefit);
+  BOOST_TEST_MESSAGE("Testing refit with same fitter matches");
+  BOOST_CHECK_EQUAL(T1refit, T1fit);
+  BOOST_CHECK_EQUAL(M0refit, M0fit);
+  BOOST_CHECK_EQUAL(EWrefit, EWfit);
+
+  //Fit initialised from the closed-form estimate of T1 and M0
+  mdm_T1FitterIR T1CalculatorIRClosedForm(TIs, TR, true, {}, true);
+  T1CalculatorIRClosedForm.setInputs(signalsCalibration);
+  errCode = T1CalculatorIRClosedForm.fitT1(T1fit, M0fit, EWfit);
+  BOOST_CHECK_MESSAGE(!errCode, "T1 fit with closed-form initialisation returned error " << errCode);
+
+  BOOST_TEST_MESSAGE("Testing fitted T1, M0 and EW match using closed-form initialisation");
+  BOOST_CHECK_CLOSE(T1fit, T1, 0.01);
+  BOOST_CHECK_CLOSE(M0fit, M0, 0.01);
+  BOOST_CHECK_CLOSE(EWfit, EW, 0.01);
+}
+
+BOOST_AUTO_TEST_CASE(test_T1_dictionary) {
+  BOOST_TEST_MESSAGE("======= Testing T1 mapping by dictionary matching =======");
+
+  //Read FAs and TR from the VFA calibration file, and TIs and TR from the IR calibration file
+  int nFAs, nTIs;
+  double T1, M0, TR_VFA, TR_IR;
+  std::ifstream VFAFileStream(mdm_test_utils::calibration_dir() + "T1.dat", std::ios::in | std::ios::binary);
+  VFAFileStream.read(reinterpret_cast<char*>(&nFAs), sizeof(int));
+  std::vector<double> FAs(nFAs), signals(nFAs);
+  for (double &fa : FAs)
+    VFAFileStream.read(reinterpret_cast<char*>(&fa), sizeof(double));
+  for (double &s : signals)
+    VFAFileStream.read(reinterpret_cast<char*>(&s), sizeof(double));
+  VFAFileStream.read(reinterpret_cast<char*>(&T1), sizeof(double));
+  VFAFileStream.read(reinterpret_cast<char*>(&M0), sizeof(double));
+  VFAFileStream.read(reinterpret_cast<char*>(&TR_VFA), sizeof(double));
+  VFAFileStream.close();
+
+  std::ifstream IRFileStream(mdm_test_utils::calibration_dir() + "T1_IR.dat", std::ios::in | std::ios::binary);
+  IRFileStream.read(reinterpret_cast<char*>(&nTIs), sizeof(int));
+  std::vector<double> TIs(nTIs), signalsIR(nTIs);
+  for (double &ti : TIs)
+    IRFileStream.read(reinterpret_cast<char*>(&ti), sizeof(double));
+  for (double &s : signalsIR)
+    IRFileStream.read(reinterpret_cast<char*>(&s), sizeof(double));
+  IRFileStream.read(reinterpret_cast<char*>(&T1), sizeof(double));
+  IRFileStream.read(reinterpret_cast<char*>(&M0), sizeof(double));
+  IRFileStream.read(reinterpret_cast<char*>(&TR_IR), sizeof(double));
+  IRFileStream.close();
+
+  mdm_T1FitterDictionary dictVFA(mdm_T1FitterDictionary::VFA, FAs, TR_VFA, false, false);
+  mdm_T1FitterDictionary dictVFARefined(mdm_T1FitterDictionary::VFA, FAs, TR_VFA, false);
+  mdm_T1FitterDictionary dictVFAB1(mdm_T1FitterDictionary::VFA, FAs, TR_VFA, true);
+  mdm_T1FitterDictionary dictIR(mdm_T1FitterDictionary::IR, TIs, TR_IR, false);
+  mdm_T1FitterDictionary dictIRE(mdm_T1FitterDictionary::IR, TIs, TR_IR, true);
+  mdm_T1FitterVFA fitterVFA(FAs, TR_VFA, false, {});
+
+  //Match noise-free signals over a range of T1. Unrefined matches are within half a grid
+  //step (0.35%) of the true T1, refined matches agree with the VFA fitter and the true
+  //values (the IR fitter, initialised at T1 = 1000, finds a local minimum for some T1)
+  const double B1 = 0.937;
+  const double EW = 0.9;
+  double T1fit, M0fit, EWfit, T1ref, M0ref, EWref;
+  for (double T1true : { 250.0, 800.0, 1333.0, 2500.0 })
+  {
+    BOOST_TEST_MESSAGE(boost::format("Testing dictionary matches for T1 = %1%") % T1true);
+    for (int i = 0; i < nFAs; i++)
+      signals[i] = mdm_T1FitterVFA::T1toSignal(T1true, M0, FAs[i], TR_VFA);
+
+    dictVFA.setInputs(signals);
+    auto errCode = dictVFA.fitT1(T1fit, M0fit, EWfit);
+    BOOST_CHECK_MESSAGE(!errCode, "VFA dictionary match returned error " << errCode);
+    BOOST_CHECK_CLOSE(T1fit, T1true, 0.35);
+
+    dictVFARefined.setInputs(signals);
+    dictVFARefined.fitT1(T1fit, M0fit, EWfit);
+    fitterVFA.setInputs(signals);
+    fitterVFA.fitT1(T1ref, M0ref, EWref);
+    BOOST_CHECK_CLOSE(T1fit, T1ref, 0.01);
+    BOOST_CHECK_CLOSE(M0fit, M0ref, 0.01);
+
+    //B1 corrected, with B1 between the dictionary's B1 grid values
+    for (int i = 0; i < nFAs; i++)
+      signals[i] = mdm_T1FitterVFA::T1toSignal(T1true, M0, B1 * FAs[i], TR_VFA);
+    signals.push_back(B1);
+    dictVFAB1.setInputs(signals);
+    errCode = dictVFAB1.fitT1(T1fit, M0fit, EWfit);
+    signals.pop_back();
+    BOOST_CHECK_MESSAGE(!errCode, "VFA B1 dictionary match returned error " << errCode);
+    BOOST_CHECK_CLOSE(T1fit, T1true, 0.01);
+    BOOST_CHECK_CLOSE(M0fit, M0, 0.01);
+
+    for (int i = 0; i < nTIs; i++)
+      signalsIR[i] = mdm_T1FitterIR::T1toSignal(T1true, M0, TIs[i], TR_IR);
+    dictIR.setInputs(signalsIR);
+    errCode = dictIR.fitT1(T1fit, M0fit, EWfit);
+    BOOST_CHECK_MESSAGE(!errCode, "IR dictionary match returned error " << errCode);
+    BOOST_CHECK_CLOSE(T1fit, T1true, 0.01);
+    BOOST_CHECK_CLOSE(M0fit, M0, 0.01);
+
+    for (int i = 0; i < nTIs; i++)
+      signalsIR[i] = mdm_T1FitterIR::T1toSignal(T1true, M0, TIs[i], TR_IR, EW);
+    dictIRE.setInputs(signalsIR);
+    errCode = dictIRE.fitT1(T1fit, M0fit, EWfit);
+    BOOST_CHECK_MESSAGE(!errCode, "IR_E dictionary match returned error " << errCode);
+    BOOST_CHECK_CLOSE(T1fit, T1true, 0.01);
+    BOOST_CHECK_CLOSE(EWfit, EW, 0.01);
+  }
+
+  //Signals that don't match the dictionary fail
+  dictVFA.setInputs(std::vector<double>(nFAs, 0.0));
+  auto errCode = dictVFA.fitT1(T1fit, M0fit, EWfit);
+  BOOST_CHECK_EQUAL(errCode, mdm_ErrorTracker::T1_FIT_FAIL);
+
+  //Resetting the acquisition parameters from a row rebuilds the dictionary
+  std::vector<double> row;
+  for (auto fa : FAs)
+    row.push_back(fa * 180 / acos(-1.0));
+  for (int i = 0; i < nFAs; i++)
+    row.push_back(mdm_T1FitterVFA::T1toSignal(T1, M0, FAs[i], TR_VFA));
+  mdm_T1FitterDictionary dictLite(mdm_T1FitterDictionary::VFA, {}, TR_VFA, false);
+  dictLite.setInputsFromRow(row, nFAs);
+  errCode = dictLite.fitT1(T1fit, M0fit, EWfit);
+  BOOST_CHECK_MESSAGE(!errCode, "VFA dictionary match from row returned error " << errCode);
+  BOOST_CHECK_CLOSE(T1fit, T1, 0.01);
+}
+
+BOOST_AUTO_TEST_CASE(test_T1_VFA_linear) {
+  BOOST_TEST_MESSAGE("======= Testing T1 mapping by linear VFA fit =======");
+
+  //Read FAs and TR from the VFA calibration file
+  int nFAs;
+  double T1, M0, TR;
+  std::ifstream VFAFileStream(mdm_test_utils::calibration_dir() + "T1.dat", std::ios::in | std::ios::binary);
+  VFAFileStream.read(reinterpret_cast<char*>(&nFAs), sizeof(int));
+  std::vector<double> FAs(nFAs), signals(nFAs);
+  for (double &fa : FAs)
+    VFAFileStream.read(reinterpret_cast<char*>(&fa), sizeof(double));
+  for (double &s : signals)
+    VFAFileStream.read(reinterpret_cast<char*>(&s), sizeof(double));
+  VFAFileStream.read(reinterpret_cast<char*>(&T1), sizeof(double));
+  VFAFileStream.read(reinterpret_cast<char*>(&M0), sizeof(double));
+  VFAFileStream.read(reinterpret_cast<char*>(&TR), sizeof(double));
+  VFAFileStream.close();
+
+  mdm_T1FitterVFALinear linearVFA(FAs, TR, false);
+  mdm_T1FitterVFALinear linearVFAB1(FAs, TR, true);
+  mdm_T1FitterVFA fitterVFA(FAs, TR, false, {});
+
+  //Build a batch of noise-free voxels, with and without B1 correction, over a range of T1,
+  //more than one block long. The linear fit is exact for noise-free signals
+  const double B1 = 0.937;
+  std::vector<double> T1s;
+  for (double T1true = 100.0; T1true < 5000.0; T1true += 50.0)
+    T1s.push_back(T1true);
+  const size_t nVoxels = T1s.size();
+
+  std::vector<double> inputs, inputsB1;
+  for (auto T1true : T1s)
+  {
+    for (int i = 0; i < nFAs; i++)
+    {
+      inputs.push_back(mdm_T1FitterVFA::T1toSignal(T1true, M0, FAs[i], TR));
+      inputsB1.push_back(mdm_T1FitterVFA::T1toSignal(T1true, M0, B1 * FAs[i], TR));
+    }
+    inputsB1.push_back(B1);
+  }
+
+  std::vector<double> T1fit(nVoxels), M0fit(nVoxels), EWfit(nVoxels);
+  std::vector<mdm_ErrorTracker::ErrorCode> errCodes(nVoxels);
+  linearVFA.fitT1Batch(inputs.data(), nVoxels, nFAs,
+    T1fit.data(), M0fit.data(), EWfit.data(), errCodes.data());
+
+  std::vector<double> T1fitB1(nVoxels), M0fitB1(nVoxels);
+  std::vector<mdm_ErrorTracker::ErrorCode> errCodesB1(nVoxels);
+  linearVFAB1.fitT1Batch(inputsB1.data(), nVoxels, nFAs + 1,
+    T1fitB1.data(), M0fitB1.data(), EWfit.data(), errCodesB1.data());
+
+  double T1single, M0single, EWsingle, T1ref, M0ref, EWref;
+  for (size_t v = 0; v < nVoxels; v++)
+  {
+    BOOST_CHECK_MESSAGE(!errCodes[v], "Linear VFA fit returned error " << errCodes[v]);
+    BOOST_CHECK_CLOSE(T1fit[v], T1s[v], 0.01);
+    BOOST_CHECK_CLOSE(M0fit[v], M0, 0.01);
+
+    BOOST_CHECK_MESSAGE(!errCodesB1[v], "Linear VFA B1 fit returned error " << errCodesB1[v]);
+    BOOST_CHECK_CLOSE(T1fitB1[v], T1s[v], 0.01);
+    BOOST_CHECK_CLOSE(M0fitB1[v], M0, 0.01);
+
+    //Single voxel fits match the batch, and agree with the nonlinear fit
+    std::vector<double> voxelSignals(inputs.begin() + v * nFAs, inputs.begin() + (v + 1) * nFAs);
+    linearVFA.setInputs(voxelSignals);
+    linearVFA.fitT1(T1single, M0single, EWsingle);
+    BOOST_CHECK_EQUAL(T1single, T1fit[v]);
+    BOOST_CHECK_EQUAL(M0single, M0fit[v]);
+
+    fitterVFA.setInputs(voxelSignals);
+    fitterVFA.fitT1(T1ref, M0ref, EWref);
+    BOOST_CHECK_CLOSE(T1single, T1ref, 0.1);
+    BOOST_CHECK_CLOSE(M0single, M0ref, 0.1);
+  }
+
+  //Signals proportional to sin(FA) give E1 = 0, so an invalid linear fit, flagged as an
+  //error unless refined by the nonlinear fit
+  for (int i = 0; i < nFAs; i++)
+    signals[i] = 100.0 * sin(FAs[i]);
+  linearVFA.setInputs(signals);
+  auto errCode = linearVFA.fitT1(T1single, M0single, EWsingle);
+  BOOST_CHECK_EQUAL(errCode, mdm_ErrorTracker::T1_MAD_VALUE);
+
+  mdm_T1FitterVFALinear linearVFARefined(FAs, TR, false, 0.01);
+  linearVFARefined.setInputs(signals);
+  errCode = linearVFARefined.fitT1(T1single, M0single, EWsingle);
+  fitterVFA.setInputs(signals);
+  auto errCodeRef = fitterVFA.fitT1(T1ref, M0ref, EWref);
+  BOOST_CHECK_EQUAL(errCode, errCodeRef);
+  if (!errCodeRef)
+  {
+    BOOST_CHECK_CLOSE(T1single, T1ref, 0.01);
+    BOOST_CHECK_CLOSE(M0single, M0ref, 0.01);
+  }
+
+  //Rows with repeated, then changed, FAs are fitted with the FAs of each row
+  const double PI = acos(-1.0);
+  mdm_T1FitterVFALinear linearVFARows({}, TR, false);
+  for (double FAscale : { 1.0, 1.0, 0.8 })
+  {
+    std::vector<double> row;
+    for (int i = 0; i < nFAs; i++)
+      row.push_back(FAscale * FAs[i] * 180 / PI);
+    for (int i = 0; i < nFAs; i++)
+      row.push_back(mdm_T1FitterVFA::T1toSignal(T1, M0, FAscale * FAs[i], TR));
+
+    linearVFARows.setInputsFromRow(row, nFAs);
+    linearVFARows.fitT1(T1single, M0single, EWsingle);
+    BOOST_CHECK_CLOSE(T1single, T1, 0.01);
+    BOOST_CHECK_CLOSE(M0single, M0, 0.01);
+  }
+
+  BOOST_CHECK_THROW(mdm_T1FitterVFALinear(FAs, TR, false, -1.0), mdm_exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_T1_mapper_VFA_linear) {
+  BOOST_TEST_MESSAGE("======= Testing T1 mapping of a volume by linear VFA fit =======");
+
+  //Simulate VFA images of a 4 x 4 x 2 volume, with T1 varying by voxel
+  const double TR = 3.5;
+  const double M0 = 1000.0;
+  const double PI = acos(-1.0);
+  const std::vector<double> FAs = { 2.0, 10.0, 18.0 };
+  const size_t nX = 4, nY = 4, nZ = 2;
+
+  std::vector<mdm_Image3D> VFAImgs(FAs.size());
+  for (size_t i = 0; i < FAs.size(); i++)
+  {
+    VFAImgs[i].setDimensions(nX, nY, nZ);
+    VFAImgs[i].setVoxelDims(1, 1, 1);
+    VFAImgs[i].info().TR.setValue(TR);
+    VFAImgs[i].info().flipAngle.setValue(FAs[i]);
+  }
+  const auto nVoxels = VFAImgs[0].numVoxels();
+  std::vector<double> T1s(nVoxels);
+  for (size_t v = 0; v < nVoxels; v++)
+  {
+    T1s[v] = 500.0 + 50.0 * v;
+    for (size_t i = 0; i < FAs.size(); i++)
+      VFAImgs[i].setVoxel(v, mdm_T1FitterVFA::T1toSignal(T1s[v], M0, FAs[i] * PI / 180, TR));
+  }
+
+  //ROI covers only the first slice, so the second slice has no voxels to fit. Slices are
+  //mapped in separate batches, whether on one thread or two
+  mdm_Image3D ROI;
+  ROI.setDimensions(nX, nY, nZ);
+  ROI.setVoxelDims(1, 1, 1);
+  const size_t sliceVoxels = nX * nY;
+  for (size_t v = 0; v < sliceVoxels; v++)
+    ROI.setVoxel(v, 1.0);
+
+  for (int nThreads : { 1, 2 })
+  {
+    mdm_ErrorTracker errorTracker;
+    mdm_T1Mapper mapper(errorTracker, ROI);
+    mapper.setNumThreads(nThreads);
+    for (const auto &img : VFAImgs)
+      mapper.addInputImage(img);
+
+    BOOST_TEST_MESSAGE(boost::format("Mapping with %1% thread(s)") % nThreads);
+    BOOST_REQUIRE_NO_THROW(mapper.mapT1(mdm_T1MethodGenerator::VFA_LINEAR, {}));
+
+    for (size_t v = 0; v < nVoxels; v++)
+    {
+      if (v < sliceVoxels)
+      {
+        BOOST_CHECK_CLOSE(mapper.T1(v), T1s[v], 0.01);
+        BOOST_CHECK_CLOSE(mapper.M0(v), M0, 0.01);
+      }
+      else
+      {
+        BOOST_CHECK_EQUAL(mapper.T1(v), 0.0);
+        BOOST_CHECK_EQUAL(mapper.M0(v), 0.0);
+      }
+    }
+  }
 }
 
 BOOST_AUTO_TEST_SUITE_END() //
@@ -1,6 +1,8 @@
 #include <boost/test/unit_test.hpp>
 
 #include <iostream>
+#include <chrono>
+#include <boost/format.hpp>
 #include <madym/dce/mdm_AIF.h>
 #include <madym/tests/mdm_test_utils.h>
 
@@ -168,4 +170,45 @@ BOOST_AUTO_TEST_CASE(test_analyze) {
 	test_xtr(img_real);
 }
 
+//Timing only, so disabled by default. Run with --run_test=test_mdm/test_analyze_benchmark
+BOOST_AUTO_TEST_CASE(test_analyze_benchmark, *boost::unit_test::disabled()) {
+	BOOST_TEST_MESSAGE("======= Benchmarking analyze format image reading/writing =======");
+
+	//A volume the size of a typical dynamic series time-point
+	mdm_Image3D img;
+	int nx = 256, ny = 256, nz = 32;
+	img.setDimensions(nx, ny, nz);
+	img.setVoxelDims(1, 1, 1);
+	for (size_t i = 0; i < img.numVoxels(); i++)
+		img.setVoxel(i, double((i * 7) % 100));
+
+	const double Mvoxels = img.numVoxels() / (1024.0 * 1024.0);
+	const int nRepeats = 5;
+	std::string img_name = mdm_test_utils::temp_dir() + "/benchmark";
+
+	for (auto format : { mdm_ImageDatatypes::DT_UNSIGNED_CHAR, mdm_ImageDatatypes::DT_SIGNED_SHORT,
+		mdm_ImageDatatypes::DT_SIGNED_INT, mdm_ImageDatatypes::DT_FLOAT, mdm_ImageDatatypes::DT_DOUBLE })
+	{
+		mdm_Image3D img_r;
+		std::chrono::duration<double> writeTime(0), readTime(0);
+		for (int i = 0; i < nRepeats; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+			mdm_AnalyzeFormat::writeImage3D(img_name, img, format, mdm_XtrFormat::NO_XTR, false);
+			auto mid = std::chrono::steady_clock::now();
+			img_r = mdm_AnalyzeFormat::readImage3D(img_name, false);
+			auto end = std::chrono::steady_clock::now();
+			writeTime += mid - start;
+			readTime += end - mid;
+		}
+
+		BOOST_TEST_MESSAGE(boost::format(
+			"Datatype %1%: write %2$.1f Mvoxels/s, read %3$.1f Mvoxels/s")
+			% format % (nRepeats * Mvoxels / writeTime.count()) % (nRepeats * Mvoxels / readTime.count()));
+		BOOST_CHECK_VECTORS(img.data(), img_r.data());
+	}
+	boost::filesystem::remove(img_name + ".hdr");
+	boost::filesystem::remove(img_name + ".img");
+}
+
 BOOST_AUTO_TEST_SUITE_END() //
@@ -0,0 +1,66 @@
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <madym/utils/mdm_AsyncWriteQueue.h>
+#include <madym/utils/mdm_exception.h>
+
+BOOST_AUTO_TEST_SUITE(test_mdm)
+
+BOOST_AUTO_TEST_CASE(test_asyncWriteQueue) {
+	BOOST_TEST_MESSAGE("======= Testing mdm_AsyncWriteQueue =======");
+
+	const size_t nJobs = 50;
+	for (size_t nThreads : {0, 1, 3})
+	{
+		//Small queue, so submit has to block while jobs are running
+		mdm_AsyncWriteQueue queue(nThreads, 2);
+		BOOST_CHECK_EQUAL(queue.numThreads(), nThreads);
+
+		std::atomic<size_t> count(0);
+		std::vector<int> done(nJobs, 0);
+		for (size_t i = 0; i < nJobs; i++)
+			queue.submit([&, i]() {
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+				done[i] = 1;
+				count++;
+			});
+		queue.wait();
+		BOOST_CHECK_EQUAL(count, nJobs);
+		BOOST_CHECK_EQUAL(std::count(done.begin(), done.end(), 1), nJobs);
+
+		//An error doesn't stop the other jobs, and is thrown by wait
+		count = 0;
+		auto failingJob = []() { throw mdm_exception(__func__, "Write failed"); };
+		if (!nThreads)
+			BOOST_CHECK_THROW(queue.submit(failingJob), mdm_exception);
+		else
+		{
+			queue.submit(failingJob);
+			for (size_t i = 0; i < nJobs; i++)
+				queue.submit([&]() { count++; });
+			BOOST_CHECK_THROW(queue.wait(), mdm_exception);
+			BOOST_CHECK_EQUAL(count, nJobs);
+		}
+
+		//The error is only reported once
+		BOOST_CHECK_NO_THROW(queue.wait());
+	}
+
+	//Changing the number of threads waits for pending jobs
+	mdm_AsyncWriteQueue queue(1);
+	std::atomic<size_t> count(0);
+	for (size_t i = 0; i < 10; i++)
+		queue.submit([&]() {
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			count++;
+		});
+	queue.setNumThreads(2);
+	BOOST_CHECK_EQUAL(count, 10);
+	BOOST_CHECK_EQUAL(queue.numThreads(), 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END() //
@@ -0,0 +1,124 @@
+#include <boost/test/unit_test.hpp>
+#include <boost/format.hpp>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <madym/utils/mdm_Image3D.h>
+#include <madym/utils/mdm_DynamicSeries.h>
+#include <madym/utils/mdm_exception.h>
+#include <madym/tests/mdm_test_utils.h>
+
+BOOST_AUTO_TEST_SUITE(test_mdm)
+
+BOOST_AUTO_TEST_CASE(test_dynamicSeries) {
+	BOOST_TEST_MESSAGE("======= Testing class mdm_DynamicSeries =======");
+
+	//Create a dynamic series where each voxel value encodes its voxel and time index
+	size_t nx = 3, ny = 2, nz = 2, nTimes = 5;
+	std::vector<mdm_Image3D> dynImages(nTimes);
+	for (size_t t = 0; t < nTimes; t++)
+	{
+		dynImages[t].setDimensions(nx, ny, nz);
+		for (size_t i = 0; i < dynImages[t].numVoxels(); i++)
+			dynImages[t].setVoxel(i, 100.0 * i + t);
+	}
+	auto nVoxels = dynImages[0].numVoxels();
+
+	//Pack all voxels
+	mdm_DynamicSeries series;
+	BOOST_CHECK(!series);
+	series.pack(dynImages);
+	BOOST_TEST_MESSAGE("Packed all voxels");
+	BOOST_CHECK(series);
+	BOOST_CHECK_EQUAL(series.numTimes(), nTimes);
+	BOOST_CHECK_EQUAL(series.numVoxels(), nVoxels);
+	BOOST_CHECK_EQUAL(series.storageType(), mdm_Image3D::STORAGE_DOUBLE);
+
+	std::vector<double> data;
+	for (size_t i = 0; i < nVoxels; i++)
+	{
+		std::vector<double> expected(nTimes);
+		for (size_t t = 0; t < nTimes; t++)
+			expected[t] = dynImages[t].voxel(i);
+
+		BOOST_CHECK(series.contains(i));
+		series.voxelData(i, data);
+		BOOST_CHECK_VECTORS(data, expected);
+
+		const double *voxelStart = series.voxelData(i);
+		std::vector<double> inPlace(voxelStart, voxelStart + nTimes);
+		BOOST_CHECK_VECTORS(inPlace, expected);
+	}
+	BOOST_CHECK(!series.contains(nVoxels));
+
+	//Pack a subset of voxels (eg an ROI)
+	std::vector<size_t> voxels = { 1, 4, 7, 10 };
+	series.pack(dynImages, voxels);
+	BOOST_TEST_MESSAGE("Packed subset of voxels");
+	BOOST_CHECK_EQUAL(series.numVoxels(), voxels.size());
+	for (size_t i = 0; i < nVoxels; i++)
+	{
+		bool packed = std::find(voxels.begin(), voxels.end(), i) != voxels.end();
+		BOOST_CHECK_EQUAL(series.contains(i), packed);
+		if (!packed)
+		{
+			BOOST_CHECK_THROW(series.voxelData(i), mdm_exception);
+			continue;
+		}
+		std::vector<double> expected(nTimes);
+		for (size_t t = 0; t < nTimes; t++)
+			expected[t] = dynImages[t].voxel(i);
+
+		series.voxelData(i, data);
+		BOOST_CHECK_VECTORS(data, expected);
+	}
+
+	//Pack images stored as float, the values are all exactly representable
+	for (auto &img : dynImages)
+		img.setStorageType(mdm_Image3D::STORAGE_FLOAT);
+	series.pack(dynImages, voxels);
+	BOOST_TEST_MESSAGE("Packed subset of voxels from float images");
+	BOOST_CHECK_EQUAL(series.storageType(), mdm_Image3D::STORAGE_FLOAT);
+	BOOST_CHECK_THROW(series.voxelData(voxels[0]), mdm_exception);
+	for (auto i : voxels)
+	{
+		std::vector<double> expected(nTimes);
+		for (size_t t = 0; t < nTimes; t++)
+			expected[t] = 100.0 * i + t;
+
+		series.voxelData(i, data);
+		BOOST_CHECK_VECTORS(data, expected);
+	}
+
+	//Allocate an empty series with the same layout, and fill it in place
+	mdm_DynamicSeries filled;
+	filled.allocate(nTimes, nVoxels, voxels);
+	BOOST_CHECK_EQUAL(filled.storageType(), mdm_Image3D::STORAGE_DOUBLE);
+	BOOST_TEST_MESSAGE("Allocated and filled subset of voxels");
+	BOOST_CHECK_EQUAL(filled.numVoxels(), voxels.size());
+	for (auto i : voxels)
+	{
+		std::vector<double> expected(nTimes, 0.0);
+		filled.voxelData(i, data);
+		BOOST_CHECK_VECTORS(data, expected);
+
+		series.voxelData(i, expected);
+		std::copy(expected.begin(), expected.end(), filled.voxelData(i));
+		filled.voxelData(i, data);
+		BOOST_CHECK_VECTORS(data, expected);
+	}
+	BOOST_CHECK_THROW(filled.allocate(nTimes, nVoxels, { nVoxels }), mdm_exception);
+
+	//Invalid inputs
+	BOOST_CHECK_THROW(series.pack(dynImages, { nVoxels }), mdm_exception);
+	dynImages.back().setDimensions(1, 1, 1);
+	BOOST_CHECK_THROW(series.pack(dynImages), mdm_exception);
+
+	//Reset
+	series.reset();
+	BOOST_CHECK(!series);
+	BOOST_CHECK(!series.contains(0));
+}
+
+BOOST_AUTO_TEST_SUITE_END() //
@@ -3,6 +3,8 @@
 
 #include <iostream>
 #include <vector>
+#include <sstream>
+#include <algorithm>
 #include <madym/utils/mdm_Image3D.h>
 #include <madym/tests/mdm_test_utils.h>
 
@@ -41,4 +43,120 @@ BOOST_AUTO_TEST_CASE(test_image3D) {
 	//dimensions, setting meta-info etc.
 }
 
+//Write values to a stream with byte order reversed, then check they're read back
+//correctly with swapping, in both dense and sparse format
+template <class T> static void test_binary_stream_swap(const std::string &typeName)
+{
+	const size_t nx = 5, ny = 4, nz = 3;
+	mdm_Image3D img;
+	img.setDimensions(nx, ny, nz);
+	std::vector<double> vals(img.numVoxels(), 0);
+	for (size_t i = 0; i < vals.size(); i += 2)
+		vals[i] = (double)(T)(i + 1);
+
+	auto write_swapped = [](std::ostream &os, auto v) {
+		char *bytes = reinterpret_cast<char*>(&v);
+		std::reverse(bytes, bytes + sizeof(v));
+		os.write(bytes, sizeof(v));
+	};
+
+	std::stringstream dense, sparse;
+	for (double v : vals)
+		write_swapped(dense, (T)v);
+
+	std::vector<unsigned int> idx;
+	for (size_t i = 0; i < vals.size(); i++)
+	{
+		if (vals[i])
+		{
+			write_swapped(sparse, (T)vals[i]);
+			idx.push_back((unsigned int)i);
+		}
+	}
+	for (auto i : idx)
+		write_swapped(sparse, i);
+
+	mdm_Image3D img_dense, img_sparse;
+	img_dense.setDimensions(nx, ny, nz);
+	img_sparse.setDimensions(nx, ny, nz);
+	img_dense.fromBinaryStream<T>(dense, false, true);
+	img_sparse.fromBinaryStream<T>(sparse, true, true);
+
+	BOOST_TEST_MESSAGE("Byte swapped binary stream read: " + typeName);
+	BOOST_CHECK_VECTORS(img_dense.data(), vals);
+	BOOST_TEST_MESSAGE("Byte swapped sparse binary stream read: " + typeName);
+	BOOST_CHECK_VECTORS(img_sparse.data(), vals);
+}
+
+BOOST_AUTO_TEST_CASE(test_image3D_binary_stream) {
+	BOOST_TEST_MESSAGE("======= Testing mdm_Image3D binary stream byte swapping =======");
+	test_binary_stream_swap<char>("char");
+	test_binary_stream_swap<short>("short");
+	test_binary_stream_swap<int>("int");
+	test_binary_stream_swap<float>("float");
+	test_binary_stream_swap<double>("double");
+}
+
+BOOST_AUTO_TEST_CASE(test_image3D_float_storage) {
+	BOOST_TEST_MESSAGE("======= Testing mdm_Image3D float storage =======");
+	size_t nx = 4, ny = 3, nz = 2;
+
+	mdm_Image3D img_d;
+	img_d.setDimensions(nx, ny, nz);
+	size_t n_voxels = img_d.numVoxels();
+	for (size_t i = 0; i < n_voxels; i++)
+		img_d.setVoxel(i, 0.1 * i + 1.0);
+	BOOST_CHECK_EQUAL(img_d.storageType(), mdm_Image3D::STORAGE_DOUBLE);
+	BOOST_CHECK_THROW(img_d.dataFloat(), mdm_exception);
+
+	//Converting keeps the values, rounded to single precision
+	mdm_Image3D img_f(img_d);
+	img_f.setStorageType(mdm_Image3D::STORAGE_FLOAT);
+	BOOST_CHECK_EQUAL(img_f.storageType(), mdm_Image3D::STORAGE_FLOAT);
+	BOOST_CHECK_EQUAL(img_f.numVoxels(), n_voxels);
+	BOOST_CHECK_THROW(img_f.data(), mdm_exception);
+	BOOST_REQUIRE_EQUAL(img_f.dataFloat().size(), n_voxels);
+	for (size_t i = 0; i < n_voxels; i++)
+	{
+		BOOST_CHECK_EQUAL(img_f.dataFloat()[i], (float)img_d.voxel(i));
+		BOOST_CHECK_EQUAL(img_f.voxel(i), (double)(float)img_d.voxel(i));
+	}
+	BOOST_CHECK_THROW(img_f.voxel(n_voxels), mdm_exception);
+
+	img_f.setVoxel(0, 2.5);
+	BOOST_CHECK_EQUAL(img_f.voxel(0), 2.5);
+
+	//Copies of float images are float
+	mdm_Image3D img_c;
+	img_c.copy(img_f);
+	BOOST_CHECK_EQUAL(img_c.storageType(), mdm_Image3D::STORAGE_FLOAT);
+	BOOST_CHECK_EQUAL(img_c.numVoxels(), n_voxels);
+
+	//Arithmetic works for any combination of storage types
+	mdm_Image3D sum_d(img_d), sum_f(img_f);
+	sum_d += img_f;
+	sum_f += img_d;
+	sum_f *= 2.0;
+	sum_f /= 2.0;
+	for (size_t i = 0; i < n_voxels; i++)
+	{
+		BOOST_CHECK_CLOSE(sum_d.voxel(i), img_d.voxel(i) + img_f.voxel(i), 1e-6);
+		BOOST_CHECK_CLOSE(sum_f.voxel(i), img_d.voxel(i) + img_f.voxel(i), 1e-4);
+	}
+
+	//Binary stream round trip
+	std::stringstream ss;
+	img_f.toBinaryStream<float>(ss, false);
+	mdm_Image3D img_r;
+	img_r.setStorageType(mdm_Image3D::STORAGE_FLOAT);
+	img_r.setDimensions(nx, ny, nz);
+	img_r.fromBinaryStream<float>(ss, false, false);
+	BOOST_CHECK(img_r.dataFloat() == img_f.dataFloat());
+
+	//And back to double
+	img_f.setStorageType(mdm_Image3D::STORAGE_DOUBLE);
+	BOOST_CHECK_EQUAL(img_f.data().size(), n_voxels);
+	BOOST_CHECK_EQUAL(img_f.voxel(1), (double)(float)img_d.voxel(1));
+}
+
 BOOST_AUTO_TEST_SUITE_END() //
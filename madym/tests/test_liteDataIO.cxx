@@ -0,0 +1,177 @@
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <madym/tests/mdm_test_utils.h>
+
+#include <madym/run/mdm_LiteDataIO.h>
+#include <madym/run/mdm_RunTools_madym_T1_lite.h>
+#include <madym/t1/mdm_T1FitterVFA.h>
+#include <madym/utils/mdm_exception.h>
+
+BOOST_AUTO_TEST_SUITE(test_mdm)
+
+BOOST_AUTO_TEST_CASE(test_liteDataIO) {
+	BOOST_TEST_MESSAGE("======= Testing lite tool data formats =======");
+
+	//Make some rows of data, with values exactly representable as floats
+	const size_t nRows = 1000, nCols = 7;
+	std::vector<std::vector<double>> rows(nRows, std::vector<double>(nCols));
+	for (size_t i = 0; i < nRows; i++)
+		for (size_t j = 0; j < nCols; j++)
+			rows[i][j] = 0.25 * i - 0.5 * j;
+
+	for (auto fmt : { mdm_LiteDataIO::TEXT, mdm_LiteDataIO::FLOAT64,
+		mdm_LiteDataIO::FLOAT32, mdm_LiteDataIO::NPY })
+	{
+		const auto fmtStr = mdm_LiteDataIO::toString(fmt);
+		BOOST_TEST_MESSAGE("Testing " + fmtStr);
+		BOOST_CHECK_EQUAL(mdm_LiteDataIO::formatFromString(fmtStr), fmt);
+
+		std::string fileName = mdm_test_utils::temp_dir() + "/lite_data_" + fmtStr;
+		{
+			mdm_LiteDataIO::Writer writer(fileName, fmt);
+			for (const auto &row : rows)
+				writer.writeRow(row);
+
+			//All rows must be the same length
+			BOOST_CHECK_THROW(writer.writeRow(std::vector<double>(nCols + 1)), mdm_exception);
+			writer.close();
+		}
+
+		//Read the rows back
+		mdm_LiteDataIO::Reader reader(fileName, fmt, nCols);
+		std::vector<double> row;
+		size_t nRead = 0;
+		while (reader.readRow(row))
+		{
+			BOOST_REQUIRE_LT(nRead, nRows);
+			BOOST_CHECK_VECTORS(row, rows[nRead]);
+			nRead++;
+		}
+		BOOST_CHECK_EQUAL(nRead, nRows);
+
+		//Reading with the wrong number of columns should fail, either on opening
+		//(binary formats) or on reaching the end of the file (text)
+		if (fmt == mdm_LiteDataIO::TEXT)
+		{
+			mdm_LiteDataIO::Reader textReader(fileName, fmt, 3);
+			BOOST_CHECK_THROW(while (textReader.readRow(row)); , mdm_exception);
+		}
+		else
+			BOOST_CHECK_THROW(mdm_LiteDataIO::Reader(fileName, fmt, 3), mdm_exception);
+	}
+
+	//NPY files start with the standard header, padded to a multiple of 64 bytes
+	{
+		std::ifstream ifs(mdm_test_utils::temp_dir() + "/lite_data_NPY", std::ios::binary);
+		std::string header(128, ' ');
+		ifs.read(&header[0], header.size());
+		BOOST_CHECK_EQUAL(header.substr(1, 5), "NUMPY");
+		BOOST_CHECK(header.find("'shape': (1000, 7)") != std::string::npos);
+		BOOST_CHECK_EQUAL(header.back(), '\n');
+	}
+
+	BOOST_CHECK_THROW(mdm_LiteDataIO::formatFromString("CSV"), mdm_exception);
+	BOOST_CHECK_THROW(mdm_LiteDataIO::Reader("not_a_file", mdm_LiteDataIO::NPY, 1), mdm_exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_liteDataIO_arrays) {
+	BOOST_TEST_MESSAGE("======= Testing lite tool in-memory data and parallel processing =======");
+
+	const size_t nRows = 2000, nCols = 3, nThreads = 4;
+	std::vector<double> inputs(nRows * nCols), params(nRows);
+	for (size_t i = 0; i < nRows; i++)
+	{
+		for (size_t j = 0; j < nCols; j++)
+			inputs[i*nCols + j] = double(i) + 0.5 * j;
+		params[i] = -double(i);
+	}
+
+	//Each output row holds the sum of the inputs, the initial parameter and the thread index
+	std::vector<double> outputs;
+	mdm_LiteDataIO::Reader inputReader(inputs.data(), nRows, nCols);
+	mdm_LiteDataIO::Reader paramsReader(params.data(), nRows, 1);
+	mdm_LiteDataIO::Writer writer(outputs);
+	auto nProcessed = mdm_LiteDataIO::processRows(inputReader, &paramsReader, writer, nThreads,
+		[](size_t i_t, const std::vector<double> &row, const std::vector<double> &initialParams,
+			std::vector<double> &output)
+	{
+		output = { row[0] + row[1] + row[2], initialParams[0], double(i_t) };
+	}, true, "row");
+	writer.close();
+
+	//Output must be complete and in input order
+	BOOST_CHECK_EQUAL(nProcessed, nRows);
+	BOOST_CHECK_EQUAL(writer.numColumns(), size_t(3));
+	BOOST_REQUIRE_EQUAL(outputs.size(), nRows * 3);
+	bool inOrder = true, validThreads = true;
+	for (size_t i = 0; i < nRows; i++)
+	{
+		inOrder &= outputs[i*3] == 3.0 * i + 1.5 && outputs[i*3 + 1] == -double(i);
+		validThreads &= outputs[i*3 + 2] >= 0 && outputs[i*3 + 2] < nThreads;
+	}
+	BOOST_CHECK(inOrder);
+	BOOST_CHECK(validThreads);
+
+	//Errors in any worker are thrown to the caller
+	mdm_LiteDataIO::Reader errorReader(inputs.data(), nRows, nCols);
+	mdm_LiteDataIO::Writer errorWriter(outputs);
+	BOOST_CHECK_THROW(mdm_LiteDataIO::processRows(errorReader, NULL, errorWriter, nThreads,
+		[](size_t, const std::vector<double> &row, const std::vector<double> &, std::vector<double> &)
+	{
+		if (row[0] == 1000)
+			throw mdm_exception("test", "bad row");
+	}, true, "row"), mdm_exception);
+
+	//Missing initial parameters
+	mdm_LiteDataIO::Reader shortReader(inputs.data(), nRows, nCols);
+	mdm_LiteDataIO::Reader shortParams(params.data(), nRows / 2, 1);
+	mdm_LiteDataIO::Writer shortWriter(outputs);
+	BOOST_CHECK_THROW(mdm_LiteDataIO::processRows(shortReader, &shortParams, shortWriter, 1,
+		[](size_t, const std::vector<double> &, const std::vector<double> &, std::vector<double> &)
+	{}, true, "row"), mdm_exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_T1_lite_arrays) {
+	BOOST_TEST_MESSAGE("======= Testing T1 lite on in-memory data =======");
+
+	//Make VFA signals for a range of T1 values
+	const double TR = 3.5, M0 = 2000;
+	const auto PI = acos(-1.0);
+	const std::vector<double>	FAs = { 2 , 10, 18 };
+	const size_t nSamples = 100;
+	std::vector<double> inputs;
+	for (size_t i = 0; i < nSamples; i++)
+	{
+		inputs.insert(inputs.end(), FAs.begin(), FAs.end());
+		for (const auto FA : FAs)
+			inputs.push_back(mdm_T1FitterVFA::T1toSignal(500 + 10.0 * i, M0, PI*FA / 180, TR));
+	}
+
+	mdm_LiteDataIO::Arrays arrays;
+	arrays.inputs = inputs.data();
+	arrays.numRows = nSamples;
+	arrays.numInputColumns = 2 * FAs.size();
+
+	mdm_RunTools_madym_T1_lite madym_exe;
+	const char *argv[] = { "madym_T1_lite", "-T", "VFA", "--n_T1", "3", "--TR", "3.5",
+		"--nthreads", "2", "--quiet" };
+	BOOST_REQUIRE_EQUAL(madym_exe.parseInputs(10, argv), int(mdm_OptionsParser::OK));
+	madym_exe.runArrays(arrays);
+
+	//Outputs are T1, M0, error code for each sample
+	BOOST_REQUIRE_EQUAL(arrays.numOutputColumns, size_t(3));
+	BOOST_REQUIRE_EQUAL(arrays.outputs.size(), 3 * nSamples);
+	for (size_t i = 0; i < nSamples; i += 33)
+	{
+		BOOST_CHECK_CLOSE(arrays.outputs[3 * i], 500 + 10.0 * i, 0.1);
+		BOOST_CHECK_CLOSE(arrays.outputs[3 * i + 1], M0, 0.1);
+		BOOST_CHECK_EQUAL(arrays.outputs[3 * i + 2], 0);
+	}
+
+	//Input arrays must have the right number of columns
+	arrays.numInputColumns = 5;
+	BOOST_CHECK_THROW(madym_exe.runArrays(arrays), mdm_exception);
+}
+
+BOOST_AUTO_TEST_SUITE_END() //
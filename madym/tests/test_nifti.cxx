@@ -1,11 +1,15 @@
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <madym/dce/mdm_AIF.h>
 #include <madym/tests/mdm_test_utils.h>
 
 #include <madym/image_io/mdm_ImageDatatypes.h>
 #include <madym/image_io/nifti/mdm_NiftiFormat.h>
+#include <madym/image_io/nifti/mdm_NiftiMappedImage.h>
+#include <madym/image_io/nifti/mdm_ParallelGzip.h>
 #include <madym/utils/mdm_Image3D.h>
 #include <madym/utils/mdm_exception.h>
 
@@ -264,4 +268,141 @@ BOOST_AUTO_TEST_CASE(test_nifti) {
 	test_nifti_scaling();
 }
 
+BOOST_AUTO_TEST_CASE(test_nifti_mapped) {
+	BOOST_TEST_MESSAGE("======= Testing memory-mapped NIFTI reading =======");
+
+	int nx = 3, ny = 2, nz = 2, nt = 4;
+	int n_voxels = nx * ny * nz;
+
+	std::vector<mdm_Image3D> imgs(nt);
+	for (int t = 0; t < nt; t++)
+	{
+		imgs[t].setDimensions(nx, ny, nz);
+		imgs[t].setVoxelDims(1.5, 2.0, 2.5);
+		for (int i = 0; i < n_voxels; i++)
+			imgs[t].setVoxel(i, i + 100.0*t);
+	}
+
+	//Uncompressed images can be mapped
+	std::string img_name = mdm_test_utils::temp_dir() + "/img_4D_mapped";
+	BOOST_CHECK_NO_THROW(mdm_NiftiFormat::writeImage4D(
+		img_name, imgs, mdm_ImageDatatypes::DT_SIGNED_SHORT, mdm_XtrFormat::NO_XTR, false, false));
+
+	mdm_NiftiMappedImage mapped(img_name + ".nii");
+	BOOST_CHECK_EQUAL(mapped.numVolumes(), nt);
+	BOOST_CHECK_EQUAL(mapped.numVoxels(), n_voxels);
+	BOOST_CHECK(mapped.volumeTemplate().dimensionsMatch(imgs[0]));
+
+	//Check volumes and time-series match the images written
+	for (int t = 0; t < nt; t++)
+	{
+		auto vol = mapped.volume(t);
+		BOOST_CHECK_VECTORS(vol.data(), imgs[t].data());
+		BOOST_CHECK_EQUAL(mapped.volumeView(t)[n_voxels - 1], imgs[t].voxel(n_voxels - 1));
+	}
+	for (int i = 0; i < n_voxels; i++)
+	{
+		std::vector<double> ts;
+		mapped.timeSeriesView(i).copyTo(ts);
+		BOOST_REQUIRE_EQUAL(ts.size(), nt);
+		for (int t = 0; t < nt; t++)
+			BOOST_CHECK_EQUAL(ts[t], imgs[t].voxel(i));
+	}
+	BOOST_CHECK_THROW(mapped.volumeView(nt), mdm_exception);
+	BOOST_CHECK_THROW(mapped.timeSeriesView(n_voxels), mdm_exception);
+
+	//readImage4D uses the mapping for uncompressed images
+	auto imgs_r = mdm_NiftiFormat::readImage4D(img_name, false, false);
+	BOOST_REQUIRE_EQUAL(imgs_r.size(), nt);
+	for (int t = 0; t < nt; t++)
+		BOOST_CHECK_VECTORS(imgs_r[t].data(), imgs[t].data());
+
+	//And can convert mapped volumes directly to float storage
+	auto imgs_f = mdm_NiftiFormat::readImage4D(img_name, false, false, mdm_Image3D::STORAGE_FLOAT);
+	BOOST_REQUIRE_EQUAL(imgs_f.size(), nt);
+	for (int t = 0; t < nt; t++)
+	{
+		BOOST_CHECK_EQUAL(imgs_f[t].storageType(), mdm_Image3D::STORAGE_FLOAT);
+		for (int i = 0; i < n_voxels; i++)
+			BOOST_CHECK_EQUAL(imgs_f[t].voxel(i), imgs[t].voxel(i));
+	}
+
+#ifdef HAVE_ZLIB
+	//Compressed images can't be mapped
+	std::string img_name_gz = mdm_test_utils::temp_dir() + "/img_4D_mapped_gz";
+	BOOST_CHECK_NO_THROW(mdm_NiftiFormat::writeImage4D(
+		img_name_gz, imgs, mdm_ImageDatatypes::DT_SIGNED_SHORT, mdm_XtrFormat::NO_XTR, true, false));
+	BOOST_CHECK_THROW(mdm_NiftiMappedImage mapped_gz(img_name_gz + ".nii.gz"), mdm_exception);
+#endif
+}
+
+#ifdef HAVE_ZLIB
+BOOST_AUTO_TEST_CASE(test_nifti_parallel_gzip) {
+	BOOST_TEST_MESSAGE("======= Testing parallel gzip NIFTI writing =======");
+
+	//Write data in pieces that straddle block boundaries, using small blocks so
+	//there are many, then check it decompresses to the same bytes
+	std::string gz_name = mdm_test_utils::temp_dir() + "/parallel_gzip_test.gz";
+	std::vector<char> bytes(100000);
+	for (size_t i = 0; i < bytes.size(); i++)
+		bytes[i] = char((i * 7919) % 251);
+
+	{
+		mdm_ParallelGzip::Writer writer(gz_name, 4, -1, 1000);
+		writer.write(bytes.data(), 10);
+		writer.write(bytes.data() + 10, 2500);
+		writer.write(bytes.data() + 2510, bytes.size() - 2510);
+		BOOST_CHECK_EQUAL(writer.tell(), bytes.size());
+		BOOST_CHECK_NO_THROW(writer.close());
+	}
+	{
+		mdm_ParallelGzip::Reader reader(gz_name, 3000);
+		std::vector<char> bytes_r(bytes.size() + 10);
+		BOOST_CHECK_EQUAL(reader.skip(100), 100);
+		BOOST_CHECK_EQUAL(reader.read(bytes_r.data() + 100, bytes_r.size()), bytes.size() - 100);
+		BOOST_CHECK(std::equal(bytes.begin() + 100, bytes.end(), bytes_r.begin() + 100));
+	}
+
+	//Empty files are still valid gzip
+	{
+		mdm_ParallelGzip::Writer writer(gz_name, 2);
+	}
+	{
+		mdm_ParallelGzip::Reader reader(gz_name);
+		char c;
+		BOOST_CHECK_EQUAL(reader.read(&c, 1), 0);
+	}
+
+	//Write 4D images with single and multi-threaded compression, and check both
+	//read back correctly
+	int nx = 16, ny = 16, nz = 8, nt = 10;
+	int n_voxels = nx * ny * nz;
+	std::vector<mdm_Image3D> imgs(nt);
+	for (int t = 0; t < nt; t++)
+	{
+		imgs[t].setDimensions(nx, ny, nz);
+		imgs[t].setVoxelDims(1.0, 1.0, 2.0);
+		for (int i = 0; i < n_voxels; i++)
+			imgs[t].setVoxel(i, std::sin(0.01*i) * t);
+	}
+
+	for (int nThreads : {1, 4, 0})
+	{
+		std::string img_name = mdm_test_utils::temp_dir() + "/img_4D_gz_" + std::to_string(nThreads);
+		BOOST_CHECK_NO_THROW(mdm_NiftiFormat::writeImage4D(
+			img_name, imgs, mdm_ImageDatatypes::DT_DOUBLE, mdm_XtrFormat::NO_XTR, true, false, nThreads));
+
+		auto imgs_r = mdm_NiftiFormat::readImage4D(img_name + ".nii.gz", false, false);
+		BOOST_REQUIRE_EQUAL(imgs_r.size(), nt);
+		for (int t = 0; t < nt; t++)
+			BOOST_CHECK_VECTORS(imgs_r[t].data(), imgs[t].data());
+
+		BOOST_CHECK_NO_THROW(mdm_NiftiFormat::writeImage3D(
+			img_name, imgs[1], mdm_ImageDatatypes::DT_FLOAT, mdm_XtrFormat::NO_XTR, true, false, nThreads));
+		auto img_r = mdm_NiftiFormat::readImage3D(img_name + ".nii.gz", false, false);
+		BOOST_CHECK(mdm_test_utils::vectors_near_equal(img_r.data(), imgs[1].data(), 1e-6));
+	}
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END() //
@@ -7,6 +7,7 @@
 #include <madym/tests/mdm_test_utils.h>
 #include <madym/run/mdm_VolumeAnalysis.h>
 #include <madym/dce/mdm_DCEModelGenerator.h>
+#include <madym/t1/mdm_T1FitterVFA.h>
 
 BOOST_AUTO_TEST_SUITE(test_mdm)
 
@@ -88,4 +89,103 @@ BOOST_AUTO_TEST_CASE(test_volumeAnalysis) {
 	
 }
 
+BOOST_AUTO_TEST_CASE(test_volumeAnalysis_CtFromSignal) {
+  BOOST_TEST_MESSAGE("======= Testing volume conversion of signal to concentration =======");
+
+  //Simulate signals from a linear uptake of contrast-agent after the bolus, in
+  //a small volume, with T1, M0 and B1 varying by voxel
+  const size_t nTimes = 20;
+  const int prebolus = 5;
+  const double TR = 4.0;
+  const double FA = 20.0;
+  const double r1 = 3.4;
+  const double PI = acos(-1.0);
+
+  mdm_Image3D T1, M0, B1;
+  for (auto img : { &T1, &M0, &B1 })
+  {
+    img->setDimensions(4, 4, 2);
+    img->setVoxelDims(1, 1, 1);
+  }
+  const auto nVoxels = T1.numVoxels();
+
+  std::vector<std::vector<double>> CtTrue(nVoxels, std::vector<double>(nTimes, 0));
+  std::vector<mdm_Image3D> dynImgs(nTimes);
+  for (size_t t = 0; t < nTimes; t++)
+  {
+    dynImgs[t].copy(T1);
+    dynImgs[t].info().TR.setValue(TR);
+    dynImgs[t].info().flipAngle.setValue(FA);
+    dynImgs[t].setTimeStampFromMins(0.1 * t);
+  }
+  for (size_t v = 0; v < nVoxels; v++)
+  {
+    T1.setVoxel(v, 500.0 + 50.0 * v);
+    M0.setVoxel(v, 2000.0 + 10.0 * v);
+    B1.setVoxel(v, 0.9 + 0.2 * v / nVoxels);
+    for (size_t t = 0; t < nTimes; t++)
+    {
+      if (t >= prebolus)
+        CtTrue[v][t] = 0.05 * (t - prebolus);
+
+      auto T1t = 1.0 / (1.0 / T1.voxel(v) + 0.001 * r1 * CtTrue[v][t]);
+      dynImgs[t].setVoxel(v, mdm_T1FitterVFA::T1toSignal(
+        T1t, M0.voxel(v), B1.voxel(v) * FA * PI / 180, TR));
+    }
+  }
+
+  //Voxel 0 has invalid T1, so is not converted, and voxel 1 has an invalid signal
+  T1.setVoxel(0, 0.0);
+  dynImgs[nTimes - 1].setVoxel(1, NAN);
+
+  mdm_AIF AIF;
+  for (bool useM0Ratio : { true, false })
+  {
+    for (int nThreads : { 1, 3 })
+    {
+      BOOST_TEST_MESSAGE(boost::format("Testing M0 ratio %1%, using %2% threads")
+        % useM0Ratio % nThreads);
+      mdm_VolumeAnalysis v;
+      v.setComputeCt(true);
+      v.setOutputCtSig(true);
+      v.setM0Ratio(useM0Ratio);
+      v.setB1correction(true);
+      v.setR1Const(r1);
+      v.setPrebolusImage(prebolus);
+      v.setNumThreads(nThreads);
+      v.setOptimisationType("BLEIC");
+      for (const auto &img : dynImgs)
+        v.addStDataMap(img);
+      v.T1Mapper().setT1(T1);
+      v.T1Mapper().setM0(M0);
+      v.T1Mapper().setB1(B1);
+      v.setModel(mdm_DCEModelGenerator::createModel(AIF,
+        mdm_DCEModelGenerator::ModelTypes::NONE, {},
+        {}, {}, {}, {}, {}, {}, {}, -1, {}));
+      v.fitDCEModel(false);
+
+      //Converted concentration matches the true values, and the per-voxel conversion
+      std::vector<double> St(nTimes);
+      for (size_t vox = 2; vox < nVoxels; vox++)
+      {
+        for (size_t t = 0; t < nTimes; t++)
+          St[t] = dynImgs[t].voxel(vox);
+
+        mdm_DCEVoxel dceVox(St, {}, prebolus, v.dynamicTimes(), {}, false);
+        dceVox.computeCtFromSignal(T1.voxel(vox), FA, TR, r1,
+          useM0Ratio ? 0.0 : M0.voxel(vox), B1.voxel(vox));
+
+        for (size_t t = 0; t < nTimes; t++)
+        {
+          BOOST_CHECK_SMALL(v.CtDataMap(t).voxel(vox) - CtTrue[vox][t], 1e-6);
+          BOOST_CHECK_EQUAL(v.CtDataMap(t).voxel(vox), dceVox.CtData()[t]);
+        }
+        BOOST_CHECK(!v.errorTracker().errorImage().voxel(vox));
+      }
+      BOOST_CHECK_EQUAL(v.CtDataMap(nTimes - 1).voxel(0), 0.0);
+      BOOST_CHECK(int(v.errorTracker().errorImage().voxel(1)) & mdm_ErrorTracker::CA_IS_NAN);
+    }
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END() //
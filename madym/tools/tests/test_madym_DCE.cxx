@@ -548,6 +548,89 @@ BOOST_AUTO_TEST_CASE(test_madym_DCE) {
     );
   }
 
+  //-------------------------------------------------------------------------------
+  // 7) Multi-threaded fitting of a multi-voxel volume matches serial fitting
+  //-------------------------------------------------------------------------------
+  {
+    BOOST_TEST_MESSAGE("7) Multi-threaded fitting matches serial fitting");
+    std::string mv_dyn_dir = test_dir + "/dynamics_mv/";
+    fs::create_directories(mv_dyn_dir);
+
+    //Write out 4x4x2 concentration maps, scaling the time-series in each voxel
+    //so the fitted values vary across the volume
+    const size_t nx = 4, ny = 4, nz = 2;
+    const size_t nVoxels = nx * ny * nz;
+    for (int i_t = 0; i_t < nTimes; i_t++)
+    {
+      auto Ct_name = mv_dyn_dir + "Ct_" + (boost::format("%02u") % (i_t + 1)).str();
+
+      mdm_Image3D Ct_img;
+      Ct_img.setDimensions(nx, ny, nz);
+      Ct_img.setVoxelDims(1, 1, 1);
+      Ct_img.setTimeStampFromMins(dynTimes[i_t]);
+      Ct_img.setType(mdm_Image3D::ImageType::TYPE_CAMAP);
+      for (size_t i_v = 0; i_v < nVoxels; i_v++)
+        Ct_img.setVoxel(i_v, Ct[i_t] * (0.5 + double(i_v) / nVoxels));
+
+      mdm_AnalyzeFormat::writeImage3D(Ct_name, Ct_img,
+        mdm_ImageDatatypes::DT_FLOAT, mdm_XtrFormat::NEW_XTR, false);
+    }
+
+    const std::vector<int> nThreads = { 1, 4 };
+    std::vector<std::string> Ct_output_dirs;
+    for (const auto n : nThreads)
+    {
+      std::string Ct_output_dir = test_dir + "/mdm_analysis_Ct_nthreads" + std::to_string(n) + "/";
+      Ct_output_dirs.push_back(Ct_output_dir);
+
+      mdm_RunTools_madym_DCE madym_exe;
+      auto &madym_options = madym_exe.options();
+
+      madym_options.model.set("ETM");
+      madym_options.outputDir.set(Ct_output_dir);
+      madym_options.dynDir.set(mv_dyn_dir);
+      madym_options.dynName.set("Ct_");
+      madym_options.sequenceFormat.set("%02u");
+      madym_options.nDyns.set(nTimes);
+      madym_options.injectionImage.set(injectionImage);
+      madym_options.dose.set(dose);
+      madym_options.hct.set(hct);
+      madym_options.IAUCTimes.set(IAUCTimes);
+      madym_options.inputCt.set(true);
+      madym_options.imageWriteFormat.set("ANALYZE");
+      madym_options.nThreads.set(n);
+      madym_options.overwrite.set(true);
+      madym_options.noAudit.set(true);
+
+      madym_exe.parseInputs("test_madym_DCE_nthreads");
+      int result = madym_exe.run_catch();
+
+      BOOST_CHECK_MESSAGE(!result, "Running madym_DCE with nthreads = " << n << " failed");
+    }
+
+    //Fitted maps should be identical, voxel for voxel
+    std::vector<std::string> map_names = { "Ktrans", "v_e", "v_p", "tau_a", "residuals", "error_tracker" };
+    for (const auto t : IAUCTimes)
+      map_names.push_back("IAUC" + std::to_string((int)t));
+
+    for (const auto &map_name : map_names)
+    {
+      mdm_Image3D serial_map = mdm_ImageIO::readImage3D(
+        mdm_ImageIO::ImageFormat::ANALYZE, Ct_output_dirs[0] + map_name, false, false);
+      mdm_Image3D threaded_map = mdm_ImageIO::readImage3D(
+        mdm_ImageIO::ImageFormat::ANALYZE, Ct_output_dirs[1] + map_name, false, false);
+
+      BOOST_TEST_MESSAGE("Checking serial and threaded " << map_name << " maps match");
+      BOOST_REQUIRE_EQUAL(threaded_map.numVoxels(), nVoxels);
+      for (size_t i_v = 0; i_v < nVoxels; i_v++)
+        BOOST_CHECK_EQUAL(serial_map.voxel(i_v), threaded_map.voxel(i_v));
+    }
+
+    for (const auto &Ct_output_dir : Ct_output_dirs)
+      fs::remove_all(Ct_output_dir);
+    fs::remove_all(mv_dyn_dir);
+  }
+
 	//---------------------------------------------------------------------------
 	//Tidy up
 	fs::remove_all(dyn_dir);
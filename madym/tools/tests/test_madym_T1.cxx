@@ -86,6 +86,94 @@ BOOST_AUTO_TEST_CASE(test_madym_T1_VFA) {
 	fs::remove_all(T1_output_dir);
 }
 
+BOOST_AUTO_TEST_CASE(test_madym_T1_VFA_nthreads) {
+  BOOST_TEST_MESSAGE("======= Testing tool: madym T1 VFA multi-threaded =======");
+
+  //Generate signals over a multi-voxel volume, with T1 varying across the volume
+  //and some voxels set below the noise threshold
+  const size_t nx = 6, ny = 5, nz = 3;
+  const size_t nVoxels = nx * ny * nz;
+  double M0 = 2000;
+  double TR = 3.5;
+  std::vector<double>	FAs = { 2, 10, 18 };
+  const auto PI = acos(-1.0);
+
+  std::string test_dir = mdm_test_utils::temp_dir();
+  std::string FA_dir = test_dir + "/FAs_nthreads/";
+  fs::create_directories(FA_dir);
+
+  std::vector<std::string> FA_names(3);
+  for (int i_fa = 0; i_fa < 3; i_fa++)
+  {
+    mdm_Image3D FA_img;
+    FA_img.setDimensions(nx, ny, nz);
+    FA_img.setVoxelDims(1, 1, 1);
+    FA_img.info().flipAngle.setValue(FAs[i_fa]);
+    FA_img.info().TR.setValue(TR);
+    for (size_t i_v = 0; i_v < nVoxels; i_v++)
+    {
+      double T1 = 500 + 20 * double(i_v);
+      double signal = (i_v % 7) ? mdm_T1FitterVFA::T1toSignal(T1, M0, PI*FAs[i_fa] / 180, TR) : 0;
+      FA_img.setVoxel(i_v, signal);
+    }
+
+    FA_names[i_fa] = FA_dir + "FA_" + std::to_string((int)FAs[i_fa]);
+
+    mdm_NiftiFormat::writeImage3D(FA_names[i_fa], FA_img,
+      mdm_ImageDatatypes::DT_FLOAT, mdm_XtrFormat::NEW_XTR, false);
+  }
+
+  //Call madym_T1 serially and multi-threaded
+  const std::vector<int> nThreads = { 1, 3 };
+  std::vector<std::string> T1_output_dirs;
+  for (const auto n : nThreads)
+  {
+    std::string T1_output_dir = test_dir + "/madym_T1_nthreads" + std::to_string(n) + "/";
+    T1_output_dirs.push_back(T1_output_dir);
+
+    std::stringstream cmd;
+    cmd << mdm_test_utils::tools_exe_dir() << "madym_T1"
+      << " -T VFA "
+      << " --T1_vols " << FA_names[0] << "," << FA_names[1] << "," << FA_names[2]
+      << " --nthreads " << n
+      << " -o " << T1_output_dir
+      << " --overwrite"
+      << " --no_audit";
+
+    BOOST_TEST_MESSAGE("Command to run: " + cmd.str());
+
+    int error;
+    try
+    {
+      error = std::system(cmd.str().c_str());
+    }
+    catch (...)
+    {
+      BOOST_CHECK_MESSAGE(false, "Running madym_T1 failed");
+      return;
+    }
+
+    BOOST_CHECK_MESSAGE(!error, "Error returned from madym_T1 tool");
+  }
+
+  //Maps and error codes should be identical, voxel for voxel
+  for (const auto map_name : { "T1", "M0", "error_tracker" })
+  {
+    mdm_Image3D serial_map = mdm_NiftiFormat::readImage3D(T1_output_dirs[0] + map_name, false);
+    mdm_Image3D threaded_map = mdm_NiftiFormat::readImage3D(T1_output_dirs[1] + map_name, false);
+
+    BOOST_TEST_MESSAGE("Testing serial and threaded " << map_name << " maps match");
+    BOOST_REQUIRE_EQUAL(threaded_map.numVoxels(), nVoxels);
+    for (size_t i_v = 0; i_v < nVoxels; i_v++)
+      BOOST_CHECK_EQUAL(serial_map.voxel(i_v), threaded_map.voxel(i_v));
+  }
+
+  //Tidy up
+  fs::remove_all(FA_dir);
+  for (const auto &T1_output_dir : T1_output_dirs)
+    fs::remove_all(T1_output_dir);
+}
+
 BOOST_AUTO_TEST_CASE(test_madym_T1_VFA_B1) {
   BOOST_TEST_MESSAGE("======= Testing tool: madym T1 VFA with B1 correction =======");
 
@@ -0,0 +1,147 @@
+/**
+*  @file    mdm_AsyncWriteQueue.cxx
+*  @brief   Implementation of mdm_AsyncWriteQueue class
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_API_EXPORTS
+#define MDM_API_EXPORTS
+#endif
+
+#include "mdm_AsyncWriteQueue.h"
+
+#include <madym/utils/mdm_ProgramLogger.h>
+
+const size_t mdm_AsyncWriteQueue::DEFAULT_JOBS_PER_THREAD;
+
+//
+MDM_API mdm_AsyncWriteQueue::mdm_AsyncWriteQueue(size_t nThreads, size_t maxQueued)
+  :
+  nThreads_(nThreads),
+  maxQueued_(maxQueued ? maxQueued : DEFAULT_JOBS_PER_THREAD * nThreads),
+  numRunning_(0),
+  stop_(false),
+  error_(nullptr)
+{
+}
+
+//
+MDM_API mdm_AsyncWriteQueue::~mdm_AsyncWriteQueue()
+{
+  try
+  {
+    wait();
+  }
+  catch (std::exception &e)
+  {
+    mdm_ProgramLogger::logProgramError(__func__, e.what());
+  }
+  stopThreads();
+}
+
+//
+MDM_API void mdm_AsyncWriteQueue::setNumThreads(size_t nThreads, size_t maxQueued)
+{
+  wait();
+  stopThreads();
+  nThreads_ = nThreads;
+  maxQueued_ = maxQueued ? maxQueued : DEFAULT_JOBS_PER_THREAD * nThreads;
+}
+
+//
+MDM_API size_t mdm_AsyncWriteQueue::numThreads() const
+{
+  return nThreads_;
+}
+
+//
+MDM_API void mdm_AsyncWriteQueue::submit(std::function<void()> job)
+{
+  if (!nThreads_)
+  {
+    job();
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (threads_.empty())
+    {
+      for (size_t i = 0; i < nThreads_; i++)
+        threads_.emplace_back(&mdm_AsyncWriteQueue::worker, this);
+    }
+    spaceReady_.wait(lock, [&] { return jobs_.size() < maxQueued_; });
+    jobs_.push_back(std::move(job));
+  }
+  jobReady_.notify_one();
+}
+
+//
+MDM_API void mdm_AsyncWriteQueue::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  jobsDone_.wait(lock, [&] { return jobs_.empty() && !numRunning_; });
+  if (error_)
+  {
+    auto error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+//-----------------------------------------------------------------------
+// Private
+//-------------------------------------------------------------------------
+void mdm_AsyncWriteQueue::worker()
+{
+  while (true)
+  {
+    std::function<void()> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      jobReady_.wait(lock, [&] { return stop_ || !jobs_.empty(); });
+
+      //Only stop once the queue has been drained
+      if (jobs_.empty())
+        return;
+
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+      numRunning_++;
+    }
+    spaceReady_.notify_one();
+
+    std::exception_ptr error = nullptr;
+    try
+    {
+      job();
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (error && !error_)
+        error_ = error;
+      numRunning_--;
+    }
+    jobsDone_.notify_all();
+  }
+}
+
+//
+void mdm_AsyncWriteQueue::stopThreads()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  jobReady_.notify_all();
+  for (auto &thread : threads_)
+    thread.join();
+  threads_.clear();
+  stop_ = false;
+}
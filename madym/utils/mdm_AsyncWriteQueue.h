@@ -0,0 +1,103 @@
+/**
+*  @file    mdm_AsyncWriteQueue.h
+*  @brief Bounded queue of output jobs run by background I/O threads
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_ASYNCWRITEQUEUE_HDR
+#define MDM_ASYNCWRITEQUEUE_HDR
+
+#include <madym/utils/mdm_api.h>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Bounded queue of output jobs run by background I/O threads
+/*!
+Jobs (typically encoding, compressing and writing an output image) are submitted
+as they become ready and run in the order submitted by a small pool of background
+threads, so output overlaps whatever the caller does next (eg preparing and writing
+the next map). If the queue is full, submit blocks until a job has been taken, so
+the memory held by pending jobs is bounded.
+
+An exception thrown by a job does not stop the remaining jobs. The first exception
+caught is rethrown in the calling thread by wait(), which must be called before any
+data referenced by pending jobs is modified or destroyed.
+
+With zero threads, jobs are run directly in submit, so errors are thrown immediately.
+Threads are only started when the first job is submitted.
+*/
+class mdm_AsyncWriteQueue {
+
+public:
+
+  //! Default maximum number of jobs waiting in the queue, per thread
+  static const size_t DEFAULT_JOBS_PER_THREAD = 4;
+
+  //! Constructor
+  /*!
+  \param nThreads number of background threads. If 0, jobs are run synchronously
+  \param maxQueued maximum number of jobs waiting to run. If 0, uses
+  DEFAULT_JOBS_PER_THREAD per thread
+  */
+  MDM_API mdm_AsyncWriteQueue(size_t nThreads = 1, size_t maxQueued = 0);
+
+  //! Destructor, waits for pending jobs. Any error is logged rather than thrown
+  MDM_API ~mdm_AsyncWriteQueue();
+
+  //! Set the number of background threads
+  /*!
+  Waits for any pending jobs to complete first, so may throw as wait()
+  \param nThreads number of background threads. If 0, jobs are run synchronously
+  \param maxQueued maximum number of jobs waiting to run. If 0, uses
+  DEFAULT_JOBS_PER_THREAD per thread
+  */
+  MDM_API void setNumThreads(size_t nThreads, size_t maxQueued = 0);
+
+  //! Return the number of background threads
+  /*!
+  \return number of threads, 0 if jobs are run synchronously
+  */
+  MDM_API size_t numThreads() const;
+
+  //! Add a job to the queue
+  /*!
+  Blocks while the queue is full
+  \param job function to run. Anything it references must remain valid until wait() returns
+  */
+  MDM_API void submit(std::function<void()> job);
+
+  //! Wait for all submitted jobs to complete
+  /*!
+  Rethrows the first exception thrown by any job since the last call to wait()
+  */
+  MDM_API void wait();
+
+private:
+  //Background thread taking jobs from the queue
+  void worker();
+
+  //Stop and join the background threads, once the queue has been drained
+  void stopThreads();
+
+  size_t nThreads_;
+  size_t maxQueued_;
+
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()> > jobs_;
+  std::mutex mutex_;
+  std::condition_variable jobReady_;
+  std::condition_variable spaceReady_;
+  std::condition_variable jobsDone_;
+  size_t numRunning_;
+  bool stop_;
+  std::exception_ptr error_;
+};
+
+#endif /* MDM_ASYNCWRITEQUEUE_HDR */
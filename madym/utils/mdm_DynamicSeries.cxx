@@ -0,0 +1,211 @@
+/**
+*  @file    mdm_DynamicSeries.cxx
+*  @brief   Implementation of mdm_DynamicSeries class
+*
+*  Original author MA Berks 12 Oct 2022
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_API_EXPORTS
+#define MDM_API_EXPORTS
+#endif
+
+#include <madym/utils/mdm_DynamicSeries.h>
+
+#include <algorithm>
+#include <limits>
+#include <boost/format.hpp>
+#include <madym/utils/mdm_exception.h>
+
+namespace {
+  //Flags a voxel that has not been packed
+  const size_t NOT_PACKED = std::numeric_limits<size_t>::max();
+}
+
+//
+MDM_API mdm_DynamicSeries::mdm_DynamicSeries()
+  :
+  storageType_(mdm_Image3D::STORAGE_DOUBLE),
+  numTimes_(0),
+  numVoxels_(0)
+{}
+
+//
+MDM_API mdm_DynamicSeries::~mdm_DynamicSeries()
+{}
+
+//
+MDM_API void mdm_DynamicSeries::pack(const std::vector<mdm_Image3D> &dynImages,
+  const std::vector<size_t> &voxels)
+{
+  reset();
+  if (dynImages.empty())
+    return;
+
+  const auto numImageVoxels = dynImages[0].numVoxels();
+  for (const auto &img : dynImages)
+    if (img.numVoxels() != numImageVoxels)
+      throw mdm_exception(__func__, boost::format(
+        "Dynamic images must all have the same number of voxels (%1% and %2%)")
+        % numImageVoxels % img.numVoxels());
+
+  setRows(dynImages.size(), numImageVoxels, voxels);
+
+  //Transpose the images into the packed data, reading each image contiguously.
+  //Pack as float if all the images are float, so packing doesn't widen the data
+  const bool packFloat = std::all_of(dynImages.begin(), dynImages.end(),
+    [](const mdm_Image3D &img) {return img.storageType() == mdm_Image3D::STORAGE_FLOAT; });
+  if (packFloat)
+  {
+    storageType_ = mdm_Image3D::STORAGE_FLOAT;
+    dataFloat_.resize(numVoxels_ * numTimes_);
+    for (size_t t = 0; t < numTimes_; t++)
+      packImage(dynImages[t].dataFloat(), voxels, t, dataFloat_);
+  }
+  else
+  {
+    data_.resize(numVoxels_ * numTimes_);
+    for (size_t t = 0; t < numTimes_; t++)
+    {
+      if (dynImages[t].storageType() == mdm_Image3D::STORAGE_FLOAT)
+        packImage(dynImages[t].dataFloat(), voxels, t, data_);
+      else
+        packImage(dynImages[t].data(), voxels, t, data_);
+    }
+  }
+}
+
+//
+MDM_API void mdm_DynamicSeries::allocate(size_t numTimes, size_t numImageVoxels,
+  const std::vector<size_t> &voxels)
+{
+  setRows(numTimes, numImageVoxels, voxels);
+  data_.assign(numVoxels_ * numTimes_, 0.0);
+}
+
+//
+void mdm_DynamicSeries::setRows(size_t numTimes, size_t numImageVoxels,
+  const std::vector<size_t> &voxels)
+{
+  reset();
+  numTimes_ = numTimes;
+
+  if (voxels.empty())
+    numVoxels_ = numImageVoxels;
+
+  else
+  {
+    //Map each voxel in the images to its row in the packed data
+    numVoxels_ = voxels.size();
+    voxelRows_.assign(numImageVoxels, NOT_PACKED);
+    for (size_t row = 0; row < numVoxels_; row++)
+    {
+      if (voxels[row] >= numImageVoxels)
+        throw mdm_exception(__func__, boost::format(
+          "Voxel index %1% out of range for dynamic images with %2% voxels")
+          % voxels[row] % numImageVoxels);
+
+      voxelRows_[voxels[row]] = row;
+    }
+  }
+}
+
+//
+template <class T, class S> void mdm_DynamicSeries::packImage(const std::vector<T> &imgData,
+  const std::vector<size_t> &voxels, size_t t, std::vector<S> &packed)
+{
+  if (voxelRows_.empty())
+  {
+    for (size_t row = 0; row < numVoxels_; row++)
+      packed[row * numTimes_ + t] = imgData[row];
+  }
+  else
+  {
+    for (size_t row = 0; row < numVoxels_; row++)
+      packed[row * numTimes_ + t] = imgData[voxels[row]];
+  }
+}
+
+//
+MDM_API void mdm_DynamicSeries::reset()
+{
+  voxelRows_.clear();
+  data_.clear();
+  dataFloat_.clear();
+  storageType_ = mdm_Image3D::STORAGE_DOUBLE;
+  numTimes_ = 0;
+  numVoxels_ = 0;
+}
+
+//
+MDM_API size_t mdm_DynamicSeries::numTimes() const
+{
+  return numTimes_;
+}
+
+//
+MDM_API size_t mdm_DynamicSeries::numVoxels() const
+{
+  return numVoxels_;
+}
+
+//
+MDM_API mdm_Image3D::StorageType mdm_DynamicSeries::storageType() const
+{
+  return storageType_;
+}
+
+//
+MDM_API bool mdm_DynamicSeries::contains(size_t voxelIndex) const
+{
+  if (!numVoxels_)
+    return false;
+
+  if (voxelRows_.empty())
+    return voxelIndex < numVoxels_;
+
+  return voxelIndex < voxelRows_.size() && voxelRows_[voxelIndex] != NOT_PACKED;
+}
+
+//
+size_t mdm_DynamicSeries::voxelRow(size_t voxelIndex) const
+{
+  if (!contains(voxelIndex))
+    throw mdm_exception(__func__, boost::format(
+      "Voxel %1% not included in packed dynamic series") % voxelIndex);
+
+  return voxelRows_.empty() ? voxelIndex : voxelRows_[voxelIndex];
+}
+
+//
+MDM_API const double* mdm_DynamicSeries::voxelData(size_t voxelIndex) const
+{
+  if (storageType_ != mdm_Image3D::STORAGE_DOUBLE)
+    throw mdm_exception(__func__,
+      "Packed dynamic series is stored as float, time-series must be copied");
+
+  return data_.data() + voxelRow(voxelIndex) * numTimes_;
+}
+
+//
+MDM_API double* mdm_DynamicSeries::voxelData(size_t voxelIndex)
+{
+  return const_cast<double*>(
+    static_cast<const mdm_DynamicSeries&>(*this).voxelData(voxelIndex));
+}
+
+//
+MDM_API void mdm_DynamicSeries::voxelData(size_t voxelIndex, std::vector<double> &data) const
+{
+  const auto start = voxelRow(voxelIndex) * numTimes_;
+  if (storageType_ == mdm_Image3D::STORAGE_FLOAT)
+    data.assign(dataFloat_.begin() + start, dataFloat_.begin() + start + numTimes_);
+  else
+    data.assign(data_.begin() + start, data_.begin() + start + numTimes_);
+}
+
+//
+MDM_API mdm_DynamicSeries::operator bool() const
+{
+  return numVoxels_ && numTimes_;
+}
@@ -0,0 +1,144 @@
+/*!
+*  @file    mdm_DynamicSeries.h
+*  @brief   Class that stores a dynamic series of 3D images in voxel-major order
+*  @details More info...
+*  @author MA Berks (c) Copyright QBI Lab, University of Manchester 2022
+*/
+
+#ifndef MDM_DYNAMICSERIES_HDR
+#define MDM_DYNAMICSERIES_HDR
+
+#include <madym/utils/mdm_api.h>
+
+#include <madym/utils/mdm_Image3D.h>
+#include <vector>
+
+/*!
+*  @brief   Stores a dynamic series of 3D images in voxel-major order
+*  @details A dynamic series loaded as a vector of 3D images stores each time-point
+*  in a separate buffer, so gathering the time-series at a voxel reads one value from
+*  each buffer. This class packs the series once, so that the time-series at
+*  each voxel is stored contiguously and can be read in place. Optionally only a subset
+*  of voxels (eg those in an ROI) are packed. If the images are stored as float, the
+*  series is packed as float too, so it takes no more memory than the images.
+*/
+class mdm_DynamicSeries {
+
+public:
+
+	//! Default constructor
+	/*!
+	*/
+	MDM_API mdm_DynamicSeries();
+
+	//! Default destructor
+	/*!
+	*/
+	MDM_API ~mdm_DynamicSeries();
+
+	//! Pack a dynamic series of images
+	/*!
+	The series is packed as float if all the images are stored as float, otherwise as double.
+	\param dynImages dynamic series of images, all of which must have the same number of voxels
+	\param voxels indices of voxels to pack. If empty, all voxels are packed
+	*/
+	MDM_API void pack(const std::vector<mdm_Image3D> &dynImages,
+		const std::vector<size_t> &voxels = {});
+
+	//! Allocate an empty series, with all values zero, to be filled in place
+	/*!
+	The series is stored as double.
+	\param numTimes number of time-points
+	\param numImageVoxels number of voxels in each image of the series
+	\param voxels indices of voxels to allocate. If empty, all voxels are allocated
+	\see voxelData
+	*/
+	MDM_API void allocate(size_t numTimes, size_t numImageVoxels,
+		const std::vector<size_t> &voxels = {});
+
+	//! Clear all packed data
+	MDM_API void reset();
+
+	//! Return number of time-points in the packed series
+	/*!
+	\return number of time-points
+	*/
+	MDM_API size_t numTimes() const;
+
+	//! Return number of voxels packed
+	/*!
+	\return number of voxels packed
+	*/
+	MDM_API size_t numVoxels() const;
+
+	//! Return whether the packed series is stored as double or float
+	/*!
+	\return storage type of the packed series
+	*/
+	MDM_API mdm_Image3D::StorageType storageType() const;
+
+	//! Check if time-series at voxel has been packed
+	/*!
+	\param voxelIndex index of voxel in the original images
+	\return true if voxel has been packed
+	*/
+	MDM_API bool contains(size_t voxelIndex) const;
+
+	//! Return pointer to the start of the time-series at a voxel
+	/*!
+	The returned pointer addresses numTimes() contiguous values, valid until the
+	series is next packed or reset. Only valid for series stored as double, throws
+	mdm_exception otherwise.
+	\param voxelIndex index of voxel in the original images, must be packed
+	\return pointer to first time-point of voxel
+	\see contains
+	*/
+	MDM_API const double* voxelData(size_t voxelIndex) const;
+
+	//! Return writable pointer to the start of the time-series at a voxel
+	/*!
+	\param voxelIndex index of voxel in the original images, must be packed
+	\return pointer to first time-point of voxel
+	\see contains
+	*/
+	MDM_API double* voxelData(size_t voxelIndex);
+
+	//! Copy the time-series at a voxel
+	/*!
+	\param voxelIndex index of voxel in the original images, must be packed
+	\param data vector, resized to numTimes(), into which the time-series is copied
+	*/
+	MDM_API void voxelData(size_t voxelIndex, std::vector<double> &data) const;
+
+	//! Check if any data has been packed
+	/*!
+	\return true if series packed and not empty
+	*/
+	MDM_API explicit operator bool() const;
+
+private:
+
+	//Set the size of the series and map voxels to rows, without allocating the data
+	void setRows(size_t numTimes, size_t numImageVoxels,
+		const std::vector<size_t> &voxels);
+
+	//Return row of a packed voxel, throws if not packed
+	size_t voxelRow(size_t voxelIndex) const;
+
+	//Copy the values of one image into column t of the packed data
+	template <class T, class S> void packImage(const std::vector<T> &imgData,
+		const std::vector<size_t> &voxels, size_t t, std::vector<S> &packed);
+
+	//Row in data_ of each voxel in the original images, empty if all voxels packed
+	std::vector<size_t> voxelRows_;
+
+	//Packed time-series, voxels x time, stored in data_ or dataFloat_ depending on storageType_
+	std::vector<double> data_;
+	std::vector<float> dataFloat_;
+	mdm_Image3D::StorageType storageType_;
+
+	size_t numTimes_;
+	size_t numVoxels_;
+};
+
+#endif /* MDM_DYNAMICSERIES_HDR */
@@ -16,6 +16,10 @@
 #include <sstream>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
 #include <boost/date_time.hpp>
 #include <boost/format.hpp>
 
@@ -67,7 +71,8 @@ MDM_API mdm_Image3D::mdm_Image3D()
 	nY_(0),
 	nZ_(0),
 	info_(),
-	data_(0)
+	data_(0),
+	storageType_(STORAGE_DOUBLE)
 {   
 	//Set time stamp this can be overridden later using setTimeStamp or read during
 	//setMetaDataFromString
@@ -92,29 +97,72 @@ MDM_API void mdm_Image3D::reset()
 //Return const ref to data
 MDM_API const std::vector<double>& mdm_Image3D::data() const
 {
+  if (storageType_ != STORAGE_DOUBLE)
+    throw mdm_exception(__func__, "Image data is stored as float, use dataFloat()");
+
 	return data_;
 }
 
+//Return const ref to float data
+MDM_API const std::vector<float>& mdm_Image3D::dataFloat() const
+{
+  if (storageType_ != STORAGE_FLOAT)
+    throw mdm_exception(__func__, "Image data is stored as double, use data()");
+
+  return dataFloat_;
+}
+
+//
+MDM_API void mdm_Image3D::setStorageType(StorageType type)
+{
+  if (type == storageType_)
+    return;
+
+  //Convert the values to the new array, then release the old one
+  if (type == STORAGE_FLOAT)
+  {
+    dataFloat_.assign(data_.begin(), data_.end());
+    std::vector<double>().swap(data_);
+  }
+  else
+  {
+    data_.assign(dataFloat_.begin(), dataFloat_.end());
+    std::vector<float>().swap(dataFloat_);
+  }
+  storageType_ = type;
+}
+
+//
+MDM_API mdm_Image3D::StorageType mdm_Image3D::storageType() const
+{
+  return storageType_;
+}
+
 //
 MDM_API double mdm_Image3D::voxel(size_t i) const
 {
-  if (i >= data_.size())
+  const auto n = numVoxels();
+  if (i >= n)
     throw mdm_exception(__func__, boost::format(
       "Attempting to access voxel %1% when there are only %2% voxels")
-      % i % data_.size());
+      % i % n);
 
-  return data_[i];
+  return storageType_ == STORAGE_FLOAT ? dataFloat_[i] : data_[i];
 }
 
 //
 MDM_API void mdm_Image3D::setVoxel(size_t i, double value)
 {
-  if (i >= data_.size())
+  const auto n = numVoxels();
+  if (i >= n)
     throw mdm_exception(__func__, boost::format(
       "Attempting to access voxel %1% when there are only %2% voxels")
-      % i % data_.size());
+      % i % n);
 
-  data_[i] = value;
+  if (storageType_ == STORAGE_FLOAT)
+    dataFloat_[i] = (float)value;
+  else
+    data_[i] = value;
 }
 
 //
@@ -145,7 +193,9 @@ MDM_API void mdm_Image3D::setSlice(size_t z, std::vector<double> values)
 
   size_t offset = nX_ * nY_*z;
 
-  std::copy(values.begin(), values.end(), data_.begin() + offset);
+  visitData([&](auto &data) {
+    std::copy(values.begin(), values.end(), data.begin() + offset);
+  });
 }
 
 //
@@ -193,7 +243,7 @@ MDM_API void mdm_Image3D::getDimensions(size_t &nX, size_t &nY, size_t &nZ) cons
 //
 MDM_API size_t mdm_Image3D::numVoxels() const
 {
-  return data_.size();
+  return storageType_ == STORAGE_FLOAT ? dataFloat_.size() : data_.size();
 }
 
 //
@@ -546,6 +596,9 @@ MDM_API void mdm_Image3D::copy(const mdm_Image3D &imgToCopy)
 	//Copy image data
 	info_ = imgToCopy.info();
 
+	//Match the storage type before setting dimensions, so only that array is allocated
+	setStorageType(imgToCopy.storageType_);
+
 	//Set dimension from the copy, this will reset and resize the data array
 	setDimensions(imgToCopy);
 
@@ -571,7 +624,8 @@ MDM_API void mdm_Image3D::toString(std::string &imgString) const
 		"time stamp is " << timeStamp_ << "\n" <<
 		"info fields: flip angle is " << info_.flipAngle.value() << ", TR is " << info_.TR.value() << ",\n" <<
     "TE is " << info_.TE.value() << " and B is " << info_.B.value() << " (value < 0.0 => not set)\n" <<
-    "and the image data is held at " << &data_ << "\n",
+    "and the image data is held at " <<
+    (storageType_ == STORAGE_FLOAT ? (const void*)&dataFloat_ : (const void*)&data_) << "\n",
   
   imgString = ss.str();
 }
@@ -631,53 +685,114 @@ MDM_API void mdm_Image3D::nonZeroVoxels(std::vector<size_t> &idx, std::vector<do
 {
 	idx.clear();
 	vals.clear();
-	for (size_t i = 0, n = numVoxels(); i < n; i++)
+	visitData([&](const auto &data) {
+		for (size_t i = 0, n = data.size(); i < n; i++)
+		{
+			if (data[i])
+			{
+				idx.push_back(i);
+				vals.push_back(data[i]);
+			}
+		}
+	});
+}
+
+//Reverse byte order of fixed width unsigned integers. Written with shifts so compilers
+//recognise them as byte swaps, and can vectorise loops over buffers
+static inline uint16_t byteSwapped(uint16_t x)
+{
+	return (uint16_t)((x >> 8) | (x << 8));
+}
+
+static inline uint32_t byteSwapped(uint32_t x)
+{
+	return ((x >> 24) & 0x000000FFu) | ((x >> 8) & 0x0000FF00u)
+		| ((x << 8) & 0x00FF0000u) | ((x << 24) & 0xFF000000u);
+}
+
+static inline uint64_t byteSwapped(uint64_t x)
+{
+	return ((uint64_t)byteSwapped((uint32_t)x) << 32) | byteSwapped((uint32_t)(x >> 32));
+}
+
+//Reverse the byte order of each element in a buffer, swapping them as unsigned
+//integers of the same width
+template <class T> static void swapBuffer(T *buffer, size_t n)
+{
+	if constexpr (sizeof(T) > 1)
 	{
-		if (data_[i])
+		using U = typename std::conditional<sizeof(T) == 2, uint16_t,
+			typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type>::type;
+		static_assert(sizeof(U) == sizeof(T), "Unsupported element size for byte swapping");
+
+		for (size_t i = 0; i < n; i++)
 		{
-			idx.push_back(i);
-			vals.push_back(data_[i]);
+			U u;
+			std::memcpy(&u, buffer + i, sizeof(U));
+			u = byteSwapped(u);
+			std::memcpy(buffer + i, &u, sizeof(U));
 		}
 	}
 }
 
+//Read n elements of type T from a stream in one block, swapping byte order if required
+template <class T> static void readBuffer(std::istream &ifs, std::vector<T> &buffer,
+	size_t n, bool swap)
+{
+	buffer.resize(n);
+	if (!n)
+		return;
+
+	ifs.read(reinterpret_cast<char*>(buffer.data()), n * sizeof(T));
+	if ((size_t)ifs.gcount() != n * sizeof(T))
+		throw mdm_exception(__func__, boost::format(
+			"Failed to read data. Read %1% bytes, expected %2%")
+			% ifs.gcount() % (n * sizeof(T)));
+
+	if (swap)
+		swapBuffer(buffer.data(), n);
+}
+
+//Write a buffer to a stream in one block
+template <class T> static void writeBuffer(std::ostream &ofs, const std::vector<T> &buffer)
+{
+	if (!buffer.empty())
+		ofs.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(T));
+}
+
 //
 template <class T> MDM_API void mdm_Image3D::toBinaryStream(std::ostream &ofs, bool nonZero)  const
 {
-	size_t elSize = sizeof(T);
 	if (nonZero)
 	{
-		auto nVoxels = numVoxels();
+		//Cast non-zero values to output type, and save their indices, then
+		//write the values followed by the indices, each in one block
+		//(TODO: behaviour of NAN?)
+		std::vector<T> vals;
 		std::vector<unsigned int> idx;
-		
-		for (size_t i = 0; i < nVoxels; i++)
-		{
-			//Check if element non-zero (TODO: behaviour of NAN?)
-			if (data_[i])
+		visitData([&](const auto &data) {
+			for (size_t i = 0, nVoxels = data.size(); i < nVoxels; i++)
 			{
-				//If non-zero, cast data to output type and write to buffer
-				T t = (T)data_[i];
-				ofs.write(reinterpret_cast<const char*>(&t), elSize);
-
-				//Append index
-				idx.push_back((unsigned int)i);
+				if (data[i])
+				{
+					vals.push_back((T)data[i]);
+					idx.push_back((unsigned int)i);
+				}
 			}
-		}
-		//For the indices we can now write in one chunk as only casting once
-		//from int to char*
-		if (!idx.empty())
-			ofs.write(reinterpret_cast<const char*>(&idx[0]), sizeof(unsigned int)*idx.size());
+		});
+		writeBuffer(ofs, vals);
+		writeBuffer(ofs, idx);
 	}
 	else
 	{
-		//Simple in this case: loop through data vector, cast each element
-		//to output type and then write to buffer
-		for (double d : data_)
-		{
-			T t = (T)d;
-			ofs.write(reinterpret_cast<const char*>(&t), elSize);
-		}
-			
+		//Simple in this case: cast the whole data vector to the output type,
+		//then write in one block
+		std::vector<T> buffer(numVoxels());
+		visitData([&](const auto &data) {
+			std::transform(data.begin(), data.end(), buffer.begin(),
+				[](auto d) {return (T)d; });
+		});
+		writeBuffer(ofs, buffer);
 	}
 }
 
@@ -716,7 +831,7 @@ template <class T> MDM_API void mdm_Image3D::fromBinaryStream(
 		//Get number of elements, by dividing buffer size by the
 		//combined size of input type + integer (because each element
 		//is stored by input type value + integer index
-		size_t intSize = sizeof(int);
+		size_t intSize = sizeof(unsigned int);
 		size_t nNonZero = bufferSize / (intSize + elSize); 
 		
 		//Check here if not divisible
@@ -726,34 +841,22 @@ template <class T> MDM_API void mdm_Image3D::fromBinaryStream(
         "Buffer size (%1%) is not divisble by combined index and value size (%2%)")
         % bufferSize % (intSize + elSize));
 
-		//Set up vectors to store data and indices
-		std::vector<T> data(nNonZero);
-		std::vector<size_t> idx(nNonZero);
-		
-		//TODO: We really should do some error checking of EOF etc here
-		//although we have checked buffer size?
-
-		//First read data values, casting from char* to input type
-		for (T &t : data)
-		{
-			ifs.read(reinterpret_cast<char*>(&t), elSize);
-			if (swap)
-				swapBytes(t);
-		}
-			
-
-		//Read indices - directly casting from char* to int
-		for (size_t &i : idx)
-		{
-			ifs.read(reinterpret_cast<char*>(&i), sizeof(unsigned int));
-			if (swap)
-				swapBytes(i);
-		}
-			
+		//Read all the data values, then all the indices, each in one block
+		std::vector<T> data;
+		std::vector<unsigned int> idx;
+		readBuffer(ifs, data, nNonZero, swap);
+		readBuffer(ifs, idx, nNonZero, swap);
 
 		//Finally loop through data and indices saving into main data array
+		const size_t nVoxels = numVoxels();
 		for (size_t i = 0; i < nNonZero; i++)
-			data_[idx[i]] = (double)data[i];
+		{
+			if (idx[i] >= nVoxels)
+				throw mdm_exception(__func__, boost::format(
+					"Failed to load sparse format data. Index %1% out of range for %2% voxels")
+					% idx[i] % nVoxels);
+			setVoxel(idx[i], (double)data[i]);
+		}
 		
 	}
 	else
@@ -766,17 +869,14 @@ template <class T> MDM_API void mdm_Image3D::fromBinaryStream(
         "Buffer size (%1%) does not match expected size (%2%)")
         % bufferSize % expectedSize);
 
-		//Now we know buffer is correct size, loop through, casting each element
-		//from char* to input type, and then to double for storing in main data array
-		T t;
-		for (double &d : data_)
-		{
-			ifs.read(reinterpret_cast<char*>(&t), elSize);
-			if (swap)
-				swapBytes(t);
-
-			d = (double)t;
-		}
+		//Now we know buffer is correct size, read it in one block as the input type,
+		//then widen to double for storing in main data array
+		std::vector<T> data;
+		readBuffer(ifs, data, numVoxels(), swap);
+		visitData([&](auto &imgData) {
+			std::transform(data.begin(), data.end(), imgData.begin(),
+				[](T d) {return (typename std::decay<decltype(imgData)>::type::value_type)d; });
+		});
 	}
 }
 
@@ -847,17 +947,22 @@ MDM_API mdm_Image3D& mdm_Image3D::operator+=(const mdm_Image3D& rhs)
   if (!dimensionsMatch(rhs))
     throw mdm_dimension_mismatch(__func__, *this, rhs);
 
-  size_t v2 = 0;
-  for (auto & v : this->data_)
-    v += rhs.voxel(v2++);
+  visitData([&](auto &data) {
+    rhs.visitData([&](const auto &rhsData) {
+      for (size_t i = 0, n = data.size(); i < n; i++)
+        data[i] += rhsData[i];
+    });
+  });
   return *this;
 }
 
 //
 MDM_API mdm_Image3D& mdm_Image3D::operator+=(const double d)
 {
-  for (auto & v : this->data_)
-    v += d;
+  visitData([&](auto &data) {
+    for (auto &v : data)
+      v += d;
+  });
   return *this;
 }
 
@@ -867,17 +972,22 @@ MDM_API mdm_Image3D& mdm_Image3D::operator*=(const mdm_Image3D& rhs)
   if (!dimensionsMatch(rhs))
     throw mdm_dimension_mismatch(__func__, *this, rhs);
 
-  size_t v2 = 0;
-  for (auto & v : this->data_)
-    v *= rhs.voxel(v2++);
+  visitData([&](auto &data) {
+    rhs.visitData([&](const auto &rhsData) {
+      for (size_t i = 0, n = data.size(); i < n; i++)
+        data[i] *= rhsData[i];
+    });
+  });
   return *this;
 }
 
 //
 MDM_API mdm_Image3D& mdm_Image3D::operator*=(const double d)
 {
-  for (auto & v : this->data_)
-    v *= d;
+  visitData([&](auto &data) {
+    for (auto &v : data)
+      v *= d;
+  });
   return *this;
 }
 
@@ -887,17 +997,22 @@ MDM_API mdm_Image3D& mdm_Image3D::operator-=(const mdm_Image3D& rhs)
   if (!dimensionsMatch(rhs))
     throw mdm_dimension_mismatch(__func__, *this, rhs);
 
-  size_t v2 = 0;
-  for (auto & v : this->data_)
-    v -= rhs.voxel(v2++);
+  visitData([&](auto &data) {
+    rhs.visitData([&](const auto &rhsData) {
+      for (size_t i = 0, n = data.size(); i < n; i++)
+        data[i] -= rhsData[i];
+    });
+  });
   return *this;
 }
 
 //
 MDM_API mdm_Image3D& mdm_Image3D::operator-=(const double d)
 {
-  for (auto & v : this->data_)
-    v -= d;
+  visitData([&](auto &data) {
+    for (auto &v : data)
+      v -= d;
+  });
   return *this;
 }
 
@@ -907,17 +1022,22 @@ MDM_API mdm_Image3D& mdm_Image3D::operator/=(const mdm_Image3D& rhs)
   if (!dimensionsMatch(rhs))
     throw mdm_dimension_mismatch(__func__, *this, rhs);
 
-  size_t v2 = 0;
-  for (auto & v : this->data_)
-    v /= rhs.voxel(v2++);
+  visitData([&](auto &data) {
+    rhs.visitData([&](const auto &rhsData) {
+      for (size_t i = 0, n = data.size(); i < n; i++)
+        data[i] /= rhsData[i];
+    });
+  });
   return *this;
 }
 
 //
 MDM_API mdm_Image3D& mdm_Image3D::operator/=(const double d)
 {
-  for (auto & v : this->data_)
-    v /= d;
+  visitData([&](auto &data) {
+    for (auto &v : data)
+      v /= d;
+  });
   return *this;
 }
 
@@ -929,5 +1049,7 @@ void mdm_Image3D::initDataArray()
 {
 	//Don't bother error checking this anymore, just assume memory will be managed correctly
 	//that's what the vector container class is for
-	data_.resize(nX_ * nY_ * nZ_);
+	visitData([&](auto &data) {
+		data.resize(nX_ * nY_ * nZ_);
+	});
 }
@@ -144,6 +144,17 @@ class mdm_Image3D
 		TYPE_KINETICMAP, //!< Tracer-kinetic model parameter map
     TYPE_ROI //!< Region of interest mask
 	};
+
+	//! Enum of precisions in which voxel values can be stored
+	/*!
+	Values are always read and written through the API as double, float storage halves
+	the memory used by an image (and the bandwidth needed to process it), at the cost of
+	rounding each voxel value to single precision when it is set.
+	*/
+	enum StorageType {
+		STORAGE_DOUBLE, //!< Voxel values stored as double
+		STORAGE_FLOAT //!< Voxel values stored as float
+	};
 	
 		
 	//!    Default constructor
@@ -168,10 +179,31 @@ class mdm_Image3D
 
 	//! Read only access to the image data array
 	/*!
+	Only valid for images with STORAGE_DOUBLE, throws mdm_exception otherwise.
 	\return const reference to data array
 	*/
 	MDM_API const std::vector<double>& data() const;
 
+	//! Read only access to the image data array of an image stored as float
+	/*!
+	Only valid for images with STORAGE_FLOAT, throws mdm_exception otherwise.
+	\return const reference to data array
+	*/
+	MDM_API const std::vector<float>& dataFloat() const;
+
+	//! Set the precision in which voxel values are stored
+	/*!
+	Converts any existing voxel values to the new storage type.
+	\param type storage type
+	*/
+	MDM_API void setStorageType(StorageType type);
+
+	//! Return the precision in which voxel values are stored
+	/*!
+	\return storage type
+	*/
+	MDM_API StorageType storageType() const;
+
 	//! Return value at specified voxel index
 	/*!
 	\param idx index into data array, using C-style ordering. Must be >=0, < numVoxels()
@@ -364,6 +396,7 @@ class mdm_Image3D
 	 Notes:
 	 -   We don't copy the type as we're usually copying to a new image type
 	 -   We don't copy the time stamp as it doesn't make sense
+	 -   We do copy the storage type, so images derived from float images are also float
 	 \param   imgToCopy image to copy
 	*/
 	MDM_API void copy(const mdm_Image3D &imgToCopy);
@@ -504,6 +537,23 @@ private:
 	*/
 	void initDataArray();
 
+	//Call f with whichever of the data arrays holds the voxel values
+	template <class F> void visitData(F f)
+	{
+		if (storageType_ == STORAGE_FLOAT)
+			f(dataFloat_);
+		else
+			f(data_);
+	}
+
+	template <class F> void visitData(F f) const
+	{
+		if (storageType_ == STORAGE_FLOAT)
+			f(dataFloat_);
+		else
+			f(data_);
+	}
+
 	ImageType imgType_;
 
 	double timeStamp_;
@@ -513,9 +563,15 @@ private:
   size_t nY_; //!< Number of voxels in y-axis
   size_t nZ_; //!< Number of voxels in z-axis (ie slices)
 
-	//! Array of voxels
+	//! Array of voxels, used for STORAGE_DOUBLE
 	std::vector<double> data_;
 
+	//! Array of voxels, used for STORAGE_FLOAT
+	std::vector<float> dataFloat_;
+
+	//! Precision in which voxel values are stored
+	StorageType storageType_;
+
 	//! Image meta data
 	MetaData info_;
 
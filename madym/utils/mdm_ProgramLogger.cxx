@@ -28,6 +28,7 @@
 std::ofstream mdm_ProgramLogger::program_log_stream_;
 std::ofstream mdm_ProgramLogger::audit_log_stream_;
 bool mdm_ProgramLogger::quiet_ = false;
+std::mutex mdm_ProgramLogger::log_mutex_;
 
 #ifdef USING_QT
 mdm_QProgramLogger mdm_ProgramLogger::qLogger_;
@@ -103,6 +104,8 @@ MDM_API bool mdm_ProgramLogger::closeProgramLog()
 //
 MDM_API void mdm_ProgramLogger::logProgramMessage(const std::string &message)
 {
+  std::lock_guard<std::mutex> lock(log_mutex_);
+
 #ifdef USING_QT
   qLogger_.send_log_message(message);
 #endif
@@ -118,6 +121,8 @@ MDM_API void mdm_ProgramLogger::logProgramMessage(const std::string &message)
 //
 MDM_API  void mdm_ProgramLogger::logProgramError(const char *func, const std::string & message)
 {
+  std::lock_guard<std::mutex> lock(log_mutex_);
+
 #ifdef USING_QT
   qLogger_.send_log_message("ERROR in " + std::string(func) + ": " + message);
 #endif
@@ -131,6 +136,8 @@ MDM_API  void mdm_ProgramLogger::logProgramError(const char *func, const std::st
 //
 MDM_API  void mdm_ProgramLogger::logProgramWarning(const char *func, const std::string & message)
 {
+  std::lock_guard<std::mutex> lock(log_mutex_);
+
 #ifdef USING_QT
   qLogger_.send_log_message("WARNING in " + std::string(func) + ": " + message);
 #endif
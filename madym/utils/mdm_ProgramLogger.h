@@ -12,6 +12,7 @@
 
 #include <string>
 #include <fstream>
+#include <mutex>
 
 #ifdef USING_QT
 #include <QObject>
@@ -129,6 +130,7 @@ private:
 	static std::ofstream program_log_stream_;
 	static std::ofstream audit_log_stream_;
   static bool quiet_;
+  static std::mutex log_mutex_; //Guards log streams when logging from worker threads
 
 #ifdef USING_QT
   static mdm_QProgramLogger qLogger_;
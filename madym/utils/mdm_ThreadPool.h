@@ -0,0 +1,135 @@
+/**
+*  @file    mdm_ThreadPool.h
+*  @brief Header only class providing simple fork-join threading for voxel-wise processing
+*
+*  (c) Copyright QBI, University of Manchester 2022
+*/
+
+#ifndef MDM_THREADPOOL_HDR
+#define MDM_THREADPOOL_HDR
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//! Header only class providing simple fork-join threading for voxel-wise processing
+/*!
+Workers are launched with run(), each receiving its thread index so it can set up
+any per-thread state (eg cloned models and fitters). Work is shared out between
+workers by a WorkQueue, from which each worker claims contiguous chunks of item indices
+until the queue is exhausted, so faster workers automatically pick up more work.
+
+Any exception thrown in a worker stops the queue, and the first exception caught
+is rethrown in the calling thread once all workers have joined.
+*/
+class mdm_ThreadPool {
+
+public:
+
+  //! Thread-safe queue of item indices [0, numItems), claimed in chunks
+  class WorkQueue {
+  public:
+    //! Constructor
+    /*!
+    \param numItems total number of items to process
+    \param chunkSize number of items claimed by a worker at a time
+    */
+    WorkQueue(size_t numItems, size_t chunkSize = 1)
+      :
+      numItems_(numItems),
+      chunkSize_(std::max(chunkSize, size_t(1))),
+      next_(0)
+    {}
+
+    //! Claim the next chunk of items
+    /*!
+    \param begin (output) index of first item in chunk
+    \param end (output) one past the index of the last item in chunk
+    \return false if no items remain, true otherwise
+    */
+    bool next(size_t &begin, size_t &end)
+    {
+      begin = next_.fetch_add(chunkSize_);
+      if (begin >= numItems_)
+        return false;
+
+      end = std::min(begin + chunkSize_, numItems_);
+      return true;
+    }
+
+    //! Stop the queue so subsequent calls to next return false
+    void stop()
+    {
+      next_ = numItems_;
+    }
+
+  private:
+    const size_t numItems_;
+    const size_t chunkSize_;
+    std::atomic<size_t> next_;
+  };
+
+  //! Convert user-specified number of threads to actual number of threads to use
+  /*!
+  \param nThreads requested number of threads. If 0, uses number of available hardware threads
+  \param numItems number of items to process, no more threads than items are used
+  \return number of threads to use, always at least 1
+  */
+  static size_t numThreads(int nThreads, size_t numItems)
+  {
+    size_t n = nThreads > 0 ? size_t(nThreads) : size_t(std::thread::hardware_concurrency());
+    return std::max(size_t(1), std::min(n, numItems));
+  }
+
+  //! Run worker on a set of threads, blocking until all complete
+  /*!
+  If nThreads is 1 the worker is run directly in the calling thread.
+  \param nThreads number of worker threads to run
+  \param worker callable with signature void(size_t threadIdx)
+  \param queue if set, stopped as soon as any worker throws
+  */
+  template <typename Worker>
+  static void run(size_t nThreads, Worker worker, WorkQueue *queue = nullptr)
+  {
+    if (nThreads <= 1)
+    {
+      worker(size_t(0));
+      return;
+    }
+
+    std::exception_ptr error = nullptr;
+    std::mutex errorMutex;
+
+    std::vector<std::thread> threads;
+    threads.reserve(nThreads);
+    for (size_t threadIdx = 0; threadIdx < nThreads; threadIdx++)
+    {
+      threads.emplace_back([&, threadIdx]() {
+        try
+        {
+          worker(threadIdx);
+        }
+        catch (...)
+        {
+          std::lock_guard<std::mutex> lock(errorMutex);
+          if (!error)
+            error = std::current_exception();
+          if (queue)
+            queue->stop();
+        }
+      });
+    }
+
+    for (auto &thread : threads)
+      thread.join();
+
+    if (error)
+      std::rethrow_exception(error);
+  }
+
+};
+
+#endif //MDM_THREADPOOL_HDR
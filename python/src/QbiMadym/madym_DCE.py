@@ -53,6 +53,7 @@ def run(
     fixed_values:np.array = None,
     repeat_param:int = None,
     repeat_values:np.array = None,
+    repeat_prune:bool = None,
     upper_bounds:np.array = None,
     lower_bounds:np.array = None,
     relative_limit_params:np.array = None,
@@ -62,6 +63,7 @@ def run(
     residuals:str = None,
     max_iter:int = None,
     opt_type:str = None,
+    nthreads:int = None,
     dyn_noise:bool = None,
     test_enhancement:bool = None,
     img_fmt_r:str = None,
@@ -190,6 +192,8 @@ def run(
             Index of parameter at which repeat fits will be made
         repeat_values : np.array = None,
             Values for repeat parameter
+        repeat_prune : bool = None,
+            Set to stop repeat fits early if they are unlikely to beat the best fit so far
         lower_bounds: np.array = None
 		    Lower bounds for each parameter during optimisation
 	    upper_bounds: np.array = None
@@ -208,6 +212,8 @@ def run(
             Maximum number of iterations to run model fit for
         opt_type: str = None
             Type of optimisation to run
+        nthreads: int = None
+            Number of threads used to fit voxels, 0 uses all available cores
         dyn_noise : bool = None,
             Set to use varying temporal noise in model fit
         test_enhancement : bool = None, 
@@ -386,6 +392,8 @@ def run(
 
     add_option('string', cmd_args, '--opt_type', opt_type)
 
+    add_option('int', cmd_args, '--nthreads', nthreads)
+
     add_option('bool', cmd_args, '--dyn_noise', dyn_noise)
 
     add_option('bool', cmd_args, '--overwrite', overwrite)
@@ -445,6 +453,7 @@ def run(
 
     add_option('int', cmd_args, '--repeat_param', repeat_param)
     add_option('float_list', cmd_args, '--repeat_values', repeat_values)
+    add_option('bool', cmd_args, '--repeat_prune', repeat_prune)
 
     add_option('float_list', cmd_args, '--upper_bounds', upper_bounds)
     add_option('float_list', cmd_args, '--lower_bounds', lower_bounds)
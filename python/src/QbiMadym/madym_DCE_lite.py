@@ -6,7 +6,7 @@ import warnings
 from tempfile import TemporaryDirectory
 import subprocess
 import os
-from QbiMadym.utils import local_madym_root, add_option
+from QbiMadym.utils import local_madym_root, add_option, run_lite_in_process
 
 def run(model=None, input_data=None,
     cmd_exe:str = None,
@@ -40,6 +40,7 @@ def run(model=None, input_data=None,
     fixed_values:np.array = None,
     repeat_param:int = None,
     repeat_values:np.array = None,
+    repeat_prune:bool = None,
     upper_bounds:np.array = None,
     lower_bounds:np.array = None,
     relative_limit_params:np.array = None,
@@ -49,10 +50,12 @@ def run(model=None, input_data=None,
     opt_type:str = None,
     dyn_noise_values:np.array = None,
     test_enhancement:bool = None,
+    nthreads:int = None,
     quiet:bool = None,
     help:bool = None,
     version:bool = None,
-    dummy_run:bool = False
+    dummy_run:bool = False,
+    in_process:bool = False
 ):
     '''
     MADYM_LITE wrapper function to call C++ tool Madym-lite. Fits
@@ -142,6 +145,8 @@ def run(model=None, input_data=None,
             Index of parameter at which repeat fits will be made
         repeat_values : np.array = None,
             Values for repeat parameter
+        repeat_prune : bool = None,
+            Set to stop repeat fits early if they are unlikely to beat the best fit so far
         lower_bounds: np.array = None
 		    Lower bounds for each parameter during optimisation
 	    upper_bounds: np.array = None
@@ -159,6 +164,8 @@ def run(model=None, input_data=None,
             Varying temporal noise in model fit
         test_enhancement : bool default False, 
             Set test-for-enhancement flag
+        nthreads : int = None,
+            Number of threads used to fit time-series, 0 to use all available cores
         quiet : bool = False,
             Do not display logging messages in cout
         help : bool = None,
@@ -167,6 +174,10 @@ def run(model=None, input_data=None,
             Display version and exit
         dummy_run : bool default False 
             Don't run any thing, just print the cmd we'll run to inspect)
+        in_process : bool default False
+            Fit in-process using the compiled madym lite python module (built with
+            BUILD_PYTHON_MODULE), passing arrays directly rather than via temporary
+            files and a madym_DCE_lite sub-process. Output files are not written
     
      Outputs:
           model_params (2D array, Nsamples x Nparams) - each row contains 
@@ -356,6 +367,8 @@ def run(model=None, input_data=None,
 
     add_option('bool', cmd_args, '--test_enh', test_enhancement)
 
+    add_option('int', cmd_args, '--nthreads', nthreads)
+
     add_option('bool', cmd_args, '--quiet', quiet)
 
     add_option('bool', cmd_args, '--help', help)
@@ -399,6 +412,8 @@ def run(model=None, input_data=None,
     
     add_option('float_list', cmd_args, '--repeat_values', repeat_values)
 
+    add_option('bool', cmd_args, '--repeat_prune', repeat_prune)
+
     add_option('float_list', cmd_args, '--upper_bounds', upper_bounds)
 
     add_option('float_list', cmd_args, '--lower_bounds', lower_bounds)
@@ -425,45 +440,57 @@ def run(model=None, input_data=None,
         Ct_s = []
         return model_params, model_fit, iauc, error_codes, Ct_m, Ct_s
 
-    #Write input values to a temporary file
-    np.savetxt(input_file, input_data, fmt='%6.5f')
-
-    #Write input params to a temporary file
     if load_params:
         discard = ~np.isfinite(init_params) | np.isnan(init_params)
         init_params[discard] = 0
-        np.savetxt(input_params_file, init_params, fmt='%6.5f')
 
-    #Write dynamic times to a temporary file if we need to
-    if dyn_times is not None:
-        np.savetxt(dyn_times_file, dyn_times, fmt='%6.5f')
+    if in_process:
+        #Pass the arrays directly to the lite tool, no files are needed
+        print('***********************Madym-lite running in-process **********************')
+        print(cmd_str)
+        outputData = run_lite_in_process('DCE', cmd_args, input_data,
+            initial_params = init_params if load_params else None,
+            dyn_times = dyn_times,
+            dyn_noise = dyn_noise_values)
+
+    else:
+        #Write input values to a temporary file
+        np.savetxt(input_file, input_data, fmt='%6.5f')
+
+        #Write input params to a temporary file
+        if load_params:
+            np.savetxt(input_params_file, init_params, fmt='%6.5f')
+
+        #Write dynamic times to a temporary file if we need to
+        if dyn_times is not None:
+            np.savetxt(dyn_times_file, dyn_times, fmt='%6.5f')
         
-    #Write noise vals to a temporary file if we need to
-    if dyn_noise_values is not None:
-        np.savetxt(dyn_noise_file, dyn_noise_values, fmt='%6.5f')
-
-    #At last.. we can run the command
-    print('***********************Madym-lite running **********************')
-    print(cmd_str)
-    result = subprocess.Popen(cmd_args, shell=False,
-        stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
-    while True:
-        out = result.stdout.readline().decode("utf-8")
-        if out == '' and result.poll() is not None:
-            break
-        if out:
-            print(f"{out}", end='')
-
-    if result.returncode:        
-        input_dir.cleanup()
-        if delete_output:
-            output_temp_dir.cleanup()
-        raise RuntimeError(f'madym_lite failed to execute, returning code {result.returncode}.'
-            f' Command ran was: {cmd_str}')
-
-    #Now load the output from madym lite and extract data to match this
-    #functions outputs
-    outputData = np.atleast_2d(np.loadtxt(full_out_path))
+        #Write noise vals to a temporary file if we need to
+        if dyn_noise_values is not None:
+            np.savetxt(dyn_noise_file, dyn_noise_values, fmt='%6.5f')
+
+        #At last.. we can run the command
+        print('***********************Madym-lite running **********************')
+        print(cmd_str)
+        result = subprocess.Popen(cmd_args, shell=False,
+            stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        while True:
+            out = result.stdout.readline().decode("utf-8")
+            if out == '' and result.poll() is not None:
+                break
+            if out:
+                print(f"{out}", end='')
+
+        if result.returncode:        
+            input_dir.cleanup()
+            if delete_output:
+                output_temp_dir.cleanup()
+            raise RuntimeError(f'madym_lite failed to execute, returning code {result.returncode}.'
+                f' Command ran was: {cmd_str}')
+
+        #Now load the output from madym lite and extract data to match this
+        #functions outputs
+        outputData = np.atleast_2d(np.loadtxt(full_out_path))
 
     error_codes = outputData[:,0:2]
     model_fit = outputData[:,2]
@@ -15,6 +15,8 @@ def run(
     cmd_exe:str = None,
     DWI_vols:list = None,
     Bvals_thresh:list = None,
+    IVIM_restart_tol:float = None,
+    nthreads:int = None,
     roi_name:str = None,
     img_fmt_r:str = None,
     img_fmt_w:str = None,
@@ -67,6 +69,10 @@ def run(
             File names of signal volumes to from which baseline T1 is mapped
         Bvals_thresh:list = None
             Thresholds used in IVIM fitting
+        IVIM_restart_tol:float = None
+            Relative SSR tolerance at which IVIM fits stop trying further thresholds, 0 to fit all
+        nthreads : int = None,
+            Number of threads used to fit voxels, 0 to use all available cores
         roi_name : str = None,
            Path to ROI map
         img_fmt_r : str = None
@@ -174,6 +180,10 @@ def run(
 
     add_option('float_list', cmd_args, '--Bvals_thresh', Bvals_thresh)
 
+    add_option('float', cmd_args, '--IVIM_restart_tol', IVIM_restart_tol)
+
+    add_option('int', cmd_args, '--nthreads', nthreads)
+
     #Now go through all the other optional parameters, and if they've been set,
     #set the necessary option flag in the cmd string
     add_option('bool', cmd_args, '--overwrite', overwrite)
@@ -6,16 +6,19 @@ import warnings
 from tempfile import TemporaryDirectory
 import subprocess
 import os
-from QbiMadym.utils import local_madym_root, add_option
+from QbiMadym.utils import local_madym_root, add_option, run_lite_in_process
 
 def run(model, signals, B_values,
     cmd_exe:str = None,
     output_dir:str = None, 
     output_name:str = 'madym_analysis.dat',
     Bvals_thresh:list = None,
+    IVIM_restart_tol:float = None,
+    nthreads:int = None,
     help:bool = None,
     version:bool = None,
-    dummy_run:bool = False
+    dummy_run:bool = False,
+    in_process:bool = False
 ):
     '''
     MADYM_LITE wrapper function to call C++ tool Madym-lite. Fits
@@ -54,12 +57,20 @@ def run(model, signals, B_values,
             Name of output file
         Bvals_thresh:list = None
             Thresholds used in IVIM fitting
+        IVIM_restart_tol:float = None
+            Relative SSR tolerance at which IVIM fits stop trying further thresholds, 0 to fit all
+        nthreads : int = None,
+            Number of threads used to fit samples, 0 to use all available cores
         help : bool = None,
             Display help and exit
         version : bool = None,
             Display version and exit
         dummy_run : bool default False 
             Don't run any thing, just print the cmd we'll run to inspect
+        in_process : bool default False
+            Fit in-process using the compiled madym lite python module (built with
+            BUILD_PYTHON_MODULE), passing arrays directly rather than via temporary
+            files and a madym_DWI_lite sub-process. Output files are not written
     
      Outputs:
           model_params (2D array, Nsamples x Nparams) - each row contains 
@@ -154,6 +165,10 @@ def run(model, signals, B_values,
 
     add_option('float_list', cmd_args, '--Bvals_thresh', Bvals_thresh)
 
+    add_option('float', cmd_args, '--IVIM_restart_tol', IVIM_restart_tol)
+
+    add_option('int', cmd_args, '--nthreads', nthreads)
+
     add_option('bool', cmd_args, '--help', help)
 
     add_option('bool', cmd_args, '--version', version)
@@ -171,32 +186,39 @@ def run(model, signals, B_values,
         error_codes = []
         return model_params, model_fit, error_codes
 
-    #Write input values to a temporary file
-    np.savetxt(input_file, combined_input, fmt='%6.5f')
-
-
-    #At last.. we can run the command
-    print('***********************Madym-lite running **********************')
-    print(cmd_str)
-    result = subprocess.Popen(cmd_args, shell=False,
-        stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
-    while True:
-        out = result.stdout.readline().decode("utf-8")
-        if out == '' and result.poll() is not None:
-            break
-        if out:
-            print(f"{out}", end='')
-
-    if result.returncode:        
-        input_dir.cleanup()
-        if delete_output:
-            output_temp_dir.cleanup()
-        raise RuntimeError(f'madym_lite failed to execute, returning code {result.returncode}.'
-            f' Command ran was: {cmd_str}')
-
-    #Now load the output from madym lite and extract data to match this
-    #functions outputs
-    outputData = np.atleast_2d(np.loadtxt(full_out_path))
+    if in_process:
+        #Pass the arrays directly to the lite tool, no files are needed
+        print('***********************Madym-lite running in-process **********************')
+        print(cmd_str)
+        outputData = run_lite_in_process('DWI', cmd_args, combined_input)
+
+    else:
+        #Write input values to a temporary file
+        np.savetxt(input_file, combined_input, fmt='%6.5f')
+
+
+        #At last.. we can run the command
+        print('***********************Madym-lite running **********************')
+        print(cmd_str)
+        result = subprocess.Popen(cmd_args, shell=False,
+            stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+        while True:
+            out = result.stdout.readline().decode("utf-8")
+            if out == '' and result.poll() is not None:
+                break
+            if out:
+                print(f"{out}", end='')
+
+        if result.returncode:        
+            input_dir.cleanup()
+            if delete_output:
+                output_temp_dir.cleanup()
+            raise RuntimeError(f'madym_lite failed to execute, returning code {result.returncode}.'
+                f' Command ran was: {cmd_str}')
+
+        #Now load the output from madym lite and extract data to match this
+        #functions outputs
+        outputData = np.atleast_2d(np.loadtxt(full_out_path))
 
     model_params = outputData[:, 0:-2]
     model_fit = outputData[:,-2]      
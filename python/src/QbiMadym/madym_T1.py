@@ -8,7 +8,7 @@ import numpy as np
 from tempfile import TemporaryDirectory
 
 from QbiPy.image_io.analyze_format import read_analyze, write_analyze
-from QbiMadym.utils import local_madym_root, add_option
+from QbiMadym.utils import local_madym_root, add_option, run_lite_in_process
 
 def  run(
     config_file = None,
@@ -24,6 +24,10 @@ def  run(
     output_dir:str = None,
     output_name:str = 'madym_analysis.dat',
     noise_thresh:float = None,
+    nthreads:int = None,
+    closed_form_init:bool = None,
+    dict_refine:bool = None,
+    linear_refine_tol:float = None,
     roi_name:str = None,
     program_log_name:str = None,
     audit_dir:str = None,
@@ -44,7 +48,8 @@ def  run(
     overwrite:bool = None,
     working_directory:str = None,
     return_maps:bool = False,
-    dummy_run:bool = False
+    dummy_run:bool = False,
+    in_process:bool = False
 ):
     '''
     MADYM_T1 wrapper function to call C++ T1 calculator, applying the
@@ -93,6 +98,14 @@ def  run(
 			 Name of output file
         noise_thresh : float default None, 
 			PD noise threshold
+        nthreads : int default None,
+			Number of threads used to map T1, 0 uses all available cores
+        closed_form_init : bool default None,
+			If set, IR_E fits are initialised from a closed-form estimate of T1 and M0
+        dict_refine : bool default None,
+			If set, T1 matched by dictionary methods (eg VFA_DICT) is refined with a Gauss-Newton step
+        linear_refine_tol : float default None,
+			If > 0, VFA_LINEAR fits with relative residual above this are refined with a nonlinear fit
         roi_name : str default None,
 			Path to ROI map
         program_log_name : str = None, 
@@ -135,6 +148,10 @@ def  run(
             If true, attempt to load output T1/M0 maps. Only currently works for Analyze output
         dummy_run : bool default False 
 			Don't run any thing, just print the cmd we'll run to inspect
+        in_process : bool default False
+            When fitting directly supplied data, fit in-process using the compiled madym lite
+            python module (built with BUILD_PYTHON_MODULE), passing arrays directly rather than
+            via temporary files and a madym_T1_lite sub-process. Output files are not written
     
      Outputs:
           
@@ -161,7 +178,9 @@ def  run(
     
        All T1 methods implemented in the main MaDym and MaDym-Lite C++ tools are
        available to fit. Currently these are VFA (+ optional B1 correction) and
-       IR
+       IR (+ optional efficiency weighting, IR_E), their dictionary matching
+       versions VFA_DICT, VFA_B1_DICT, IR_DICT and IR_E_DICT, and closed-form
+       linear VFA fits VFA_LINEAR and VFA_B1_LINEAR
     
      Created: 20-Feb-2019
      Author: Michael Berks 
@@ -242,6 +261,14 @@ def  run(
         add_option('string', cmd_args, '--roi', roi_name)
     
         add_option('float', cmd_args, '--T1_noise', noise_thresh)
+
+        add_option('int', cmd_args, '--nthreads', nthreads)
+
+        add_option('bool', cmd_args, '--T1_closed_form_init', closed_form_init)
+
+        add_option('bool', cmd_args, '--T1_dict_refine', dict_refine)
+
+        add_option('float', cmd_args, '--T1_linear_refine_tol', linear_refine_tol)
     
         add_option('bool', cmd_args, '--no_audit', no_audit)
 
@@ -304,6 +331,14 @@ def  run(
             )
             add_option('bool', cmd_args, '--B1_correction', True)
 
+        add_option('int', cmd_args, '--nthreads', nthreads)
+
+        add_option('bool', cmd_args, '--T1_closed_form_init', closed_form_init)
+
+        add_option('bool', cmd_args, '--T1_dict_refine', dict_refine)
+
+        add_option('float', cmd_args, '--T1_linear_refine_tol', linear_refine_tol)
+
         add_option('bool', cmd_args, '--quiet', quiet)
         
         #Check for bad samples, these can screw up Madym as the lite version
@@ -338,6 +373,20 @@ def  run(
         result = []
         return T1, M0, error_codes, result
 
+    if use_lite and in_process:
+        #Pass the arrays directly to madym_T1_lite, no files are needed
+        print('***********************Madym-T1 running in-process **********************')
+        print(cmd_str)
+        output_data = run_lite_in_process('T1', cmd_args, combined_input)
+        T1 = output_data[:,0]
+        M0 = output_data[:,1]
+        error_codes = output_data[:,2]
+
+        input_dir.cleanup()
+        if delete_output:
+            output_temp_dir.cleanup()
+        return T1, M0, error_codes, None
+
     #For the lite method, no we can write the temporary files
     if use_lite:
         #Write input values to a temporary file
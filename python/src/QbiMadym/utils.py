@@ -11,7 +11,10 @@ import tkinter as tk
 from tkinter import filedialog, messagebox
 import warnings
 import subprocess
+import importlib.machinery
+import importlib.util
 from shutil import copyfile
+import numpy as np
 
 #-------------------------------------------------------------------------------------------
 def latest_madym_version():
@@ -114,6 +117,84 @@ def local_madym_version(cmd_exe:str=None):
     version = result.stdout.rstrip()
     return version
 
+#-------------------------------------------------------------------------------------
+_madym_lite_module = None
+
+def load_madym_lite_module(madym_root:str=None):
+    '''LOAD_MADYM_LITE_MODULE load the compiled python module running the lite tools in-process
+       [module] = load_madym_lite_module()
+    
+     Inputs:
+           madym_root (str - []) - folder containing the module, if not set uses
+           local_madym_root
+    
+     Outputs:
+           module - the _madym_lite extension module
+    
+     Example: madym_lite = load_madym_lite_module()
+    
+     Notes: The module is only built if madym was configured with BUILD_PYTHON_MODULE,
+     and is installed alongside the madym tools. It must have been built for the same
+     version of python as the calling interpreter.
+    '''
+    global _madym_lite_module
+    if _madym_lite_module is not None:
+        return _madym_lite_module
+
+    if not madym_root:
+        madym_root = local_madym_root()
+        if not madym_root:
+            raise ValueError('MADYM_ROOT not found, can not load the madym lite python module.')
+
+    for suffix in importlib.machinery.EXTENSION_SUFFIXES:
+        module_path = os.path.join(madym_root, '_madym_lite' + suffix)
+        if os.path.exists(module_path):
+            spec = importlib.util.spec_from_file_location('_madym_lite', module_path)
+            module = importlib.util.module_from_spec(spec)
+            spec.loader.exec_module(module)
+            _madym_lite_module = module
+            return module
+
+    raise ImportError(f'madym lite python module not found in {madym_root}.'
+        ' Check madym was built with BUILD_PYTHON_MODULE for this version of python')
+
+#-------------------------------------------------------------------------------------
+def run_lite_in_process(tool:str, cmd_args:list, input_data:np.array, **arrays):
+    '''RUN_LITE_IN_PROCESS run a madym lite tool in-process, without writing data to file
+       [output_data] = run_lite_in_process(tool, cmd_args, input_data, **arrays)
+    
+     Inputs:
+           tool (str) - lite tool to run, one of 'DCE', 'T1' or 'DWI'
+           
+           cmd_args (list) - command to run the equivalent lite tool executable, the
+           first entry must be the executable path. Any data file options are ignored
+           
+           input_data (np.array) - 2D input data (Nsamples x Ncolumns), with the same
+           columns as the lite tool's input data file
+           
+           arrays - optional additional arrays, passed to the module's run function
+           (eg initial_params, dyn_times, dyn_noise for DCE). None values are ignored
+    
+     Outputs:
+           output_data (np.array) - 2D output data (Nsamples x Noutputs), with the same
+           columns as the lite tool's output data file
+    
+     Notes: Arrays that are already C-contiguous float64 are passed to the C++ tool
+     without copying. Fitting runs with the GIL released, in parallel if the --nthreads
+     option is set.
+    '''
+    madym_lite = load_madym_lite_module(os.path.dirname(cmd_args[0]))
+    run_func = getattr(madym_lite, f'run_{tool}_lite')
+
+    input_data = np.ascontiguousarray(input_data, dtype=np.float64)
+    arrays = {key : np.ascontiguousarray(val, dtype=np.float64) 
+        for key, val in arrays.items() if val is not None}
+    
+    outputs, n_cols = run_func(cmd_args[1:], input_data, **arrays)
+    if not n_cols:
+        return np.zeros((0,0))
+    return np.frombuffer(outputs, dtype=np.float64).reshape(-1, n_cols)
+
 #-------------------------------------------------------------------------------------
 def set_madym_root(madym_root:str=None, 
     add_to_conda_env:bool = True, add_to_bashrc:bool = None, add_to_bash_profile:bool = None):